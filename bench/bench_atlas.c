@@ -0,0 +1,506 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "geometry.h"
+#include "isosurface.h"
+#include "presets.h"
+#include "render.h"
+#include "rings.h"
+#include "sasa.h"
+#include "text.h"
+#include "thread_pool.h"
+
+// Micro and whole-frame benchmarks for atlas_core. Every case is timed by
+// doubling its iteration count until one run lasts --min-time seconds.
+//
+//   bench_atlas [--filter SUBSTR] [--min-time SECONDS] [--json FILE] [--list]
+
+#define FRAME_WIDTH 1600
+#define FRAME_HEIGHT 900
+#define GRID_COLS 5
+#define GRID_ROWS 4
+#define MAX_RESULTS 128
+
+typedef void (*BenchFn)(void *ctx, long iterations);
+
+typedef struct {
+    char name[64];
+    int size;
+    long iterations;
+    double nsPerOp;
+} BenchResult;
+
+typedef struct {
+    const char *filter;
+    double minTime;
+    bool listOnly;
+    BenchResult results[MAX_RESULTS];
+    int resultCount;
+} BenchRun;
+
+static volatile float benchSink;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rng_state = 0x9E3779B9u;
+
+static float rng_float(void){
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (float)(rng_state >> 8) / 16777216.0f;
+}
+
+static void run_case(BenchRun *run, const char *name, int size, BenchFn fn, void *ctx){
+    if(run->filter && !strstr(name, run->filter)) return;
+    if(run->listOnly){
+        printf("%s/%d\n", name, size);
+        return;
+    }
+    if(run->resultCount == MAX_RESULTS) return;
+
+    fn(ctx, 1); // warm caches and lazily built tables
+
+    long iterations = 1;
+    double elapsed = 0.0;
+    for(;;){
+        double start = now_seconds();
+        fn(ctx, iterations);
+        elapsed = now_seconds() - start;
+        if(elapsed >= run->minTime || iterations >= (1L << 40)) break;
+        // Jump straight to the estimate once a run is long enough to trust.
+        long next = iterations * 2;
+        if(elapsed > 0.01) next = (long)((double)iterations * run->minTime * 1.2 / elapsed) + 1;
+        iterations = next > iterations ? next : iterations + 1;
+    }
+
+    BenchResult *r = &run->results[run->resultCount++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->size = size;
+    r->iterations = iterations;
+    r->nsPerOp = elapsed * 1e9 / (double)iterations;
+
+    printf("%-28s %7d %12ld %14.1f ns/op\n", name, size, iterations, r->nsPerOp);
+    fflush(stdout);
+}
+
+static bool write_json(const BenchRun *run, const char *path){
+    FILE *f = fopen(path, "w");
+    if(!f) return false;
+
+    fprintf(f, "{\n  \"threads\": %d,\n  \"min_time\": %.3f,\n  \"benchmarks\": [\n",
+            thread_pool_size(), run->minTime);
+    for(int i = 0; i < run->resultCount; i++){
+        const BenchResult *r = &run->results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"size\": %d, \"iterations\": %ld, \"ns_per_op\": %.3f, \"ops_per_sec\": %.3f}%s\n",
+                r->name, r->size, r->iterations, r->nsPerOp, 1e9 / r->nsPerOp,
+                i + 1 < run->resultCount ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+// ---- transform ----
+
+typedef struct {
+    Vec3 *points;
+    int count;
+} TransformCtx;
+
+// What draw_molecule does per atom: trig per point, then projection.
+static void bench_transform_yaw_pitch(void *ctx, long iterations){
+    TransformCtx *t = ctx;
+    float acc = 0.0f;
+    for(long it = 0; it < iterations; it++){
+        float yaw = 0.01f * (float)it;
+        for(int i = 0; i < t->count; i++){
+            int sx, sy;
+            float d;
+            project_to_screen(rotate_yaw_pitch(t->points[i], yaw, 0.5f), 40.0f, 800, 450, &sx, &sy, &d);
+            acc += (float)(sx + sy) + d;
+        }
+    }
+    benchSink = acc;
+}
+
+static void bench_transform_cos_sin(void *ctx, long iterations){
+    TransformCtx *t = ctx;
+    float acc = 0.0f;
+    for(long it = 0; it < iterations; it++){
+        float yaw = 0.01f * (float)it;
+        float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(0.5f), sp = sinf(0.5f);
+        for(int i = 0; i < t->count; i++){
+            int sx, sy2;
+            float d;
+            project_to_screen(rotate_cos_sin(t->points[i], cy, sy, cp, sp), 40.0f, 800, 450, &sx, &sy2, &d);
+            acc += (float)(sx + sy2) + d;
+        }
+    }
+    benchSink = acc;
+}
+
+// ---- sort ----
+
+typedef struct {
+    AtomDraw *source;
+    AtomDraw *work;
+    int count;
+} SortCtx;
+
+static void bench_sort_atoms(void *ctx, long iterations){
+    SortCtx *s = ctx;
+    for(long it = 0; it < iterations; it++){
+        memcpy(s->work, s->source, sizeof(AtomDraw) * (size_t)s->count);
+        qsort(s->work, (size_t)s->count, sizeof(AtomDraw), sort_atoms_far_to_near);
+    }
+    benchSink = s->work[0].depth;
+}
+
+// ---- rasterization ----
+
+typedef struct {
+    SDL_Renderer *renderer;
+    CommandBuffer *cb;
+    int radius;
+    int length;
+    int thickness;
+} RasterCtx;
+
+// Record and submit each primitive on its own, as the worst case.
+static void bench_circle(void *ctx, long iterations){
+    RasterCtx *r = ctx;
+    for(long it = 0; it < iterations; it++){
+        int x = 100 + (int)(it % 1400);
+        command_buffer_reset(r->cb);
+        cmd_color(r->cb, 200, 120, 80, 255);
+        draw_filled_circle(r->cb, x, 450, r->radius);
+        command_buffer_submit(r->cb, r->renderer, NULL);
+    }
+}
+
+static void bench_thick_line(void *ctx, long iterations){
+    RasterCtx *r = ctx;
+    for(long it = 0; it < iterations; it++){
+        float angle = 0.37f * (float)it;
+        int x1 = 800, y1 = 450;
+        int x2 = x1 + (int)lroundf(cosf(angle) * (float)r->length);
+        int y2 = y1 + (int)lroundf(sinf(angle) * (float)r->length);
+        command_buffer_reset(r->cb);
+        cmd_color(r->cb, 80, 200, 120, 255);
+        draw_thick_line(r->cb, x1, y1, x2, y2, r->thickness);
+        command_buffer_submit(r->cb, r->renderer, NULL);
+    }
+}
+
+// ---- text ----
+
+typedef struct {
+    SDL_Renderer *renderer;
+    CommandBuffer *cb;
+    const SubmitResources *resources;
+    int count;
+} TextCtx;
+
+// One element symbol per atom of a large focus view, recorded and submitted.
+static void bench_text_labels(void *ctx, long iterations){
+    TextCtx *t = ctx;
+    for(long it = 0; it < iterations; it++){
+        command_buffer_reset(t->cb);
+        for(int i = 0; i < t->count; i++){
+            int x = 20 + (int)((i * 37 + it) % 1500);
+            int y = 20 + (i * 53) % 840;
+            draw_text(t->cb, x, y, 1, 0xF5F5FFFF, element_symbol((uint8_t)(i % 5)));
+        }
+        command_buffer_submit(t->cb, t->renderer, t->resources);
+    }
+}
+
+// ---- rings ----
+
+typedef struct {
+    const MoleculeGeometry *molecules;
+    int count;
+    bool cached;
+} RingCtx;
+
+// One op is one molecule, cycling through the set.
+static void bench_rings(void *ctx, long iterations){
+    RingCtx *r = ctx;
+    RingInfo info;
+    int aromatic = 0;
+    for(long it = 0; it < iterations; it++){
+        const MoleculeGeometry *mol = &r->molecules[it % r->count];
+        if(r->cached) aromatic += ring_info_cached(mol)->ringCount;
+        else {
+            perceive_rings(mol, &info);
+            aromatic += info.ringCount;
+        }
+    }
+    benchSink = (float)aromatic;
+}
+
+// Linearly fused benzene rings in Kekule form: 4n + 2 carbons.
+static void build_acene(MoleculeGeometry *mol, int rings){
+    memset(mol, 0, sizeof(*mol));
+    float h = 1.4f * 0.8660254f;
+    for(int i = 0; i <= rings; i++){
+        float x = (float)i * 2.0f * h;
+        add_atom(mol, make_vec3(x, 0.7f, 0.0f), 0);
+        add_atom(mol, make_vec3(x, -0.7f, 0.0f), 0);
+        add_bond(mol, 2 * i, 2 * i + 1, i == 0 ? 2 : 1);
+    }
+    int top = mol->atomCount;
+    for(int i = 0; i < rings; i++){
+        float x = ((float)i * 2.0f + 1.0f) * h;
+        add_atom(mol, make_vec3(x, 1.4f, 0.0f), 0);
+        add_atom(mol, make_vec3(x, -1.4f, 0.0f), 0);
+        int t = top + 2 * i, b = t + 1;
+        add_bond(mol, 2 * i, t, 1);
+        add_bond(mol, t, 2 * i + 2, 2);
+        add_bond(mol, 2 * i + 1, b, 1);
+        add_bond(mol, b, 2 * i + 3, 2);
+    }
+}
+
+// ---- frames ----
+
+typedef struct {
+    SDL_Renderer *renderer; // NULL: record the frame without submitting it
+    CommandBuffer *cb;
+    const SubmitResources *resources;
+    RenderMode mode;
+    int tileCount;
+    const MoleculeGeometry *molecules; // one per tile
+    const SasaCache *sasa;
+    const SurfaceCache *mesh;
+} FrameCtx;
+
+static RectI tile_rect(int index){
+    int col = index % GRID_COLS;
+    int row = index / GRID_COLS;
+    int padding = 14;
+    int tileW = (FRAME_WIDTH - padding * (GRID_COLS + 1)) / GRID_COLS;
+    int tileH = (FRAME_HEIGHT - padding * (GRID_ROWS + 1)) / GRID_ROWS;
+    return (RectI){ padding + col * (tileW + padding), padding + row * (tileH + padding), tileW, tileH };
+}
+
+static void bench_frame(void *ctx, long iterations){
+    FrameCtx *f = ctx;
+    ViewControl view;
+    reset_view_control(&view);
+
+    for(long it = 0; it < iterations; it++){
+        float t = 0.016f * (float)it;
+        command_buffer_reset(f->cb);
+        for(int i = 0; i < f->tileCount; i++){
+            RectI rect = f->tileCount == 1 ? (RectI){ 20, 20, FRAME_WIDTH - 40, FRAME_HEIGHT - 40 } : tile_rect(i);
+            build_molecule(f->cb, &compounds[i % COMPOUND_COUNT], &f->molecules[i], &rect,
+                           f->tileCount == 1, f->mode, &f->sasa[i], &f->mesh[i], t, &view, true, NULL);
+        }
+        if(!f->renderer) continue;
+        SDL_SetRenderDrawColor(f->renderer, 10, 10, 12, 255);
+        SDL_RenderClear(f->renderer);
+        command_buffer_submit(f->cb, f->renderer, f->resources);
+        SDL_RenderPresent(f->renderer);
+    }
+}
+
+// A helical chain of n atoms with every fifth bond double; the heteroatom
+// mix follows the presets so per-label paths are exercised.
+static void build_helix(MoleculeGeometry *mol, int n){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < n && i < MAX_ATOMS; i++){
+        float a = 0.9f * (float)i;
+        uint8_t label = (i % 11 == 3) ? 1 : (i % 17 == 5) ? 2 : 0;
+        add_atom(mol, make_vec3(cosf(a) * 2.2f, sinf(a) * 2.2f, 0.25f * (float)i - 0.125f * (float)n), label);
+        if(i > 0) add_bond(mol, i - 1, i, (i % 5 == 0) ? 2 : 1);
+    }
+}
+
+static const char *mode_name(RenderMode mode){
+    switch(mode){
+        case RENDER_BALL_AND_STICK: return "ball_and_stick";
+        case RENDER_WIREFRAME: return "wireframe";
+        case RENDER_DOTS: return "dots";
+        case RENDER_SURFACE: return "surface";
+        default: return "unknown";
+    }
+}
+
+static void usage(const char *argv0){
+    fprintf(stderr, "usage: %s [--filter SUBSTR] [--min-time SECONDS] [--json FILE] [--list]\n", argv0);
+}
+
+int main(int argc, char **argv){
+    BenchRun *run = calloc(1, sizeof(BenchRun));
+    if(!run) return 1;
+    run->minTime = 0.25;
+    const char *jsonPath = NULL;
+
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) run->filter = argv[++i];
+        else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) run->minTime = atof(argv[++i]);
+        else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else if(strcmp(argv[i], "--list") == 0) run->listOnly = true;
+        else {
+            usage(argv[0]);
+            free(run);
+            return 2;
+        }
+    }
+    if(run->minTime <= 0.0) run->minTime = 0.25;
+
+    // Frames go to a software renderer on an offscreen surface, so results
+    // do not depend on the GPU driver or vsync.
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, FRAME_WIDTH, FRAME_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if(!renderer){
+        fprintf(stderr, "bench_atlas: cannot create software renderer: %s\n", SDL_GetError());
+        free(run);
+        return 1;
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    SubmitResources resources = { NULL, 0, glyph_atlas_create(renderer) };
+
+    if(!run->listOnly) printf("%-28s %7s %12s %14s\n", "benchmark", "size", "iterations", "time");
+
+    static const int transformSizes[] = { 64, 1024, 16384 };
+    for(size_t s = 0; s < sizeof(transformSizes) / sizeof(transformSizes[0]); s++){
+        TransformCtx t = { malloc(sizeof(Vec3) * (size_t)transformSizes[s]), transformSizes[s] };
+        for(int i = 0; i < t.count; i++){
+            t.points[i] = make_vec3(rng_float() * 12.0f - 6.0f, rng_float() * 12.0f - 6.0f, rng_float() * 12.0f - 6.0f);
+        }
+        run_case(run, "transform_yaw_pitch", t.count, bench_transform_yaw_pitch, &t);
+        run_case(run, "transform_cos_sin", t.count, bench_transform_cos_sin, &t);
+        free(t.points);
+    }
+
+    static const int sortSizes[] = { 64, 1024, 16384 };
+    for(size_t s = 0; s < sizeof(sortSizes) / sizeof(sortSizes[0]); s++){
+        int n = sortSizes[s];
+        SortCtx sc = { malloc(sizeof(AtomDraw) * (size_t)n), malloc(sizeof(AtomDraw) * (size_t)n), n };
+        for(int i = 0; i < n; i++){
+            sc.source[i] = (AtomDraw){ i, rng_float() * 20.0f - 10.0f, 0, 0, 7, 0xFFFFFFFF };
+        }
+        run_case(run, "sort_atoms", n, bench_sort_atoms, &sc);
+        free(sc.source);
+        free(sc.work);
+    }
+
+    static const int circleRadii[] = { 4, 8, 16, 32 };
+    for(size_t s = 0; s < sizeof(circleRadii) / sizeof(circleRadii[0]); s++){
+        RasterCtx rc = { renderer, &cb, circleRadii[s], 0, 0 };
+        run_case(run, "raster_circle", rc.radius, bench_circle, &rc);
+    }
+
+    static const int lineShapes[][2] = { {50, 2}, {50, 8}, {200, 2}, {200, 8} };
+    for(size_t s = 0; s < sizeof(lineShapes) / sizeof(lineShapes[0]); s++){
+        RasterCtx rc = { renderer, &cb, 0, lineShapes[s][0], lineShapes[s][1] };
+        char name[64];
+        snprintf(name, sizeof(name), "raster_line_t%d", rc.thickness);
+        run_case(run, name, rc.length, bench_thick_line, &rc);
+    }
+
+    static const int labelCounts[] = { 100, 1000 };
+    for(size_t s = 0; s < sizeof(labelCounts) / sizeof(labelCounts[0]); s++){
+        TextCtx tc = { renderer, &cb, &resources, labelCounts[s] };
+        run_case(run, "text_labels", tc.count, bench_text_labels, &tc);
+    }
+
+    static MoleculeGeometry ringSet[COMPOUND_COUNT];
+    for(int i = 0; i < COMPOUND_COUNT; i++) apply_preset(&ringSet[i], compounds[i].presetType);
+    RingCtx rings = { ringSet, COMPOUND_COUNT, false };
+    run_case(run, "perceive_rings_presets", COMPOUND_COUNT, bench_rings, &rings);
+    rings.cached = true;
+    run_case(run, "ring_cache_presets", COMPOUND_COUNT, bench_rings, &rings);
+    static const int aceneSizes[] = { 1, 3, 10 };
+    for(size_t s = 0; s < sizeof(aceneSizes) / sizeof(aceneSizes[0]); s++){
+        MoleculeGeometry acene;
+        build_acene(&acene, aceneSizes[s]);
+        RingCtx rc = { &acene, 1, false };
+        run_case(run, "perceive_rings_acene", aceneSizes[s], bench_rings, &rc);
+    }
+
+    // Full frames: the 20-compound grid, and one large view of synthetic
+    // molecules of increasing size. build_grid_* is the builder thread's
+    // share of a grid frame; the rest of frame_grid_* is submission.
+    MoleculeGeometry *molecules = calloc(COMPOUND_COUNT, sizeof(MoleculeGeometry));
+    SasaCache *sasa = calloc(COMPOUND_COUNT, sizeof(SasaCache));
+    SurfaceCache *mesh = calloc(COMPOUND_COUNT, sizeof(SurfaceCache));
+    if(!molecules || !sasa || !mesh){
+        fprintf(stderr, "bench_atlas: out of memory\n");
+        return 1;
+    }
+
+    for(int mode = 0; mode < RENDER_MODE_COUNT; mode++){
+        char name[64];
+        char buildName[64];
+        snprintf(name, sizeof(name), "frame_grid_%s", mode_name((RenderMode)mode));
+        snprintf(buildName, sizeof(buildName), "build_grid_%s", mode_name((RenderMode)mode));
+        if(run->filter && !strstr(name, run->filter) && !strstr(buildName, run->filter)) continue;
+
+        for(int i = 0; i < COMPOUND_COUNT; i++){
+            apply_preset(&molecules[i], compounds[i].presetType);
+            sasa_cache_init(&sasa[i]);
+            surface_cache_init(&mesh[i]);
+            if(mode == RENDER_DOTS) sasa_update(&sasa[i], &molecules[i]);
+            if(mode == RENDER_SURFACE) surface_cache_update(&mesh[i], &molecules[i]);
+        }
+        FrameCtx fc = { renderer, &cb, &resources, (RenderMode)mode, COMPOUND_COUNT, molecules, sasa, mesh };
+        run_case(run, name, COMPOUND_COUNT, bench_frame, &fc);
+        fc.renderer = NULL;
+        run_case(run, buildName, COMPOUND_COUNT, bench_frame, &fc);
+        for(int i = 0; i < COMPOUND_COUNT; i++) surface_cache_free(&mesh[i]);
+    }
+
+    static const int helixSizes[] = { 16, 32, MAX_ATOMS };
+    for(int mode = 0; mode < RENDER_MODE_COUNT; mode++){
+        char name[64];
+        snprintf(name, sizeof(name), "frame_focus_%s", mode_name((RenderMode)mode));
+        if(run->filter && !strstr(name, run->filter)) continue;
+
+        for(size_t s = 0; s < sizeof(helixSizes) / sizeof(helixSizes[0]); s++){
+            build_helix(&molecules[0], helixSizes[s]);
+            sasa_cache_init(&sasa[0]);
+            surface_cache_init(&mesh[0]);
+            if(mode == RENDER_DOTS) sasa_update(&sasa[0], &molecules[0]);
+            if(mode == RENDER_SURFACE) surface_cache_update(&mesh[0], &molecules[0]);
+
+            FrameCtx fc = { renderer, &cb, &resources, (RenderMode)mode, 1, molecules, sasa, mesh };
+            run_case(run, name, helixSizes[s], bench_frame, &fc);
+            surface_cache_free(&mesh[0]);
+        }
+    }
+
+    int status = 0;
+    if(jsonPath && !run->listOnly){
+        if(write_json(run, jsonPath)) printf("wrote %s\n", jsonPath);
+        else {
+            fprintf(stderr, "bench_atlas: cannot write %s\n", jsonPath);
+            status = 1;
+        }
+    }
+
+    free(molecules);
+    free(sasa);
+    free(mesh);
+    command_buffer_free(&cb);
+    if(resources.glyphs) SDL_DestroyTexture(resources.glyphs);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    thread_pool_shutdown();
+    free(run);
+    return status;
+}
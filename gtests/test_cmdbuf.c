@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/cmdbuf.h"
+#include "../src/pipeline.h"
+#include "../src/render.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void test_batching(void){
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+
+    cmd_color(&cb, 1, 2, 3, 255);
+    cmd_color(&cb, 4, 5, 6, 255);
+    assert_true(cb.cmdCount == 1 && cb.cmds[0].r == 4, "unused colour is replaced");
+
+    for(int i = 0; i < 100; i++) cmd_point(&cb, i, i);
+    for(int i = 0; i < 10; i++) cmd_fill_rect(&cb, i, 0, 1, 1);
+    cmd_color(&cb, 9, 9, 9, 255);
+    for(int i = 0; i < 10; i++) cmd_fill_rect(&cb, i, 1, 1, 1);
+    assert_true(cb.cmdCount == 5, "runs of points and rects merge into one command each");
+    assert_true(cb.cmds[1].type == CMD_POINTS && cb.cmds[1].count == 100, "100 points in one call");
+    assert_true(cb.cmds[2].type == CMD_FILL_RECTS && cb.cmds[2].count == 10, "first rect run");
+    assert_true(cb.cmds[4].first == 10 && cb.cmds[4].count == 10, "second rect run starts after the first");
+
+    SDL_Vertex *v = cmd_geometry(&cb, 6);
+    assert_true(v != NULL && cb.vertexCount == 6, "geometry reserves vertices");
+
+    command_buffer_reset(&cb);
+    assert_true(cb.cmdCount == 0 && cb.pointCount == 0 && cb.rectCount == 0 && cb.cmdCapacity > 0,
+                "reset keeps the allocations");
+    command_buffer_free(&cb);
+}
+
+static void test_circle_spans(void){
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    for(int r = 0; r <= 40; r++){
+        command_buffer_reset(&cb);
+        draw_filled_circle(&cb, 0, 0, r);
+
+        long expected = 0;
+        for(int y = -r; y <= r; y++){
+            for(int x = -r; x <= r; x++){
+                if(x*x + y*y <= r*r) expected++;
+            }
+        }
+        long covered = 0;
+        bool inside = true;
+        for(int i = 0; i < cb.rectCount; i++){
+            const SDL_Rect *s = &cb.rects[i];
+            covered += (long)s->w * s->h;
+            int xl = s->x, xr = s->x + s->w - 1;
+            if(xl*xl + s->y*s->y > r*r || xr*xr + s->y*s->y > r*r) inside = false;
+            if((xl-1)*(xl-1) + s->y*s->y <= r*r) inside = false;
+        }
+        if(covered != expected || !inside || cb.rectCount != 2*r + 1){
+            assert_true(false, "circle spans cover exactly the disc");
+            break;
+        }
+    }
+    assert_true(cb.cmdCount == 1, "a circle is one batched fill");
+    command_buffer_free(&cb);
+}
+
+typedef struct {
+    int order[8];
+    int built;
+} BuildLog;
+
+static void log_build(void *ctx, void *job, CommandBuffer *out){
+    BuildLog *log = ctx;
+    int id = *(int*)job;
+    usleep(2000);
+    cmd_point(out, id, id);
+    log->order[log->built++] = id;
+}
+
+static void test_pipeline(void){
+    BuildLog log = {0};
+    FramePipeline *p = pipeline_create(log_build, &log);
+    assert_true(p != NULL, "pipeline starts");
+    if(!p) return;
+
+    assert_true(pipeline_wait(p) == NULL, "nothing to collect before the first frame");
+
+    int jobs[6] = { 0, 1, 2, 3, 4, 5 };
+    CommandBuffer *previous = NULL;
+    bool inOrder = true, alternates = true;
+    pipeline_begin(p, &jobs[0]);
+    for(int f = 1; f < 6; f++){
+        CommandBuffer *ready = pipeline_wait(p);
+        pipeline_begin(p, &jobs[f]);
+        // Frame f - 1 comes back while f is being built, in the other buffer.
+        if(!ready || ready->pointCount != 1 || ready->points[0].x != f - 1) inOrder = false;
+        if(ready == previous) alternates = false;
+        previous = ready;
+    }
+    CommandBuffer *last = pipeline_wait(p);
+    assert_true(inOrder && last && last->points[0].x == 5, "frames come back in order, one behind");
+    assert_true(alternates, "consecutive frames use different buffers");
+    assert_true(log.built == 6, "every frame was built once");
+    pipeline_destroy(p);
+}
+
+int main(void){
+    test_batching();
+    test_circle_spans();
+    test_pipeline();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
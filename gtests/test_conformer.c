@@ -0,0 +1,135 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/conformer.h"
+#include "../src/forcefield.h"
+#include "../src/presets.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+// Relaxed six-ring with a five-carbon chain hanging off atom 0.
+static void build_relaxed_sample(MoleculeGeometry *mol){
+    build_ring_with_chain(mol, 5, false);
+    ff_relax_molecule(mol);
+}
+
+static float distance(Vec3 a, Vec3 b){
+    float dx = a.x-b.x, dy = a.y-b.y, dz = a.z-b.z;
+    return sqrtf(dx*dx + dy*dy + dz*dz);
+}
+
+static void test_rotatable_bonds(void){
+    MoleculeGeometry mol;
+    build_relaxed_sample(&mol);
+
+    int rot[MAX_ROTATABLE];
+    int count = conformer_find_rotatable(&mol, rot);
+    // ring-chain bond plus three chain bonds; the terminal bond has no heavy atom beyond it
+    assert_true(count == 4, "ring and terminal bonds are not rotatable");
+    for(int i = 0; i < count; i++){
+        assert_true(rot[i] >= 6, "no ring bond reported rotatable");
+    }
+}
+
+static void test_enumeration(void){
+    MoleculeGeometry mol;
+    build_relaxed_sample(&mol);
+
+    ConformerSet *set = malloc(sizeof(ConformerSet));
+    ConformerOptions options = conformer_default_options();
+    conformer_enumerate(&mol, &options, set);
+
+    assert_true(set->enumerated == 81, "all 3^4 torsion states visited");
+    assert_true(set->count > 2, "several conformers kept");
+    assert_true(memcmp(set->pos[0], mol.atomPos, sizeof(Vec3) * mol.atomCount) == 0, "entry 0 is the input");
+
+    bool sorted = true, bondsKept = true, ringFixed = true, distinct = true;
+    for(int c = 1; c < set->count; c++){
+        if(c > 1 && set->energy[c] < set->energy[c-1]) sorted = false;
+        for(int b = 0; b < mol.bondCount; b++){
+            float before = distance(mol.atomPos[mol.bonds[b].from], mol.atomPos[mol.bonds[b].to]);
+            float after = distance(set->pos[c][mol.bonds[b].from], set->pos[c][mol.bonds[b].to]);
+            if(fabsf(before - after) > 1e-3f) bondsKept = false;
+        }
+        for(int i = 0; i < 6; i++){
+            if(distance(set->pos[c][i], mol.atomPos[i]) > 1e-4f) ringFixed = false;
+        }
+        for(int k = 0; k < c; k++){
+            float sum = 0.0f;
+            for(int i = 0; i < mol.atomCount; i++){
+                float d = distance(set->pos[c][i], set->pos[k][i]);
+                sum += d * d;
+            }
+            if(sqrtf(sum / mol.atomCount) < options.minRmsd) distinct = false;
+        }
+    }
+    assert_true(sorted, "conformers sorted by energy");
+    assert_true(bondsKept, "torsion moves keep bond lengths");
+    assert_true(ringFixed, "ring atoms stay put");
+    assert_true(distinct, "kept conformers are distinct");
+
+    ConformerSet *again = malloc(sizeof(ConformerSet));
+    conformer_enumerate(&mol, &options, again);
+    assert_true(again->count == set->count &&
+                memcmp(again->pos, set->pos, sizeof(set->pos)) == 0, "enumeration is deterministic");
+
+    free(again);
+    free(set);
+}
+
+// Spaces too large to score in full are sampled; every torsion must still
+// take all three states, and no combination may be scored twice.
+static void test_sampling(void){
+    const int bonds[] = { 12, 14, 16 };
+    for(int k = 0; k < 3; k++){
+        TorsionSampling s = torsion_sampling(bonds[k], conformer_default_options().maxCombinations);
+        assert_true(s.count <= conformer_default_options().maxCombinations && s.count > 0, "sample fits the budget");
+        assert_true(s.stride % 3 != 0, "stride is coprime to 3");
+
+        unsigned char *seen = calloc((size_t)s.total / 8 + 1, 1);
+        int states[MAX_ROTATABLE] = {0};
+        bool repeated = false;
+        for(long long item = 0; item < s.count; item++){
+            long long combo = torsion_sample(&s, item);
+            if(seen[combo / 8] & (1 << (combo % 8))) repeated = true;
+            seen[combo / 8] |= (unsigned char)(1 << (combo % 8));
+            for(int r = 0; r < bonds[k]; r++){
+                states[r] |= 1 << (combo % 3);
+                combo /= 3;
+            }
+        }
+        bool allStates = true;
+        for(int r = 0; r < bonds[k]; r++) if(states[r] != 7) allStates = false;
+        assert_true(allStates, "every torsion takes all three states");
+        assert_true(!repeated, "no combination is sampled twice");
+        free(seen);
+    }
+
+    TorsionSampling full = torsion_sampling(4, conformer_default_options().maxCombinations);
+    assert_true(full.stride == 1 && full.count == 81, "small spaces are enumerated in full");
+}
+
+int main(void){
+    test_rotatable_bonds();
+    test_enumeration();
+    test_sampling();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
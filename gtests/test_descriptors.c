@@ -0,0 +1,185 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/descriptors.h"
+#include "../src/geometry.h"
+#include "../src/library.h"
+#include "../src/presets.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static bool near(float a, float b, float tol){
+    return fabsf(a - b) <= tol;
+}
+
+// A flat hexagon of carbons, 1.4 A apart, optionally with Kekule double bonds.
+static void make_ring(MoleculeGeometry *mol, bool kekule){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < 6; i++){
+        float a = (float)i * PI / 3.0f;
+        add_atom(mol, make_vec3(1.4f * cosf(a), 1.4f * sinf(a), 0.0f), 0);
+    }
+    for(int i = 0; i < 6; i++) add_bond(mol, i, (i + 1) % 6, kekule && i % 2 == 0 ? 2 : 1);
+}
+
+// Cyclohexane chair: 1.54 A single bonds, alternately up and down.
+static void make_chair(MoleculeGeometry *mol){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < 6; i++){
+        float a = (float)i * PI / 3.0f;
+        add_atom(mol, make_vec3(1.45f * cosf(a), 1.45f * sinf(a), i % 2 ? 0.25f : -0.25f), 0);
+    }
+    for(int i = 0; i < 6; i++) add_bond(mol, i, (i + 1) % 6, 1);
+}
+
+static void test_counts_and_formula(void){
+    MoleculeGeometry ring;
+    make_chair(&ring);
+    Descriptors d;
+    compute_descriptors(&ring, -1, &d);
+    char formula[32];
+    descriptor_formula(&d, formula, sizeof(formula));
+    assert_true(d.rings == 1 && d.aromaticRings == 0, "chair has one ring, not aromatic");
+    assert_true(d.hydrogens == 12 && strcmp(formula, "C6H12") == 0, "cyclohexane hydrogens implied by valence");
+    assert_true(near(d.mass, 6 * 12.011f + 12 * 1.008f, 0.01f), "mass includes implied hydrogens");
+
+    make_ring(&ring, true);
+    compute_descriptors(&ring, -1, &d);
+    descriptor_formula(&d, formula, sizeof(formula));
+    assert_true(strcmp(formula, "C6H6") == 0, "double bonds reduce implied hydrogens");
+
+    make_ring(&ring, false);
+    compute_descriptors(&ring, -1, &d);
+    descriptor_formula(&d, formula, sizeof(formula));
+    assert_true(d.aromaticRings == 1 && strcmp(formula, "C6H6") == 0, "flat 1.4 A hexagon without orders is benzene");
+    assert_true(d.rings == 1 && d.aromaticRings == 1, "Kekule hexagon is one aromatic ring");
+
+    compute_descriptors(&ring, 3, &d);
+    assert_true(d.hydrogens == 3, "explicit hydrogen count wins");
+
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    add_atom(&mol, make_vec3(0, 0, 0), 2);  // N
+    add_atom(&mol, make_vec3(1, 0, 0), 1);  // O
+    add_atom(&mol, make_vec3(0, 1, 0), 3);  // Cl
+    add_atom(&mol, make_vec3(0, 0, 1), 4);  // F
+    add_atom(&mol, make_vec3(5, 0, 0), 0);  // C, disconnected
+    add_bond(&mol, 0, 1, 1);
+    add_bond(&mol, 0, 2, 1);
+    add_bond(&mol, 0, 3, 1);
+    compute_descriptors(&mol, 0, &d);
+    descriptor_formula(&d, formula, sizeof(formula));
+    assert_true(strcmp(formula, "CClFNO") == 0, "Hill order: C first, then alphabetical");
+    assert_true(d.rings == 0, "two components and no cycle means no rings");
+    assert_true(d.elementCounts[2] == 1 && d.elementCounts[3] == 1 && d.elementCounts[4] == 1, "heteroatoms counted");
+
+    mol.atomCount = 4;
+    mol.bondCount = 0;
+    compute_descriptors(&mol, 2, &d);
+    descriptor_formula(&d, formula, sizeof(formula));
+    assert_true(strcmp(formula, "ClFH2NO") == 0, "without carbon H is alphabetical");
+}
+
+static void test_shape(void){
+    // Two carbons 2 A apart: gyration radius 1, moments 0, 24.02, 24.02.
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    add_atom(&mol, make_vec3(-1, 0, 0), 0);
+    add_atom(&mol, make_vec3(1, 0, 0), 0);
+    Descriptors d;
+    compute_descriptors(&mol, 0, &d);
+    assert_true(near(d.radiusOfGyration, 1.0f, 1e-4f), "radius of gyration of a dimer");
+    assert_true(near(d.principalMoments[0], 0.0f, 1e-3f) &&
+                near(d.principalMoments[1], 2 * 12.011f, 1e-2f) &&
+                near(d.principalMoments[2], 2 * 12.011f, 1e-2f), "dimer principal moments");
+    assert_true(near(d.boundingRadius, compute_bounding_radius(&mol), 1e-6f), "bounding radius matches the renderer");
+
+    // Moments are invariant under rotation and translation of the molecule.
+    MoleculeGeometry ring, moved;
+    make_ring(&ring, false);
+    moved = ring;
+    for(int i = 0; i < moved.atomCount; i++){
+        Vec3 p = rotate_yaw_pitch(moved.atomPos[i], 0.7f, -1.1f);
+        moved.atomPos[i] = make_vec3(p.x + 3.0f, p.y - 2.0f, p.z + 0.5f);
+    }
+    Descriptors a, b;
+    compute_descriptors(&ring, -1, &a);
+    compute_descriptors(&moved, -1, &b);
+    bool same = true;
+    for(int i = 0; i < 3; i++) same = same && near(a.principalMoments[i], b.principalMoments[i], 0.05f);
+    assert_true(same && near(a.radiusOfGyration, b.radiusOfGyration, 1e-3f), "shape descriptors are rigid-motion invariant");
+    // A flat ring: the largest moment is the sum of the other two.
+    assert_true(near(a.principalMoments[2], a.principalMoments[0] + a.principalMoments[1], 0.05f), "planar moments add up");
+}
+
+// XYZ carries no bond orders, so aromaticity must come from geometry.
+static void test_benzene_from_xyz(void){
+    char path[256];
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_descriptors_%d.xyz", (int)getpid());
+    FILE *f = fopen(path, "w");
+    if(f){
+        fputs("6\nbenzene\n", f);
+        for(int i = 0; i < 6; i++){
+            float a = (float)i * PI / 3.0f;
+            fprintf(f, "C %.4f %.4f 0.0\n", 1.39f * cosf(a), 1.39f * sinf(a));
+        }
+        fclose(f);
+    }
+
+    Library lib;
+    library_init(&lib);
+    char error[256] = "";
+    bool ok = library_load_xyz(&lib, path, error, sizeof(error));
+    assert_true(ok && lib.count == 1, "benzene XYZ loads");
+    if(ok && lib.count == 1){
+        // The file lists no hydrogens, so let valence imply them.
+        Descriptors d;
+        compute_descriptors(&lib.entries[0].mol, -1, &d);
+        char formula[32];
+        descriptor_formula(&d, formula, sizeof(formula));
+        assert_true(d.aromaticRings == 1, "XYZ benzene ring is aromatic");
+        assert_true(d.hydrogens == 6 && strcmp(formula, "C6H6") == 0, "XYZ benzene is C6H6, not C6H12");
+    }
+    library_free(&lib);
+    remove(path);
+}
+
+static void test_presets(void){
+    bool sane = true;
+    for(int c = 0; c < COMPOUND_COUNT; c++){
+        MoleculeGeometry mol;
+        apply_preset(&mol, compounds[c].presetType);
+        Descriptors d;
+        compute_descriptors(&mol, -1, &d);
+        if(d.heavyAtoms != mol.atomCount || d.rings < 4 || d.mass <= 0.0f) sane = false;
+        if(!(d.principalMoments[0] <= d.principalMoments[1] && d.principalMoments[1] <= d.principalMoments[2])) sane = false;
+    }
+    assert_true(sane, "every preset has the steroid rings and ordered moments");
+}
+
+int main(void){
+    test_counts_and_formula();
+    test_shape();
+    test_benzene_from_xyz();
+    test_presets();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
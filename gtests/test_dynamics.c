@@ -0,0 +1,116 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/dynamics.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void build_ring(MoleculeGeometry *mol){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < 6; i++){
+        float ang = i * PI / 3.0f;
+        mol->atomPos[i] = make_vec3(cosf(ang) * 1.5f, sinf(ang) * 1.5f, 0.0f);
+        mol->atomLabel[i] = (i == 3) ? 1 : 0;
+        mol->bonds[i] = (Bond){i, (i+1)%6, 1};
+    }
+    mol->atomCount = 6;
+    mol->bondCount = 6;
+}
+
+static void test_energy_conserved_without_thermostat(void){
+    MoleculeGeometry mol;
+    build_ring(&mol);
+
+    MdSystem sys;
+    md_system_init(&sys, &mol, 2.0f, 42u);
+    sys.targetTemperature = 0.0f;
+
+    double start = md_system_energy(&sys);
+    double worst = 0.0;
+    for(int i = 0; i < 5000; i++){
+        md_system_step(&sys, 0.004f);
+        double drift = fabs(md_system_energy(&sys) - start);
+        if(drift > worst) worst = drift;
+    }
+    assert_true(start > 0.0, "initial energy positive");
+    assert_true(worst < 0.02 * start, "velocity Verlet conserves energy");
+}
+
+static void test_momentum_stays_zero(void){
+    MoleculeGeometry mol;
+    build_ring(&mol);
+
+    MdSystem sys;
+    md_system_init(&sys, &mol, 2.0f, 7u);
+    for(int i = 0; i < 1000; i++) md_system_step(&sys, 0.004f);
+
+    float p[3] = {0};
+    for(int i = 0; i < sys.atomCount; i++){
+        for(int k = 0; k < 3; k++) p[k] += sys.mass[i] * sys.vel[k][i];
+    }
+    assert_true(fabsf(p[0]) < 1e-2f && fabsf(p[1]) < 1e-2f && fabsf(p[2]) < 1e-2f, "no centre-of-mass drift");
+}
+
+static void test_thermostat_reaches_target(void){
+    MoleculeGeometry mol;
+    build_ring(&mol);
+
+    MdSystem sys;
+    md_system_init(&sys, &mol, 0.1f, 3u);
+    sys.targetTemperature = 2.0f;
+
+    float average = 0.0f;
+    int samples = 0;
+    for(int i = 0; i < 20000; i++){
+        md_system_step(&sys, 0.004f);
+        if(i >= 10000){
+            average += md_system_temperature(&sys);
+            samples++;
+        }
+    }
+    average /= (float)samples;
+    assert_true(fabsf(average - 2.0f) < 0.4f, "thermostat holds target temperature");
+}
+
+static void test_positions_stay_near_rest(void){
+    MoleculeGeometry mol;
+    build_ring(&mol);
+
+    MdSystem sys;
+    md_system_init(&sys, &mol, 2.0f, 11u);
+    for(int i = 0; i < 5000; i++) md_system_step(&sys, 0.004f);
+
+    bool bounded = true;
+    for(int i = 0; i < sys.atomCount; i++){
+        float dx = sys.pos[0][i] - mol.atomPos[i].x;
+        float dy = sys.pos[1][i] - mol.atomPos[i].y;
+        float dz = sys.pos[2][i] - mol.atomPos[i].z;
+        if(!isfinite(dx) || dx*dx + dy*dy + dz*dz > 4.0f) bounded = false;
+    }
+    assert_true(bounded, "atoms vibrate about the input geometry");
+}
+
+int main(void){
+    test_energy_conserved_without_thermostat();
+    test_momentum_stays_zero();
+    test_thermostat_reaches_target();
+    test_positions_stay_near_rest();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/export.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static uint8_t *read_file(const char *path, long *size){
+    FILE *f = fopen(path, "rb");
+    if(!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc((size_t)*size);
+    if(data && fread(data, 1, (size_t)*size, f) != (size_t)*size){
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static uint32_t be32(const uint8_t *p){
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t crc32_of(const uint8_t *p, size_t n){
+    uint32_t c = 0xFFFFFFFFu;
+    for(size_t i = 0; i < n; i++){
+        c ^= p[i];
+        for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+static int idatChunks;
+
+// Checks every chunk CRC, joins the IDAT chunks and unpacks the stored
+// deflate blocks of the PNGs png_write produces. Returns the raw scanlines
+// or NULL.
+static uint8_t *decode_png(const uint8_t *data, long size, int *width, int *height, bool *crcOk){
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if(size < 8 || memcmp(data, signature, 8) != 0) return NULL;
+    *crcOk = true;
+    uint8_t *stream = malloc((size_t)size);
+    size_t streamSize = 0;
+    idatChunks = 0;
+    long pos = 8;
+    while(pos + 12 <= size){
+        uint32_t length = be32(data + pos);
+        const uint8_t *type = data + pos + 4;
+        if(crc32_of(type, length + 4) != be32(type + 4 + length)) *crcOk = false;
+        if(memcmp(type, "IHDR", 4) == 0){
+            *width = (int)be32(type + 4);
+            *height = (int)be32(type + 8);
+        }
+        if(memcmp(type, "IDAT", 4) == 0){
+            memcpy(stream + streamSize, type + 4, length);
+            streamSize += length;
+            idatChunks++;
+        }
+        pos += 12 + (long)length;
+    }
+    if(streamSize == 0){
+        free(stream);
+        return NULL;
+    }
+
+    uint8_t *raw = malloc(streamSize);
+    size_t rawSize = 0;
+    const uint8_t *z = stream + 2;
+    bool last = false;
+    while(!last){
+        last = z[0] & 1;
+        size_t n = z[1] | (size_t)z[2] << 8;
+        memcpy(raw + rawSize, z + 5, n);
+        rawSize += n;
+        z += 5 + n;
+    }
+    free(stream);
+    return raw;
+}
+
+static void temp_path(char *out, size_t size, const char *tag){
+    snprintf(out, size, "/tmp/pk_rk4_export_%d_%s", (int)getpid(), tag);
+}
+
+static void test_png(void){
+    char path[128];
+    temp_path(path, sizeof(path), "single.png");
+    const uint32_t pixels[6] = { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFFFF, 0xFF000000, 0xFF123456 };
+    FILE *f = fopen(path, "wb");
+    assert_true(f && png_write(f, pixels, 3, 2), "png written");
+    if(f) fclose(f);
+
+    long size = 0;
+    uint8_t *data = read_file(path, &size);
+    int w = 0, h = 0;
+    bool crcOk = false;
+    uint8_t *raw = data ? decode_png(data, size, &w, &h, &crcOk) : NULL;
+    assert_true(raw != NULL, "png has signature and image data");
+    assert_true(w == 3 && h == 2, "IHDR carries the size");
+    assert_true(crcOk, "chunk CRCs match");
+    if(raw){
+        assert_true(raw[0] == 0 && raw[1] == 255 && raw[2] == 0 && raw[3] == 0, "first row starts unfiltered with red");
+        assert_true(raw[10] == 0 && raw[11] == 255 && raw[14] == 0 && raw[17] == 0x12 && raw[19] == 0x56,
+                    "second row is white, black, then 0x123456");
+    }
+    free(raw);
+    free(data);
+    remove(path);
+
+    // Larger than one stored block.
+    int bw = 200, bh = 150;
+    uint32_t *big = malloc(sizeof(uint32_t) * (size_t)(bw * bh));
+    for(int i = 0; i < bw * bh; i++) big[i] = 0xFF000000u | (uint32_t)(i * 2654435761u >> 8);
+    f = fopen(path, "wb");
+    png_write(f, big, bw, bh);
+    fclose(f);
+    data = read_file(path, &size);
+    raw = data ? decode_png(data, size, &w, &h, &crcOk) : NULL;
+    bool same = raw != NULL;
+    for(int y = 0; same && y < bh; y++){
+        for(int x = 0; x < bw; x++){
+            const uint8_t *p = raw + (size_t)y * (1 + (size_t)bw * 3) + 1 + (size_t)x * 3;
+            uint32_t c = big[y * bw + x];
+            if(p[0] != (uint8_t)(c >> 16) || p[1] != (uint8_t)(c >> 8) || p[2] != (uint8_t)c) same = false;
+        }
+    }
+    assert_true(same && crcOk, "multi-block png round-trips");
+    free(raw);
+    free(data);
+    free(big);
+
+    // Past one IDAT chunk's worth: the stream continues in the next chunk.
+    bw = 1000, bh = 800;
+    big = malloc(sizeof(uint32_t) * (size_t)(bw * bh));
+    for(int i = 0; i < bw * bh; i++) big[i] = 0xFF000000u | (uint32_t)(i * 2654435761u >> 8);
+    f = fopen(path, "wb");
+    png_write(f, big, bw, bh);
+    fclose(f);
+    data = read_file(path, &size);
+    raw = data ? decode_png(data, size, &w, &h, &crcOk) : NULL;
+    same = raw != NULL;
+    for(int y = 0; same && y < bh; y++){
+        for(int x = 0; x < bw; x++){
+            const uint8_t *p = raw + (size_t)y * (1 + (size_t)bw * 3) + 1 + (size_t)x * 3;
+            uint32_t c = big[y * bw + x];
+            if(p[0] != (uint8_t)(c >> 16) || p[1] != (uint8_t)(c >> 8) || p[2] != (uint8_t)c) same = false;
+        }
+    }
+    assert_true(idatChunks > 1, "large image data is split across IDAT chunks");
+    assert_true(same && crcOk, "split png round-trips");
+    free(raw);
+    free(data);
+    free(big);
+    remove(path);
+}
+
+static void test_y4m(void){
+    char path[128];
+    temp_path(path, sizeof(path), "single.y4m");
+    uint32_t pixels[4 * 2];
+    for(int i = 0; i < 4; i++) pixels[i] = 0xFFFFFFFF;
+    for(int i = 4; i < 8; i++) pixels[i] = 0xFFFF0000;
+
+    FILE *f = fopen(path, "wb");
+    assert_true(y4m_write_header(f, 4, 2, 30), "y4m header written");
+    assert_true(y4m_write_frame(f, pixels, 4, 2), "y4m frame written");
+    assert_true(!y4m_write_frame(f, pixels, 3, 2), "odd width rejected");
+    fclose(f);
+
+    long size = 0;
+    uint8_t *data = read_file(path, &size);
+    const char *header = "YUV4MPEG2 W4 H2 F30:1 Ip A1:1 C420jpeg\nFRAME\n";
+    size_t headerLen = strlen(header);
+    assert_true(data && size == (long)(headerLen + 8 + 2 + 2), "4:2:0 frame is 12 bytes");
+    if(data && size >= (long)headerLen + 12){
+        assert_true(memcmp(data, header, headerLen) == 0, "stream and frame headers");
+        const uint8_t *y = data + headerLen;
+        assert_true(y[0] == 255 && y[4] == 76, "luma of white and red");
+        // Half white, half red: U about 106, V about 192.
+        assert_true(y[8] >= 104 && y[8] <= 108 && y[10] >= 190 && y[10] <= 194, "chroma averages the 2x2 block");
+    }
+    free(data);
+    remove(path);
+}
+
+static void test_writer(void){
+    char dir[128];
+    temp_path(dir, sizeof(dir), "seq");
+    const int w = 8, h = 4, frames = 10;
+    FrameWriter *writer = frame_writer_open(dir, EXPORT_PNG, w, h, 30, 2);
+    assert_true(writer != NULL, "png sequence writer opens");
+    if(!writer) return;
+    for(int i = 0; i < frames; i++){
+        uint32_t *pixels = frame_writer_acquire(writer);
+        for(int p = 0; p < w * h; p++) pixels[p] = 0xFF000000u | (uint32_t)i;
+        frame_writer_submit(writer);
+    }
+    assert_true(frame_writer_close(writer), "writer drains and closes");
+
+    bool allThere = true, inOrder = true;
+    for(int i = 0; i < frames; i++){
+        char path[192];
+        snprintf(path, sizeof(path), "%s/frame_%05d.png", dir, i);
+        long size = 0;
+        uint8_t *data = read_file(path, &size);
+        int pw, ph;
+        bool crcOk;
+        uint8_t *raw = data ? decode_png(data, size, &pw, &ph, &crcOk) : NULL;
+        if(!raw) allThere = false;
+        else if(raw[3] != i) inOrder = false;
+        free(raw);
+        free(data);
+        remove(path);
+    }
+    rmdir(dir);
+    assert_true(allThere, "one file per frame");
+    assert_true(inOrder, "frames keep their order through the ring");
+
+    char video[128];
+    temp_path(video, sizeof(video), "clip.y4m");
+    assert_true(export_format_for_path(video) == EXPORT_Y4M && export_format_for_path(dir) == EXPORT_PNG,
+                "format follows the extension");
+    assert_true(frame_writer_open(video, EXPORT_Y4M, 7, 4, 30, 2) == NULL, "y4m writer needs even sizes");
+    writer = frame_writer_open(video, EXPORT_Y4M, w, h, 30, 3);
+    for(int i = 0; i < frames; i++){
+        memset(frame_writer_acquire(writer), 0, sizeof(uint32_t) * (size_t)(w * h));
+        frame_writer_submit(writer);
+    }
+    assert_true(frame_writer_close(writer), "y4m writer closes");
+    long size = 0;
+    uint8_t *data = read_file(video, &size);
+    long header = (long)strlen("YUV4MPEG2 W8 H4 F30:1 Ip A1:1 C420jpeg\n");
+    assert_true(data && size == header + frames * (6 + w * h * 3 / 2), "y4m holds every frame");
+    free(data);
+    remove(video);
+}
+
+int main(void){
+    test_png();
+    test_y4m();
+    test_writer();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
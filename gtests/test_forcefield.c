@@ -0,0 +1,130 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/forcefield.h"
+#include "../src/presets.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+// Hexagon with a carbonyl and a three-carbon tail, the same kind of crude
+// input the presets produce.
+static void build_sample(MoleculeGeometry *mol){
+    build_ring_with_chain(mol, 3, true);
+}
+
+static void load_positions(const MoleculeGeometry *mol, float *x){
+    memset(x, 0, sizeof(float) * FF_DIM);
+    for(int i = 0; i < mol->atomCount; i++){
+        x[i] = mol->atomPos[i].x + 0.05f * sinf((float)i);
+        x[FF_STRIDE + i] = mol->atomPos[i].y + 0.05f * cosf((float)i * 1.7f);
+        x[2*FF_STRIDE + i] = mol->atomPos[i].z + 0.05f * sinf((float)i * 2.3f);
+    }
+}
+
+static void test_gradient_matches_finite_difference(void){
+    MoleculeGeometry mol;
+    build_sample(&mol);
+
+    ForceField *ff = malloc(sizeof(ForceField));
+    ff_setup(ff, &mol);
+
+    float x[FF_DIM], grad[FF_DIM];
+    load_positions(&mol, x);
+    ff_energy_gradient(ff, x, grad);
+
+    int bad = 0;
+    for(int k = 0; k < 3; k++){
+        for(int i = 0; i < mol.atomCount; i++){
+            int idx = k * FF_STRIDE + i;
+            float saved = x[idx];
+            float h = 1e-3f;
+            x[idx] = saved + h;
+            double ePlus = ff_energy_gradient(ff, x, NULL);
+            x[idx] = saved - h;
+            double eMinus = ff_energy_gradient(ff, x, NULL);
+            x[idx] = saved;
+
+            double numeric = (ePlus - eMinus) / (2.0 * h);
+            double tol = 0.02 * fabs(numeric) + 0.05;
+            if(fabs(numeric - grad[idx]) > tol){
+                bad++;
+                printf("  grad[%d][%d] analytic %.4f numeric %.4f\n", k, i, grad[idx], numeric);
+            }
+        }
+    }
+    assert_true(bad == 0, "analytic gradient matches central differences");
+    free(ff);
+}
+
+static void test_relax_lowers_energy_and_fixes_bonds(void){
+    MoleculeGeometry mol;
+    build_sample(&mol);
+
+    ForceField *ff = malloc(sizeof(ForceField));
+    ff_setup(ff, &mol);
+    float x[FF_DIM];
+    load_positions(&mol, x);
+    double before = ff_energy_gradient(ff, x, NULL);
+
+    FfResult r = ff_relax_molecule(&mol);
+    assert_true(r.energy < before, "relaxation lowers energy");
+    assert_true(r.iterations > 0, "minimizer took steps");
+
+    int badBonds = 0;
+    for(int i = 0; i < mol.bondCount; i++){
+        Vec3 a = mol.atomPos[mol.bonds[i].from];
+        Vec3 b = mol.atomPos[mol.bonds[i].to];
+        float dx = a.x-b.x, dy = a.y-b.y, dz = a.z-b.z;
+        float len = sqrtf(dx*dx + dy*dy + dz*dz);
+        if(len < 1.0f || len > 1.7f) badBonds++;
+    }
+    assert_true(badBonds == 0, "relaxed bond lengths are chemical");
+
+    for(int i = 0; i < mol.atomCount; i++){
+        assert_true(isfinite(mol.atomPos[i].x) && isfinite(mol.atomPos[i].y) && isfinite(mol.atomPos[i].z),
+                    "relaxed positions finite");
+    }
+    free(ff);
+}
+
+static void test_relax_library_matches_serial(void){
+    MoleculeGeometry serial[4], parallel[4];
+    for(int i = 0; i < 4; i++){
+        build_sample(&serial[i]);
+        serial[i].atomPos[0].z += 0.1f * (float)i;
+        parallel[i] = serial[i];
+        ff_relax_molecule(&serial[i]);
+    }
+    ff_relax_library(parallel, 4);
+
+    bool same = true;
+    for(int i = 0; i < 4; i++){
+        if(memcmp(serial[i].atomPos, parallel[i].atomPos, sizeof(Vec3) * serial[i].atomCount) != 0) same = false;
+    }
+    assert_true(same, "parallel library relax is deterministic");
+}
+
+int main(void){
+    test_gradient_matches_finite_difference();
+    test_relax_lowers_energy_and_fixes_bonds();
+    test_relax_library_matches_serial();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,113 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "../src/governor.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void assert_near(float a, float b, float eps, const char *msg){
+    tests_run++;
+    if(fabsf(a - b) > eps){
+        tests_failed++;
+        printf("[FAIL] %s (got %.6f expected %.6f)\n", msg, a, b);
+    }
+}
+
+static int run_frames(QualityGovernor *gov, int frames, float ms){
+    int changes = 0;
+    for(int i = 0; i < frames; i++) changes += governor_frame(gov, ms);
+    return changes;
+}
+
+static void test_steady_under_budget(void){
+    QualityGovernor gov;
+    governor_init(&gov, 16.7f);
+    run_frames(&gov, 600, 12.0f);
+    assert_true(gov.level == 0, "frames inside the budget keep full quality");
+
+    TileQuality q = governor_tile_quality(&gov, false, 1.0f);
+    assert_true(q.highlights && q.labels, "full quality draws highlights and labels");
+    assert_near(q.resolution, 1.0f, 1e-6f, "full quality renders every pixel");
+}
+
+static void test_degrades_and_recovers(void){
+    QualityGovernor gov;
+    governor_init(&gov, 16.7f);
+
+    run_frames(&gov, 60, 40.0f);
+    assert_true(gov.level >= 2, "sustained overload lowers quality quickly");
+    run_frames(&gov, 600, 40.0f);
+    assert_true(gov.level == GOVERNOR_LEVELS - 1, "overload bottoms out at the last level");
+
+    TileQuality low = governor_tile_quality(&gov, false, 1.0f);
+    assert_true(!low.highlights && !low.labels, "low quality drops highlights and labels");
+    assert_true(low.resolution < 0.5f, "low quality renders tiles at reduced resolution");
+    assert_near(low.scale, low.resolution, 1e-6f, "pixel scale follows the resolution");
+
+    TileQuality selected = governor_tile_quality(&gov, true, 1.0f);
+    assert_true(selected.highlights && selected.labels, "selected tile keeps highlights and labels");
+    assert_near(selected.resolution, 1.0f, 1e-6f, "selected tile keeps full resolution");
+
+    run_frames(&gov, 2000, 4.0f);
+    assert_true(gov.level == 0, "light frames restore full quality");
+}
+
+static void test_hysteresis(void){
+    QualityGovernor gov;
+    governor_init(&gov, 16.7f);
+
+    // Just under the degrade threshold and just over the restore one: no
+    // level should ever change.
+    int changes = run_frames(&gov, 1000, 16.7f * 1.05f);
+    assert_true(changes == 0, "frames slightly over budget do not trigger changes");
+
+    run_frames(&gov, 200, 40.0f);
+    int level = gov.level;
+    changes = run_frames(&gov, 1000, 16.7f * 0.8f);
+    assert_true(changes == 0 && gov.level == level, "a degraded level holds while frames sit in the dead band");
+
+    // Alternating spikes around the target average out instead of flapping.
+    governor_init(&gov, 16.7f);
+    changes = 0;
+    for(int i = 0; i < 1000; i++) changes += governor_frame(&gov, (i & 1) ? 24.0f : 10.0f);
+    assert_true(changes == 0, "alternating frame times average out");
+}
+
+static void test_disable_and_dpi(void){
+    QualityGovernor gov;
+    governor_init(&gov, 16.7f);
+    run_frames(&gov, 300, 40.0f);
+    governor_set_enabled(&gov, false);
+    assert_true(gov.level == 0, "disabling resets to full quality");
+    run_frames(&gov, 300, 40.0f);
+    assert_true(gov.level == 0, "a disabled governor stays at full quality");
+
+    TileQuality hidpi = governor_tile_quality(&gov, false, 2.0f);
+    assert_near(hidpi.scale, 2.0f, 1e-6f, "HiDPI factor scales pixel sizes");
+    assert_near(hidpi.resolution, 1.0f, 1e-6f, "HiDPI factor does not change resolution");
+}
+
+int main(void){
+    test_steady_under_budget();
+    test_degrades_and_recovers();
+    test_hysteresis();
+    test_disable_and_dpi();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/image_cache.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static RenderKey make_key(int compound, float yaw){
+    RenderKey k;
+    memset(&k, 0, sizeof(k));
+    k.compound = compound;
+    k.width = k.height = 64;
+    k.yaw = yaw;
+    k.pitch = 0.35f;
+    k.zoom = 1.0f;
+    return k;
+}
+
+static uint8_t *make_data(size_t size, uint8_t fill){
+    uint8_t *d = malloc(size);
+    memset(d, fill, size);
+    return d;
+}
+
+static void test_get_put(void){
+    ImageCache cache;
+    image_cache_init(&cache, 1000);
+    RenderKey a = make_key(1, 0.5f);
+    assert_true(image_cache_get(&cache, &a) == NULL, "empty cache misses");
+    assert_true(image_cache_put(&cache, &a, make_data(100, 7), 100), "put fits the budget");
+    const CachedImage *e = image_cache_get(&cache, &a);
+    assert_true(e && e->size == 100 && e->data[99] == 7, "put image is returned");
+
+    RenderKey b = make_key(1, 0.6f);
+    assert_true(image_cache_get(&cache, &b) == NULL, "a different yaw is a different key");
+    RenderKey c = a;
+    c.mode = 3;
+    assert_true(image_cache_get(&cache, &c) == NULL, "a different mode is a different key");
+    assert_true(cache.hits == 1 && cache.misses == 3, "hits and misses counted");
+
+    image_cache_put(&cache, &a, make_data(200, 9), 200);
+    e = image_cache_get(&cache, &a);
+    assert_true(e && e->size == 200 && e->data[0] == 9, "put replaces the image under a key");
+    assert_true(cache.count == 1 && cache.bytes == 200, "replacement does not double count");
+
+    assert_true(!image_cache_put(&cache, &b, make_data(2000, 1), 2000), "image over the whole budget is refused");
+    assert_true(image_cache_get(&cache, &a) != NULL, "refused image evicts nothing");
+    image_cache_free(&cache);
+}
+
+static void test_lru_eviction(void){
+    ImageCache cache;
+    image_cache_init(&cache, 300);
+    RenderKey k[4];
+    for(int i = 0; i < 4; i++) k[i] = make_key(i, 0.0f);
+    for(int i = 0; i < 3; i++) image_cache_put(&cache, &k[i], make_data(100, (uint8_t)i), 100);
+    image_cache_get(&cache, &k[0]); // k[1] is now the oldest
+    image_cache_put(&cache, &k[3], make_data(100, 3), 100);
+    assert_true(image_cache_get(&cache, &k[1]) == NULL, "least recently used image evicted");
+    assert_true(image_cache_get(&cache, &k[0]) && image_cache_get(&cache, &k[2]) && image_cache_get(&cache, &k[3]),
+                "recently used images kept");
+    assert_true(cache.bytes <= 300 && cache.evictions == 1, "budget held with one eviction");
+    image_cache_free(&cache);
+}
+
+static void test_many(void){
+    // Enough entries to grow the bucket table several times.
+    ImageCache cache;
+    image_cache_init(&cache, 1 << 20);
+    for(int i = 0; i < 5000; i++){
+        RenderKey key = make_key(i % 20, (float)i * 0.01f);
+        image_cache_put(&cache, &key, make_data(16, (uint8_t)i), 16);
+    }
+    bool all = true;
+    for(int i = 0; i < 5000; i++){
+        RenderKey key = make_key(i % 20, (float)i * 0.01f);
+        const CachedImage *e = image_cache_get(&cache, &key);
+        if(!e || e->data[0] != (uint8_t)i) all = false;
+    }
+    assert_true(all && cache.count == 5000, "every entry found after the table grows");
+    image_cache_free(&cache);
+    assert_true(cache.count == 0 && cache.bytes == 0, "free empties the cache");
+}
+
+static void test_drop_compounds(void){
+    ImageCache cache;
+    image_cache_init(&cache, 1 << 20);
+    for(int i = 0; i < 40; i++){
+        RenderKey key = make_key(i % 10, (float)i);
+        image_cache_put(&cache, &key, make_data(16, (uint8_t)i), 16);
+    }
+    assert_true(image_cache_drop_compounds(&cache, 3, 1) == 4, "one compound's images dropped");
+    RenderKey dropped = make_key(3, 3.0f), kept = make_key(4, 4.0f);
+    assert_true(image_cache_get(&cache, &dropped) == NULL && image_cache_get(&cache, &kept) != NULL,
+                "other compounds kept");
+    assert_true(image_cache_drop_compounds(&cache, 8, 1 << 30) == 8 && cache.count == 28 && cache.bytes == 28 * 16,
+                "open-ended range drops the rest");
+    assert_true(image_cache_put(&cache, &dropped, make_data(16, 1), 16) && image_cache_get(&cache, &dropped),
+                "dropped key can be cached again");
+    image_cache_free(&cache);
+}
+
+int main(void){
+    test_get_put();
+    test_lru_eviction();
+    test_many();
+    test_drop_compounds();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,185 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/isosurface.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void assert_near(float a, float b, float eps, const char *msg){
+    tests_run++;
+    if(fabsf(a - b) > eps){
+        tests_failed++;
+        printf("[FAIL] %s (got %.6f expected %.6f)\n", msg, a, b);
+    }
+}
+
+static Vec3 sub(Vec3 a, Vec3 b){ return make_vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static Vec3 cross(Vec3 a, Vec3 b){ return make_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x); }
+static float dot(Vec3 a, Vec3 b){ return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+static void mesh_measure(const SurfaceMesh *mesh, float *area, float *volume){
+    double a = 0.0, v = 0.0;
+    for(int t = 0; t + 2 < mesh->vertexCount; t += 3){
+        Vec3 p0 = mesh->position[t], p1 = mesh->position[t+1], p2 = mesh->position[t+2];
+        Vec3 n = cross(sub(p1, p0), sub(p2, p0));
+        a += 0.5 * sqrt(dot(n, n));
+        v += dot(p0, cross(p1, p2)) / 6.0;
+    }
+    *area = (float)a;
+    *volume = (float)v;
+}
+
+// Welds vertices by rounding and checks every edge is shared by exactly two
+// triangles, in opposite directions.
+static bool mesh_is_closed(const SurfaceMesh *mesh){
+    int n = mesh->vertexCount;
+    long long *edges = malloc(sizeof(long long) * (size_t)n);
+    int *ids = malloc(sizeof(int) * (size_t)n);
+    for(int i = 0; i < n; i++){
+        ids[i] = -1;
+        for(int j = 0; j < i && ids[i] < 0; j++){
+            Vec3 d = sub(mesh->position[i], mesh->position[j]);
+            if(dot(d, d) < 1e-10f) ids[i] = ids[j];
+        }
+        if(ids[i] < 0) ids[i] = i;
+    }
+    for(int t = 0; t < n; t += 3){
+        for(int k = 0; k < 3; k++){
+            edges[t + k] = (long long)ids[t + k] * n + ids[t + (k + 1) % 3];
+        }
+    }
+    bool closed = true;
+    for(int i = 0; i < n && closed; i++){
+        long long a = edges[i] / n, b = edges[i] % n;
+        if(a == b) continue; // degenerate sliver on a sample point
+        int forward = 0, backward = 0;
+        for(int j = 0; j < n; j++){
+            if(edges[j] == edges[i]) forward++;
+            if(edges[j] == b * n + a) backward++;
+        }
+        if(forward != 1 || backward != 1) closed = false;
+    }
+    free(edges);
+    free(ids);
+    return closed;
+}
+
+static void test_single_atom_sphere(void){
+    Vec3 pos[1] = { {0.3f, -0.2f, 0.1f} };
+    float radius[1] = { 1.7f };
+    SurfaceOptions opt = surface_default_options();
+    opt.spacing = 0.25f;
+    SurfaceMesh mesh;
+    assert_true(surface_build(pos, radius, 1, &opt, &mesh), "build succeeds");
+    assert_true(mesh.vertexCount > 0 && mesh.vertexCount % 3 == 0, "mesh is a triangle list");
+
+    float maxErr = 0.0f, minAlign = 1.0f;
+    for(int i = 0; i < mesh.vertexCount; i++){
+        Vec3 d = sub(mesh.position[i], pos[0]);
+        float r = sqrtf(dot(d, d));
+        if(fabsf(r - 1.7f) > maxErr) maxErr = fabsf(r - 1.7f);
+        float align = dot(d, mesh.normal[i]) / r;
+        if(align < minAlign) minAlign = align;
+    }
+    assert_true(maxErr < 0.05f, "vertices lie on the atom radius");
+    assert_true(minAlign > 0.99f, "normals point outwards");
+
+    float area, volume;
+    mesh_measure(&mesh, &area, &volume);
+    float r = 1.7f;
+    assert_near(area, 4.0f * PI * r * r, 0.03f * 4.0f * PI * r * r, "sphere area");
+    assert_near(volume, 4.0f / 3.0f * PI * r * r * r, 0.03f * 4.0f / 3.0f * PI * r * r * r, "sphere volume, outward winding");
+    surface_mesh_free(&mesh);
+}
+
+static void test_closed_across_blocks(void){
+    // Three overlapping atoms spanning several blocks, with the join saddles
+    // exercising the ambiguous cube faces.
+    Vec3 pos[3] = { {0.0f, 0.0f, 0.0f}, {2.6f, 0.4f, 0.0f}, {1.2f, 2.4f, 0.7f} };
+    float radius[3] = { 1.7f, 1.52f, 1.55f };
+    SurfaceOptions opt = surface_default_options();
+    SurfaceMesh mesh;
+    surface_build(pos, radius, 3, &opt, &mesh);
+    assert_true(mesh_is_closed(&mesh), "mesh is watertight across block borders");
+
+    float area, volume;
+    mesh_measure(&mesh, &area, &volume);
+    assert_true(volume > 0.0f, "consistent outward winding");
+    surface_mesh_free(&mesh);
+}
+
+static void test_cache(void){
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    mol.atomPos[0] = make_vec3(0.0f, 0.0f, 0.0f);
+    mol.atomPos[1] = make_vec3(1.4f, 0.0f, 0.0f);
+    mol.atomLabel[1] = 1;
+    mol.atomCount = 2;
+
+    SurfaceCache cache;
+    surface_cache_init(&cache);
+    assert_true(surface_cache_update(&cache, &mol), "first update builds");
+    assert_true(!surface_cache_update(&cache, &mol), "unchanged geometry reuses the mesh");
+    mol.atomPos[1].y += 0.2f;
+    assert_true(surface_cache_update(&cache, &mol), "moved atom rebuilds");
+    assert_true(cache.mesh.vertexCount > 0, "cached mesh populated");
+    surface_cache_free(&cache);
+}
+
+static void test_large_structure(void){
+    int side = 22;
+    int n = side * side * side;
+    Vec3 *pos = malloc(sizeof(Vec3) * n);
+    float *radius = malloc(sizeof(float) * n);
+    for(int i = 0; i < n; i++){
+        pos[i] = make_vec3((float)(i % side) * 1.5f, (float)((i / side) % side) * 1.5f, (float)(i / (side*side)) * 1.5f);
+        radius[i] = 1.7f;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    SurfaceOptions opt = surface_default_options();
+    SurfaceMesh mesh;
+    bool ok = surface_build(pos, radius, n, &opt, &mesh);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    printf("isosurface: %d atoms, %d triangles in %.3f s\n", n, mesh.vertexCount / 3, seconds);
+
+    // The lattice is dense enough to be one box; only the skin is meshed.
+    float edge = (float)(side - 1) * 1.5f;
+    float area, volume;
+    mesh_measure(&mesh, &area, &volume);
+    assert_true(ok, "large build succeeds");
+    assert_true(area > 6.0f * edge * edge && area < 6.0f * (edge + 5.0f) * (edge + 5.0f), "only the outer skin is meshed");
+
+    surface_mesh_free(&mesh);
+    free(pos);
+    free(radius);
+}
+
+int main(void){
+    test_single_atom_sphere();
+    test_closed_across_blocks();
+    test_cache();
+    test_large_structure();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
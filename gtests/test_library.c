@@ -0,0 +1,106 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/library.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void write_file(const char *path, const char *text){
+    FILE *f = fopen(path, "w");
+    if(!f) return;
+    fputs(text, f);
+    fclose(f);
+}
+
+static void test_element_labels(void){
+    assert_true(element_label("C") == 0, "carbon is label 0");
+    assert_true(element_label("cl") == 3, "symbols are case-insensitive");
+    assert_true(element_label("F") == 4, "fluorine is label 4");
+    assert_true(element_label("H") == -2, "hydrogen is reported separately");
+    assert_true(element_label("Fe") == -1, "iron has no atlas colour");
+}
+
+static void test_load(void){
+    char path[256];
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_library_%d.xyz", (int)getpid());
+    write_file(path,
+               "3\n"
+               "  ethanol  \n"
+               "C -1.2 0.0 0.0\n"
+               "C  0.3 0.0 0.0\n"
+               "O  0.8 1.2 0.0\n"
+               "\n"
+               "4\n"
+               "\n"
+               "O 0 0 0\n"
+               "H 0.96 0 0\n"
+               "H -0.24 0.93 0\n"
+               "O 5 0 0\n");
+
+    Library lib;
+    library_init(&lib);
+    char error[256] = "";
+    bool ok = library_load_xyz(&lib, path, error, sizeof(error));
+    assert_true(ok, "well-formed file loads");
+    assert_true(lib.count == 2, "both records loaded");
+    if(lib.count == 2){
+        const MoleculeGeometry *ethanol = &lib.entries[0].mol;
+        assert_true(strcmp(lib.entries[0].name, "ethanol") == 0, "name line is trimmed");
+        assert_true(ethanol->atomCount == 3 && ethanol->atomLabel[2] == 1, "heavy atoms keep their elements");
+        float cx = (ethanol->atomPos[0].x + ethanol->atomPos[1].x + ethanol->atomPos[2].x) / 3.0f;
+        assert_true(fabsf(cx) < 1e-5f, "record is centred on the origin");
+        assert_true(ethanol->bondCount == 2, "C-C and C-O bonds perceived, C...O not");
+
+        const MoleculeGeometry *water = &lib.entries[1].mol;
+        assert_true(water->atomCount == 2, "hydrogens are dropped");
+        assert_true(water->bondCount == 0, "distant oxygens are not bonded");
+        assert_true(strcmp(lib.entries[1].name, "record 2") == 0, "empty names are numbered");
+
+        Compound c = library_compound(&lib, 1);
+        assert_true(c.name == lib.entries[1].name && c.presetType < 0, "compound refers to the entry");
+    }
+    library_free(&lib);
+
+    write_file(path, "2\nbroken\nC 0 0 0\nXx 1 1 1\n");
+    library_init(&lib);
+    ok = library_load_xyz(&lib, path, error, sizeof(error));
+    assert_true(!ok && strstr(error, ":4:") && strstr(error, "Xx"), "unsupported element reported with its line");
+    library_free(&lib);
+
+    write_file(path, "2\ntruncated\nC 0 0 0\n");
+    library_init(&lib);
+    ok = library_load_xyz(&lib, path, error, sizeof(error));
+    assert_true(!ok && strstr(error, ":4:"), "missing atom line reported");
+    assert_true(lib.count == 0, "partial record is not kept");
+    library_free(&lib);
+
+    remove(path);
+    library_init(&lib);
+    assert_true(!library_load_xyz(&lib, path, error, sizeof(error)), "missing file fails");
+    library_free(&lib);
+}
+
+int main(void){
+    test_element_labels();
+    test_load();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
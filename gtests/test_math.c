@@ -3,30 +3,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-typedef struct { float x, y, z; } Vec3;
-
-static float clampf(float v, float lo, float hi){
-    if(v < lo) return lo;
-    if(v > hi) return hi;
-    return v;
-}
-
-static Vec3 make_vec3(float x, float y, float z){
-    Vec3 v = {x,y,z};
-    return v;
-}
-
-static Vec3 rotate_yaw_pitch(Vec3 p, float yaw, float pitch){
-    float cy = cosf(yaw), sy = sinf(yaw);
-    float x1 =  cy * p.x + sy * p.z;
-    float z1 = -sy * p.x + cy * p.z;
-
-    float cp = cosf(pitch), sp = sinf(pitch);
-    float y2 =  cp * p.y - sp * z1;
-    float z2 =  sp * p.y + cp * z1;
-
-    return make_vec3(x1, y2, z2);
-}
+#include "../src/geometry.h"
 
 static int tests_run = 0;
 static int tests_failed = 0;
@@ -61,6 +38,20 @@ static void test_rotate_identity(void){
     assert_near(q.z, p.z, 1e-6f, "rotate yaw=0 pitch=0 z unchanged");
 }
 
+static void test_rotate_cos_sin_matches(void){
+    Vec3 p = make_vec3(0.3f, -1.2f, 2.5f);
+    float yaw = 0.8f, pitch = -0.4f;
+    Vec3 a = rotate_yaw_pitch(p, yaw, pitch);
+    Vec3 b = rotate_cos_sin(p, cosf(yaw), sinf(yaw), cosf(pitch), sinf(pitch));
+    assert_near(a.x, b.x, 1e-6f, "precomputed rotation x matches");
+    assert_near(a.y, b.y, 1e-6f, "precomputed rotation y matches");
+    assert_near(a.z, b.z, 1e-6f, "precomputed rotation z matches");
+
+    float lenP = sqrtf(p.x*p.x + p.y*p.y + p.z*p.z);
+    float lenA = sqrtf(a.x*a.x + a.y*a.y + a.z*a.z);
+    assert_near(lenA, lenP, 1e-5f, "rotation preserves length");
+}
+
 static void test_rotate_yaw_90(void){
     float yaw = (float)M_PI * 0.5f;
     Vec3 p = make_vec3(1.0f, 0.0f, 0.0f);
@@ -73,6 +64,7 @@ int main(void){
     test_clampf();
     test_rotate_identity();
     test_rotate_yaw_90();
+    test_rotate_cos_sin_matches();
 
     if(tests_failed == 0){
         printf("[OK] %d tests passed\n", tests_run);
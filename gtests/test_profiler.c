@@ -0,0 +1,197 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/profiler.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static char *read_file(const char *path){
+    FILE *f = fopen(path, "rb");
+    if(!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc((size_t)n + 1);
+    size_t got = fread(buf, 1, (size_t)n, f);
+    buf[got] = '\0';
+    fclose(f);
+    return buf;
+}
+
+static int count_occurrences(const char *text, const char *needle){
+    int n = 0;
+    for(const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) n++;
+    return n;
+}
+
+static void busy_wait_us(int us){
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+    } while((t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000 < us);
+}
+
+static void traced_work(void){
+    PROF_SCOPE("outer");
+    busy_wait_us(200);
+    {
+        PROF_SCOPE("inner");
+        busy_wait_us(200);
+    }
+}
+
+static pthread_barrier_t workersDone;
+
+// Both workers stay alive until both have recorded, so neither inherits
+// the other's ring.
+static void *thread_work(void *arg){
+    (void)arg;
+    for(int i = 0; i < 3; i++){
+        PROF_SCOPE("worker");
+        PROF_COUNT(PROF_ATOMS, 10);
+    }
+    pthread_barrier_wait(&workersDone);
+    return NULL;
+}
+
+static void *short_lived(void *arg){
+    (void)arg;
+    PROF_SCOPE("short_lived");
+    return NULL;
+}
+
+static void test_disabled_records_nothing(void){
+    profiler_set_enabled(false);
+    traced_work();
+    PROF_COUNT(PROF_DRAW_CALLS, 5);
+    profiler_frame_end();
+
+    float ms[4];
+    assert_true(profiler_frame_history(ms, 4) == 0, "no frames while disabled");
+
+    const char *path = "test_profiler_empty.json";
+    assert_true(profiler_dump_chrome_trace(path), "dump succeeds");
+    char *text = read_file(path);
+    assert_true(text && strstr(text, "\"traceEvents\"") != NULL, "valid trace skeleton");
+    assert_true(text && count_occurrences(text, "\"ph\":\"X\"") == 0, "no scopes recorded");
+    free(text);
+    remove(path);
+}
+
+static void test_scopes_counters_and_frames(void){
+    profiler_set_enabled(true);
+    for(int frame = 0; frame < 3; frame++){
+        traced_work();
+        PROF_COUNT(PROF_DRAW_CALLS, 7);
+        PROF_COUNT(PROF_PIXELS, 1000);
+        profiler_frame_end();
+    }
+
+    pthread_t threads[2];
+    pthread_barrier_init(&workersDone, NULL, 2);
+    for(int i = 0; i < 2; i++) pthread_create(&threads[i], NULL, thread_work, NULL);
+    for(int i = 0; i < 2; i++) pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&workersDone);
+    profiler_frame_end();
+
+    float ms[8];
+    int frames = profiler_frame_history(ms, 8);
+    assert_true(frames == 4, "one history entry per frame");
+    assert_true(ms[1] >= 0.3f, "frame time covers the traced work");
+
+    uint64_t counters[PROF_COUNTER_COUNT];
+    profiler_last_counters(counters);
+    assert_true(counters[PROF_ATOMS] == 60, "counters from every thread land in the frame");
+    assert_true(counters[PROF_DRAW_CALLS] == 0, "counters reset each frame");
+
+    const char *path = "test_profiler.json";
+    assert_true(profiler_dump_chrome_trace(path), "dump succeeds");
+    char *text = read_file(path);
+    assert_true(text != NULL, "dump readable");
+    if(text){
+        assert_true(count_occurrences(text, "\"name\":\"outer\"") == 3, "outer scopes");
+        assert_true(count_occurrences(text, "\"name\":\"inner\"") == 3, "inner scopes");
+        assert_true(count_occurrences(text, "\"name\":\"worker\"") == 6, "worker scopes");
+        assert_true(count_occurrences(text, "\"ph\":\"C\"") == 4, "one counter event per frame");
+        assert_true(strstr(text, "\"tid\":1") && strstr(text, "\"tid\":2"), "worker threads get their own rings");
+
+        // The inner scope's duration (~200us) must fit inside the outer one.
+        const char *outer = strstr(text, "\"name\":\"outer\"");
+        const char *inner = strstr(text, "\"name\":\"inner\"");
+        double outerDur = 0.0, innerDur = 0.0;
+        if(outer) sscanf(strstr(outer, "\"dur\":") + 6, "%lf", &outerDur);
+        if(inner) sscanf(strstr(inner, "\"dur\":") + 6, "%lf", &innerDur);
+        assert_true(innerDur >= 150.0 && outerDur > innerDur, "durations in microseconds, nested");
+    }
+    free(text);
+    remove(path);
+    profiler_set_enabled(false);
+}
+
+// A thread per background job must not use up the rings: exited threads
+// hand theirs on.
+static void test_rings_recycled(void){
+    profiler_set_enabled(true);
+    int threads = PROF_MAX_THREADS * 3;
+    for(int i = 0; i < threads; i++){
+        pthread_t t;
+        pthread_create(&t, NULL, short_lived, NULL);
+        pthread_join(t, NULL);
+    }
+    assert_true(profiler_dropped_events() == 0, "no events dropped after many short-lived threads");
+
+    const char *path = "test_profiler_recycled.json";
+    assert_true(profiler_dump_chrome_trace(path), "dump succeeds");
+    char *text = read_file(path);
+    assert_true(text && count_occurrences(text, "\"name\":\"short_lived\"") == threads, "every thread's scope is kept");
+    assert_true(text && strstr(text, "\"droppedEvents\":0") != NULL, "dropped events are reported");
+    free(text);
+    remove(path);
+    profiler_set_enabled(false);
+}
+
+static void test_disabled_overhead(void){
+    profiler_set_enabled(false);
+    struct timespec t0, t1;
+    int n = 10000000;
+    volatile int sink = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(int i = 0; i < n; i++){
+        PROF_SCOPE("hot");
+        PROF_COUNT(PROF_PIXELS, 1);
+        sink += i;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = ((double)(t1.tv_sec - t0.tv_sec) * 1e9 + (double)(t1.tv_nsec - t0.tv_nsec)) / n;
+    printf("profiler: disabled scope + counter %.2f ns\n", ns);
+    assert_true(ns < 20.0, "disabled instrumentation is nearly free");
+}
+
+int main(void){
+    test_disabled_records_nothing();
+    test_scopes_counters_and_frames();
+    test_rings_recycled();
+    test_disabled_overhead();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -1,8 +1,9 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
-typedef struct { float x,y,z; } Vec3;
+#include "../src/geometry.h"
 
 static int tests_run = 0;
 static int tests_failed = 0;
@@ -23,13 +24,6 @@ static void assert_near(float a, float b, float eps, const char *msg){
     }
 }
 
-static void project_to_screen(Vec3 p, float zoom, int cx, int cy, int *sx, int *sy, float *depth){
-    float perspective = 900.0f / (900.0f + p.z);
-    *sx = (int)lroundf(cx + p.x * zoom * perspective);
-    *sy = (int)lroundf(cy - p.y * zoom * perspective);
-    *depth = p.z;
-}
-
 int main(void){
     int sx1, sy1, sx2, sy2;
     float d1, d2;
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../src/raster.h"
+#include "../src/text.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+#define W 32
+#define H 32
+
+static uint32_t pixels[W * H];
+
+static Canvas make_canvas(void){
+    Canvas c = { pixels, W, H, W };
+    canvas_clear(&c, 0xFF000000u);
+    return c;
+}
+
+static int count_pixels(const Canvas *c, uint32_t argb){
+    int n = 0;
+    for(int y = 0; y < c->height; y++){
+        for(int x = 0; x < c->width; x++) n += c->pixels[y * c->pitch + x] == argb;
+    }
+    return n;
+}
+
+static void set_vertex(SDL_Vertex *v, float x, float y){
+    v->position.x = x;
+    v->position.y = y;
+    v->color.r = 255;
+    v->color.g = 0;
+    v->color.b = 0;
+    v->color.a = 255;
+    v->tex_coord.x = 0;
+    v->tex_coord.y = 0;
+}
+
+static void test_rects_and_clip(void){
+    Canvas canvas = make_canvas();
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    cmd_color(&cb, 255, 255, 255, 255);
+    cmd_fill_rect(&cb, 2, 2, 4, 3);
+    cmd_point(&cb, 31, 31);
+    SDL_Rect clip = { 0, 0, 16, 16 };
+    cmd_clip(&cb, &clip);
+    cmd_fill_rect(&cb, 10, 10, 20, 20);
+    cmd_clip(&cb, NULL);
+    command_buffer_rasterize(&cb, &canvas);
+    assert_true(count_pixels(&canvas, 0xFFFFFFFFu) == 12 + 1 + 36, "rects, point and clipped rect cover the right pixels");
+    assert_true(pixels[31 * W + 31] == 0xFFFFFFFFu, "point lands on its pixel");
+    assert_true(pixels[20 * W + 20] == 0xFF000000u, "clip rect masks drawing");
+
+    canvas = make_canvas();
+    command_buffer_reset(&cb);
+    cmd_color(&cb, 0, 255, 0, 255);
+    SDL_Rect outline = { 4, 4, 5, 5 };
+    cmd_draw_rect(&cb, &outline);
+    command_buffer_rasterize(&cb, &canvas);
+    assert_true(count_pixels(&canvas, 0xFF00FF00u) == 16, "outline is one pixel wide");
+    assert_true(pixels[6 * W + 6] == 0xFF000000u, "outline is hollow");
+    command_buffer_free(&cb);
+}
+
+static void test_blend(void){
+    Canvas canvas = make_canvas();
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    cmd_color(&cb, 255, 255, 255, 128);
+    cmd_fill_rect(&cb, 0, 0, 1, 1);
+    cmd_blend(&cb, SDL_BLENDMODE_BLEND);
+    cmd_fill_rect(&cb, 1, 0, 1, 1);
+    command_buffer_rasterize(&cb, &canvas);
+    assert_true(pixels[0] == 0x80FFFFFFu, "blend mode none copies the colour");
+    uint32_t g = (pixels[1] >> 8) & 255;
+    assert_true(g >= 127 && g <= 129, "blend mode blend mixes by alpha");
+    command_buffer_free(&cb);
+}
+
+static void test_triangles(void){
+    Canvas canvas = make_canvas();
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    // Two triangles sharing a diagonal: every pixel of the square is
+    // covered exactly once, whichever way each triangle winds.
+    cmd_blend(&cb, SDL_BLENDMODE_BLEND);
+    SDL_Vertex *v = cmd_geometry(&cb, 6);
+    set_vertex(&v[0], 4, 4);
+    set_vertex(&v[1], 12, 4);
+    set_vertex(&v[2], 12, 12);
+    set_vertex(&v[3], 4, 4);
+    set_vertex(&v[4], 12, 12);
+    set_vertex(&v[5], 4, 12);
+    for(int i = 0; i < 6; i++) v[i].color.a = 128;
+    command_buffer_rasterize(&cb, &canvas);
+    int once = 0, twice = 0, outside = 0;
+    for(int y = 0; y < H; y++){
+        for(int x = 0; x < W; x++){
+            uint32_t r = (pixels[y * W + x] >> 16) & 255;
+            bool inside = x >= 4 && x < 12 && y >= 4 && y < 12;
+            if(inside && r >= 127 && r <= 129) once++;
+            else if(inside && r > 129) twice++;
+            else if(!inside && r != 0) outside++;
+        }
+    }
+    assert_true(once == 64, "shared edge pixels are drawn once (top-left rule)");
+    assert_true(twice == 0 && outside == 0, "no overdraw or bleed outside the square");
+    command_buffer_free(&cb);
+}
+
+static void test_text(void){
+    Canvas canvas = make_canvas();
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    draw_text(&cb, 1, 1, 1, 0xFFFFFFFFu, "I");
+    command_buffer_rasterize(&cb, &canvas);
+    int lit = count_pixels(&canvas, 0xFFFFFFFFu);
+    assert_true(lit > 0 && lit <= GLYPH_WIDTH * GLYPH_HEIGHT, "glyph pixels come from the atlas mask");
+    bool inside = true;
+    for(int y = 0; y < H; y++){
+        for(int x = 0; x < W; x++){
+            if(pixels[y * W + x] != 0xFF000000u && (x < 1 || x >= 1 + GLYPH_WIDTH || y < 1 || y >= 1 + GLYPH_HEIGHT)) inside = false;
+        }
+    }
+    assert_true(inside, "glyph stays inside its cell");
+    command_buffer_free(&cb);
+}
+
+static void test_pitch(void){
+    // A canvas that is the right half of a wider image.
+    static uint32_t sheet[8 * 4];
+    for(int i = 0; i < 8 * 4; i++) sheet[i] = 0;
+    Canvas cell = { sheet + 4, 4, 4, 8 };
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    cmd_color(&cb, 255, 255, 255, 255);
+    cmd_fill_rect(&cb, -2, -2, 100, 100);
+    command_buffer_rasterize(&cb, &cell);
+    int left = 0, right = 0;
+    for(int y = 0; y < 4; y++){
+        for(int x = 0; x < 8; x++){
+            if(sheet[y * 8 + x] && x < 4) left++;
+            if(sheet[y * 8 + x] && x >= 4) right++;
+        }
+    }
+    assert_true(right == 16 && left == 0, "drawing is confined to the cell");
+    command_buffer_free(&cb);
+}
+
+int main(void){
+    test_rects_and_clip();
+    test_blend();
+    test_triangles();
+    test_text();
+    test_pitch();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
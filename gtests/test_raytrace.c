@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/geometry.h"
+#include "../src/raytrace.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void assert_near(float a, float b, float eps, const char *msg){
+    tests_run++;
+    if(fabsf(a - b) > eps){
+        tests_failed++;
+        printf("[FAIL] %s (got %.6f expected %.6f)\n", msg, a, b);
+    }
+}
+
+static uint32_t atomColors[MAX_ATOMS];
+
+static void build_chain(MoleculeGeometry *mol, int atoms){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < atoms; i++){
+        mol->atomPos[i] = make_vec3((float)i * 1.4f - (float)(atoms - 1) * 0.7f, (i % 2) ? 0.5f : -0.5f, 0.0f);
+        mol->atomLabel[i] = (uint8_t)(i % 3 == 2);
+        atomColors[i] = 0xC0C0C0FF;
+        if(i > 0) mol->bonds[mol->bondCount++] = (Bond){ i - 1, i, (i % 4 == 0) ? 2 : 1 };
+    }
+    mol->atomCount = atoms;
+}
+
+static TraceScene make_scene(const MoleculeGeometry *mol, int w, int h){
+    TraceScene s;
+    memset(&s, 0, sizeof(s));
+    s.mol = mol;
+    s.atomColor = atomColors;
+    s.bondColor = 0x808080FF;
+    s.background = 0x101014FF;
+    s.zoom = 20.0f;
+    s.centerX = (float)w * 0.5f;
+    s.centerY = (float)h * 0.5f;
+    s.width = w;
+    s.height = h;
+    return s;
+}
+
+static void test_ray_hits_match_geometry(void){
+    MoleculeGeometry mol;
+    build_chain(&mol, 12);
+    Tracer *t = tracer_create();
+    TraceScene s = make_scene(&mol, 64, 64);
+    tracer_set_scene(t, &s);
+
+    // Straight down onto an atom centre hits its sphere cap.
+    Vec3 c = mol.atomPos[3];
+    float d = tracer_cast(t, make_vec3(c.x, c.y, 10.0f), make_vec3(0.0f, 0.0f, -1.0f));
+    assert_near(d, 10.0f - 0.40f, 1e-3f, "primary ray meets the carbon sphere");
+
+    float miss = tracer_cast(t, make_vec3(0.0f, 30.0f, 10.0f), make_vec3(0.0f, 0.0f, -1.0f));
+    assert_true(miss < 0.0f, "ray beside the molecule misses");
+
+    // Along the chain axis through the first atom: the near sphere wins.
+    Vec3 a0 = mol.atomPos[0];
+    float along = tracer_cast(t, make_vec3(a0.x - 5.0f, a0.y, 0.0f), make_vec3(1.0f, 0.0f, 0.0f));
+    assert_near(along, 5.0f - 0.40f, 1e-3f, "closest of several primitives");
+
+    // Perpendicular through the middle of a single bond hits the cylinder.
+    Vec3 a = mol.atomPos[1], b = mol.atomPos[2];
+    Vec3 mid = make_vec3((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, 0.0f);
+    float bond = tracer_cast(t, make_vec3(mid.x, mid.y, 5.0f), make_vec3(0.0f, 0.0f, -1.0f));
+    assert_near(bond, 5.0f - 0.13f, 1e-3f, "bond cylinder");
+    tracer_destroy(t);
+}
+
+static void test_progressive_accumulation(void){
+    MoleculeGeometry mol;
+    build_chain(&mol, 8);
+    Tracer *t = tracer_create();
+    TraceScene s = make_scene(&mol, 96, 48);
+    assert_true(tracer_set_scene(t, &s), "first scene starts accumulation");
+
+    int calls = 0;
+    while(!tracer_preview_done(t) && calls < 1000){
+        tracer_render(t, 0.0);
+        calls++;
+    }
+    assert_true(tracer_preview_done(t), "zero budget calls still complete the preview");
+    assert_true(tracer_samples(t) == 0, "zero budget calls only draw the preview");
+    const uint32_t *px = tracer_pixels(t);
+    assert_true((px[0] & 0xFFFFFF) == 0x101014, "corner is background");
+    int ax = (int)(s.centerX + mol.atomPos[2].x * s.zoom);
+    int ay = (int)(s.centerY - mol.atomPos[2].y * s.zoom);
+    assert_true((px[ay * 96 + ax] & 0xFFFFFF) != 0x101014, "atom shows in the preview");
+
+    for(int i = 0; i < 200 && tracer_samples(t) < 8; i++) tracer_render(t, 0.01);
+    int samples = tracer_samples(t);
+    assert_true(samples >= 8, "samples accumulate across calls");
+
+    assert_true(!tracer_set_scene(t, &s), "unchanged view keeps accumulating");
+    assert_true(tracer_samples(t) == samples, "sample count preserved");
+
+    s.yaw += 0.1f;
+    assert_true(tracer_set_scene(t, &s), "view change restarts");
+    assert_true(tracer_samples(t) == 0, "accumulation reset");
+    tracer_destroy(t);
+}
+
+static void test_occlusion_darkens_contacts(void){
+    // A lone atom against one pressed into a crowd: ambient occlusion must
+    // make the crowded one darker at the same relative pixel.
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    mol.atomPos[0] = make_vec3(-3.0f, 0.0f, 0.0f);
+    mol.atomPos[1] = make_vec3(3.0f, 0.0f, 0.0f);
+    int n = 2;
+    for(int k = 0; k < 6; k++){
+        float a = (float)k * PI / 3.0f;
+        mol.atomPos[n++] = make_vec3(3.0f + 0.75f * cosf(a), 0.75f * sinf(a), -0.35f);
+    }
+    mol.atomCount = n;
+    for(int i = 0; i < n; i++) atomColors[i] = 0xFFFFFFFF;
+
+    Tracer *t = tracer_create();
+    TraceScene s = make_scene(&mol, 160, 48);
+    tracer_set_scene(t, &s);
+    for(int i = 0; i < 400 && tracer_samples(t) < 32; i++) tracer_render(t, 0.01);
+
+    const uint32_t *px = tracer_pixels(t);
+    int y = 24;
+    int xLone = (int)(s.centerX - 3.0f * s.zoom);
+    int xCrowd = (int)(s.centerX + 3.0f * s.zoom);
+    float lone = 0.0f, crowd = 0.0f;
+    for(int dy = -3; dy <= 3; dy++){
+        lone += (float)((px[(y + dy) * 160 + xLone] >> 8) & 255);
+        crowd += (float)((px[(y + dy) * 160 + xCrowd] >> 8) & 255);
+    }
+    assert_true(crowd < lone, "occluded atom is darker");
+    tracer_destroy(t);
+}
+
+// A large view's preview is split across frames instead of blowing
+// through the budget in one call.
+static void test_preview_within_budget(void){
+    MoleculeGeometry mol;
+    build_chain(&mol, 8);
+    Tracer *t = tracer_create();
+    TraceScene s = make_scene(&mol, 2048, 2048);
+    tracer_set_scene(t, &s);
+    tracer_render(t, 0.0);
+    assert_true(!tracer_preview_done(t), "one zero-budget call draws part of a large preview");
+    const uint32_t *px = tracer_pixels(t);
+    assert_true((px[2047 * 2048 + 2047] & 0xFFFFFF) == 0x101014, "unfinished tiles show the background");
+    int calls = 1;
+    while(!tracer_preview_done(t) && calls < 10000){
+        tracer_render(t, 0.0);
+        calls++;
+    }
+    assert_true(tracer_preview_done(t) && calls > 1, "preview completes over several calls");
+    tracer_destroy(t);
+}
+
+// The traced view must line up with draw_molecule: an atom far off-axis
+// and off the mid plane is drawn where project_to_screen() puts it.
+static void test_matches_projection(void){
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    mol.atomPos[0] = make_vec3(20.0f, 3.0f, 60.0f);
+    mol.atomPos[1] = make_vec3(-20.0f, -3.0f, -60.0f);
+    mol.atomCount = 2;
+    atomColors[0] = atomColors[1] = 0xFFFFFFFF;
+
+    Tracer *t = tracer_create();
+    TraceScene s = make_scene(&mol, 1000, 240);
+    tracer_set_scene(t, &s);
+    tracer_render_samples(t, 1);
+    const uint32_t *px = tracer_pixels(t);
+
+    for(int a = 0; a < 2; a++){
+        int sx, sy;
+        float depth;
+        project_to_screen(mol.atomPos[a], s.zoom, (int)s.centerX, (int)s.centerY, &sx, &sy, &depth);
+        // Centre of the atom's hit pixels along its projected row and column.
+        int left = -1, right = -1, upper = -1, lower = -1;
+        for(int x = 0; x < 1000; x++){
+            if((px[sy * 1000 + x] & 0xFFFFFF) == 0x101014 || abs(x - sx) > 40) continue;
+            if(left < 0) left = x;
+            right = x;
+        }
+        for(int y = 0; y < 240; y++){
+            if((px[y * 1000 + sx] & 0xFFFFFF) == 0x101014 || abs(y - sy) > 40) continue;
+            if(upper < 0) upper = y;
+            lower = y;
+        }
+        char msg[64];
+        snprintf(msg, sizeof(msg), "atom %d is traced where it is projected", a);
+        assert_true(left >= 0 && upper >= 0 && abs((left + right) / 2 - sx) <= 1 && abs((upper + lower) / 2 - sy) <= 1, msg);
+    }
+    tracer_destroy(t);
+}
+
+int main(void){
+    test_ray_hits_match_geometry();
+    test_progressive_accumulation();
+    test_preview_within_budget();
+    test_occlusion_darkens_contacts();
+    test_matches_projection();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/library.h"
+#include "../src/reload.h"
+#include "../src/watch.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+// A library file as a list of records; kind 0 is a named molecule, 1 one
+// with a blank name line and 2 hydrogen only (no entry).
+#define MAX_RECORDS 6000
+
+typedef struct {
+    int kind[MAX_RECORDS];
+    int id[MAX_RECORDS]; // names stay with their record as others come and go
+    int atoms[MAX_RECORDS];
+    float x[MAX_RECORDS];
+    int count;
+} Model;
+
+static char path[64];
+
+static void model_init(Model *m, int count){
+    m->count = count;
+    for(int i = 0; i < count; i++){
+        m->kind[i] = i % 97 == 5 ? 1 : i % 89 == 7 ? 2 : 0;
+        m->id[i] = i;
+        m->atoms[i] = 2 + i % 3;
+        m->x[i] = 0.25f * (float)(i % 11);
+    }
+}
+
+static void model_insert(Model *m, int at, int kind){
+    memmove(&m->kind[at + 1], &m->kind[at], sizeof(int) * (size_t)(m->count - at));
+    memmove(&m->id[at + 1], &m->id[at], sizeof(int) * (size_t)(m->count - at));
+    memmove(&m->atoms[at + 1], &m->atoms[at], sizeof(int) * (size_t)(m->count - at));
+    memmove(&m->x[at + 1], &m->x[at], sizeof(float) * (size_t)(m->count - at));
+    m->kind[at] = kind;
+    m->id[at] = 100000 + at;
+    m->atoms[at] = 3;
+    m->x[at] = 9.0f;
+    m->count++;
+}
+
+static void model_remove(Model *m, int at){
+    memmove(&m->kind[at], &m->kind[at + 1], sizeof(int) * (size_t)(m->count - at - 1));
+    memmove(&m->id[at], &m->id[at + 1], sizeof(int) * (size_t)(m->count - at - 1));
+    memmove(&m->atoms[at], &m->atoms[at + 1], sizeof(int) * (size_t)(m->count - at - 1));
+    memmove(&m->x[at], &m->x[at + 1], sizeof(float) * (size_t)(m->count - at - 1));
+    m->count--;
+}
+
+static void model_write(const Model *m, const char *tail){
+    char tmp[80];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if(!f) return;
+    for(int i = 0; i < m->count; i++){
+        if(m->kind[i] == 2){
+            fprintf(f, "2\nhydrogen %d\nH 0 0 0\nH 0.74 0 0\n", m->id[i]);
+            continue;
+        }
+        if(m->kind[i] == 1) fprintf(f, "%d\n   \n", m->atoms[i]);
+        else fprintf(f, "%d\nmolecule %d\n", m->atoms[i], m->id[i]);
+        for(int a = 0; a < m->atoms[i]; a++) fprintf(f, "%s %.3f %.3f 0.000\n", a % 2 ? "O" : "C", m->x[i] + 1.2f * (float)a, 0.1f * (float)a);
+        if(m->id[i] % 13 == 0) fputs("\n", f);
+    }
+    fputs(tail, f);
+    fclose(f);
+    rename(tmp, path); // the way editors save
+}
+
+// The reloaded state must be exactly what loading the file afresh gives.
+static bool matches_fresh_load(const LibrarySource *src, const Library *lib){
+    Library fresh;
+    library_init(&fresh);
+    LibrarySource check;
+    char error[256];
+    bool ok = library_source_load(&check, &fresh, path, error, sizeof(error));
+    ok = ok && fresh.count == src->entryCount && lib->count == src->firstEntry + src->entryCount &&
+         memcmp(fresh.entries, lib->entries + src->firstEntry, sizeof(LibraryEntry) * (size_t)fresh.count) == 0;
+    const XyzRecordTable *a = &src->records, *b = &check.records;
+    ok = ok && a->count == b->count && src->size == check.size;
+    for(int i = 0; ok && i < a->count; i++){
+        ok = a->offset[i] == b->offset[i] && a->line[i] == b->line[i] &&
+             a->entryStart[i] == b->entryStart[i] && a->unnamed[i] == b->unnamed[i];
+    }
+    // Blocks still tile the file, though not necessarily as a fresh load would.
+    const BlockList *blocks = &src->blocks;
+    ok = ok && (blocks->count > 0 ? blocks->end[blocks->count - 1] == src->size : src->size == 0);
+    for(int i = 0; ok && i < blocks->count; i++){
+        long long start = i > 0 ? blocks->end[i - 1] : 0;
+        ok = blocks->end[i] > start && blocks->end[i] - start <= LIBRARY_BLOCK;
+    }
+    library_source_free(&check);
+    library_free(&fresh);
+    return ok;
+}
+
+// Entry index of record r, or -1 for hydrogen-only records.
+static int entry_of(const Model *m, int r, int first){
+    if(m->kind[r] == 2) return -1;
+    int e = first;
+    for(int i = 0; i < r; i++) e += m->kind[i] != 2;
+    return e;
+}
+
+static void test_reload(void){
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_reload_%d.xyz", (int)getpid());
+    static Model m;
+    model_init(&m, 5000);
+    model_write(&m, "");
+
+    // Entries before the file's must be left alone.
+    Library lib;
+    library_init(&lib);
+    char error[256];
+    char other[80];
+    snprintf(other, sizeof(other), "%s.other", path);
+    FILE *o = fopen(other, "w");
+    fputs("2\nfirst\nC 0 0 0\nN 1.3 0 0\n", o);
+    fclose(o);
+    library_load_xyz(&lib, other, error, sizeof(error));
+    remove(other);
+
+    LibrarySource src;
+    bool ok = library_source_load(&src, &lib, path, error, sizeof(error));
+    assert_true(ok && src.firstEntry == 1 && src.records.count == 5000, "load records every record");
+    assert_true(src.blocks.count > 4, "test file spans several blocks");
+    assert_true(matches_fresh_load(&src, &lib), "load is reproducible");
+
+    LibraryDelta delta;
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.changedCount == 0 && delta.shiftedFrom < 0 && delta.recordsParsed == 0,
+                "unchanged file parses nothing");
+    library_delta_free(&delta);
+
+    // One coordinate in the middle of the file.
+    m.x[2500] += 0.5f;
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.changedCount == 1 && delta.changed[0] == entry_of(&m, 2500, 1) && delta.shiftedFrom < 0,
+                "one edited record is the only change");
+    assert_true(delta.recordsParsed < 200, "only records near the edit are parsed");
+    assert_true(matches_fresh_load(&src, &lib), "edited record matches a fresh load");
+    library_delta_free(&delta);
+
+    // Saving the same text again.
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.changedCount == 0 && delta.recordsParsed == 0, "resave changes nothing");
+    library_delta_free(&delta);
+
+    // An atom count change moves the record boundaries after it.
+    m.atoms[1200] = 4;
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.changedCount == 1 && delta.changed[0] == entry_of(&m, 1200, 1) && delta.shiftedFrom < 0,
+                "longer record is reported as changed");
+    assert_true(matches_fresh_load(&src, &lib), "longer record matches a fresh load");
+    library_delta_free(&delta);
+
+    // Inserting a record shifts every entry after it.
+    int count = lib.count;
+    model_insert(&m, 3000, 0);
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.shiftedFrom == entry_of(&m, 3000, 1) && lib.count == count + 1 && delta.oldCount == count,
+                "insertion shifts from the new entry");
+    assert_true(matches_fresh_load(&src, &lib), "insertion matches a fresh load");
+    library_delta_free(&delta);
+
+    model_remove(&m, 10);
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.shiftedFrom == entry_of(&m, 10, 1) && lib.count == count, "deletion shifts from its entry");
+    assert_true(matches_fresh_load(&src, &lib), "deletion matches a fresh load");
+    library_delta_free(&delta);
+
+    // A hydrogen-only record adds no entry but renumbers unnamed records.
+    model_insert(&m, 40, 2);
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.shiftedFrom < 0 && lib.count == count, "hydrogen-only record adds no entry");
+    bool renamed = delta.changedCount > 0;
+    for(int i = 0; i < delta.changedCount; i++){
+        LibraryEntry *e = &lib.entries[delta.changed[i]];
+        renamed = renamed && strncmp(e->name, "record ", 7) == 0;
+    }
+    assert_true(renamed, "unnamed records after it are renamed");
+    assert_true(matches_fresh_load(&src, &lib), "hydrogen-only insertion matches a fresh load");
+    library_delta_free(&delta);
+
+    // Both ends of the file.
+    m.x[0] = 5.0f;
+    m.x[m.count - 1] = 5.0f;
+    m.kind[m.count - 1] = 0;
+    model_write(&m, "\n\n");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.changedCount == 2 && delta.changed[0] == 1 && delta.changed[1] == lib.count - 1,
+                "edits at both ends");
+    assert_true(matches_fresh_load(&src, &lib), "edits at both ends match a fresh load");
+    library_delta_free(&delta);
+
+    model_write(&m, "3\nappended\nC 0 0 0\nC 1.5 0 0\nO 3 0 0\n");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.shiftedFrom == count && lib.count == count + 1, "appended record");
+    assert_true(matches_fresh_load(&src, &lib), "append matches a fresh load");
+    library_delta_free(&delta);
+
+    // A half-written file keeps the last good state.
+    Library before = lib;
+    before.entries = malloc(sizeof(LibraryEntry) * (size_t)lib.count);
+    memcpy(before.entries, lib.entries, sizeof(LibraryEntry) * (size_t)lib.count);
+    model_write(&m, "3\ncut short\nC 0 0 0\n");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(!ok && strstr(error, "record ends early") != NULL, "truncated record fails");
+    assert_true(lib.count == before.count &&
+                memcmp(lib.entries, before.entries, sizeof(LibraryEntry) * (size_t)lib.count) == 0,
+                "failed reload keeps the entries");
+    library_delta_free(&delta);
+    free(before.entries);
+
+    model_write(&m, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && delta.shiftedFrom == count && lib.count == count, "repair is compared with the last good file");
+    assert_true(matches_fresh_load(&src, &lib), "repair matches a fresh load");
+    library_delta_free(&delta);
+
+    // Emptying the file.
+    Model empty;
+    empty.count = 0;
+    model_write(&empty, "");
+    ok = library_source_reload(&src, &lib, &delta, error, sizeof(error));
+    assert_true(ok && lib.count == 1 && src.entryCount == 0 && delta.shiftedFrom == 1, "emptied file");
+    library_delta_free(&delta);
+
+    library_source_free(&src);
+    library_free(&lib);
+    remove(path);
+
+    library_init(&lib);
+    assert_true(!library_source_load(&src, &lib, path, error, sizeof(error)) && lib.count == 0, "missing file fails");
+    library_free(&lib);
+}
+
+static void test_watch(void){
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_watch_%d.xyz", (int)getpid());
+    Model m;
+    model_init(&m, 3);
+    model_write(&m, "");
+    FileWatch w;
+    assert_true(file_watch_open(&w, path), "watch opens");
+    assert_true(!file_watch_changed(&w), "nothing pending after opening");
+    model_write(&m, "");
+    assert_true(file_watch_changed(&w), "a save is seen");
+    assert_true(!file_watch_changed(&w), "events are drained");
+
+    char other[80];
+    snprintf(other, sizeof(other), "%s.unrelated", path);
+    FILE *f = fopen(other, "w");
+    fclose(f);
+    remove(other);
+    assert_true(!file_watch_changed(&w), "other files in the directory are ignored");
+    file_watch_close(&w);
+    remove(path);
+}
+
+int main(void){
+    test_reload();
+    test_watch();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/dynamics.h"
+#include "../src/presets.h"
+#include "../src/raytrace.h"
+#include "../src/replay.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void temp_path(char *out, size_t size, const char *tag){
+    snprintf(out, size, "/tmp/pk_rk4_replay_%s_%d.bin", tag, (int)getpid());
+}
+
+static long file_size(const char *path){
+    FILE *f = fopen(path, "rb");
+    if(!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static SDL_Event key_event(SDL_Keycode sym){
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = SDL_KEYDOWN;
+    e.key.keysym.sym = sym;
+    return e;
+}
+
+static SDL_Event motion_event(int x, int y){
+    SDL_Event e;
+    memset(&e, 0, sizeof(e));
+    e.type = SDL_MOUSEMOTION;
+    e.motion.x = x;
+    e.motion.y = y;
+    e.motion.state = 1;
+    return e;
+}
+
+static void test_round_trip(void){
+    char path[128];
+    temp_path(path, sizeof(path), "trip");
+
+    InputRecorder *rec = recorder_open(path, 1600, 900);
+    assert_true(rec != NULL, "recorder opens");
+
+    SDL_Event button;
+    memset(&button, 0, sizeof(button));
+    button.type = SDL_MOUSEBUTTONDOWN;
+    button.button.button = SDL_BUTTON_LEFT;
+    button.button.x = 400;
+    button.button.y = 300;
+
+    SDL_Event wheel;
+    memset(&wheel, 0, sizeof(wheel));
+    wheel.type = SDL_MOUSEWHEEL;
+    wheel.wheel.y = -2;
+
+    SDL_Event window;
+    memset(&window, 0, sizeof(window));
+    window.type = SDL_WINDOWEVENT;
+    window.window.event = SDL_WINDOWEVENT_RESIZED;
+    window.window.data1 = 1280;
+    window.window.data2 = 720;
+
+    recorder_frame(rec, 0);
+    recorder_frame(rec, 16);
+    recorder_event(rec, &button);
+    SDL_Event m1 = motion_event(395, 310);
+    SDL_Event m2 = motion_event(390, 322);
+    recorder_event(rec, &m1);
+    recorder_event(rec, &m2);
+    recorder_frame(rec, 33);
+    SDL_Event k = key_event(SDLK_LEFT);
+    recorder_event(rec, &k);
+    recorder_event(rec, &wheel);
+    recorder_event(rec, &window);
+    recorder_marker(rec, REPLAY_MARKER_LIBRARY_READY);
+    assert_true(recorder_close(rec), "recorder closes cleanly");
+
+    InputReplay *rp = replay_open(path);
+    assert_true(rp != NULL, "replay opens");
+    if(!rp) return;
+
+    int w = 0, h = 0;
+    replay_window_size(rp, &w, &h);
+    assert_true(w == 1600 && h == 900, "window size restored");
+
+    uint32_t t = 99;
+    SDL_Event e;
+    assert_true(replay_next_frame(rp, &t) && t == 0, "frame 0 at t=0");
+    assert_true(!replay_poll_event(rp, &e), "frame 0 has no events");
+
+    assert_true(replay_next_frame(rp, &t) && t == 16, "frame 1 at t=16");
+    assert_true(replay_poll_event(rp, &e) && e.type == SDL_MOUSEBUTTONDOWN &&
+                e.button.button == SDL_BUTTON_LEFT && e.button.x == 400 && e.button.y == 300,
+                "button press restored");
+    assert_true(replay_poll_event(rp, &e) && e.type == SDL_MOUSEMOTION && e.motion.x == 395 && e.motion.y == 310,
+                "first motion restored from deltas");
+    assert_true(replay_poll_event(rp, &e) && e.motion.x == 390 && e.motion.y == 322 &&
+                e.motion.xrel == -5 && e.motion.yrel == 12,
+                "second motion and relative motion restored");
+    assert_true(!replay_poll_event(rp, &e), "frame 1 has three events");
+    assert_true(replay_frame_markers(rp) == 0, "no markers on frame 1");
+
+    assert_true(replay_next_frame(rp, &t) && t == 33, "frame 2 at t=33");
+    assert_true(replay_poll_event(rp, &e) && e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_LEFT,
+                "arrow key restored");
+    assert_true(replay_poll_event(rp, &e) && e.type == SDL_MOUSEWHEEL && e.wheel.y == -2, "wheel restored");
+    assert_true(replay_poll_event(rp, &e) && e.type == SDL_WINDOWEVENT &&
+                e.window.data1 == 1280 && e.window.data2 == 720, "resize restored");
+    assert_true(replay_frame_markers(rp) == REPLAY_MARKER_LIBRARY_READY, "marker lands on its frame");
+    assert_true(replay_frame_index(rp) == 2, "frame index counts from 0");
+
+    assert_true(!replay_next_frame(rp, &t), "session ends after the last frame");
+    replay_close(rp);
+    remove(path);
+}
+
+static void test_compact(void){
+    char path[128];
+    temp_path(path, sizeof(path), "size");
+
+    InputRecorder *rec = recorder_open(path, 1600, 900);
+    for(int f = 0; f < 1000; f++){
+        recorder_frame(rec, (uint32_t)(f * 16));
+        SDL_Event m = motion_event(800 + (f % 7), 450 - (f % 5));
+        recorder_event(rec, &m);
+    }
+    recorder_close(rec);
+
+    long size = file_size(path);
+    assert_true(size > 0 && size < 1000 * 7, "1000 frames with a mouse move each stay under 7 bytes per frame");
+    remove(path);
+}
+
+static void test_rejects_bad_files(void){
+    char path[128];
+    temp_path(path, sizeof(path), "bad");
+
+    FILE *f = fopen(path, "wb");
+    fputs("not a session", f);
+    fclose(f);
+    assert_true(replay_open(path) == NULL, "wrong magic rejected");
+    assert_true(replay_open("/nonexistent/pk_rk4.bin") == NULL, "missing file rejected");
+
+    // A file cut mid-record still replays its complete frames.
+    InputRecorder *rec = recorder_open(path, 640, 480);
+    recorder_frame(rec, 0);
+    recorder_frame(rec, 20);
+    SDL_Event k = key_event(SDLK_SPACE);
+    recorder_event(rec, &k);
+    recorder_close(rec);
+    long size = file_size(path);
+    if(truncate(path, size - 1) != 0) perror("truncate");
+
+    InputReplay *rp = replay_open(path);
+    assert_true(rp != NULL, "truncated file opens");
+    if(rp){
+        uint32_t t;
+        assert_true(replay_next_frame(rp, &t), "first frame intact");
+        assert_true(replay_next_frame(rp, &t) && t == 20, "second frame timestamp intact");
+        assert_true(!replay_next_frame(rp, &t), "nothing after the cut");
+        replay_close(rp);
+    }
+    remove(path);
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t size){
+    const unsigned char *p = data;
+    for(size_t i = 0; i < size; i++) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// Plays a session the way the viewer does while replaying: V toggles a
+// stepped vibration that advances once per frame and the traced view gets
+// a fixed number of samples. Returns a hash of the final frame.
+static uint64_t replay_frame_hash(const char *path){
+    InputReplay *rp = replay_open(path);
+    if(!rp) return 0;
+    MoleculeGeometry mol;
+    apply_preset(&mol, 0);
+    MdSimulation *sim = md_create(1);
+    md_set_stepped(sim, true);
+    md_set_active(sim, 0, true);
+    bool loaded = false;
+
+    Tracer *tracer = tracer_create();
+    uint32_t colors[MAX_ATOMS];
+    for(int i = 0; i < MAX_ATOMS; i++) colors[i] = 0xC0C0C0FF;
+    MoleculeGeometry shown = mol;
+
+    uint32_t ms;
+    while(replay_next_frame(rp, &ms)){
+        SDL_Event e;
+        while(replay_poll_event(rp, &e)){
+            if(e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_v){
+                if(!loaded) md_load(sim, 0, &mol);
+                loaded = true;
+                md_set_running(sim, !md_is_running(sim));
+            }
+        }
+        md_step_frame(sim);
+        if(md_is_running(sim)) md_read_positions(sim, 0, shown.atomPos, shown.atomCount);
+
+        TraceScene scene = { &shown, colors, 0x808080FF, 0x101014FF, (float)ms * 0.0007f, 0.3f, 6.0f, 32.0f, 32.0f, 64, 64 };
+        tracer_set_scene(tracer, &scene);
+        tracer_render_samples(tracer, 1);
+
+        // Give a wall-clock driven simulation time to run ahead.
+        struct timespec nap = { 0, 2 * 1000 * 1000 };
+        nanosleep(&nap, NULL);
+    }
+
+    uint64_t h = fnv1a(1469598103934665603ull, shown.atomPos, sizeof(Vec3) * (size_t)shown.atomCount);
+    h = fnv1a(h, tracer_pixels(tracer), sizeof(uint32_t) * 64 * 64);
+    tracer_destroy(tracer);
+    md_destroy(sim);
+    replay_close(rp);
+    return h;
+}
+
+static void test_vibration_replays_identically(void){
+    char path[128];
+    temp_path(path, sizeof(path), "vibrate");
+    InputRecorder *rec = recorder_open(path, 640, 480);
+    for(int f = 0; f < 40; f++){
+        recorder_frame(rec, (uint32_t)(f * 16));
+        if(f == 3){
+            SDL_Event v = key_event(SDLK_v);
+            recorder_event(rec, &v);
+        }
+    }
+    recorder_close(rec);
+
+    uint64_t first = replay_frame_hash(path);
+    uint64_t second = replay_frame_hash(path);
+    assert_true(first != 0 && first == second, "a session with vibration replays to the same final frame");
+    remove(path);
+}
+
+int main(void){
+    test_round_trip();
+    test_compact();
+    test_rejects_bad_files();
+    test_vibration_replays_identically();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
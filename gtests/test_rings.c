@@ -0,0 +1,286 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/rings.h"
+#include "../src/presets.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static int bond_between(const MoleculeGeometry *mol, int a, int b){
+    for(int i = 0; i < mol->bondCount; i++){
+        if((mol->bonds[i].from == a && mol->bonds[i].to == b) || (mol->bonds[i].from == b && mol->bonds[i].to == a)) return i;
+    }
+    return -1;
+}
+
+// Every ring must be a simple cycle whose bond mask matches its atoms, and
+// there must be as many rings as the cycle space has dimensions.
+static bool rings_consistent(const MoleculeGeometry *mol, const RingInfo *info, int components){
+    if(info->truncated || info->ringCount != mol->bondCount - mol->atomCount + components) return false;
+    for(int r = 0; r < info->ringCount; r++){
+        int size = ring_size(info, r);
+        uint64_t seen = 0;
+        int bonds = 0;
+        for(int k = 0; k < size; k++){
+            int a = info->atoms[info->ringStart[r] + k];
+            int b = info->atoms[info->ringStart[r] + (k + 1) % size];
+            int bond = bond_between(mol, a, b);
+            if(bond < 0 || !ring_bond_test(info->ringBonds[r], bond) || (seen >> a & 1)) return false;
+            seen |= 1ull << a;
+        }
+        for(int b = 0; b < mol->bondCount; b++) bonds += ring_bond_test(info->ringBonds[r], b);
+        if(bonds != size) return false;
+    }
+    return true;
+}
+
+static void make_cycle(MoleculeGeometry *mol, int n, const uint8_t *labels, const int *orders, float bondLength){
+    memset(mol, 0, sizeof(*mol));
+    float radius = bondLength / (2.0f * sinf(PI / (float)n));
+    for(int i = 0; i < n; i++){
+        float a = 2.0f * PI * (float)i / (float)n;
+        add_atom(mol, make_vec3(radius * cosf(a), radius * sinf(a), 0.0f), labels ? labels[i] : 0);
+    }
+    for(int i = 0; i < n; i++) add_bond(mol, i, (i + 1) % n, orders ? orders[i] : 1);
+}
+
+static void test_benzene_and_cyclohexane(void){
+    static const int kekule[6] = { 2, 1, 2, 1, 2, 1 };
+    MoleculeGeometry mol;
+    RingInfo info;
+
+    make_cycle(&mol, 6, NULL, kekule, 1.40f);
+    perceive_rings(&mol, &info);
+    assert_true(rings_consistent(&mol, &info, 1) && ring_size(&info, 0) == 6, "benzene has one six-ring");
+    assert_true(ring_is_aromatic(&info, 0) && info.aromaticAtoms == 0x3F, "Kekule benzene is aromatic");
+    assert_true(info.aromaticBondMask[0] == 0x3F && info.ringBondMask[0] == 0x3F, "all benzene bonds are aromatic ring bonds");
+
+    // a chair: alternate atoms 0.25 A above and below the mean plane
+    make_cycle(&mol, 6, NULL, NULL, 1.50f);
+    for(int i = 0; i < 6; i++) mol.atomPos[i].z = i % 2 ? 0.25f : -0.25f;
+    perceive_rings(&mol, &info);
+    assert_true(info.ringCount == 1 && info.aromaticRings == 0, "chair cyclohexane is not aromatic");
+
+    make_cycle(&mol, 6, NULL, NULL, 1.52f);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 0, "flat ring with single-bond lengths is not aromatic");
+
+    make_cycle(&mol, 6, NULL, NULL, 1.39f);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 1, "imported benzene without bond orders is aromatic by geometry");
+
+    static const int diene[6] = { 2, 1, 2, 1, 1, 1 };
+    make_cycle(&mol, 6, NULL, diene, 1.45f);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 0, "cyclohexadiene is not aromatic");
+}
+
+static void test_five_rings(void){
+    static const uint8_t pyrrole[5] = { 2, 0, 0, 0, 0 };
+    static const uint8_t furan[5] = { 1, 0, 0, 0, 0 };
+    static const int orders[5] = { 1, 2, 1, 2, 1 };
+    MoleculeGeometry mol;
+    RingInfo info;
+
+    make_cycle(&mol, 5, pyrrole, orders, 1.38f);
+    perceive_rings(&mol, &info);
+    assert_true(info.ringCount == 1 && info.aromaticRings == 1, "pyrrole nitrogen lone pair completes the sextet");
+
+    make_cycle(&mol, 5, furan, orders, 1.38f);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 1, "furan is aromatic");
+
+    make_cycle(&mol, 5, NULL, orders, 1.45f);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 0, "cyclopentadiene has an sp3 carbon");
+
+    static const uint8_t pyridone[6] = { 2, 0, 0, 0, 0, 0 };
+    static const int pyridoneOrders[6] = { 1, 1, 2, 1, 2, 1 };
+    make_cycle(&mol, 6, pyridone, pyridoneOrders, 1.40f);
+    add_atom(&mol, make_vec3(mol.atomPos[1].x * 1.9f, mol.atomPos[1].y * 1.9f, 0.0f), 1);
+    add_bond(&mol, 1, 6, 2);
+    perceive_rings(&mol, &info);
+    assert_true(info.aromaticRings == 1 && !ring_bond_test(info.ringBondMask, 6), "2-pyridone is aromatic, C=O is not a ring bond");
+}
+
+static void make_naphthalene(MoleculeGeometry *mol, bool sharedDouble){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < 10; i++) add_atom(mol, make_vec3((float)i, (float)(i % 3), 0.0f), 0);
+    // ring A is 0-1-2-3-4-5, ring B shares the 4-5 bond
+    static const int pairs[11][2] = { {0,1}, {1,2}, {2,3}, {3,4}, {4,5}, {5,0}, {4,6}, {6,7}, {7,8}, {8,9}, {9,5} };
+    static const int orderShared[11] = { 2, 1, 2, 1, 2, 1, 1, 2, 1, 2, 1 };
+    static const int orderOuter[11]  = { 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 };
+    for(int b = 0; b < 11; b++) add_bond(mol, pairs[b][0], pairs[b][1], sharedDouble ? orderShared[b] : orderOuter[b]);
+}
+
+static void test_fused_and_bridged(void){
+    MoleculeGeometry mol;
+    RingInfo info;
+
+    for(int variant = 0; variant < 2; variant++){
+        make_naphthalene(&mol, variant == 0);
+        perceive_rings(&mol, &info);
+        assert_true(rings_consistent(&mol, &info, 1) && ring_size(&info, 0) == 6 && ring_size(&info, 1) == 6,
+                    "naphthalene is two six-rings, not the ten-ring");
+        assert_true(info.aromaticRings == 3, "both naphthalene rings are aromatic in either Kekule form");
+    }
+
+    // norbornane: two five-rings share the bridgehead path; the six-ring is
+    // their sum and must not be chosen
+    memset(&mol, 0, sizeof(mol));
+    for(int i = 0; i < 7; i++) add_atom(&mol, make_vec3((float)i, 0, 0), 0);
+    static const int norbornane[8][2] = { {0,1}, {1,2}, {2,3}, {3,4}, {4,5}, {5,0}, {0,6}, {6,3} };
+    for(int b = 0; b < 8; b++) add_bond(&mol, norbornane[b][0], norbornane[b][1], 1);
+    perceive_rings(&mol, &info);
+    assert_true(rings_consistent(&mol, &info, 1) && ring_size(&info, 0) == 5 && ring_size(&info, 1) == 5, "norbornane is two five-rings");
+
+    // cubane: five independent four-rings out of six faces
+    memset(&mol, 0, sizeof(mol));
+    for(int i = 0; i < 8; i++) add_atom(&mol, make_vec3((float)(i & 1), (float)(i >> 1 & 1), (float)(i >> 2)), 0);
+    for(int a = 0; a < 8; a++){
+        for(int bit = 1; bit < 8; bit <<= 1) if(!(a & bit)) add_bond(&mol, a, a | bit, 1);
+    }
+    perceive_rings(&mol, &info);
+    bool allFour = true;
+    for(int r = 0; r < info.ringCount; r++) allFour &= ring_size(&info, r) == 4;
+    assert_true(rings_consistent(&mol, &info, 1) && info.ringCount == 5 && allFour, "cubane is five four-rings");
+
+    // K5: six independent triangles
+    memset(&mol, 0, sizeof(mol));
+    for(int i = 0; i < 5; i++) add_atom(&mol, make_vec3((float)i, 0, 0), 0);
+    for(int a = 0; a < 5; a++) for(int b = a + 1; b < 5; b++) add_bond(&mol, a, b, 1);
+    perceive_rings(&mol, &info);
+    allFour = true;
+    for(int r = 0; r < info.ringCount; r++) allFour &= ring_size(&info, r) == 3;
+    assert_true(rings_consistent(&mol, &info, 1) && allFour, "complete graph K5 is six triangles");
+}
+
+static void test_bridges_and_components(void){
+    static const int kekule[6] = { 2, 1, 2, 1, 2, 1 };
+    MoleculeGeometry mol, ring;
+    RingInfo info;
+
+    // biphenyl-like: two rings joined by a bridge, plus a methyl tail
+    make_cycle(&ring, 6, NULL, kekule, 1.40f);
+    mol = ring;
+    for(int i = 0; i < 6; i++) add_atom(&mol, make_vec3(ring.atomPos[i].x + 4.0f, ring.atomPos[i].y, 0.0f), 0);
+    for(int i = 0; i < 6; i++) add_bond(&mol, 6 + i, 6 + (i + 1) % 6, kekule[i]);
+    add_bond(&mol, 0, 9, 1);
+    add_atom(&mol, make_vec3(-2.9f, 0.0f, 0.0f), 0);
+    add_bond(&mol, 3, 12, 1);
+    perceive_rings(&mol, &info);
+    assert_true(rings_consistent(&mol, &info, 1) && info.aromaticRings == 3, "biphenyl has two aromatic rings");
+    assert_true(!ring_bond_test(info.ringBondMask, 12) && !ring_bond_test(info.ringBondMask, 13), "bridge and tail are not ring bonds");
+    assert_true(!(info.ringAtoms >> 12 & 1) && (info.ringAtoms & 0xFFF) == 0xFFF, "ring atoms exclude the tail");
+
+    // the same two rings as separate components
+    mol.bondCount = 12;
+    mol.atomCount = 12;
+    perceive_rings(&mol, &info);
+    assert_true(rings_consistent(&mol, &info, 2) && info.ringCount == 2, "disconnected rings are both found");
+
+    memset(&mol, 0, sizeof(mol));
+    for(int i = 0; i < 5; i++) add_atom(&mol, make_vec3((float)i, 0, 0), 0);
+    for(int i = 0; i < 4; i++) add_bond(&mol, i, i + 1, 1);
+    perceive_rings(&mol, &info);
+    assert_true(info.ringCount == 0 && info.ringBondMask[0] == 0 && !info.truncated, "a chain has no rings");
+}
+
+static void test_presets(void){
+    for(int c = 0; c < COMPOUND_COUNT; c++){
+        MoleculeGeometry mol;
+        apply_preset(&mol, compounds[c].presetType);
+        RingInfo info;
+        perceive_rings(&mol, &info);
+        char msg[96];
+        snprintf(msg, sizeof(msg), "%s rings span the cycle space", compounds[c].name);
+        assert_true(rings_consistent(&mol, &info, 1), msg);
+        snprintf(msg, sizeof(msg), "%s has no aromatic rings", compounds[c].name);
+        assert_true(info.aromaticRings == 0, msg);
+    }
+}
+
+// Random sparse graphs: the basis must always reach full rank, which
+// exercises the Horton fallback whenever the shortest-cycle pass falls short.
+static void test_random_graphs(void){
+    srand(42);
+    bool ok = true;
+    for(int trial = 0; trial < 400 && ok; trial++){
+        MoleculeGeometry mol;
+        memset(&mol, 0, sizeof(mol));
+        int n = 4 + rand() % 40;
+        for(int i = 0; i < n; i++) add_atom(&mol, make_vec3((float)i, 0, 0), 0);
+        for(int i = 1; i < n; i++) add_bond(&mol, rand() % i, i, 1);
+        int extra = rand() % 12;
+        for(int e = 0; e < extra; e++){
+            int a = rand() % n, b = rand() % n;
+            if(a != b && bond_between(&mol, a, b) < 0) add_bond(&mol, a, b, 1);
+        }
+        RingInfo info;
+        perceive_rings(&mol, &info);
+        ok = rings_consistent(&mol, &info, 1);
+    }
+    assert_true(ok, "random graphs get a full cycle basis");
+}
+
+static void test_cache(void){
+    static const int kekule[6] = { 2, 1, 2, 1, 2, 1 };
+    MoleculeGeometry mol;
+    make_cycle(&mol, 6, NULL, kekule, 1.40f);
+    const RingInfo *first = ring_info_cached(&mol);
+    mol.atomPos[0].x += 0.5f;
+    const RingInfo *second = ring_info_cached(&mol);
+    assert_true(first == second && first->aromaticRings == 1, "moving atoms keeps a cached topology");
+
+    mol.bonds[0].order = 1;
+    const RingInfo *third = ring_info_cached(&mol);
+    assert_true(third->ringCount == 1 && third->aromaticRings == 0, "changing a bond order is a different entry");
+
+    // Single bonds only: aromaticity is judged from the geometry the
+    // topology was first seen with, and vibration does not disturb it.
+    make_cycle(&mol, 6, NULL, NULL, 1.39f);
+    const RingInfo *flat = ring_info_cached(&mol);
+    assert_true(flat->aromaticRings == 1, "flat imported ring is aromatic");
+    srand(7);
+    bool hit = true, stable = true;
+    for(int frame = 0; frame < 50; frame++){
+        for(int i = 0; i < 6; i++){
+            mol.atomPos[i].x += 0.1f * ((float)rand() / (float)RAND_MAX - 0.5f);
+            mol.atomPos[i].z = 0.3f * ((float)rand() / (float)RAND_MAX - 0.5f);
+        }
+        const RingInfo *info = ring_info_cached(&mol);
+        hit = hit && info == flat;
+        stable = stable && info->aromaticRings == 1 && info->aromaticAtoms == 0x3F;
+    }
+    assert_true(hit, "perturbed positions hit the cached topology");
+    assert_true(stable, "aromatic flags stay put while atoms move");
+}
+
+int main(void){
+    test_benzene_and_cyclohexane();
+    test_five_rings();
+    test_fused_and_bridged();
+    test_bridges_and_components();
+    test_presets();
+    test_random_graphs();
+    test_cache();
+
+    if(tests_failed){
+        printf("[FAIL] %d of %d tests failed\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("[OK] %d tests passed\n", tests_run);
+    return 0;
+}
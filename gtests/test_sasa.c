@@ -0,0 +1,147 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/sasa.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void assert_near(float a, float b, float eps, const char *msg){
+    tests_run++;
+    if(fabsf(a - b) > eps){
+        tests_failed++;
+        printf("[FAIL] %s (got %.6f expected %.6f)\n", msg, a, b);
+    }
+}
+
+static void test_isolated_atom(void){
+    Vec3 pos[1] = { {0.0f, 0.0f, 0.0f} };
+    float radius[1] = { 1.7f };
+    float area[1];
+    sasa_compute(pos, radius, 1, NULL, 0, area, NULL);
+
+    float r = 1.7f + SASA_PROBE;
+    assert_near(area[0], 4.0f * PI * r * r, 1e-3f, "isolated atom fully exposed");
+}
+
+static void test_two_atom_cap(void){
+    float d = 3.0f;
+    Vec3 pos[2] = { {0.0f, 0.0f, 0.0f}, {d, 0.0f, 0.0f} };
+    float radius[2] = { 1.7f, 1.7f };
+    float area[2];
+    sasa_compute(pos, radius, 2, NULL, 0, area, NULL);
+
+    float r = 1.7f + SASA_PROBE;
+    float h = r - d * 0.5f;
+    float expected = 4.0f * PI * r * r - 2.0f * PI * r * h;
+    assert_near(area[0], expected, 0.02f * expected, "spherical cap removed from atom 0");
+    assert_near(area[1], area[0], 0.02f * expected, "symmetric pair");
+}
+
+static void test_incremental_matches_full(void){
+    MoleculeGeometry mol;
+    memset(&mol, 0, sizeof(mol));
+    for(int i = 0; i < 20; i++){
+        mol.atomPos[i] = make_vec3((float)(i % 5) * 1.5f, (float)(i / 5) * 1.5f, (i % 2) ? 0.4f : -0.4f);
+        mol.atomLabel[i] = (uint8_t)(i % 3);
+    }
+    mol.atomCount = 20;
+
+    SasaCache cache;
+    sasa_cache_init(&cache);
+    assert_true(sasa_update(&cache, &mol) == 20, "first update computes every atom");
+    assert_true(sasa_update(&cache, &mol) == 0, "unchanged geometry is free");
+
+    mol.atomPos[0].z += 0.7f;
+    int recomputed = sasa_update(&cache, &mol);
+    assert_true(recomputed > 0 && recomputed < 20, "moving a corner atom recomputes only its neighbourhood");
+
+    SasaCache fresh;
+    sasa_cache_init(&fresh);
+    sasa_update(&fresh, &mol);
+
+    bool same = true;
+    for(int i = 0; i < 20; i++){
+        if(fabsf(fresh.atomArea[i] - cache.atomArea[i]) > 1e-4f) same = false;
+        if(memcmp(fresh.exposed[i], cache.exposed[i], sizeof(fresh.exposed[i])) != 0) same = false;
+    }
+    assert_true(same, "incremental update matches a full recompute");
+    assert_near(cache.totalArea, fresh.totalArea, 1e-2f, "total area matches");
+}
+
+static void test_large_structure(void){
+    int side = 22;
+    int n = side * side * side;
+    Vec3 *pos = malloc(sizeof(Vec3) * n);
+    float *radius = malloc(sizeof(float) * n);
+    float *area = malloc(sizeof(float) * n);
+    for(int i = 0; i < n; i++){
+        pos[i] = make_vec3((float)(i % side) * 1.5f, (float)((i / side) % side) * 1.5f, (float)(i / (side*side)) * 1.5f);
+        radius[i] = 1.7f;
+    }
+    sasa_compute(pos, radius, n, NULL, 0, area, NULL);
+
+    int center = (side/2) + side * (side/2) + side * side * (side/2);
+    float r = 1.7f + SASA_PROBE;
+    assert_true(area[center] == 0.0f, "buried atom has no accessible area");
+    assert_true(area[0] > 0.0f && area[0] < 4.0f * PI * r * r, "corner atom partly exposed");
+
+    free(pos);
+    free(radius);
+    free(area);
+}
+
+// More neighbours than any packing of real atoms allows: 600 coincident
+// decoys on one side plus a shell that buries the centre on every side.
+// All of them must count.
+static void test_dense_neighbourhood(void){
+    int shell = 60, decoys = 600;
+    int n = 1 + shell + decoys;
+    Vec3 *pos = malloc(sizeof(Vec3) * n);
+    float *radius = malloc(sizeof(float) * n);
+    float *area = malloc(sizeof(float) * n);
+    pos[0] = make_vec3(0.0f, 0.0f, 0.0f);
+    const float golden = PI * (3.0f - sqrtf(5.0f));
+    for(int k = 0; k < shell; k++){
+        float z = 1.0f - 2.0f * ((float)k + 0.5f) / (float)shell;
+        float rxy = sqrtf(1.0f - z * z);
+        pos[1 + k] = make_vec3(2.0f * rxy * cosf(golden * (float)k), 2.0f * rxy * sinf(golden * (float)k), 2.0f * z);
+    }
+    // Last in, so the cell lists hand them out first.
+    for(int k = 0; k < decoys; k++) pos[1 + shell + k] = make_vec3(0.0f, 0.0f, -2.0f);
+    for(int i = 0; i < n; i++) radius[i] = 1.7f;
+
+    int which[1] = { 0 };
+    sasa_compute(pos, radius, n, which, 1, area, NULL);
+    assert_true(area[0] == 0.0f, "every neighbour counts, however many there are");
+
+    free(pos);
+    free(radius);
+    free(area);
+}
+
+int main(void){
+    test_isolated_atom();
+    test_dense_neighbourhood();
+    test_two_atom_cap();
+    test_incremental_matches_full();
+    test_large_structure();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/server.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static bool parses(const char *line, char *error, size_t errorSize){
+    RenderKey key;
+    return render_request_parse(line, 20, &key, error, errorSize);
+}
+
+static void test_valid_requests(void){
+    RenderKey key;
+    char error[96];
+    bool ok = render_request_parse("render 3 64x48 0.8 -0.35 1.2 surface", 20, &key, error, sizeof(error));
+    assert_true(ok, "a well-formed request parses");
+    assert_true(key.compound == 3 && key.width == 64 && key.height == 48, "compound and size are read");
+    assert_true(key.yaw == 0.8f && key.pitch == -0.35f && key.zoom == 1.2f, "view is read");
+    assert_true(parses("render 0 64 0 0 0.35 ball", error, sizeof(error)), "smallest zoom is accepted");
+    assert_true(parses("render 0 64 0 0 4 ball", error, sizeof(error)), "largest zoom is accepted");
+    assert_true(parses("render 0 64 -31.4 7 1 dots", error, sizeof(error)), "angles past a turn are accepted");
+}
+
+// Each of these once reached the renderer; a huge zoom stalled or killed
+// the server.
+static void test_rejected_requests(void){
+    const char *bad[] = {
+        "render 0 64 0 0 1e6 ball",
+        "render 0 64 0 0 1e9 ball",
+        "render 0 64 0 0 4.01 ball",
+        "render 0 64 0 0 0.3 ball",
+        "render 0 64 0 0 0 ball",
+        "render 0 64 0 0 -1 ball",
+        "render 0 64 0 0 nan ball",
+        "render 0 64 0 0 inf ball",
+        "render 0 64 nan 0 1 ball",
+        "render 0 64 0 nan 1 ball",
+        "render 0 64 inf 0 1 ball",
+        "render 0 64 0 -inf 1 ball",
+        "render 20 64 0 0 1 ball",
+        "render -1 64 0 0 1 ball",
+        "render 0 8 0 0 1 ball",
+        "render 0 64x4096 0 0 1 ball",
+        "render 0 64 0 0 1 sketch",
+        "render 0 64 0 0 1 ball extra",
+        "render 0 64 0 0",
+    };
+    for(size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++){
+        char error[96] = "";
+        bool ok = parses(bad[i], error, sizeof(error));
+        char msg[128];
+        snprintf(msg, sizeof(msg), "rejected with a reason: %s", bad[i]);
+        assert_true(!ok && error[0] != '\0', msg);
+    }
+    char error[96];
+    parses("render 0 64 0 0 1e6 ball", error, sizeof(error));
+    assert_true(strstr(error, "zoom") != NULL, "zoom error names the zoom");
+    parses("render 0 64 nan 0 1 ball", error, sizeof(error));
+    assert_true(strstr(error, "finite") != NULL, "angle error says finite");
+}
+
+int main(void){
+    test_valid_requests();
+    test_rejected_requests();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
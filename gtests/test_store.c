@@ -0,0 +1,219 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/library.h"
+#include "../src/store.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+// count records, the first one shifted along x by offset.
+static void write_library(const char *path, int count, float offset){
+    char tmp[96];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if(!f) return;
+    for(int i = 0; i < count; i++){
+        int atoms = 2 + i % 4;
+        fprintf(f, "%d\nmolecule %d\n", atoms, i);
+        for(int a = 0; a < atoms; a++){
+            fprintf(f, "%s %.3f %.3f 0.000\n", a % 2 ? "N" : "C", (i == 0 ? offset : 0.0f) + 1.3f * (float)a, 0.2f * (float)a);
+        }
+    }
+    fclose(f);
+    rename(tmp, path);
+}
+
+static bool same_entries(const Library *a, const Library *b){
+    return a->count == b->count && memcmp(a->entries, b->entries, sizeof(LibraryEntry) * (size_t)a->count) == 0;
+}
+
+static bool matches_file(const LibrarySnapshot *snap, const char *path){
+    Library lib;
+    library_init(&lib);
+    char error[256];
+    bool ok = library_load_xyz(&lib, path, error, sizeof(error)) && same_entries(&snap->lib, &lib);
+    library_free(&lib);
+    return ok;
+}
+
+static void test_publish_and_attach(void){
+    char path[64], error[256];
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_store_%d.xyz", (int)getpid());
+    write_library(path, 300, 0.0f);
+
+    LibraryStore first, second;
+    bool ok = library_store_open(&first, path, NULL, 0, error, sizeof(error));
+    assert_true(ok, "first open publishes");
+    if(!ok) return;
+    assert_true(first.built && library_store_generation(&first) == 1, "first open builds generation 1");
+    LibrarySnapshot a;
+    assert_true(library_store_map(&first, &a, error, sizeof(error)), "snapshot maps");
+    assert_true(a.lib.count == 300 && matches_file(&a, path), "snapshot holds the file's entries");
+
+    assert_true(library_store_open(&second, path, NULL, 0, error, sizeof(error)), "second open attaches");
+    assert_true(!second.built && library_store_generation(&second) == 1, "second open does not rebuild");
+    LibrarySnapshot b;
+    assert_true(library_store_map(&second, &b, error, sizeof(error)) && same_entries(&a.lib, &b.lib), "both see the same snapshot");
+    library_snapshot_unmap(&b);
+    assert_true(b.generation == 0 && b.lib.count == 0, "unmap detaches");
+
+    // A new generation replaces the old one; a mapping of the old one
+    // stays readable until it is dropped.
+    uint64_t stamp;
+    assert_true(library_store_stamp(path, &stamp), "file stamps");
+    Library edited;
+    library_init(&edited);
+    library_load_xyz(&edited, path, error, sizeof(error));
+    edited.entries[0].mol.atomPos[0].x = 42.0f;
+    edited.count = 200;
+    assert_true(library_store_publish(&second, &edited, stamp, error, sizeof(error)), "publish succeeds");
+    assert_true(library_store_generation(&first) == 2, "the other process sees the new generation");
+    char old[96];
+    snprintf(old, sizeof(old), "%s-1", first.name);
+    int fd = shm_open(old, O_RDONLY, 0);
+    assert_true(fd < 0, "old snapshot is unlinked");
+    if(fd >= 0) close(fd);
+    assert_true(a.generation == 1 && matches_file(&a, path), "old mapping still reads the old entries");
+    LibrarySnapshot c;
+    assert_true(library_store_map(&first, &c, error, sizeof(error)), "new snapshot maps");
+    assert_true(c.generation == 2 && same_entries(&c.lib, &edited), "new snapshot holds the published entries");
+    library_snapshot_unmap(&a);
+    library_snapshot_unmap(&c);
+    library_free(&edited);
+    library_store_close(&second);
+
+    // A file changed while nothing watched it is republished on open.
+    write_library(path, 150, 1.5f);
+    LibraryStore third;
+    assert_true(library_store_open(&third, path, NULL, 0, error, sizeof(error)), "open after an edit");
+    assert_true(third.built && library_store_generation(&third) == 3, "edited file is republished");
+    assert_true(library_store_map(&third, &c, error, sizeof(error)) && matches_file(&c, path), "republished snapshot matches the file");
+    library_snapshot_unmap(&c);
+    library_store_close(&third);
+
+    // A caller that already parsed the file hands its copy over.
+    library_store_remove(&first);
+    library_store_close(&first);
+    Library loaded;
+    library_init(&loaded);
+    library_store_stamp(path, &stamp);
+    library_load_xyz(&loaded, path, error, sizeof(error));
+    assert_true(library_store_open(&first, path, &loaded, stamp, error, sizeof(error)), "open with a loaded library");
+    assert_true(first.built && library_store_generation(&first) == 1, "removed store starts over");
+    assert_true(library_store_map(&first, &c, error, sizeof(error)) && same_entries(&c.lib, &loaded), "loaded entries are published");
+    library_snapshot_unmap(&c);
+    library_free(&loaded);
+
+    // A file edited while it was being parsed is published under the stamp
+    // from before the parse, so the next open parses it again.
+    library_store_stamp(path, &stamp);
+    library_init(&loaded);
+    library_load_xyz(&loaded, path, error, sizeof(error));
+    write_library(path, 120, 2.5f);
+    assert_true(library_store_publish(&first, &loaded, stamp, error, sizeof(error)), "publish the copy parsed before the edit");
+    library_free(&loaded);
+    assert_true(library_store_open(&third, path, NULL, 0, error, sizeof(error)), "open after an edit during the parse");
+    assert_true(third.built && library_store_generation(&third) == 3, "edit during the parse is republished");
+    assert_true(library_store_map(&third, &c, error, sizeof(error)) && matches_file(&c, path), "republished snapshot matches the edited file");
+    library_snapshot_unmap(&c);
+    library_store_close(&third);
+
+    // Another layout under the same name is refused, not misread.
+    StoreControl *control = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, first.fd, 0);
+    if(control != MAP_FAILED){
+        ((char *)control)[0] = 'X';
+        munmap(control, 4096);
+    }
+    LibraryStore other;
+    assert_true(!library_store_open(&other, path, NULL, 0, error, sizeof(error)) && strstr(error, "incompatible"), "foreign layout is refused");
+    library_store_remove(&first);
+    library_store_close(&first);
+
+    // Segments others may write are not trusted: their entries would be
+    // read without bounds checks.
+    assert_true(library_store_open(&first, path, NULL, 0, error, sizeof(error)), "store opens again");
+    char uid[32];
+    snprintf(uid, sizeof(uid), "-%u-", (unsigned)geteuid());
+    assert_true(strstr(first.name, uid) != NULL, "segment name carries the user");
+    snprintf(old, sizeof(old), "%s-1", first.name);
+    fd = shm_open(old, O_RDONLY, 0);
+    if(fd >= 0){
+        fchmod(fd, 0666);
+        close(fd);
+    }
+    assert_true(!library_store_map(&first, &c, error, sizeof(error)) && strstr(error, "not trusting"), "writable snapshot is refused");
+    fchmod(first.fd, 0666);
+    assert_true(!library_store_open(&other, path, NULL, 0, error, sizeof(error)) && strstr(error, "not trusting"), "writable control segment is refused");
+    library_store_remove(&first);
+    library_store_close(&first);
+
+    assert_true(!library_store_open(&other, "/nonexistent/lib.xyz", NULL, 0, error, sizeof(error)), "missing file fails");
+    remove(path);
+}
+
+static void test_concurrent_open(void){
+    char path[64], error[256];
+    snprintf(path, sizeof(path), "/tmp/pk_rk4_store_race_%d.xyz", (int)getpid());
+    write_library(path, 2000, 0.0f);
+
+    // Processes opening a library at once publish it once; the others
+    // wait and attach.
+    enum { CHILDREN = 4 };
+    pid_t pids[CHILDREN];
+    for(int i = 0; i < CHILDREN; i++){
+        pids[i] = fork();
+        if(pids[i] == 0){
+            LibraryStore store;
+            LibrarySnapshot snap;
+            if(!library_store_open(&store, path, NULL, 0, error, sizeof(error))) _exit(1);
+            if(!library_store_map(&store, &snap, error, sizeof(error)) || snap.lib.count != 2000) _exit(1);
+            _exit(store.built ? 10 : 0);
+        }
+    }
+    int builders = 0, failures = 0;
+    for(int i = 0; i < CHILDREN; i++){
+        int status = 0;
+        waitpid(pids[i], &status, 0);
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        if(code == 10) builders++;
+        else if(code != 0) failures++;
+    }
+    assert_true(failures == 0, "every process attaches");
+    assert_true(builders == 1, "exactly one process publishes");
+
+    LibraryStore store;
+    if(library_store_open(&store, path, NULL, 0, error, sizeof(error))){
+        assert_true(library_store_generation(&store) == 1, "one generation was published");
+        library_store_remove(&store);
+        library_store_close(&store);
+    }
+    remove(path);
+}
+
+int main(void){
+    test_publish_and_attach();
+    test_concurrent_open();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "../src/render.h"
+#include "../src/text.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void test_layout(void){
+    assert_true(text_width("", 2) == 0, "empty string has no width");
+    assert_true(text_width("C", 1) == GLYPH_WIDTH, "one glyph is its own width");
+    assert_true(text_width("Cl", 3) == (2 * GLYPH_ADVANCE - 1) * 3, "width scales and skips trailing spacing");
+
+    assert_true(strcmp(element_symbol(0), "C") == 0 && strcmp(element_symbol(3), "Cl") == 0,
+                "element symbols follow the label codes");
+    assert_true(strcmp(element_symbol(200), "?") == 0, "unknown label is marked");
+    assert_true(text_scale(0.35f) == 1 && text_scale(2.0f) == 2, "text scale is an integer of at least 1");
+}
+
+static void test_quads(void){
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+
+    draw_text(&cb, 10, 20, 2, 0xFF0000FF, "N O");
+    assert_true(cb.cmdCount == 1 && cb.cmds[0].type == CMD_GLYPHS, "text is one glyph command");
+    assert_true(cb.vertexCount == 12, "spaces emit no quads");
+
+    const SDL_Vertex *v = cb.vertices;
+    assert_true(v[0].position.x == 10.0f && v[0].position.y == 20.0f, "first quad starts at the origin");
+    assert_true(v[4].position.x == 10.0f + GLYPH_WIDTH * 2 && v[4].position.y == 20.0f + GLYPH_HEIGHT * 2,
+                "quad covers the scaled glyph");
+    assert_true(v[6].position.x == 10.0f + 2 * GLYPH_ADVANCE * 2, "space still advances the pen");
+    assert_true(v[0].color.r == 255 && v[0].color.g == 0 && v[0].color.a == 255, "colour goes on the vertices");
+
+    bool uvInside = true;
+    for(int i = 0; i < cb.vertexCount; i++){
+        if(v[i].tex_coord.x < 0.0f || v[i].tex_coord.x > 1.0f || v[i].tex_coord.y < 0.0f || v[i].tex_coord.y > 1.0f) uvInside = false;
+    }
+    assert_true(uvInside, "texture coordinates stay inside the atlas");
+
+    draw_text(&cb, 0, 0, 1, 0x00FF00FF, "\x80");
+    draw_text(&cb, 0, 40, 1, 0x00FF00FF, "?");
+    const SDL_Vertex *q = &cb.vertices[12];
+    const SDL_Vertex *r = &cb.vertices[18];
+    assert_true(q[0].tex_coord.x == r[0].tex_coord.x && q[0].tex_coord.y == r[0].tex_coord.y,
+                "non-ASCII draws as '?'");
+    assert_true(cb.cmdCount == 1 && cb.cmds[0].count == 24, "strings in different colours share one call");
+
+    command_buffer_reset(&cb);
+    for(int i = 0; i < 1000; i++) draw_text(&cb, i, i, 1, 0xFFFFFFFF, element_symbol((uint8_t)(i % 5)));
+    assert_true(cb.cmdCount == 1 && !cb.failed, "a thousand labels batch into one call");
+    command_buffer_free(&cb);
+}
+
+int main(void){
+    test_layout();
+    test_quads();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,108 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../src/thread_pool.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+static void assert_true(bool cond, const char *msg){
+    tests_run++;
+    if(!cond){
+        tests_failed++;
+        printf("[FAIL] %s\n", msg);
+    }
+}
+
+static void sleep_ms(int ms){
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+enum { ITEMS = 1000 };
+
+static void mark(void *ctx, int begin, int end){
+    atomic_int *seen = ctx;
+    for(int i = begin; i < end; i++) atomic_fetch_add(&seen[i], 1);
+}
+
+static void test_covers_range(void){
+    static atomic_int seen[ITEMS];
+    for(int i = 0; i < ITEMS; i++) atomic_init(&seen[i], 0);
+    parallel_for(ITEMS, 7, mark, seen);
+    bool once = true;
+    for(int i = 0; i < ITEMS; i++) once = once && atomic_load(&seen[i]) == 1;
+    assert_true(once, "every item runs exactly once");
+}
+
+// A job that holds the pool until released.
+static atomic_int started;
+static atomic_bool released;
+
+static void hold(void *ctx, int begin, int end){
+    (void)ctx;
+    atomic_fetch_add(&started, end - begin);
+    while(!atomic_load(&released)) sleep_ms(1);
+}
+
+static void *hold_pool(void *arg){
+    (void)arg;
+    parallel_for(2, 1, hold, NULL);
+    return NULL;
+}
+
+static atomic_bool secondDone;
+static atomic_int secondSeen[ITEMS];
+
+static void *second_caller(void *arg){
+    (void)arg;
+    parallel_for(ITEMS, 7, mark, secondSeen);
+    atomic_store(&secondDone, true);
+    return NULL;
+}
+
+// A caller arriving while another thread's job runs is not held up by it.
+static void test_second_caller_runs_inline(void){
+    atomic_init(&started, 0);
+    atomic_init(&released, false);
+    atomic_init(&secondDone, false);
+    for(int i = 0; i < ITEMS; i++) atomic_init(&secondSeen[i], 0);
+
+    pthread_t holder, second;
+    pthread_create(&holder, NULL, hold_pool, NULL);
+    for(int i = 0; i < 2000 && atomic_load(&started) < 2; i++) sleep_ms(1);
+    assert_true(atomic_load(&started) == 2, "the first job occupies the pool");
+
+    pthread_create(&second, NULL, second_caller, NULL);
+    for(int i = 0; i < 2000 && !atomic_load(&secondDone); i++) sleep_ms(1);
+    assert_true(atomic_load(&secondDone), "second caller finishes while the first job runs");
+
+    atomic_store(&released, true);
+    pthread_join(holder, NULL);
+    pthread_join(second, NULL);
+    bool once = true;
+    for(int i = 0; i < ITEMS; i++) once = once && atomic_load(&secondSeen[i]) == 1;
+    assert_true(once, "second caller covers its whole range");
+}
+
+int main(void){
+    // A worker besides the caller, even on a single-CPU machine.
+    setenv("ATLAS_THREADS", "2", 1);
+    assert_true(thread_pool_size() == 2, "pool has one worker");
+
+    test_covers_range();
+    test_second_caller_runs_inline();
+    test_covers_range(); // the pool takes jobs again afterwards
+    thread_pool_shutdown();
+
+    if(tests_failed == 0){
+        printf("[OK] %d tests passed\n", tests_run);
+        return 0;
+    }
+    printf("[FAIL] %d/%d tests failed\n", tests_failed, tests_run);
+    return 1;
+}
@@ -0,0 +1,233 @@
+#include "cmdbuf.h"
+#include "profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Grows *array to hold at least `needed` items of `size` bytes.
+static bool reserve(void **array, int *capacity, int needed, size_t size){
+    if(needed <= *capacity) return true;
+    int grown = *capacity ? *capacity : 256;
+    while(grown < needed) grown *= 2;
+    void *p = realloc(*array, size * (size_t)grown);
+    if(!p) return false;
+    *array = p;
+    *capacity = grown;
+    return true;
+}
+
+static DrawCommand *push_command(CommandBuffer *cb, DrawCommandType type){
+    if(cb->failed) return NULL;
+    if(!reserve((void**)&cb->cmds, &cb->cmdCapacity, cb->cmdCount + 1, sizeof(DrawCommand))){
+        cb->failed = true;
+        return NULL;
+    }
+    DrawCommand *c = &cb->cmds[cb->cmdCount++];
+    memset(c, 0, sizeof(*c));
+    c->type = (uint8_t)type;
+    return c;
+}
+
+static DrawCommand *last_command(CommandBuffer *cb, DrawCommandType type){
+    if(cb->cmdCount == 0) return NULL;
+    DrawCommand *c = &cb->cmds[cb->cmdCount - 1];
+    return c->type == type ? c : NULL;
+}
+
+void command_buffer_init(CommandBuffer *cb){
+    memset(cb, 0, sizeof(*cb));
+}
+
+void command_buffer_reset(CommandBuffer *cb){
+    cb->cmdCount = 0;
+    cb->pointCount = 0;
+    cb->rectCount = 0;
+    cb->vertexCount = 0;
+    cb->failed = false;
+}
+
+void command_buffer_free(CommandBuffer *cb){
+    free(cb->cmds);
+    free(cb->points);
+    free(cb->rects);
+    free(cb->vertices);
+    command_buffer_init(cb);
+}
+
+void cmd_color(CommandBuffer *cb, uint8_t r, uint8_t g, uint8_t b, uint8_t a){
+    // A colour nothing was drawn with is simply replaced.
+    DrawCommand *c = last_command(cb, CMD_COLOR);
+    if(!c) c = push_command(cb, CMD_COLOR);
+    if(!c) return;
+    c->r = r;
+    c->g = g;
+    c->b = b;
+    c->a = a;
+}
+
+void cmd_blend(CommandBuffer *cb, SDL_BlendMode mode){
+    DrawCommand *c = push_command(cb, CMD_BLEND);
+    if(c) c->slot = (int)mode;
+}
+
+void cmd_clip(CommandBuffer *cb, const SDL_Rect *rect){
+    DrawCommand *c = push_command(cb, CMD_CLIP);
+    if(c && rect) c->rect = *rect;
+}
+
+void cmd_point(CommandBuffer *cb, int x, int y){
+    if(cb->failed) return;
+    if(!reserve((void**)&cb->points, &cb->pointCapacity, cb->pointCount + 1, sizeof(SDL_Point))){
+        cb->failed = true;
+        return;
+    }
+    DrawCommand *c = last_command(cb, CMD_POINTS);
+    if(!c){
+        c = push_command(cb, CMD_POINTS);
+        if(!c) return;
+        c->first = cb->pointCount;
+    }
+    cb->points[cb->pointCount++] = (SDL_Point){ x, y };
+    c->count++;
+}
+
+void cmd_fill_rect(CommandBuffer *cb, int x, int y, int w, int h){
+    if(cb->failed) return;
+    if(!reserve((void**)&cb->rects, &cb->rectCapacity, cb->rectCount + 1, sizeof(SDL_Rect))){
+        cb->failed = true;
+        return;
+    }
+    DrawCommand *c = last_command(cb, CMD_FILL_RECTS);
+    if(!c){
+        c = push_command(cb, CMD_FILL_RECTS);
+        if(!c) return;
+        c->first = cb->rectCount;
+    }
+    cb->rects[cb->rectCount++] = (SDL_Rect){ x, y, w, h };
+    c->count++;
+}
+
+void cmd_draw_rect(CommandBuffer *cb, const SDL_Rect *rect){
+    DrawCommand *c = push_command(cb, CMD_DRAW_RECT);
+    if(c) c->rect = *rect;
+}
+
+SDL_Vertex *cmd_geometry(CommandBuffer *cb, int count){
+    if(cb->failed || count <= 0) return NULL;
+    if(!reserve((void**)&cb->vertices, &cb->vertexCapacity, cb->vertexCount + count, sizeof(SDL_Vertex))){
+        cb->failed = true;
+        return NULL;
+    }
+    DrawCommand *c = push_command(cb, CMD_GEOMETRY);
+    if(!c) return NULL;
+    c->first = cb->vertexCount;
+    c->count = count;
+    cb->vertexCount += count;
+    return &cb->vertices[c->first];
+}
+
+SDL_Vertex *cmd_glyph_quads(CommandBuffer *cb, int quadCount){
+    int count = quadCount * 6;
+    if(cb->failed || count <= 0) return NULL;
+    if(!reserve((void**)&cb->vertices, &cb->vertexCapacity, cb->vertexCount + count, sizeof(SDL_Vertex))){
+        cb->failed = true;
+        return NULL;
+    }
+    DrawCommand *c = last_command(cb, CMD_GLYPHS);
+    if(!c){
+        c = push_command(cb, CMD_GLYPHS);
+        if(!c) return NULL;
+        c->first = cb->vertexCount;
+    }
+    SDL_Vertex *v = &cb->vertices[cb->vertexCount];
+    c->count += count;
+    cb->vertexCount += count;
+    return v;
+}
+
+void cmd_tile_begin(CommandBuffer *cb, int slot, int width, int height){
+    DrawCommand *c = push_command(cb, CMD_TILE_BEGIN);
+    if(!c) return;
+    c->slot = slot;
+    c->rect = (SDL_Rect){ 0, 0, width, height };
+}
+
+void cmd_tile_end(CommandBuffer *cb, int slot, const SDL_Rect *dst){
+    DrawCommand *c = push_command(cb, CMD_TILE_END);
+    if(!c) return;
+    c->slot = slot;
+    c->rect = *dst;
+}
+
+static SDL_Texture *tile_texture(SDL_Renderer *renderer, TileTexture *target, int w, int h){
+    if(target->texture && target->width == w && target->height == h) return target->texture;
+    tile_texture_free(target);
+    target->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    target->width = w;
+    target->height = h;
+    return target->texture;
+}
+
+void command_buffer_submit(const CommandBuffer *cb, SDL_Renderer *renderer, const SubmitResources *res){
+    PROF_SCOPE("submit");
+    if(cb->failed) return;
+    TileTexture *tiles = res ? res->tiles : NULL;
+    int tileCount = res ? res->tileCount : 0;
+    for(int i = 0; i < cb->cmdCount; i++){
+        const DrawCommand *c = &cb->cmds[i];
+        switch(c->type){
+            case CMD_COLOR:
+                SDL_SetRenderDrawColor(renderer, c->r, c->g, c->b, c->a);
+                break;
+            case CMD_BLEND:
+                SDL_SetRenderDrawBlendMode(renderer, (SDL_BlendMode)c->slot);
+                break;
+            case CMD_CLIP:
+                SDL_RenderSetClipRect(renderer, c->rect.w > 0 ? &c->rect : NULL);
+                break;
+            case CMD_POINTS:
+                SDL_RenderDrawPoints(renderer, cb->points + c->first, c->count);
+                PROF_COUNT(PROF_DRAW_CALLS, 1);
+                break;
+            case CMD_FILL_RECTS:
+                SDL_RenderFillRects(renderer, cb->rects + c->first, c->count);
+                PROF_COUNT(PROF_DRAW_CALLS, 1);
+                break;
+            case CMD_DRAW_RECT:
+                SDL_RenderDrawRect(renderer, &c->rect);
+                PROF_COUNT(PROF_DRAW_CALLS, 1);
+                break;
+            case CMD_GEOMETRY:
+                SDL_RenderGeometry(renderer, NULL, cb->vertices + c->first, c->count, NULL, 0);
+                PROF_COUNT(PROF_DRAW_CALLS, 1);
+                break;
+            case CMD_GLYPHS:
+                if(res && res->glyphs){
+                    SDL_RenderGeometry(renderer, res->glyphs, cb->vertices + c->first, c->count, NULL, 0);
+                    PROF_COUNT(PROF_DRAW_CALLS, 1);
+                }
+                break;
+            case CMD_TILE_BEGIN: {
+                SDL_Texture *t = c->slot < tileCount ? tile_texture(renderer, &tiles[c->slot], c->rect.w, c->rect.h) : NULL;
+                if(t && SDL_SetRenderTarget(renderer, t) == 0) break;
+                // No target: skip the tile rather than draw it unscaled.
+                while(i + 1 < cb->cmdCount && cb->cmds[i + 1].type != CMD_TILE_END) i++;
+                i++;
+                break;
+            }
+            case CMD_TILE_END:
+                SDL_SetRenderTarget(renderer, NULL);
+                if(c->slot < tileCount && tiles[c->slot].texture){
+                    SDL_RenderCopy(renderer, tiles[c->slot].texture, NULL, &c->rect);
+                    PROF_COUNT(PROF_DRAW_CALLS, 1);
+                }
+                break;
+        }
+    }
+}
+
+void tile_texture_free(TileTexture *target){
+    if(target->texture) SDL_DestroyTexture(target->texture);
+    target->texture = NULL;
+    target->width = target->height = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef ATLAS_CMDBUF_H
+#define ATLAS_CMDBUF_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Recorded SDL draw calls. Building a buffer touches no renderer state, so
+// it can happen on any thread; submitting replays it on the render thread.
+// Consecutive points or rects in one colour merge into a single batched
+// call.
+
+typedef enum {
+    CMD_COLOR,
+    CMD_BLEND,
+    CMD_CLIP,       // rect, or none when rect.w == 0
+    CMD_POINTS,     // points[first, first + count)
+    CMD_FILL_RECTS, // rects[first, first + count)
+    CMD_DRAW_RECT,
+    CMD_GEOMETRY,   // vertices[first, first + count), untextured
+    CMD_GLYPHS,     // vertices[first, first + count) textured by the glyph atlas
+    CMD_TILE_BEGIN, // redirect into tile texture `slot`, rect.w x rect.h
+    CMD_TILE_END,   // stretch tile texture `slot` over rect
+} DrawCommandType;
+
+typedef struct {
+    uint8_t type;
+    uint8_t r, g, b, a;
+    int slot;
+    int first, count;
+    SDL_Rect rect;
+} DrawCommand;
+
+typedef struct {
+    DrawCommand *cmds;
+    int cmdCount, cmdCapacity;
+    SDL_Point *points;
+    int pointCount, pointCapacity;
+    SDL_Rect *rects;
+    int rectCount, rectCapacity;
+    SDL_Vertex *vertices;
+    int vertexCount, vertexCapacity;
+    bool failed; // an allocation failed; later commands were dropped
+} CommandBuffer;
+
+// Textures the tile commands draw through, owned by the render thread.
+typedef struct {
+    SDL_Texture *texture;
+    int width, height;
+} TileTexture;
+
+// Render-thread textures that commands refer to.
+typedef struct {
+    TileTexture *tiles; // indexed by tile slot
+    int tileCount;
+    SDL_Texture *glyphs; // from glyph_atlas_create(); text is skipped without it
+} SubmitResources;
+
+void command_buffer_init(CommandBuffer *cb);
+void command_buffer_reset(CommandBuffer *cb); // keeps the allocations
+void command_buffer_free(CommandBuffer *cb);
+
+void cmd_color(CommandBuffer *cb, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+void cmd_blend(CommandBuffer *cb, SDL_BlendMode mode);
+void cmd_clip(CommandBuffer *cb, const SDL_Rect *rect);
+void cmd_point(CommandBuffer *cb, int x, int y);
+void cmd_fill_rect(CommandBuffer *cb, int x, int y, int w, int h);
+void cmd_draw_rect(CommandBuffer *cb, const SDL_Rect *rect);
+// Reserves count vertices for one geometry call; NULL if out of memory.
+SDL_Vertex *cmd_geometry(CommandBuffer *cb, int count);
+// Reserves six vertices per glyph quad, appended to the previous glyph
+// command when it is the last one.
+SDL_Vertex *cmd_glyph_quads(CommandBuffer *cb, int quadCount);
+void cmd_tile_begin(CommandBuffer *cb, int slot, int width, int height);
+void cmd_tile_end(CommandBuffer *cb, int slot, const SDL_Rect *dst);
+
+// Replays the buffer. Tile textures are (re)created at the recorded size;
+// a NULL res skips tiles and text.
+void command_buffer_submit(const CommandBuffer *cb, SDL_Renderer *renderer, const SubmitResources *res);
+void tile_texture_free(TileTexture *target);
+
+#endif
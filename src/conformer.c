@@ -0,0 +1,368 @@
+#include "conformer.h"
+#include "forcefield.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TORSION_STATES 3
+#define CANDIDATE_POOL 128
+#define CHUNK_KEEP 32
+#define CLASH_SCALE 0.65f
+#define GRID_BUCKETS 1024
+
+static const float torsionStates[TORSION_STATES] = { PI / 3.0f, PI, 5.0f * PI / 3.0f };
+static const float clashRadius[5] = { 1.70f, 1.52f, 1.55f, 1.75f, 1.47f };
+
+typedef struct {
+    float energy;
+    long long combo;
+    Vec3 pos[MAX_ATOMS];
+} Candidate;
+
+typedef struct {
+    const MoleculeGeometry *mol;
+    const ForceField *prototype;
+
+    int rotatableCount;
+    int refA[MAX_ROTATABLE], refB[MAX_ROTATABLE], refC[MAX_ROTATABLE], refD[MAX_ROTATABLE];
+    uint64_t moving[MAX_ROTATABLE];
+
+    uint64_t excluded[MAX_ATOMS];
+    float radius[MAX_ATOMS];
+    float cellSize;
+
+    TorsionSampling sampling;
+
+    pthread_mutex_t lock;
+    Candidate *pool;
+    int poolCount;
+    long long enumerated;
+    long long clashed;
+} EnumerationContext;
+
+ConformerOptions conformer_default_options(void){
+    ConformerOptions o = { MAX_CONFORMERS - 1, 0.3f, 200000 };
+    return o;
+}
+
+static uint64_t side_of(const MoleculeGeometry *mol, int start, int blockedFrom, int blockedTo){
+    uint64_t seen = 1ull << start;
+    int stack[MAX_ATOMS];
+    int top = 0;
+    stack[top++] = start;
+    while(top > 0){
+        int a = stack[--top];
+        for(int i = 0; i < mol->bondCount; i++){
+            const Bond *b = &mol->bonds[i];
+            if((b->from == blockedFrom && b->to == blockedTo) || (b->from == blockedTo && b->to == blockedFrom)) continue;
+            int other = -1;
+            if(b->from == a) other = b->to;
+            else if(b->to == a) other = b->from;
+            if(other < 0 || (seen & (1ull << other))) continue;
+            seen |= 1ull << other;
+            stack[top++] = other;
+        }
+    }
+    return seen;
+}
+
+static int degree_of(const MoleculeGeometry *mol, int atom){
+    int d = 0;
+    for(int i = 0; i < mol->bondCount; i++){
+        if(mol->bonds[i].from == atom || mol->bonds[i].to == atom) d++;
+    }
+    return d;
+}
+
+static int other_neighbour(const MoleculeGeometry *mol, int atom, int exclude){
+    int best = -1;
+    for(int i = 0; i < mol->bondCount; i++){
+        int other = -1;
+        if(mol->bonds[i].from == atom) other = mol->bonds[i].to;
+        else if(mol->bonds[i].to == atom) other = mol->bonds[i].from;
+        if(other >= 0 && other != exclude && (best < 0 || other < best)) best = other;
+    }
+    return best;
+}
+
+int conformer_find_rotatable(const MoleculeGeometry *mol, int bondIndex[MAX_ROTATABLE]){
+    int count = 0;
+    for(int i = 0; i < mol->bondCount && count < MAX_ROTATABLE; i++){
+        const Bond *b = &mol->bonds[i];
+        if(b->order != 1) continue;
+        if(degree_of(mol, b->from) < 2 || degree_of(mol, b->to) < 2) continue;
+        if(side_of(mol, b->to, b->from, b->to) & (1ull << b->from)) continue; // ring bond
+        bondIndex[count++] = i;
+    }
+    return count;
+}
+
+
+static inline Vec3 v_sub(Vec3 a, Vec3 b){ return make_vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline float v_dot(Vec3 a, Vec3 b){ return a.x*b.x + a.y*b.y + a.z*b.z; }
+static inline Vec3 v_cross(Vec3 a, Vec3 b){
+    return make_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+
+static float dihedral(Vec3 a, Vec3 b, Vec3 c, Vec3 d){
+    Vec3 b1 = v_sub(b, a);
+    Vec3 b2 = v_sub(c, b);
+    Vec3 b3 = v_sub(d, c);
+    Vec3 m = v_cross(b1, b2);
+    Vec3 n = v_cross(b2, b3);
+    return atan2f(sqrtf(v_dot(b2, b2)) * v_dot(b1, n), v_dot(m, n));
+}
+
+// Rodrigues rotation of the atoms in `mask` about the axis through b and c.
+static void rotate_side(Vec3 *pos, int atomCount, uint64_t mask, Vec3 b, Vec3 c, float angle){
+    Vec3 axis = v_sub(c, b);
+    float len = sqrtf(v_dot(axis, axis));
+    if(len < 1e-6f) return;
+    axis = make_vec3(axis.x / len, axis.y / len, axis.z / len);
+    float cs = cosf(angle), sn = sinf(angle);
+
+    for(int i = 0; i < atomCount; i++){
+        if(!(mask & (1ull << i))) continue;
+        Vec3 p = v_sub(pos[i], b);
+        Vec3 k = v_cross(axis, p);
+        float kd = v_dot(axis, p) * (1.0f - cs);
+        pos[i] = make_vec3(b.x + p.x*cs + k.x*sn + axis.x*kd,
+                           b.y + p.y*cs + k.y*sn + axis.y*kd,
+                           b.z + p.z*cs + k.z*sn + axis.z*kd);
+    }
+}
+
+static unsigned bucket_of(int cx, int cy, int cz){
+    return ((unsigned)(cx * 73856093) ^ (unsigned)(cy * 19349663) ^ (unsigned)(cz * 83492791)) & (GRID_BUCKETS - 1);
+}
+
+// Spatial-hash check for non-bonded pairs closer than CLASH_SCALE times the
+// sum of their van der Waals radii.
+static bool has_clash(const EnumerationContext *ctx, const Vec3 *pos, int atomCount){
+    int head[GRID_BUCKETS];
+    int next[MAX_ATOMS];
+    int cell[MAX_ATOMS][3];
+    memset(head, -1, sizeof(head));
+
+    float inv = 1.0f / ctx->cellSize;
+    for(int i = 0; i < atomCount; i++){
+        cell[i][0] = (int)floorf(pos[i].x * inv);
+        cell[i][1] = (int)floorf(pos[i].y * inv);
+        cell[i][2] = (int)floorf(pos[i].z * inv);
+        unsigned h = bucket_of(cell[i][0], cell[i][1], cell[i][2]);
+        next[i] = head[h];
+        head[h] = i;
+    }
+
+    for(int i = 0; i < atomCount; i++){
+        for(int dz = -1; dz <= 1; dz++){
+            for(int dy = -1; dy <= 1; dy++){
+                for(int dx = -1; dx <= 1; dx++){
+                    unsigned h = bucket_of(cell[i][0] + dx, cell[i][1] + dy, cell[i][2] + dz);
+                    for(int j = head[h]; j >= 0; j = next[j]){
+                        if(j <= i || (ctx->excluded[i] & (1ull << j))) continue;
+                        Vec3 d = v_sub(pos[j], pos[i]);
+                        float limit = CLASH_SCALE * (ctx->radius[i] + ctx->radius[j]);
+                        if(v_dot(d, d) < limit * limit) return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static bool candidate_better(float ea, long long ia, float eb, long long ib){
+    if(ea != eb) return ea < eb;
+    return ia < ib;
+}
+
+// Inserts into a list sorted by (energy, combo) and capped at `cap`.
+static void insert_candidate(Candidate *list, int *count, int cap, float energy, long long combo, const Vec3 *pos, int atomCount){
+    int n = *count;
+    if(n == cap && !candidate_better(energy, combo, list[n-1].energy, list[n-1].combo)) return;
+
+    int at = (n < cap) ? n : cap - 1;
+    while(at > 0 && candidate_better(energy, combo, list[at-1].energy, list[at-1].combo)){
+        list[at] = list[at-1];
+        at--;
+    }
+    list[at].energy = energy;
+    list[at].combo = combo;
+    memcpy(list[at].pos, pos, sizeof(Vec3) * (size_t)atomCount);
+    if(n < cap) *count = n + 1;
+}
+
+static void enumerate_range(void *arg, int begin, int end){
+    EnumerationContext *ctx = arg;
+    const MoleculeGeometry *mol = ctx->mol;
+    int n = mol->atomCount;
+
+    ForceField *ff = malloc(sizeof(ForceField));
+    Candidate *local = malloc(sizeof(Candidate) * CHUNK_KEEP);
+    if(!ff || !local){
+        free(ff);
+        free(local);
+        return;
+    }
+    memcpy(ff, ctx->prototype, sizeof(ForceField));
+    int localCount = 0;
+    long long clashed = 0;
+
+    Vec3 pos[MAX_ATOMS];
+    float x[FF_DIM] = {0};
+
+    for(int item = begin; item < end; item++){
+        long long combo = torsion_sample(&ctx->sampling, item);
+        memcpy(pos, mol->atomPos, sizeof(Vec3) * (size_t)n);
+
+        long long digits = combo;
+        for(int r = 0; r < ctx->rotatableCount; r++){
+            float target = torsionStates[digits % TORSION_STATES];
+            digits /= TORSION_STATES;
+            float current = dihedral(pos[ctx->refA[r]], pos[ctx->refB[r]], pos[ctx->refC[r]], pos[ctx->refD[r]]);
+            rotate_side(pos, n, ctx->moving[r], pos[ctx->refB[r]], pos[ctx->refC[r]], target - current);
+        }
+
+        if(has_clash(ctx, pos, n)){
+            clashed++;
+            continue;
+        }
+
+        for(int i = 0; i < n; i++){
+            x[i] = pos[i].x;
+            x[FF_STRIDE + i] = pos[i].y;
+            x[2*FF_STRIDE + i] = pos[i].z;
+        }
+        float energy = (float)ff_energy_gradient(ff, x, NULL);
+        insert_candidate(local, &localCount, CHUNK_KEEP, energy, combo, pos, n);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for(int i = 0; i < localCount; i++){
+        insert_candidate(ctx->pool, &ctx->poolCount, CANDIDATE_POOL, local[i].energy, local[i].combo, local[i].pos, n);
+    }
+    ctx->enumerated += end - begin;
+    ctx->clashed += clashed;
+    pthread_mutex_unlock(&ctx->lock);
+
+    free(local);
+    free(ff);
+}
+
+TorsionSampling torsion_sampling(int rotatableCount, long long maxCombinations){
+    TorsionSampling s = { 1, 1, 1 };
+    for(int r = 0; r < rotatableCount; r++) s.total *= TORSION_STATES;
+    if(maxCombinations > 0 && s.total > maxCombinations){
+        s.stride = (s.total + maxCombinations - 1) / maxCombinations;
+        // A multiple of 3 would freeze the low digits: every sample would
+        // share the first torsions' states.
+        while(s.stride % TORSION_STATES == 0) s.stride++;
+    }
+    s.count = (s.total + s.stride - 1) / s.stride;
+    return s;
+}
+
+long long torsion_sample(const TorsionSampling *s, long long item){
+    return item * s->stride % s->total;
+}
+
+static float rmsd(const Vec3 *a, const Vec3 *b, int n){
+    float sum = 0.0f;
+    for(int i = 0; i < n; i++){
+        Vec3 d = v_sub(a[i], b[i]);
+        sum += v_dot(d, d);
+    }
+    return sqrtf(sum / (float)(n > 0 ? n : 1));
+}
+
+void conformer_enumerate(const MoleculeGeometry *mol, const ConformerOptions *options, ConformerSet *out){
+    ConformerOptions opts = options ? *options : conformer_default_options();
+    if(opts.keep > MAX_CONFORMERS - 1) opts.keep = MAX_CONFORMERS - 1;
+
+    memset(out, 0, sizeof(*out));
+    memcpy(out->pos[0], mol->atomPos, sizeof(Vec3) * (size_t)mol->atomCount);
+    out->count = 1;
+
+    EnumerationContext *ctx = calloc(1, sizeof(EnumerationContext));
+    ForceField *prototype = malloc(sizeof(ForceField));
+    if(!ctx || !prototype){
+        free(ctx);
+        free(prototype);
+        return;
+    }
+    ff_setup(prototype, mol);
+
+    float x[FF_DIM] = {0};
+    for(int i = 0; i < mol->atomCount; i++){
+        x[i] = mol->atomPos[i].x;
+        x[FF_STRIDE + i] = mol->atomPos[i].y;
+        x[2*FF_STRIDE + i] = mol->atomPos[i].z;
+    }
+    out->energy[0] = (float)ff_energy_gradient(prototype, x, NULL);
+
+    int rotatable[MAX_ROTATABLE];
+    int rotCount = conformer_find_rotatable(mol, rotatable);
+    out->rotatableCount = rotCount;
+
+    ctx->mol = mol;
+    ctx->prototype = prototype;
+    for(int r = 0; r < rotCount; r++){
+        const Bond *bond = &mol->bonds[rotatable[r]];
+        int b = bond->from, c = bond->to;
+        uint64_t sideC = side_of(mol, c, b, c);
+        uint64_t sideB = side_of(mol, b, b, c);
+        // Move whichever half is smaller so the ring system stays put.
+        if(__builtin_popcountll(sideB) < __builtin_popcountll(sideC)){
+            int t = b; b = c; c = t;
+            sideC = sideB;
+        }
+        ctx->refB[r] = b;
+        ctx->refC[r] = c;
+        ctx->refA[r] = other_neighbour(mol, b, c);
+        ctx->refD[r] = other_neighbour(mol, c, b);
+        ctx->moving[r] = sideC;
+    }
+    ctx->rotatableCount = rotCount;
+
+    float maxRadius = 0.0f;
+    for(int i = 0; i < mol->atomCount; i++){
+        uint8_t l = mol->atomLabel[i];
+        ctx->radius[i] = clashRadius[l < 5 ? l : 0];
+        if(ctx->radius[i] > maxRadius) maxRadius = ctx->radius[i];
+        ctx->excluded[i] = prototype->excluded[i];
+    }
+    ctx->cellSize = 2.0f * CLASH_SCALE * maxRadius;
+
+    ctx->sampling = torsion_sampling(rotCount, opts.maxCombinations);
+    long long items = ctx->sampling.count;
+
+    ctx->pool = malloc(sizeof(Candidate) * CANDIDATE_POOL);
+    pthread_mutex_init(&ctx->lock, NULL);
+
+    if(rotCount > 0 && ctx->pool){
+        parallel_for((int)items, 256, enumerate_range, ctx);
+    }
+
+    for(int i = 0; i < ctx->poolCount && out->count < opts.keep + 1; i++){
+        const Candidate *c = &ctx->pool[i];
+        bool distinct = true;
+        for(int k = 0; k < out->count && distinct; k++){
+            if(rmsd(c->pos, out->pos[k], mol->atomCount) < opts.minRmsd) distinct = false;
+        }
+        if(!distinct) continue;
+        memcpy(out->pos[out->count], c->pos, sizeof(Vec3) * (size_t)mol->atomCount);
+        out->energy[out->count] = c->energy;
+        out->count++;
+    }
+    out->enumerated = ctx->enumerated;
+    out->clashed = ctx->clashed;
+
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->pool);
+    free(ctx);
+    free(prototype);
+}
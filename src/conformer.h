@@ -0,0 +1,47 @@
+#ifndef ATLAS_CONFORMER_H
+#define ATLAS_CONFORMER_H
+
+#include "molecule.h"
+
+#define MAX_CONFORMERS 9
+#define MAX_ROTATABLE 16
+
+typedef struct {
+    int count;                          // entry 0 is always the input geometry
+    Vec3 pos[MAX_CONFORMERS][MAX_ATOMS];
+    float energy[MAX_CONFORMERS];
+    int rotatableCount;
+    long long enumerated;               // torsion combinations scored
+    long long clashed;                  // combinations rejected by the clash grid
+} ConformerSet;
+
+typedef struct {
+    int keep;                  // distinct conformers to keep besides the input
+    float minRmsd;             // conformers closer than this count as duplicates
+    long long maxCombinations; // larger spaces are sampled with a fixed stride
+} ConformerOptions;
+
+// Which torsion combinations get scored. Combination c sets rotatable bond
+// r to state (c / 3^r) % 3. A space larger than maxCombinations is walked
+// as item * stride modulo its size, with the stride coprime to 3 so every
+// torsion, the lowest digit included, cycles through all its states.
+typedef struct {
+    long long total;  // 3^rotatableCount
+    long long stride;
+    long long count;  // combinations scored
+} TorsionSampling;
+
+TorsionSampling torsion_sampling(int rotatableCount, long long maxCombinations);
+long long torsion_sample(const TorsionSampling *s, long long item);
+
+ConformerOptions conformer_default_options(void);
+
+// Single, acyclic bonds with heavy atoms on both sides.
+int conformer_find_rotatable(const MoleculeGeometry *mol, int bondIndex[MAX_ROTATABLE]);
+
+// Enumerates staggered torsion states (60/180/300 degrees) of every
+// rotatable bond, drops clashing combinations, scores the rest with the
+// force field and keeps the lowest-energy distinct ones. Runs on the pool.
+void conformer_enumerate(const MoleculeGeometry *mol, const ConformerOptions *options, ConformerSet *out);
+
+#endif
@@ -0,0 +1,427 @@
+#include "descriptors.h"
+#include "geometry.h"
+#include "library.h"
+#include "profiler.h"
+#include "rings.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DESCRIPTOR_CHUNK 8192
+#define DESCRIPTOR_ROW_MAX 384
+
+static const float elementMass[ELEMENT_COUNT] = { 12.011f, 15.999f, 14.007f, 35.45f, 18.998f };
+static const int elementValence[ELEMENT_COUNT] = { 4, 2, 3, 1, 1 };
+#define HYDROGEN_MASS 1.008f
+
+static int find_root(int *parent, int i){
+    while(parent[i] != i){
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Eigenvalues of a symmetric 3x3 matrix by cyclic Jacobi rotations.
+static void symmetric_eigenvalues3(double a[3][3], double out[3]){
+    for(int sweep = 0; sweep < 32; sweep++){
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        if(off < 1e-22) break;
+        for(int p = 0; p < 2; p++){
+            for(int q = p + 1; q < 3; q++){
+                if(fabs(a[p][q]) < 1e-300) continue;
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                for(int k = 0; k < 3; k++){
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for(int k = 0; k < 3; k++){
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+            }
+        }
+    }
+    for(int i = 0; i < 3; i++) out[i] = a[i][i];
+    for(int i = 0; i < 2; i++){
+        for(int j = i + 1; j < 3; j++){
+            if(out[j] < out[i]){
+                double t = out[i];
+                out[i] = out[j];
+                out[j] = t;
+            }
+        }
+    }
+}
+
+void compute_descriptors(const MoleculeGeometry *mol, int hydrogens, Descriptors *out){
+    memset(out, 0, sizeof(*out));
+    int n = mol->atomCount;
+    out->heavyAtoms = n;
+
+    int bondOrder[MAX_ATOMS] = {0};
+    int parent[MAX_ATOMS];
+    for(int i = 0; i < n; i++) parent[i] = i;
+    int components = n;
+    for(int b = 0; b < mol->bondCount; b++){
+        int i = mol->bonds[b].from, j = mol->bonds[b].to;
+        bondOrder[i] += mol->bonds[b].order;
+        bondOrder[j] += mol->bonds[b].order;
+        int ri = find_root(parent, i), rj = find_root(parent, j);
+        if(ri != rj){
+            parent[ri] = rj;
+            components--;
+        }
+    }
+    out->rings = mol->bondCount - n + components;
+    uint64_t aromaticAtoms = 0;
+    if(out->rings > 0){
+        RingInfo info;
+        perceive_rings(mol, &info);
+        out->aromaticRings = __builtin_popcountll(info.aromaticRings);
+        aromaticAtoms = info.aromaticAtoms;
+    }
+    // Kekule input already spends the aromatic valence on its double bonds.
+    for(int b = 0; b < mol->bondCount; b++){
+        if(mol->bonds[b].order > 1) aromaticAtoms &= ~((1ull << mol->bonds[b].from) | (1ull << mol->bonds[b].to));
+    }
+
+    double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    int implied = 0;
+    for(int i = 0; i < n; i++){
+        int label = mol->atomLabel[i] < ELEMENT_COUNT ? mol->atomLabel[i] : 0;
+        out->elementCounts[label]++;
+        int free = elementValence[label] - bondOrder[i] - (int)((aromaticAtoms >> i) & 1);
+        if(free > 0) implied += free;
+        double m = elementMass[label];
+        mass += m;
+        cx += m * mol->atomPos[i].x;
+        cy += m * mol->atomPos[i].y;
+        cz += m * mol->atomPos[i].z;
+    }
+    out->hydrogens = hydrogens >= 0 ? hydrogens : implied;
+    out->mass = (float)(mass + HYDROGEN_MASS * out->hydrogens);
+    out->boundingRadius = n ? compute_bounding_radius(mol) : 0.0f;
+    if(n == 0) return;
+
+    cx /= mass;
+    cy /= mass;
+    cz /= mass;
+    double inertia[3][3] = {{0}};
+    double r2sum = 0.0;
+    for(int i = 0; i < n; i++){
+        int label = mol->atomLabel[i] < ELEMENT_COUNT ? mol->atomLabel[i] : 0;
+        double m = elementMass[label];
+        double x = mol->atomPos[i].x - cx, y = mol->atomPos[i].y - cy, z = mol->atomPos[i].z - cz;
+        r2sum += m * (x*x + y*y + z*z);
+        inertia[0][0] += m * (y*y + z*z);
+        inertia[1][1] += m * (x*x + z*z);
+        inertia[2][2] += m * (x*x + y*y);
+        inertia[0][1] -= m * x * y;
+        inertia[0][2] -= m * x * z;
+        inertia[1][2] -= m * y * z;
+    }
+    inertia[1][0] = inertia[0][1];
+    inertia[2][0] = inertia[0][2];
+    inertia[2][1] = inertia[1][2];
+    out->radiusOfGyration = (float)sqrt(r2sum / mass);
+    double moments[3];
+    symmetric_eigenvalues3(inertia, moments);
+    for(int i = 0; i < 3; i++) out->principalMoments[i] = (float)(moments[i] > 0.0 ? moments[i] : 0.0);
+}
+
+static void append_element(char *out, size_t size, size_t *len, const char *symbol, int count){
+    if(count <= 0) return;
+    size_t at = *len < size ? *len : size;
+    int w = snprintf(out + at, size - at, count == 1 ? "%s" : "%s%d", symbol, count);
+    if(w > 0) *len += (size_t)w;
+}
+
+int descriptor_formula(const Descriptors *d, char *out, size_t size){
+    // Hill order: carbon, hydrogen, then the rest alphabetically; without
+    // carbon, hydrogen takes its alphabetical place too.
+    const int *n = d->elementCounts;
+    size_t len = 0;
+    if(size > 0) out[0] = '\0';
+    if(n[0] > 0){
+        append_element(out, size, &len, "C", n[0]);
+        append_element(out, size, &len, "H", d->hydrogens);
+        append_element(out, size, &len, "Cl", n[3]);
+        append_element(out, size, &len, "F", n[4]);
+    } else {
+        append_element(out, size, &len, "Cl", n[3]);
+        append_element(out, size, &len, "F", n[4]);
+        append_element(out, size, &len, "H", d->hydrogens);
+    }
+    append_element(out, size, &len, "N", n[2]);
+    append_element(out, size, &len, "O", n[1]);
+    return (int)len;
+}
+
+typedef enum { FORMAT_CSV, FORMAT_BINARY } DescriptorFormat;
+
+typedef struct {
+    const char *path;
+    const XyzRecord *records;
+    const LibraryEntry *entries; // parsed already (built-in compounds)
+    int count;
+    DescriptorFormat format;
+    int *record;
+    int8_t *status;              // 1 ok, 0 no heavy atoms, -1 parse error
+    Descriptors *results;
+    char (*rows)[DESCRIPTOR_ROW_MAX];
+    int *rowLength;
+} DescriptorChunk;
+
+static int csv_quote(char *out, size_t size, const char *s){
+    if(!strpbrk(s, ",\"")) return snprintf(out, size, "%s", s);
+    size_t n = 0;
+    if(n < size) out[n] = '"';
+    n++;
+    for(; *s; s++){
+        if(*s == '"'){
+            if(n < size) out[n] = '"';
+            n++;
+        }
+        if(n < size) out[n] = *s;
+        n++;
+    }
+    if(n < size) out[n] = '"';
+    n++;
+    if(size) out[n < size ? n : size - 1] = '\0';
+    return (int)n;
+}
+
+static void format_row(const DescriptorChunk *c, int i, const char *name){
+    const Descriptors *d = &c->results[i];
+    char quoted[2 * LIBRARY_NAME_MAX + 3], formula[64];
+    csv_quote(quoted, sizeof(quoted), name);
+    descriptor_formula(d, formula, sizeof(formula));
+    int n = snprintf(c->rows[i], DESCRIPTOR_ROW_MAX, "%d,%s,%s,%.3f,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.4f,%.4f,%.3f,%.3f,%.3f\n",
+                     c->record[i], quoted, formula, d->mass, d->heavyAtoms, d->hydrogens,
+                     d->elementCounts[0], d->elementCounts[2], d->elementCounts[1],
+                     d->elementCounts[4], d->elementCounts[3], d->rings, d->aromaticRings,
+                     d->boundingRadius, d->radiusOfGyration,
+                     d->principalMoments[0], d->principalMoments[1], d->principalMoments[2]);
+    c->rowLength[i] = n < DESCRIPTOR_ROW_MAX ? n : DESCRIPTOR_ROW_MAX - 1;
+}
+
+static void process_chunk(void *ctx, int begin, int end){
+    DescriptorChunk *c = ctx;
+    LibraryEntry entry;
+    char error[8];
+    for(int i = begin; i < end; i++){
+        const LibraryEntry *e = c->entries ? &c->entries[i] : &entry;
+        if(!c->entries){
+            c->record[i] = c->records[i].record;
+            c->status[i] = (int8_t)xyz_parse_record(&c->records[i], c->path, &entry, error, sizeof(error));
+            if(c->status[i] <= 0) continue;
+        } else {
+            c->record[i] = i + 1;
+            c->status[i] = 1;
+        }
+        compute_descriptors(&e->mol, e->hydrogens, &c->results[i]);
+        if(c->format == FORMAT_CSV) format_row(c, i, e->name);
+    }
+}
+
+enum { COL_INT32, COL_FLOAT32 };
+
+typedef struct {
+    char name[24];
+    uint32_t type;
+} ColumnInfo;
+
+static const ColumnInfo binaryColumns[] = {
+    { "record", COL_INT32 }, { "heavy_atoms", COL_INT32 }, { "hydrogens", COL_INT32 },
+    { "C", COL_INT32 }, { "N", COL_INT32 }, { "O", COL_INT32 }, { "F", COL_INT32 }, { "Cl", COL_INT32 },
+    { "rings", COL_INT32 }, { "aromatic_rings", COL_INT32 }, { "mass", COL_FLOAT32 }, { "bounding_radius", COL_FLOAT32 },
+    { "radius_of_gyration", COL_FLOAT32 }, { "moment1", COL_FLOAT32 }, { "moment2", COL_FLOAT32 },
+    { "moment3", COL_FLOAT32 },
+};
+#define BINARY_COLUMN_COUNT (int)(sizeof(binaryColumns) / sizeof(binaryColumns[0]))
+
+static void binary_value(const Descriptors *d, int record, int column, void *out){
+    int32_t iv = 0;
+    float fv = 0.0f;
+    switch(column){
+        case 0: iv = record; break;
+        case 1: iv = d->heavyAtoms; break;
+        case 2: iv = d->hydrogens; break;
+        case 3: iv = d->elementCounts[0]; break;
+        case 4: iv = d->elementCounts[2]; break;
+        case 5: iv = d->elementCounts[1]; break;
+        case 6: iv = d->elementCounts[4]; break;
+        case 7: iv = d->elementCounts[3]; break;
+        case 8: iv = d->rings; break;
+        case 9: iv = d->aromaticRings; break;
+        case 10: fv = d->mass; break;
+        case 11: fv = d->boundingRadius; break;
+        case 12: fv = d->radiusOfGyration; break;
+        default: fv = d->principalMoments[column - 13]; break;
+    }
+    if(binaryColumns[column].type == COL_INT32) memcpy(out, &iv, 4);
+    else memcpy(out, &fv, 4);
+}
+
+static bool write_chunk(FILE *out, const DescriptorChunk *c, void *columnBuffer){
+    if(c->format == FORMAT_CSV){
+        for(int i = 0; i < c->count; i++){
+            if(c->status[i] > 0 && fwrite(c->rows[i], 1, (size_t)c->rowLength[i], out) != (size_t)c->rowLength[i]) return false;
+        }
+        return true;
+    }
+    // A block: row count, then each column's values for those rows.
+    uint32_t rows = 0;
+    for(int i = 0; i < c->count; i++) rows += c->status[i] > 0;
+    if(rows == 0) return true;
+    if(fwrite(&rows, 4, 1, out) != 1) return false;
+    uint8_t *column = columnBuffer;
+    for(int k = 0; k < BINARY_COLUMN_COUNT; k++){
+        size_t n = 0;
+        for(int i = 0; i < c->count; i++){
+            if(c->status[i] > 0) binary_value(&c->results[i], c->record[i], k, column + 4 * n++);
+        }
+        if(fwrite(column, 4, n, out) != n) return false;
+    }
+    return true;
+}
+
+static bool write_header(FILE *out, DescriptorFormat format){
+    if(format == FORMAT_CSV){
+        return fputs("record,name,formula,mass,heavy_atoms,hydrogens,C,N,O,F,Cl,rings,aromatic_rings,"
+                     "bounding_radius,radius_of_gyration,moment1,moment2,moment3\n", out) >= 0;
+    }
+    uint32_t columns = (uint32_t)BINARY_COLUMN_COUNT, reserved = 0;
+    return fwrite("PKDESC1", 1, 8, out) == 8 && fwrite(&columns, 4, 1, out) == 1 &&
+           fwrite(&reserved, 4, 1, out) == 1 &&
+           fwrite(binaryColumns, sizeof(ColumnInfo), (size_t)BINARY_COLUMN_COUNT, out) == (size_t)BINARY_COLUMN_COUNT;
+}
+
+static bool write_trailer(FILE *out, DescriptorFormat format){
+    uint32_t zero = 0;
+    return format == FORMAT_CSV || fwrite(&zero, 4, 1, out) == 1;
+}
+
+static void print_descriptors_usage(void){
+    fprintf(stderr,
+            "usage: pk_rk4 descriptors [--library FILE.xyz|-] [--format csv|binary]\n"
+            "Writes one row per compound to stdout, in input order. Binary output is an\n"
+            "8-byte \"PKDESC1\" magic, the column count, a reserved word and a 24-byte name\n"
+            "plus type (0 int32, 1 float32) per column; then blocks of a row count followed\n"
+            "by each column's values, ending with a zero row count. Host byte order.\n");
+}
+
+int descriptors_main(int argc, char **argv){
+    const char *libraryPath = NULL;
+    DescriptorFormat format = FORMAT_CSV;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--library") == 0 && i + 1 < argc) libraryPath = argv[++i];
+        else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc){
+            const char *f = argv[++i];
+            if(strcmp(f, "csv") == 0) format = FORMAT_CSV;
+            else if(strcmp(f, "binary") == 0) format = FORMAT_BINARY;
+            else {
+                print_descriptors_usage();
+                return 2;
+            }
+        }
+        else {
+            print_descriptors_usage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    // Chunk buffers are the only allocation that scales, and they are fixed.
+    DescriptorChunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.format = format;
+    XyzRecord *records = malloc(sizeof(XyzRecord) * DESCRIPTOR_CHUNK);
+    chunk.record = malloc(sizeof(int) * DESCRIPTOR_CHUNK);
+    chunk.status = malloc(DESCRIPTOR_CHUNK);
+    chunk.results = malloc(sizeof(Descriptors) * DESCRIPTOR_CHUNK);
+    chunk.rows = format == FORMAT_CSV ? malloc(DESCRIPTOR_ROW_MAX * (size_t)DESCRIPTOR_CHUNK) : NULL;
+    chunk.rowLength = malloc(sizeof(int) * DESCRIPTOR_CHUNK);
+    void *columnBuffer = malloc(4 * (size_t)DESCRIPTOR_CHUNK);
+    static char outBuffer[1 << 20];
+    setvbuf(stdout, outBuffer, _IOFBF, sizeof(outBuffer));
+
+    int status = 1;
+    char error[256] = "out of memory";
+    bool ok = records && chunk.record && chunk.status && chunk.results && chunk.rowLength && columnBuffer &&
+              (format != FORMAT_CSV || chunk.rows) && write_header(stdout, format);
+    long long rows = 0;
+    if(ok && !libraryPath){
+        Library lib;
+        library_init(&lib);
+        ok = library_add_builtin(&lib);
+        if(ok){
+            chunk.entries = lib.entries;
+            chunk.count = lib.count;
+            process_chunk(&chunk, 0, chunk.count);
+            ok = write_chunk(stdout, &chunk, columnBuffer);
+            rows = lib.count;
+        }
+        library_free(&lib);
+    } else if(ok){
+        XyzReader reader;
+        if(!xyz_reader_open(&reader, libraryPath)){
+            snprintf(error, sizeof(error), "%s: cannot open", libraryPath);
+            ok = false;
+        }
+        chunk.path = reader.path;
+        chunk.records = records;
+        while(ok){
+            int n = xyz_reader_split(&reader, records, DESCRIPTOR_CHUNK, error, sizeof(error));
+            if(n <= 0){
+                ok = n == 0;
+                break;
+            }
+            chunk.count = n;
+            parallel_for(n, 256, process_chunk, &chunk);
+            for(int i = 0; i < n; i++){
+                if(chunk.status[i] < 0){
+                    // Parse it again here for the message.
+                    LibraryEntry entry;
+                    xyz_parse_record(&records[i], reader.path, &entry, error, sizeof(error));
+                    chunk.count = i;
+                    ok = false;
+                    break;
+                }
+                rows += chunk.status[i] > 0;
+            }
+            if(!write_chunk(stdout, &chunk, columnBuffer)){
+                snprintf(error, sizeof(error), "write to stdout failed");
+                ok = false;
+            }
+        }
+        xyz_reader_close(&reader);
+    }
+    if(ok) ok = write_trailer(stdout, format);
+    if(fflush(stdout) != 0 && ok){
+        snprintf(error, sizeof(error), "write to stdout failed");
+        ok = false;
+    }
+    if(ok) status = 0;
+    else fprintf(stderr, "descriptors: %s\n", error);
+    fprintf(stderr, "descriptors: %lld molecules\n", rows);
+
+    free(records);
+    free(chunk.record);
+    free(chunk.status);
+    free(chunk.results);
+    free(chunk.rows);
+    free(chunk.rowLength);
+    free(columnBuffer);
+    thread_pool_shutdown();
+    return status;
+}
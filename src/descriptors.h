@@ -0,0 +1,38 @@
+#ifndef ATLAS_DESCRIPTORS_H
+#define ATLAS_DESCRIPTORS_H
+
+#include <stddef.h>
+
+#include "molecule.h"
+
+// Per-molecule descriptors for data pipelines. Geometry-derived values use
+// the heavy atoms only, which is all a MoleculeGeometry holds.
+
+#define ELEMENT_COUNT 5 // atom labels: C, O, N, Cl, F
+
+typedef struct {
+    int heavyAtoms;
+    int hydrogens;                  // as given, or implied by valence
+    int elementCounts[ELEMENT_COUNT];
+    int rings;                      // bonds - atoms + connected components
+    int aromaticRings;              // of the smallest set of smallest rings
+    float mass;                     // g/mol, hydrogens included
+    float boundingRadius;           // compute_bounding_radius()
+    float radiusOfGyration;         // mass-weighted, about the centre of mass
+    float principalMoments[3];      // of inertia, ascending, amu * A^2
+} Descriptors;
+
+// hydrogens < 0 fills each heavy atom up to its usual valence (C 4, N 3,
+// O 2, halogens 1) given the bond orders present. An aromatic ring atom
+// with only single bonds, as perceived from XYZ, counts one more.
+void compute_descriptors(const MoleculeGeometry *mol, int hydrogens, Descriptors *out);
+
+// Hill-order formula ("C19H28O2"); returns the length like snprintf.
+int descriptor_formula(const Descriptors *d, char *out, size_t size);
+
+// `pk_rk4 descriptors`: streams descriptors of the built-in compounds or
+// an XYZ library to stdout as CSV or binary columns, in input order.
+// argv[0] is "descriptors"; returns a process exit code.
+int descriptors_main(int argc, char **argv);
+
+#endif
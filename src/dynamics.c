@@ -0,0 +1,391 @@
+#include "dynamics.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MD_DT 0.004f
+#define MD_TIME_SCALE 1.0f      // simulated time units per wall-clock second
+#define MD_MAX_STEPS_PER_TICK 64
+#define MD_TEMPERATURE 2.0f
+
+static const float massByLabel[5] = { 12.0f, 16.0f, 14.0f, 35.5f, 19.0f };
+
+static float rand_unit(uint32_t *state){
+    *state = *state * 1664525u + 1013904223u;
+    return (float)((*state >> 8) & 0xFFFFFF) / 16777216.0f;
+}
+
+static float rand_normal(uint32_t *state){
+    float u1 = rand_unit(state);
+    float u2 = rand_unit(state);
+    if(u1 < 1e-7f) u1 = 1e-7f;
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * u2);
+}
+
+static void add_spring(MdSystem *sys, int a, int b, float k){
+    if(sys->springCount >= MD_MAX_SPRINGS) return;
+    for(int i = 0; i < sys->springCount; i++){
+        if((sys->springA[i] == a && sys->springB[i] == b) || (sys->springA[i] == b && sys->springB[i] == a)) return;
+    }
+    float dx = sys->pos[0][b] - sys->pos[0][a];
+    float dy = sys->pos[1][b] - sys->pos[1][a];
+    float dz = sys->pos[2][b] - sys->pos[2][a];
+    int n = sys->springCount++;
+    sys->springA[n] = a;
+    sys->springB[n] = b;
+    sys->springRest[n] = sqrtf(dx*dx + dy*dy + dz*dz);
+    sys->springK[n] = k;
+}
+
+static void compute_forces(MdSystem *sys){
+    memset(sys->force, 0, sizeof(sys->force));
+    for(int i = 0; i < sys->springCount; i++){
+        int a = sys->springA[i];
+        int b = sys->springB[i];
+        float dx = sys->pos[0][b] - sys->pos[0][a];
+        float dy = sys->pos[1][b] - sys->pos[1][a];
+        float dz = sys->pos[2][b] - sys->pos[2][a];
+        float r = sqrtf(dx*dx + dy*dy + dz*dz);
+        if(r < 1e-6f) continue;
+        float f = -sys->springK[i] * (r - sys->springRest[i]) / r;
+        sys->force[0][b] += f * dx;
+        sys->force[1][b] += f * dy;
+        sys->force[2][b] += f * dz;
+        sys->force[0][a] -= f * dx;
+        sys->force[1][a] -= f * dy;
+        sys->force[2][a] -= f * dz;
+    }
+}
+
+// Removes rigid-body spin so a tile does not slowly start turning on its own.
+static void remove_rotation(MdSystem *sys, float totalMass){
+    if(totalMass <= 0.0f) return;
+    float c[3] = {0.0f, 0.0f, 0.0f};
+    for(int i = 0; i < sys->atomCount; i++){
+        for(int k = 0; k < 3; k++) c[k] += sys->mass[i] * sys->pos[k][i];
+    }
+    for(int k = 0; k < 3; k++) c[k] /= totalMass;
+
+    float L[3] = {0.0f, 0.0f, 0.0f};
+    float I[3][3] = {{0.0f}};
+    for(int i = 0; i < sys->atomCount; i++){
+        float r[3] = { sys->pos[0][i] - c[0], sys->pos[1][i] - c[1], sys->pos[2][i] - c[2] };
+        float v[3] = { sys->vel[0][i], sys->vel[1][i], sys->vel[2][i] };
+        float m = sys->mass[i];
+        L[0] += m * (r[1]*v[2] - r[2]*v[1]);
+        L[1] += m * (r[2]*v[0] - r[0]*v[2]);
+        L[2] += m * (r[0]*v[1] - r[1]*v[0]);
+        float r2 = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+        for(int a = 0; a < 3; a++){
+            for(int b = 0; b < 3; b++) I[a][b] += m * ((a == b ? r2 : 0.0f) - r[a]*r[b]);
+        }
+    }
+
+    // omega = I^-1 L by Cramer's rule; planar molecules still invert because
+    // the in-plane axes carry the out-of-plane inertia.
+    float det = I[0][0]*(I[1][1]*I[2][2] - I[1][2]*I[2][1])
+              - I[0][1]*(I[1][0]*I[2][2] - I[1][2]*I[2][0])
+              + I[0][2]*(I[1][0]*I[2][1] - I[1][1]*I[2][0]);
+    if(fabsf(det) < 1e-6f) return;
+    float inv[3][3];
+    inv[0][0] =  (I[1][1]*I[2][2] - I[1][2]*I[2][1]) / det;
+    inv[0][1] = -(I[0][1]*I[2][2] - I[0][2]*I[2][1]) / det;
+    inv[0][2] =  (I[0][1]*I[1][2] - I[0][2]*I[1][1]) / det;
+    inv[1][0] = -(I[1][0]*I[2][2] - I[1][2]*I[2][0]) / det;
+    inv[1][1] =  (I[0][0]*I[2][2] - I[0][2]*I[2][0]) / det;
+    inv[1][2] = -(I[0][0]*I[1][2] - I[0][2]*I[1][0]) / det;
+    inv[2][0] =  (I[1][0]*I[2][1] - I[1][1]*I[2][0]) / det;
+    inv[2][1] = -(I[0][0]*I[2][1] - I[0][1]*I[2][0]) / det;
+    inv[2][2] =  (I[0][0]*I[1][1] - I[0][1]*I[1][0]) / det;
+
+    float w[3];
+    for(int a = 0; a < 3; a++) w[a] = inv[a][0]*L[0] + inv[a][1]*L[1] + inv[a][2]*L[2];
+
+    for(int i = 0; i < sys->atomCount; i++){
+        float r[3] = { sys->pos[0][i] - c[0], sys->pos[1][i] - c[1], sys->pos[2][i] - c[2] };
+        sys->vel[0][i] -= w[1]*r[2] - w[2]*r[1];
+        sys->vel[1][i] -= w[2]*r[0] - w[0]*r[2];
+        sys->vel[2][i] -= w[0]*r[1] - w[1]*r[0];
+    }
+}
+
+void md_system_init(MdSystem *sys, const MoleculeGeometry *mol, float temperature, uint32_t seed){
+    memset(sys, 0, sizeof(*sys));
+    sys->atomCount = mol->atomCount;
+    sys->targetTemperature = temperature;
+    sys->thermostatTau = 0.5f;
+
+    for(int i = 0; i < mol->atomCount; i++){
+        sys->pos[0][i] = mol->atomPos[i].x;
+        sys->pos[1][i] = mol->atomPos[i].y;
+        sys->pos[2][i] = mol->atomPos[i].z;
+        uint8_t label = mol->atomLabel[i];
+        sys->mass[i] = massByLabel[label < 5 ? label : 0];
+        sys->invMass[i] = 1.0f / sys->mass[i];
+    }
+
+    for(int i = 0; i < mol->bondCount; i++){
+        add_spring(sys, mol->bonds[i].from, mol->bonds[i].to, 300.0f * (float)mol->bonds[i].order);
+    }
+    for(int i = 0; i < mol->bondCount; i++){
+        for(int j = i + 1; j < mol->bondCount; j++){
+            const Bond *p = &mol->bonds[i];
+            const Bond *q = &mol->bonds[j];
+            int a = -1, c = -1;
+            if(p->from == q->from){ a = p->to; c = q->to; }
+            else if(p->from == q->to){ a = p->to; c = q->from; }
+            else if(p->to == q->from){ a = p->from; c = q->to; }
+            else if(p->to == q->to){ a = p->from; c = q->from; }
+            if(a >= 0 && a != c) add_spring(sys, a, c, 80.0f);
+        }
+    }
+
+    // Maxwell-Boltzmann velocities with the centre-of-mass drift removed.
+    uint32_t state = seed ? seed : 1u;
+    float momentum[3] = {0.0f, 0.0f, 0.0f};
+    float totalMass = 0.0f;
+    float sigmaScale = temperature > 0.0f ? temperature : 0.0f;
+    for(int i = 0; i < sys->atomCount; i++){
+        float sigma = sqrtf(sigmaScale * sys->invMass[i]);
+        for(int k = 0; k < 3; k++){
+            sys->vel[k][i] = sigma * rand_normal(&state);
+            momentum[k] += sys->mass[i] * sys->vel[k][i];
+        }
+        totalMass += sys->mass[i];
+    }
+    for(int i = 0; i < sys->atomCount && totalMass > 0.0f; i++){
+        for(int k = 0; k < 3; k++) sys->vel[k][i] -= momentum[k] / totalMass;
+    }
+    remove_rotation(sys, totalMass);
+
+    compute_forces(sys);
+}
+
+void md_system_step(MdSystem *sys, float dt){
+    int n = sys->atomCount;
+    float half = 0.5f * dt;
+
+    for(int k = 0; k < 3; k++){
+        float *x = sys->pos[k];
+        float *v = sys->vel[k];
+        const float *f = sys->force[k];
+        for(int i = 0; i < n; i++){
+            v[i] += half * f[i] * sys->invMass[i];
+            x[i] += dt * v[i];
+        }
+    }
+
+    compute_forces(sys);
+
+    for(int k = 0; k < 3; k++){
+        float *v = sys->vel[k];
+        const float *f = sys->force[k];
+        for(int i = 0; i < n; i++) v[i] += half * f[i] * sys->invMass[i];
+    }
+
+    // Berendsen weak coupling to the target temperature.
+    if(sys->targetTemperature > 0.0f){
+        float t = md_system_temperature(sys);
+        if(t > 1e-6f){
+            float lambda = sqrtf(1.0f + dt / sys->thermostatTau * (sys->targetTemperature / t - 1.0f));
+            for(int k = 0; k < 3; k++){
+                for(int i = 0; i < n; i++) sys->vel[k][i] *= lambda;
+            }
+        }
+    }
+}
+
+double md_system_energy(const MdSystem *sys){
+    double kinetic = 0.0;
+    for(int i = 0; i < sys->atomCount; i++){
+        float v2 = sys->vel[0][i]*sys->vel[0][i] + sys->vel[1][i]*sys->vel[1][i] + sys->vel[2][i]*sys->vel[2][i];
+        kinetic += 0.5 * sys->mass[i] * v2;
+    }
+    double potential = 0.0;
+    for(int i = 0; i < sys->springCount; i++){
+        int a = sys->springA[i];
+        int b = sys->springB[i];
+        float dx = sys->pos[0][b] - sys->pos[0][a];
+        float dy = sys->pos[1][b] - sys->pos[1][a];
+        float dz = sys->pos[2][b] - sys->pos[2][a];
+        float stretch = sqrtf(dx*dx + dy*dy + dz*dz) - sys->springRest[i];
+        potential += 0.5 * sys->springK[i] * stretch * stretch;
+    }
+    return kinetic + potential;
+}
+
+float md_system_temperature(const MdSystem *sys){
+    if(sys->atomCount == 0) return 0.0f;
+    float twiceKinetic = 0.0f;
+    for(int i = 0; i < sys->atomCount; i++){
+        float v2 = sys->vel[0][i]*sys->vel[0][i] + sys->vel[1][i]*sys->vel[1][i] + sys->vel[2][i]*sys->vel[2][i];
+        twiceKinetic += sys->mass[i] * v2;
+    }
+    return twiceKinetic / (3.0f * (float)sys->atomCount);
+}
+
+
+typedef struct {
+    MdSystem system;
+    bool loaded;
+    atomic_bool active;
+
+    // Writer fills buffer[(seq + 1) & 1] and then bumps seq; a reader copy
+    // is only valid if seq did not move while it was copying.
+    Vec3 published[2][MAX_ATOMS];
+    atomic_uint seq;
+} MdSlot;
+
+struct MdSimulation {
+    int systemCount;
+    MdSlot *slots;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    atomic_bool running;
+    atomic_bool stepped;
+    atomic_bool quit;
+};
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void publish(MdSlot *slot){
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    Vec3 *dst = slot->published[(seq + 1) & 1];
+    const MdSystem *sys = &slot->system;
+    for(int i = 0; i < sys->atomCount; i++){
+        dst[i] = make_vec3(sys->pos[0][i], sys->pos[1][i], sys->pos[2][i]);
+    }
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+}
+
+static void step_active(MdSimulation *sim, int steps){
+    pthread_mutex_lock(&sim->lock);
+    for(int s = 0; s < sim->systemCount; s++){
+        MdSlot *slot = &sim->slots[s];
+        if(!slot->loaded || !atomic_load(&slot->active)) continue;
+        for(int k = 0; k < steps; k++) md_system_step(&slot->system, MD_DT);
+        publish(slot);
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+static void *simulation_main(void *arg){
+    MdSimulation *sim = arg;
+    double last = now_seconds();
+    double pending = 0.0;
+
+    while(!atomic_load(&sim->quit)){
+        double now = now_seconds();
+        double elapsed = now - last;
+        last = now;
+
+        if(atomic_load(&sim->running) && !atomic_load(&sim->stepped)){
+            pending += elapsed * MD_TIME_SCALE;
+            int steps = (int)(pending / MD_DT);
+            if(steps > MD_MAX_STEPS_PER_TICK){
+                // Fell behind (e.g. the process was suspended); drop the backlog.
+                steps = MD_MAX_STEPS_PER_TICK;
+                pending = 0.0;
+            } else {
+                pending -= steps * MD_DT;
+            }
+
+            if(steps > 0) step_active(sim, steps);
+        } else {
+            pending = 0.0;
+        }
+
+        struct timespec nap = { 0, 2 * 1000 * 1000 };
+        nanosleep(&nap, NULL);
+    }
+    return NULL;
+}
+
+MdSimulation *md_create(int systemCount){
+    MdSimulation *sim = calloc(1, sizeof(*sim));
+    if(!sim) return NULL;
+    sim->slots = calloc((size_t)systemCount, sizeof(MdSlot));
+    if(!sim->slots){
+        free(sim);
+        return NULL;
+    }
+    sim->systemCount = systemCount;
+    pthread_mutex_init(&sim->lock, NULL);
+    atomic_init(&sim->running, false);
+    atomic_init(&sim->stepped, false);
+    atomic_init(&sim->quit, false);
+
+    if(pthread_create(&sim->thread, NULL, simulation_main, sim) != 0){
+        pthread_mutex_destroy(&sim->lock);
+        free(sim->slots);
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+void md_destroy(MdSimulation *sim){
+    if(!sim) return;
+    atomic_store(&sim->quit, true);
+    pthread_join(sim->thread, NULL);
+    pthread_mutex_destroy(&sim->lock);
+    free(sim->slots);
+    free(sim);
+}
+
+void md_load(MdSimulation *sim, int index, const MoleculeGeometry *mol){
+    if(!sim || index < 0 || index >= sim->systemCount) return;
+    MdSlot *slot = &sim->slots[index];
+
+    pthread_mutex_lock(&sim->lock);
+    md_system_init(&slot->system, mol, MD_TEMPERATURE, 0x9E3779B9u ^ (uint32_t)index);
+    slot->loaded = true;
+    publish(slot);
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void md_set_active(MdSimulation *sim, int index, bool active){
+    if(!sim || index < 0 || index >= sim->systemCount) return;
+    atomic_store(&sim->slots[index].active, active);
+}
+
+void md_set_running(MdSimulation *sim, bool running){
+    if(sim) atomic_store(&sim->running, running);
+}
+
+bool md_is_running(const MdSimulation *sim){
+    return sim && atomic_load(&((MdSimulation*)sim)->running);
+}
+
+void md_set_stepped(MdSimulation *sim, bool stepped){
+    if(sim) atomic_store(&sim->stepped, stepped);
+}
+
+void md_step_frame(MdSimulation *sim){
+    if(!sim || !atomic_load(&sim->stepped) || !atomic_load(&sim->running)) return;
+    step_active(sim, MD_STEPS_PER_FRAME);
+}
+
+bool md_read_positions(MdSimulation *sim, int index, Vec3 *out, int atomCount){
+    if(!sim || index < 0 || index >= sim->systemCount) return false;
+    MdSlot *slot = &sim->slots[index];
+    if(!atomic_load(&slot->active)) return false;
+
+    for(int attempt = 0; attempt < 8; attempt++){
+        unsigned before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if(before == 0) return false;
+        memcpy(out, slot->published[before & 1], sizeof(Vec3) * (size_t)atomCount);
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&slot->seq, memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#ifndef ATLAS_DYNAMICS_H
+#define ATLAS_DYNAMICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+// Bonds plus 1-3 (Urey-Bradley) springs; the 1-3 terms keep angles from
+// collapsing without a full angle potential.
+#define MD_MAX_SPRINGS (MAX_BONDS + MAX_ATOMS * 6)
+
+typedef struct {
+    int atomCount;
+    float pos[3][MAX_ATOMS];
+    float vel[3][MAX_ATOMS];
+    float force[3][MAX_ATOMS];
+    float invMass[MAX_ATOMS];
+    float mass[MAX_ATOMS];
+
+    int springCount;
+    int springA[MD_MAX_SPRINGS], springB[MD_MAX_SPRINGS];
+    float springRest[MD_MAX_SPRINGS], springK[MD_MAX_SPRINGS];
+
+    float targetTemperature; // kT in simulation units, <= 0 disables the thermostat
+    float thermostatTau;
+} MdSystem;
+
+// Springs rest at the current geometry, so the molecule vibrates about it.
+void md_system_init(MdSystem *sys, const MoleculeGeometry *mol, float temperature, uint32_t seed);
+void md_system_step(MdSystem *sys, float dt);
+double md_system_energy(const MdSystem *sys);
+float md_system_temperature(const MdSystem *sys);
+
+
+// Background simulation that integrates a set of systems at a fixed
+// timestep on its own thread and publishes positions through a pair of
+// buffers per system, independent of the display rate.
+typedef struct MdSimulation MdSimulation;
+
+MdSimulation *md_create(int systemCount);
+void md_destroy(MdSimulation *sim);
+
+void md_load(MdSimulation *sim, int index, const MoleculeGeometry *mol);
+void md_set_active(MdSimulation *sim, int index, bool active);
+void md_set_running(MdSimulation *sim, bool running);
+bool md_is_running(const MdSimulation *sim);
+
+// Replays step the simulation from the frame clock instead of the wall
+// clock: the thread leaves a stepped simulation alone and each
+// md_step_frame() integrates MD_STEPS_PER_FRAME steps, one 60 Hz frame's
+// worth, so the same session always vibrates the same way.
+#define MD_STEPS_PER_FRAME 4
+void md_set_stepped(MdSimulation *sim, bool stepped);
+void md_step_frame(MdSimulation *sim);
+
+// Copies the latest published positions of a loaded, active system into
+// out. Returns false when there is nothing to show.
+bool md_read_positions(MdSimulation *sim, int index, Vec3 *out, int atomCount);
+
+#endif
@@ -0,0 +1,351 @@
+#include "export.h"
+#include "profiler.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct FrameWriter {
+    ExportFormat format;
+    char *path;
+    FILE *video; // Y4M only
+    int width, height;
+    bool ok;
+
+    uint32_t **ring;
+    int ringSize;
+    int head;   // next buffer to hand out
+    int queued; // buffers waiting for the writer
+    int frameIndex;
+    bool closing;
+
+    // Scratch owned by the writer thread.
+    uint8_t *encodeBuffer;
+    size_t encodeCapacity;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t space;
+};
+
+ExportFormat export_format_for_path(const char *path){
+    size_t n = strlen(path);
+    return (n >= 4 && strcmp(path + n - 4, ".y4m") == 0) ? EXPORT_Y4M : EXPORT_PNG;
+}
+
+// ---- PNG ----
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void build_crc_table(void){
+    for(uint32_t n = 0; n < 256; n++){
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *p, size_t n){
+    for(size_t i = 0; i < n; i++) crc = crcTable[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static void put_be32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static bool write_chunk(FILE *f, const char type[4], const uint8_t *data, uint32_t length){
+    uint8_t header[8];
+    put_be32(header, length);
+    memcpy(header + 4, type, 4);
+    uint32_t crc = crc_update(0xFFFFFFFFu, header + 4, 4);
+    crc = crc_update(crc, data, length) ^ 0xFFFFFFFFu;
+    uint8_t trailer[4];
+    put_be32(trailer, crc);
+    return fwrite(header, 1, 8, f) == 8 &&
+           (length == 0 || fwrite(data, 1, length, f) == length) &&
+           fwrite(trailer, 1, 4, f) == 4;
+}
+
+#define DEFLATE_STORED_MAX 65535
+#define PNG_IDAT_MAX (1u << 20) // chunk lengths must stay below 2^31
+
+static bool png_encode(const uint32_t *argb, int width, int height, uint8_t **buffer, size_t *capacity, size_t *outSize){
+    size_t raw = (size_t)height * (1 + (size_t)width * 3);
+    size_t blocks = raw / DEFLATE_STORED_MAX + 1;
+    size_t needed = raw * 2 + 2 + blocks * 5 + 4; // raw rows staged after the stream
+    if(needed > *capacity){
+        uint8_t *grown = realloc(*buffer, needed);
+        if(!grown) return false;
+        *buffer = grown;
+        *capacity = needed;
+    }
+
+    // Filter-free scanlines first, in the back half of the buffer.
+    uint8_t *rows = *buffer + (needed - raw);
+    uint8_t *r = rows;
+    for(int y = 0; y < height; y++){
+        *r++ = 0;
+        const uint32_t *src = argb + (size_t)y * (size_t)width;
+        for(int x = 0; x < width; x++){
+            *r++ = (uint8_t)(src[x] >> 16);
+            *r++ = (uint8_t)(src[x] >> 8);
+            *r++ = (uint8_t)src[x];
+        }
+    }
+
+    // zlib stream of stored blocks, written in front of the rows.
+    uint8_t *out = *buffer;
+    *out++ = 0x78;
+    *out++ = 0x01;
+    uint32_t a = 1, b = 0;
+    size_t done = 0;
+    do {
+        size_t n = raw - done < DEFLATE_STORED_MAX ? raw - done : DEFLATE_STORED_MAX;
+        *out++ = done + n == raw ? 1 : 0;
+        *out++ = (uint8_t)n;
+        *out++ = (uint8_t)(n >> 8);
+        *out++ = (uint8_t)~n;
+        *out++ = (uint8_t)(~n >> 8);
+        memmove(out, rows + done, n);
+        for(size_t i = 0; i < n; i++){
+            a += out[i];
+            if(a >= 65521) a -= 65521;
+            b += a;
+            if(b >= 65521) b -= 65521;
+        }
+        out += n;
+        done += n;
+    } while(done < raw);
+    put_be32(out, (b << 16) | a);
+    out += 4;
+    *outSize = (size_t)(out - *buffer);
+    return true;
+}
+
+static bool png_write_buffered(FILE *f, const uint32_t *argb, int width, int height,
+                               uint8_t **buffer, size_t *capacity){
+    pthread_once(&crcOnce, build_crc_table);
+    size_t idatSize = 0;
+    if(!png_encode(argb, width, height, buffer, capacity, &idatSize)) return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    uint8_t ihdr[13];
+    put_be32(ihdr, (uint32_t)width);
+    put_be32(ihdr + 4, (uint32_t)height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // RGB
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering, all rows unfiltered
+    ihdr[12] = 0; // no interlace
+    bool ok = fwrite(signature, 1, 8, f) == 8 && write_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    // The zlib stream is split across as many IDAT chunks as it needs.
+    for(size_t done = 0; ok && done < idatSize; done += PNG_IDAT_MAX){
+        size_t n = idatSize - done < PNG_IDAT_MAX ? idatSize - done : PNG_IDAT_MAX;
+        ok = write_chunk(f, "IDAT", *buffer + done, (uint32_t)n);
+    }
+    return ok && write_chunk(f, "IEND", NULL, 0);
+}
+
+bool png_write(FILE *f, const uint32_t *argb, int width, int height){
+    uint8_t *buffer = NULL;
+    size_t capacity = 0;
+    bool ok = png_write_buffered(f, argb, width, height, &buffer, &capacity);
+    free(buffer);
+    return ok;
+}
+
+// ---- Y4M ----
+
+bool y4m_write_header(FILE *f, int width, int height, int fps){
+    return fprintf(f, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps) > 0;
+}
+
+static bool y4m_write_buffered(FILE *f, const uint32_t *argb, int width, int height,
+                               uint8_t **buffer, size_t *capacity){
+    size_t lumaSize = (size_t)width * (size_t)height;
+    size_t chromaSize = lumaSize / 4;
+    size_t needed = lumaSize + 2 * chromaSize;
+    if(needed > *capacity){
+        uint8_t *grown = realloc(*buffer, needed);
+        if(!grown) return false;
+        *buffer = grown;
+        *capacity = needed;
+    }
+    uint8_t *yPlane = *buffer;
+    uint8_t *uPlane = yPlane + lumaSize;
+    uint8_t *vPlane = uPlane + chromaSize;
+
+    // BT.601 full range in 16.16 fixed point; chroma from 2x2 averages.
+    for(int y = 0; y < height; y += 2){
+        for(int x = 0; x < width; x += 2){
+            int sumR = 0, sumG = 0, sumB = 0;
+            for(int k = 0; k < 4; k++){
+                int px = x + (k & 1), py = y + (k >> 1);
+                uint32_t c = argb[(size_t)py * (size_t)width + (size_t)px];
+                int r = (int)((c >> 16) & 255), g = (int)((c >> 8) & 255), b = (int)(c & 255);
+                yPlane[(size_t)py * (size_t)width + (size_t)px] = (uint8_t)((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+                sumR += r;
+                sumG += g;
+                sumB += b;
+            }
+            int u = (-11059 * sumR - 21709 * sumG + 32768 * sumB + 4 * 32768) / (4 * 65536) + 128;
+            int v = (32768 * sumR - 27439 * sumG - 5329 * sumB + 4 * 32768) / (4 * 65536) + 128;
+            size_t ci = (size_t)(y / 2) * (size_t)(width / 2) + (size_t)(x / 2);
+            uPlane[ci] = (uint8_t)(u < 0 ? 0 : u > 255 ? 255 : u);
+            vPlane[ci] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+    }
+    return fputs("FRAME\n", f) >= 0 && fwrite(*buffer, 1, needed, f) == needed;
+}
+
+bool y4m_write_frame(FILE *f, const uint32_t *argb, int width, int height){
+    uint8_t *buffer = NULL;
+    size_t capacity = 0;
+    bool ok = (width % 2 == 0 && height % 2 == 0) && y4m_write_buffered(f, argb, width, height, &buffer, &capacity);
+    free(buffer);
+    return ok;
+}
+
+// ---- writer ----
+
+static bool write_frame(FrameWriter *w, const uint32_t *pixels, int index){
+    PROF_SCOPE("export_write");
+    if(w->format == EXPORT_Y4M){
+        return y4m_write_buffered(w->video, pixels, w->width, w->height, &w->encodeBuffer, &w->encodeCapacity);
+    }
+    size_t n = strlen(w->path) + 32;
+    char *name = malloc(n);
+    if(!name) return false;
+    snprintf(name, n, "%s/frame_%05d.png", w->path, index);
+    FILE *f = fopen(name, "wb");
+    free(name);
+    if(!f) return false;
+    bool ok = png_write_buffered(f, pixels, w->width, w->height, &w->encodeBuffer, &w->encodeCapacity);
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
+
+static void *writer_main(void *arg){
+    FrameWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for(;;){
+        while(w->queued == 0 && !w->closing) pthread_cond_wait(&w->work, &w->lock);
+        if(w->queued == 0) break;
+        int slot = (w->head - w->queued + w->ringSize) % w->ringSize;
+        int index = w->frameIndex++;
+        pthread_mutex_unlock(&w->lock);
+
+        bool ok = write_frame(w, w->ring[slot], index);
+
+        pthread_mutex_lock(&w->lock);
+        if(!ok) w->ok = false;
+        w->queued--;
+        pthread_cond_signal(&w->space);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static void frame_writer_free(FrameWriter *w){
+    if(w->ring){
+        for(int i = 0; i < w->ringSize; i++) free(w->ring[i]);
+    }
+    free(w->ring);
+    free(w->path);
+    free(w->encodeBuffer);
+    free(w);
+}
+
+FrameWriter *frame_writer_open(const char *path, ExportFormat format, int width, int height,
+                               int fps, int ringSize){
+    if(width <= 0 || height <= 0 || ringSize < 1) return NULL;
+    if(format == EXPORT_Y4M && (width % 2 || height % 2)) return NULL;
+
+    FrameWriter *w = calloc(1, sizeof(FrameWriter));
+    if(!w) return NULL;
+    w->format = format;
+    w->width = width;
+    w->height = height;
+    w->ok = true;
+    w->ringSize = ringSize;
+    w->path = strdup(path);
+    w->ring = calloc((size_t)ringSize, sizeof(uint32_t*));
+    if(!w->path || !w->ring){
+        frame_writer_free(w);
+        return NULL;
+    }
+    for(int i = 0; i < ringSize; i++){
+        w->ring[i] = malloc(sizeof(uint32_t) * (size_t)width * (size_t)height);
+        if(!w->ring[i]){
+            frame_writer_free(w);
+            return NULL;
+        }
+    }
+
+    if(format == EXPORT_Y4M){
+        w->video = fopen(path, "wb");
+        if(!w->video || !y4m_write_header(w->video, width, height, fps)){
+            if(w->video) fclose(w->video);
+            frame_writer_free(w);
+            return NULL;
+        }
+    } else if(mkdir(path, 0777) != 0 && errno != EEXIST){
+        frame_writer_free(w);
+        return NULL;
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work, NULL);
+    pthread_cond_init(&w->space, NULL);
+    if(pthread_create(&w->thread, NULL, writer_main, w) != 0){
+        if(w->video) fclose(w->video);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->work);
+        pthread_cond_destroy(&w->space);
+        frame_writer_free(w);
+        return NULL;
+    }
+    return w;
+}
+
+uint32_t *frame_writer_acquire(FrameWriter *w){
+    PROF_SCOPE("export_acquire");
+    pthread_mutex_lock(&w->lock);
+    while(w->queued == w->ringSize) pthread_cond_wait(&w->space, &w->lock);
+    uint32_t *pixels = w->ring[w->head];
+    pthread_mutex_unlock(&w->lock);
+    return pixels;
+}
+
+void frame_writer_submit(FrameWriter *w){
+    pthread_mutex_lock(&w->lock);
+    w->head = (w->head + 1) % w->ringSize;
+    w->queued++;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+}
+
+bool frame_writer_close(FrameWriter *w){
+    if(!w) return false;
+    pthread_mutex_lock(&w->lock);
+    w->closing = true;
+    pthread_cond_signal(&w->work);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    bool ok = w->ok;
+    if(w->video && fclose(w->video) != 0) ok = false;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->work);
+    pthread_cond_destroy(&w->space);
+    frame_writer_free(w);
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef ATLAS_EXPORT_H
+#define ATLAS_EXPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Image-sequence and video export. Rendered frames are read back into a
+// ring of buffers and encoded by a background writer thread, so the render
+// loop only waits when the writer is a whole ring behind.
+
+typedef enum {
+    EXPORT_PNG, // numbered frame_NNNNN.png files in a directory
+    EXPORT_Y4M, // one YUV4MPEG2 stream, 4:2:0, full range
+} ExportFormat;
+
+// EXPORT_Y4M for paths ending in .y4m, EXPORT_PNG otherwise.
+ExportFormat export_format_for_path(const char *path);
+
+typedef struct FrameWriter FrameWriter;
+
+// Creates the output (the directory for PNG) and starts the writer. Y4M
+// needs even dimensions. NULL on failure.
+FrameWriter *frame_writer_open(const char *path, ExportFormat format, int width, int height,
+                               int fps, int ringSize);
+
+// Next free ring buffer: width * height ARGB8888 pixels, rows packed.
+// Blocks while every buffer is queued for writing.
+uint32_t *frame_writer_acquire(FrameWriter *w);
+// Queues the acquired buffer as the next frame.
+void frame_writer_submit(FrameWriter *w);
+// Writes what is queued, stops the thread and closes the output; false if
+// any write failed.
+bool frame_writer_close(FrameWriter *w);
+
+// Encoders, also used directly by tests. The PNG is 8-bit RGB with
+// uncompressed deflate blocks: larger files, but no zlib dependency and no
+// time spent compressing. Y4M frames need even dimensions.
+bool png_write(FILE *f, const uint32_t *argb, int width, int height);
+bool y4m_write_header(FILE *f, int width, int height, int fps);
+bool y4m_write_frame(FILE *f, const uint32_t *argb, int width, int height);
+
+#endif
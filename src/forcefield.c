@@ -0,0 +1,632 @@
+#include "forcefield.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FF_SIMD 1
+#endif
+
+#define LBFGS_HISTORY 8
+
+// Element parameters indexed by atomLabel: 0=C, 1=O, 2=N, 3=Cl, 4=F.
+static const float covalentRadius[5] = { 0.76f, 0.66f, 0.71f, 0.99f, 0.57f };
+static const float vdwRadiusByLabel[5] = { 1.70f, 1.52f, 1.55f, 1.75f, 1.47f };
+static const float vdwWellByLabel[5] = { 0.10f, 0.12f, 0.11f, 0.24f, 0.06f };
+
+static int label_index(uint8_t label){
+    return label < 5 ? label : 0;
+}
+
+static float rest_length(uint8_t a, uint8_t b, int order){
+    float r = covalentRadius[label_index(a)] + covalentRadius[label_index(b)];
+    if(order == 2) r *= 0.87f;
+    if(order >= 3) r *= 0.78f;
+    return r;
+}
+
+static void build_adjacency(const MoleculeGeometry *mol, int neighbours[MAX_ATOMS][8], int degree[MAX_ATOMS], bool sp2[MAX_ATOMS]){
+    memset(degree, 0, sizeof(int) * MAX_ATOMS);
+    memset(sp2, 0, sizeof(bool) * MAX_ATOMS);
+    for(int i = 0; i < mol->bondCount; i++){
+        int a = mol->bonds[i].from;
+        int b = mol->bonds[i].to;
+        if(degree[a] < 8) neighbours[a][degree[a]++] = b;
+        if(degree[b] < 8) neighbours[b][degree[b]++] = a;
+        if(mol->bonds[i].order >= 2){
+            sp2[a] = true;
+            sp2[b] = true;
+        }
+    }
+}
+
+void ff_setup(ForceField *ff, const MoleculeGeometry *mol){
+    memset(ff, 0, sizeof(*ff));
+    ff->atomCount = mol->atomCount;
+    ff->cutoff = 6.0f;
+    ff->skin = 1.0f;
+
+    int neighbours[MAX_ATOMS][8];
+    int degree[MAX_ATOMS];
+    bool sp2[MAX_ATOMS];
+    build_adjacency(mol, neighbours, degree, sp2);
+
+    for(int i = 0; i < mol->bondCount; i++){
+        const Bond *b = &mol->bonds[i];
+        ff->bondA[ff->bondCount] = b->from;
+        ff->bondB[ff->bondCount] = b->to;
+        ff->bondRest[ff->bondCount] = rest_length(mol->atomLabel[b->from], mol->atomLabel[b->to], b->order);
+        ff->bondK[ff->bondCount] = 300.0f;
+        ff->bondCount++;
+
+        ff->excluded[b->from] |= 1ull << b->to;
+        ff->excluded[b->to] |= 1ull << b->from;
+    }
+
+    for(int center = 0; center < mol->atomCount; center++){
+        float rest = sp2[center] ? 2.0944f : 1.9106f; // 120 and 109.5 degrees
+        for(int i = 0; i < degree[center]; i++){
+            for(int j = i + 1; j < degree[center]; j++){
+                if(ff->angleCount >= FF_MAX_ANGLES) break;
+                int a = neighbours[center][i];
+                int c = neighbours[center][j];
+                int n = ff->angleCount++;
+                ff->angleA[n] = a;
+                ff->angleB[n] = center;
+                ff->angleC[n] = c;
+                ff->angleRest[n] = rest;
+                ff->angleK[n] = 60.0f;
+
+                ff->excluded[a] |= 1ull << c;
+                ff->excluded[c] |= 1ull << a;
+            }
+        }
+    }
+
+    for(int i = 0; i < mol->bondCount; i++){
+        int b = mol->bonds[i].from;
+        int c = mol->bonds[i].to;
+        int order = mol->bonds[i].order;
+        bool planar = order >= 2 || (sp2[b] && sp2[c]);
+
+        for(int ia = 0; ia < degree[b]; ia++){
+            int a = neighbours[b][ia];
+            if(a == c) continue;
+            for(int id = 0; id < degree[c]; id++){
+                int d = neighbours[c][id];
+                if(d == b || d == a) continue;
+                if(ff->torsionCount >= FF_MAX_TORSIONS) break;
+
+                int n = ff->torsionCount++;
+                ff->torsionA[n] = a;
+                ff->torsionB[n] = b;
+                ff->torsionC[n] = c;
+                ff->torsionD[n] = d;
+                ff->torsionK[n] = planar ? 2.5f : 0.8f;
+                ff->torsionPeriod[n] = planar ? 2 : 3;
+                ff->torsionSign[n] = planar ? -1.0f : 1.0f;
+            }
+        }
+    }
+
+    for(int i = 0; i < mol->atomCount; i++){
+        int l = label_index(mol->atomLabel[i]);
+        ff->vdwRadius[i] = vdwRadiusByLabel[l];
+        ff->vdwWell[i] = vdwWellByLabel[l];
+    }
+
+}
+
+
+static void build_neighbour_list(ForceField *ff, const float *x){
+    const float *px = x;
+    const float *py = x + FF_STRIDE;
+    const float *pz = x + 2 * FF_STRIDE;
+    int n = ff->atomCount;
+
+    float lo[3] = { px[0], py[0], pz[0] };
+    float hi[3] = { px[0], py[0], pz[0] };
+    for(int i = 1; i < n; i++){
+        if(px[i] < lo[0]) lo[0] = px[i];
+        if(py[i] < lo[1]) lo[1] = py[i];
+        if(pz[i] < lo[2]) lo[2] = pz[i];
+        if(px[i] > hi[0]) hi[0] = px[i];
+        if(py[i] > hi[1]) hi[1] = py[i];
+        if(pz[i] > hi[2]) hi[2] = pz[i];
+    }
+
+    float reach = ff->cutoff + ff->skin;
+    int dims[3];
+    for(int k = 0; k < 3; k++){
+        dims[k] = (int)((hi[k] - lo[k]) / reach) + 1;
+        if(dims[k] > 16) dims[k] = 16;
+    }
+
+    int head[16 * 16 * 16];
+    int next[MAX_ATOMS];
+    int cellOf[MAX_ATOMS][3];
+    int cellCount = dims[0] * dims[1] * dims[2];
+    for(int c = 0; c < cellCount; c++) head[c] = -1;
+
+    for(int i = 0; i < n; i++){
+        int cx = (int)((px[i] - lo[0]) / reach);
+        int cy = (int)((py[i] - lo[1]) / reach);
+        int cz = (int)((pz[i] - lo[2]) / reach);
+        if(cx >= dims[0]) cx = dims[0] - 1;
+        if(cy >= dims[1]) cy = dims[1] - 1;
+        if(cz >= dims[2]) cz = dims[2] - 1;
+        cellOf[i][0] = cx;
+        cellOf[i][1] = cy;
+        cellOf[i][2] = cz;
+        int c = (cz * dims[1] + cy) * dims[0] + cx;
+        next[i] = head[c];
+        head[c] = i;
+    }
+
+    float reach2 = reach * reach;
+    ff->pairCount = 0;
+    for(int i = 0; i < n; i++){
+        for(int dz = -1; dz <= 1; dz++){
+            int cz = cellOf[i][2] + dz;
+            if(cz < 0 || cz >= dims[2]) continue;
+            for(int dy = -1; dy <= 1; dy++){
+                int cy = cellOf[i][1] + dy;
+                if(cy < 0 || cy >= dims[1]) continue;
+                for(int dx = -1; dx <= 1; dx++){
+                    int cx = cellOf[i][0] + dx;
+                    if(cx < 0 || cx >= dims[0]) continue;
+
+                    for(int j = head[(cz * dims[1] + cy) * dims[0] + cx]; j >= 0; j = next[j]){
+                        if(j <= i) continue;
+                        if(ff->excluded[i] & (1ull << j)) continue;
+
+                        float ex = px[j] - px[i];
+                        float ey = py[j] - py[i];
+                        float ez = pz[j] - pz[i];
+                        if(ex*ex + ey*ey + ez*ez > reach2) continue;
+
+                        int p = ff->pairCount++;
+                        float rmin = ff->vdwRadius[i] + ff->vdwRadius[j];
+                        ff->pairI[p] = i;
+                        ff->pairJ[p] = j;
+                        ff->pairRmin2[p] = rmin * rmin;
+                        ff->pairWell[p] = sqrtf(ff->vdwWell[i] * ff->vdwWell[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    memcpy(ff->listRef, x, sizeof(ff->listRef));
+    ff->listValid = true;
+}
+
+static void refresh_neighbour_list(ForceField *ff, const float *x){
+    if(ff->listValid){
+        float limit = 0.25f * ff->skin * ff->skin;
+        bool stale = false;
+        for(int i = 0; i < ff->atomCount && !stale; i++){
+            float dx = x[i] - ff->listRef[i];
+            float dy = x[FF_STRIDE + i] - ff->listRef[FF_STRIDE + i];
+            float dz = x[2*FF_STRIDE + i] - ff->listRef[2*FF_STRIDE + i];
+            stale = dx*dx + dy*dy + dz*dz > limit;
+        }
+        if(!stale) return;
+    }
+    build_neighbour_list(ff, x);
+}
+
+
+// Harmonic stretch over gathered separation vectors. Writes (dE/dr)/r per
+// term into coef and returns the summed energy.
+static float stretch_kernel(const float *dx, const float *dy, const float *dz,
+                            const float *rest, const float *k, float *coef, int n){
+    int i = 0;
+    float energy = 0.0f;
+#if FF_SIMD
+    __m128 acc = _mm_setzero_ps();
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 tiny = _mm_set1_ps(1e-6f);
+    for(; i + 4 <= n; i += 4){
+        __m128 x = _mm_loadu_ps(dx + i);
+        __m128 y = _mm_loadu_ps(dy + i);
+        __m128 z = _mm_loadu_ps(dz + i);
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 r = _mm_max_ps(_mm_sqrt_ps(r2), tiny);
+        __m128 stretch = _mm_sub_ps(r, _mm_loadu_ps(rest + i));
+        __m128 kk = _mm_loadu_ps(k + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(kk, _mm_mul_ps(stretch, stretch)));
+        _mm_storeu_ps(coef + i, _mm_div_ps(_mm_mul_ps(two, _mm_mul_ps(kk, stretch)), r));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    energy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i < n; i++){
+        float r = sqrtf(dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i]);
+        if(r < 1e-6f) r = 1e-6f;
+        float stretch = r - rest[i];
+        energy += k[i] * stretch * stretch;
+        coef[i] = 2.0f * k[i] * stretch / r;
+    }
+    return energy;
+}
+
+// Lennard-Jones 12-6 in r_min form, eps * ((rmin/r)^12 - 2 (rmin/r)^6).
+// Works on r^2 only, so there is no square root in the inner loop.
+static float lennard_jones_kernel(const float *dx, const float *dy, const float *dz,
+                                  const float *rmin2, const float *well, float cutoff2,
+                                  float *coef, int n){
+    int i = 0;
+    float energy = 0.0f;
+#if FF_SIMD
+    __m128 acc = _mm_setzero_ps();
+    __m128 twelve = _mm_set1_ps(12.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 tiny = _mm_set1_ps(1e-4f);
+    __m128 cut = _mm_set1_ps(cutoff2);
+    for(; i + 4 <= n; i += 4){
+        __m128 x = _mm_loadu_ps(dx + i);
+        __m128 y = _mm_loadu_ps(dy + i);
+        __m128 z = _mm_loadu_ps(dz + i);
+        __m128 r2 = _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), tiny);
+        __m128 inside = _mm_cmple_ps(r2, cut);
+        __m128 s2 = _mm_div_ps(_mm_loadu_ps(rmin2 + i), r2);
+        __m128 s6 = _mm_mul_ps(s2, _mm_mul_ps(s2, s2));
+        __m128 s12 = _mm_mul_ps(s6, s6);
+        __m128 eps = _mm_and_ps(_mm_loadu_ps(well + i), inside);
+        acc = _mm_add_ps(acc, _mm_mul_ps(eps, _mm_sub_ps(s12, _mm_mul_ps(two, s6))));
+        __m128 g = _mm_mul_ps(_mm_mul_ps(twelve, eps), _mm_sub_ps(s6, s12));
+        _mm_storeu_ps(coef + i, _mm_div_ps(g, r2));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    energy = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for(; i < n; i++){
+        float r2 = dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i];
+        if(r2 < 1e-4f) r2 = 1e-4f;
+        if(r2 > cutoff2){
+            coef[i] = 0.0f;
+            continue;
+        }
+        float s2 = rmin2[i] / r2;
+        float s6 = s2 * s2 * s2;
+        float s12 = s6 * s6;
+        energy += well[i] * (s12 - 2.0f * s6);
+        coef[i] = 12.0f * well[i] * (s6 - s12) / r2;
+    }
+    return energy;
+}
+
+static float pair_terms(const float *x, float *grad, const int *ia, const int *ib, int n,
+                        const float *p0, const float *p1, float cutoff2, bool stretch){
+    const float *px = x;
+    const float *py = x + FF_STRIDE;
+    const float *pz = x + 2 * FF_STRIDE;
+
+    float dx[FF_MAX_PAIRS], dy[FF_MAX_PAIRS], dz[FF_MAX_PAIRS], coef[FF_MAX_PAIRS];
+    for(int i = 0; i < n; i++){
+        dx[i] = px[ib[i]] - px[ia[i]];
+        dy[i] = py[ib[i]] - py[ia[i]];
+        dz[i] = pz[ib[i]] - pz[ia[i]];
+    }
+
+    float energy = stretch ? stretch_kernel(dx, dy, dz, p0, p1, coef, n)
+                           : lennard_jones_kernel(dx, dy, dz, p0, p1, cutoff2, coef, n);
+
+    if(grad){
+        for(int i = 0; i < n; i++){
+            float gx = coef[i] * dx[i];
+            float gy = coef[i] * dy[i];
+            float gz = coef[i] * dz[i];
+            grad[ib[i]] += gx;
+            grad[FF_STRIDE + ib[i]] += gy;
+            grad[2*FF_STRIDE + ib[i]] += gz;
+            grad[ia[i]] -= gx;
+            grad[FF_STRIDE + ia[i]] -= gy;
+            grad[2*FF_STRIDE + ia[i]] -= gz;
+        }
+    }
+    return energy;
+}
+
+static inline Vec3 load_atom(const float *x, int i){
+    return make_vec3(x[i], x[FF_STRIDE + i], x[2*FF_STRIDE + i]);
+}
+
+static inline void add_grad(float *grad, int i, Vec3 g, float s){
+    grad[i] += g.x * s;
+    grad[FF_STRIDE + i] += g.y * s;
+    grad[2*FF_STRIDE + i] += g.z * s;
+}
+
+static inline Vec3 v_sub(Vec3 a, Vec3 b){ return make_vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline Vec3 v_add(Vec3 a, Vec3 b){ return make_vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline float v_dot(Vec3 a, Vec3 b){ return a.x*b.x + a.y*b.y + a.z*b.z; }
+static inline Vec3 v_cross(Vec3 a, Vec3 b){
+    return make_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+static inline Vec3 v_scale(Vec3 a, float s){ return make_vec3(a.x*s, a.y*s, a.z*s); }
+
+static float angle_terms(const ForceField *ff, const float *x, float *grad){
+    float energy = 0.0f;
+    for(int i = 0; i < ff->angleCount; i++){
+        Vec3 b = load_atom(x, ff->angleB[i]);
+        Vec3 u = v_sub(load_atom(x, ff->angleA[i]), b);
+        Vec3 v = v_sub(load_atom(x, ff->angleC[i]), b);
+
+        float lu = sqrtf(v_dot(u, u));
+        float lv = sqrtf(v_dot(v, v));
+        if(lu < 1e-6f || lv < 1e-6f) continue;
+
+        float c = v_dot(u, v) / (lu * lv);
+        if(c > 0.999999f) c = 0.999999f;
+        if(c < -0.999999f) c = -0.999999f;
+        float theta = acosf(c);
+        float delta = theta - ff->angleRest[i];
+        energy += ff->angleK[i] * delta * delta;
+
+        if(!grad) continue;
+
+        // dE/dtheta * dtheta/dcos, with dtheta/dcos = -1/sin(theta).
+        float s = sqrtf(1.0f - c*c);
+        float dEdc = -2.0f * ff->angleK[i] * delta / s;
+
+        Vec3 dcdu = v_scale(v_sub(v_scale(v, 1.0f / (lu * lv)), v_scale(u, c / (lu * lu))), dEdc);
+        Vec3 dcdv = v_scale(v_sub(v_scale(u, 1.0f / (lu * lv)), v_scale(v, c / (lv * lv))), dEdc);
+
+        add_grad(grad, ff->angleA[i], dcdu, 1.0f);
+        add_grad(grad, ff->angleC[i], dcdv, 1.0f);
+        add_grad(grad, ff->angleB[i], dcdu, -1.0f);
+        add_grad(grad, ff->angleB[i], dcdv, -1.0f);
+    }
+    return energy;
+}
+
+static float torsion_terms(const ForceField *ff, const float *x, float *grad){
+    float energy = 0.0f;
+    for(int i = 0; i < ff->torsionCount; i++){
+        Vec3 pa = load_atom(x, ff->torsionA[i]);
+        Vec3 pb = load_atom(x, ff->torsionB[i]);
+        Vec3 pc = load_atom(x, ff->torsionC[i]);
+        Vec3 pd = load_atom(x, ff->torsionD[i]);
+
+        Vec3 b1 = v_sub(pb, pa);
+        Vec3 b2 = v_sub(pc, pb);
+        Vec3 b3 = v_sub(pd, pc);
+        Vec3 m = v_cross(b1, b2);
+        Vec3 n = v_cross(b2, b3);
+
+        float m2 = v_dot(m, m);
+        float n2 = v_dot(n, n);
+        float lb2 = sqrtf(v_dot(b2, b2));
+        if(m2 < 1e-8f || n2 < 1e-8f || lb2 < 1e-6f) continue;
+
+        float phi = atan2f(lb2 * v_dot(b1, n), v_dot(m, n));
+        int period = ff->torsionPeriod[i];
+        float k = ff->torsionK[i];
+        float sign = ff->torsionSign[i];
+        energy += k * (1.0f + sign * cosf(period * phi));
+
+        if(!grad) continue;
+
+        float dEdphi = -k * sign * period * sinf(period * phi);
+
+        Vec3 ga = v_scale(m, -lb2 / m2);
+        Vec3 gd = v_scale(n, lb2 / n2);
+        float f1 = v_dot(b1, b2) / (lb2 * lb2);
+        float f3 = v_dot(b3, b2) / (lb2 * lb2);
+        Vec3 gb = v_add(v_scale(ga, -1.0f - f1), v_scale(gd, f3));
+        Vec3 gc = v_add(v_scale(gd, -1.0f - f3), v_scale(ga, f1));
+
+        add_grad(grad, ff->torsionA[i], ga, dEdphi);
+        add_grad(grad, ff->torsionB[i], gb, dEdphi);
+        add_grad(grad, ff->torsionC[i], gc, dEdphi);
+        add_grad(grad, ff->torsionD[i], gd, dEdphi);
+    }
+    return energy;
+}
+
+double ff_energy_gradient(ForceField *ff, const float *x, float *grad){
+    if(grad) memset(grad, 0, sizeof(float) * FF_DIM);
+    refresh_neighbour_list(ff, x);
+
+    double energy = 0.0;
+    energy += pair_terms(x, grad, ff->bondA, ff->bondB, ff->bondCount,
+                         ff->bondRest, ff->bondK, 0.0f, true);
+    energy += angle_terms(ff, x, grad);
+    energy += torsion_terms(ff, x, grad);
+    energy += pair_terms(x, grad, ff->pairI, ff->pairJ, ff->pairCount,
+                         ff->pairRmin2, ff->pairWell, ff->cutoff * ff->cutoff, false);
+    return energy;
+}
+
+
+static double dot_n(const double *a, const double *b, int n){
+    double s = 0.0;
+    for(int i = 0; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+// Evaluates at the packed double vector by scattering it into the SoA layout.
+static double evaluate_packed(ForceField *ff, const double *v, double *g, float *xs, float *gs){
+    int n = ff->atomCount;
+    for(int k = 0; k < 3; k++){
+        for(int i = 0; i < n; i++) xs[k*FF_STRIDE + i] = (float)v[k*n + i];
+    }
+    double e = ff_energy_gradient(ff, xs, gs);
+    for(int k = 0; k < 3; k++){
+        for(int i = 0; i < n; i++) g[k*n + i] = gs[k*FF_STRIDE + i];
+    }
+    return e;
+}
+
+FfResult ff_minimize(ForceField *ff, float *x, int maxIterations, float gradientTolerance){
+    FfResult result = {0.0, 0, false};
+    int n = ff->atomCount;
+    int dim = 3 * n;
+    if(n == 0) return result;
+
+    double v[FF_DIM], g[FF_DIM], d[FF_DIM], vNew[FF_DIM], gNew[FF_DIM];
+    double s[LBFGS_HISTORY][FF_DIM], y[LBFGS_HISTORY][FF_DIM];
+    double rho[LBFGS_HISTORY], alpha[LBFGS_HISTORY];
+    float xs[FF_DIM] = {0}, gs[FF_DIM];
+    int stored = 0, head = 0;
+
+    for(int k = 0; k < 3; k++){
+        for(int i = 0; i < n; i++) v[k*n + i] = x[k*FF_STRIDE + i];
+    }
+    ff->listValid = false;
+    double energy = evaluate_packed(ff, v, g, xs, gs);
+
+    int iter = 0;
+    for(; iter < maxIterations; iter++){
+        double gmax = 0.0;
+        for(int i = 0; i < dim; i++) if(fabs(g[i]) > gmax) gmax = fabs(g[i]);
+        if(gmax < gradientTolerance){
+            result.converged = true;
+            break;
+        }
+
+        // Two-loop recursion for d = -H g.
+        for(int i = 0; i < dim; i++) d[i] = -g[i];
+        for(int k = 0; k < stored; k++){
+            int slot = (head - 1 - k + LBFGS_HISTORY) % LBFGS_HISTORY;
+            alpha[slot] = rho[slot] * dot_n(s[slot], d, dim);
+            for(int i = 0; i < dim; i++) d[i] -= alpha[slot] * y[slot][i];
+        }
+        if(stored > 0){
+            int last = (head - 1 + LBFGS_HISTORY) % LBFGS_HISTORY;
+            double gamma = dot_n(s[last], y[last], dim) / dot_n(y[last], y[last], dim);
+            for(int i = 0; i < dim; i++) d[i] *= gamma;
+        } else {
+            // First step: cap the move so a huge initial gradient cannot
+            // throw atoms across the molecule.
+            double scale = 0.1 / (gmax > 1e-12 ? gmax : 1.0);
+            for(int i = 0; i < dim; i++) d[i] *= scale;
+        }
+        for(int k = stored - 1; k >= 0; k--){
+            int slot = (head - 1 - k + LBFGS_HISTORY) % LBFGS_HISTORY;
+            double beta = rho[slot] * dot_n(y[slot], d, dim);
+            for(int i = 0; i < dim; i++) d[i] += s[slot][i] * (alpha[slot] - beta);
+        }
+
+        double slope = dot_n(g, d, dim);
+        if(slope >= 0.0){
+            // Not a descent direction; fall back to steepest descent.
+            stored = 0;
+            double scale = 0.1 / (gmax > 1e-12 ? gmax : 1.0);
+            for(int i = 0; i < dim; i++) d[i] = -g[i] * scale;
+            slope = dot_n(g, d, dim);
+        }
+
+        // Backtracking line search with the Armijo condition.
+        double step = 1.0;
+        double eNew = energy;
+        bool accepted = false;
+        for(int tries = 0; tries < 30; tries++){
+            for(int i = 0; i < dim; i++) vNew[i] = v[i] + step * d[i];
+            eNew = evaluate_packed(ff, vNew, gNew, xs, gs);
+            if(eNew <= energy + 1e-4 * step * slope){
+                accepted = true;
+                break;
+            }
+            step *= 0.5;
+        }
+        if(!accepted) break;
+
+        double sy = 0.0, yy = 0.0;
+        for(int i = 0; i < dim; i++){
+            s[head][i] = vNew[i] - v[i];
+            y[head][i] = gNew[i] - g[i];
+            sy += s[head][i] * y[head][i];
+            yy += y[head][i] * y[head][i];
+        }
+        if(sy > 1e-10 * yy){
+            rho[head] = 1.0 / sy;
+            head = (head + 1) % LBFGS_HISTORY;
+            if(stored < LBFGS_HISTORY) stored++;
+        }
+
+        memcpy(v, vNew, sizeof(double) * dim);
+        memcpy(g, gNew, sizeof(double) * dim);
+        bool flat = fabs(energy - eNew) < 1e-9 * (1.0 + fabs(energy));
+        energy = eNew;
+        if(flat){
+            result.converged = true;
+            iter++;
+            break;
+        }
+    }
+
+    for(int k = 0; k < 3; k++){
+        for(int i = 0; i < n; i++) x[k*FF_STRIDE + i] = (float)v[k*n + i];
+    }
+    result.energy = energy;
+    result.iterations = iter;
+    return result;
+}
+
+
+// Deterministic small offset per atom: a perfectly flat ring sits on a
+// saddle point where the out-of-plane gradient is exactly zero.
+static float jitter(int i, int axis){
+    uint32_t h = (uint32_t)(i * 73856093) ^ (uint32_t)(axis * 19349663);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return ((float)(h & 0xFFFF) / 65535.0f - 0.5f) * 0.1f;
+}
+
+FfResult ff_relax_molecule(MoleculeGeometry *mol){
+    FfResult result = {0.0, 0, false};
+    if(mol->atomCount == 0) return result;
+
+    ForceField *ff = malloc(sizeof(ForceField));
+    if(!ff) return result;
+    ff_setup(ff, mol);
+
+    float x[FF_DIM] = {0};
+    Vec3 centroid = make_vec3(0.0f, 0.0f, 0.0f);
+    for(int i = 0; i < mol->atomCount; i++){
+        Vec3 p = mol->atomPos[i];
+        centroid.x += p.x;
+        centroid.y += p.y;
+        centroid.z += p.z;
+        x[i] = p.x + jitter(i, 0);
+        x[FF_STRIDE + i] = p.y + jitter(i, 1);
+        x[2*FF_STRIDE + i] = p.z + jitter(i, 2);
+    }
+
+    result = ff_minimize(ff, x, 2000, 1e-3f);
+
+    Vec3 relaxed = make_vec3(0.0f, 0.0f, 0.0f);
+    for(int i = 0; i < mol->atomCount; i++){
+        relaxed.x += x[i];
+        relaxed.y += x[FF_STRIDE + i];
+        relaxed.z += x[2*FF_STRIDE + i];
+    }
+    float inv = 1.0f / (float)mol->atomCount;
+    float shiftX = (centroid.x - relaxed.x) * inv;
+    float shiftY = (centroid.y - relaxed.y) * inv;
+    float shiftZ = (centroid.z - relaxed.z) * inv;
+    for(int i = 0; i < mol->atomCount; i++){
+        mol->atomPos[i] = make_vec3(x[i] + shiftX, x[FF_STRIDE + i] + shiftY, x[2*FF_STRIDE + i] + shiftZ);
+    }
+
+    free(ff);
+    return result;
+}
+
+static void relax_range(void *ctx, int begin, int end){
+    MoleculeGeometry *mols = ctx;
+    for(int i = begin; i < end; i++) ff_relax_molecule(&mols[i]);
+}
+
+void ff_relax_library(MoleculeGeometry *mols, int count){
+    parallel_for(count, 1, relax_range, mols);
+}
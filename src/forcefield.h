@@ -0,0 +1,74 @@
+#ifndef ATLAS_FORCEFIELD_H
+#define ATLAS_FORCEFIELD_H
+
+#include <stdbool.h>
+
+#include "molecule.h"
+
+#define FF_MAX_ANGLES (MAX_ATOMS * 6)
+#define FF_MAX_TORSIONS (MAX_BONDS * 9)
+#define FF_MAX_PAIRS (MAX_ATOMS * (MAX_ATOMS - 1) / 2)
+
+// Bump whenever a change to the terms, parameters or minimiser moves the
+// relaxed geometries; stores of relaxed compounds are stamped with it.
+#define FF_RELAX_VERSION 1
+
+// Coordinates are stored structure-of-arrays in one flat vector:
+// x[0..N) then y[0..N) then z[0..N), with N = MAX_ATOMS slots per axis.
+#define FF_STRIDE MAX_ATOMS
+#define FF_DIM (3 * FF_STRIDE)
+
+typedef struct {
+    int atomCount;
+
+    int bondCount;
+    int bondA[MAX_BONDS], bondB[MAX_BONDS];
+    float bondRest[MAX_BONDS], bondK[MAX_BONDS];
+
+    int angleCount;
+    int angleA[FF_MAX_ANGLES], angleB[FF_MAX_ANGLES], angleC[FF_MAX_ANGLES];
+    float angleRest[FF_MAX_ANGLES], angleK[FF_MAX_ANGLES];
+
+    int torsionCount;
+    int torsionA[FF_MAX_TORSIONS], torsionB[FF_MAX_TORSIONS];
+    int torsionC[FF_MAX_TORSIONS], torsionD[FF_MAX_TORSIONS];
+    float torsionK[FF_MAX_TORSIONS];
+    int torsionPeriod[FF_MAX_TORSIONS];
+    float torsionSign[FF_MAX_TORSIONS]; // +1: minima staggered, -1: minima eclipsed
+
+    uint64_t excluded[MAX_ATOMS]; // 1-2 and 1-3 partners, skipped by van der Waals
+    float vdwRadius[MAX_ATOMS];
+    float vdwWell[MAX_ATOMS];
+
+    // Verlet neighbour list built from a cell grid, refreshed once any atom
+    // moves more than half the skin since the last build.
+    float cutoff;
+    float skin;
+    int pairCount;
+    int pairI[FF_MAX_PAIRS], pairJ[FF_MAX_PAIRS];
+    float pairRmin2[FF_MAX_PAIRS], pairWell[FF_MAX_PAIRS];
+    float listRef[FF_DIM];
+    bool listValid;
+} ForceField;
+
+typedef struct {
+    double energy;
+    int iterations;
+    bool converged;
+} FfResult;
+
+void ff_setup(ForceField *ff, const MoleculeGeometry *mol);
+
+// Total energy at x; writes dE/dx into grad when it is non-NULL.
+double ff_energy_gradient(ForceField *ff, const float *x, float *grad);
+
+// L-BFGS minimisation of x in place.
+FfResult ff_minimize(ForceField *ff, float *x, int maxIterations, float gradientTolerance);
+
+// Relaxes one molecule, keeping its centroid where it was.
+FfResult ff_relax_molecule(MoleculeGeometry *mol);
+
+// Relaxes every molecule in mols across the worker pool.
+void ff_relax_library(MoleculeGeometry *mols, int count);
+
+#endif
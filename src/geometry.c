@@ -0,0 +1,44 @@
+#include "geometry.h"
+
+#include <math.h>
+
+float clampf(float v, float lo, float hi){
+    if(v < lo) return lo;
+    if(v > hi) return hi;
+    return v;
+}
+
+Vec3 rotate_cos_sin(Vec3 p, float cy, float sy, float cp, float sp){
+    float x1 =  cy * p.x + sy * p.z;
+    float z1 = -sy * p.x + cy * p.z;
+
+    float y2 =  cp * p.y - sp * z1;
+    float z2 =  sp * p.y + cp * z1;
+
+    return make_vec3(x1, y2, z2);
+}
+
+Vec3 rotate_yaw_pitch(Vec3 p, float yaw, float pitch){
+    return rotate_cos_sin(p, cosf(yaw), sinf(yaw), cosf(pitch), sinf(pitch));
+}
+
+void project_to_screen(Vec3 p, float zoom, int centerX, int centerY, int *outX, int *outY, float *outDepth){
+    float perspective = PERSPECTIVE_DISTANCE / (PERSPECTIVE_DISTANCE + p.z);
+    *outX = (int)lroundf(centerX + p.x * zoom * perspective);
+    *outY = (int)lroundf(centerY - p.y * zoom * perspective);
+    *outDepth = p.z;
+}
+
+float compute_bounding_radius(const MoleculeGeometry *mol){
+    float maxR2 = 0.0f;
+    for(int i = 0; i < mol->atomCount; i++){
+        float x = mol->atomPos[i].x;
+        float y = mol->atomPos[i].y;
+        float z = mol->atomPos[i].z;
+        float r2 = x*x + y*y + z*z;
+        if(r2 > maxR2) maxR2 = r2;
+    }
+    float r = sqrtf(maxR2);
+    if(r < 0.001f) r = 1.0f;
+    return r;
+}
@@ -0,0 +1,22 @@
+#ifndef ATLAS_GEOMETRY_H
+#define ATLAS_GEOMETRY_H
+
+#include "molecule.h"
+
+float clampf(float v, float lo, float hi);
+
+// Yaw about y, then pitch about x, with the sines and cosines precomputed.
+Vec3 rotate_cos_sin(Vec3 p, float cy, float sy, float cp, float sp);
+Vec3 rotate_yaw_pitch(Vec3 p, float yaw, float pitch);
+
+// Distance of the perspective centre from the origin, in angstroms: a view
+// space point p lands at p.xy * zoom * D / (D + p.z) from the centre.
+#define PERSPECTIVE_DISTANCE 900.0f
+
+// Perspective projection into a tile centred on (centerX, centerY).
+void project_to_screen(Vec3 p, float zoom, int centerX, int centerY, int *outX, int *outY, float *outDepth);
+
+// Distance of the farthest atom from the origin, used to fit a tile.
+float compute_bounding_radius(const MoleculeGeometry *mol);
+
+#endif
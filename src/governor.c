@@ -0,0 +1,62 @@
+#include "governor.h"
+
+#define SMOOTHING 0.1f
+#define DEGRADE_ABOVE 1.10f // of the target
+#define RESTORE_BELOW 0.60f
+#define HOLD_AFTER_DEGRADE 20
+#define HOLD_AFTER_RESTORE 90 // recovering slowly keeps it from oscillating
+
+static const TileQuality levels[GOVERNOR_LEVELS] = {
+    { 1.00f, 1.00f, true,  true,  false },
+    { 1.00f, 1.00f, false, false, false },
+    { 0.75f, 0.75f, false, false, false },
+    { 0.50f, 0.50f, false, false, false },
+    { 0.35f, 0.35f, false, false, false },
+};
+
+void governor_init(QualityGovernor *gov, float targetMs){
+    gov->targetMs = targetMs > 0.0f ? targetMs : 16.7f;
+    gov->smoothedMs = 0.0f;
+    gov->level = 0;
+    gov->holdFrames = HOLD_AFTER_DEGRADE;
+    gov->enabled = true;
+}
+
+bool governor_frame(QualityGovernor *gov, float frameMs){
+    if(!gov->enabled) return false;
+
+    if(gov->smoothedMs <= 0.0f) gov->smoothedMs = frameMs;
+    else gov->smoothedMs += (frameMs - gov->smoothedMs) * SMOOTHING;
+
+    if(gov->holdFrames > 0){
+        gov->holdFrames--;
+        return false;
+    }
+
+    if(gov->smoothedMs > gov->targetMs * DEGRADE_ABOVE && gov->level < GOVERNOR_LEVELS - 1){
+        gov->level++;
+        gov->holdFrames = HOLD_AFTER_DEGRADE;
+        return true;
+    }
+    if(gov->smoothedMs < gov->targetMs * RESTORE_BELOW && gov->level > 0){
+        gov->level--;
+        gov->holdFrames = HOLD_AFTER_RESTORE;
+        return true;
+    }
+    return false;
+}
+
+void governor_set_enabled(QualityGovernor *gov, bool enabled){
+    gov->enabled = enabled;
+    if(!enabled){
+        gov->level = 0;
+        gov->smoothedMs = 0.0f;
+    }
+    gov->holdFrames = HOLD_AFTER_DEGRADE;
+}
+
+TileQuality governor_tile_quality(const QualityGovernor *gov, bool selected, float dpiScale){
+    TileQuality q = levels[selected ? 0 : gov->level];
+    q.scale *= dpiScale;
+    return q;
+}
@@ -0,0 +1,29 @@
+#ifndef ATLAS_GOVERNOR_H
+#define ATLAS_GOVERNOR_H
+
+#include <stdbool.h>
+
+#include "render.h"
+
+// Holds frame time near a budget by trading detail on the tiles that are
+// not selected: first highlights and labels go, then those tiles are drawn
+// at a lower resolution and stretched. Level 0 is full quality.
+#define GOVERNOR_LEVELS 5
+
+typedef struct {
+    float targetMs;
+    float smoothedMs; // exponential moving average of frame time
+    int level;
+    int holdFrames;   // frames left before the level may change again
+    bool enabled;
+} QualityGovernor;
+
+void governor_init(QualityGovernor *gov, float targetMs);
+// Feeds one frame's CPU time. Returns true if the level changed.
+bool governor_frame(QualityGovernor *gov, float frameMs);
+void governor_set_enabled(QualityGovernor *gov, bool enabled);
+
+// Quality for one tile; the selected one always gets full detail.
+TileQuality governor_tile_quality(const QualityGovernor *gov, bool selected, float dpiScale);
+
+#endif
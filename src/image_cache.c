@@ -0,0 +1,164 @@
+#include "image_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Keys are compared field by field so padding never matters; -0.0 and 0.0
+// hash apart, which only costs a duplicate entry.
+static bool key_equal(const RenderKey *a, const RenderKey *b){
+    return a->compound == b->compound && a->width == b->width && a->height == b->height &&
+           a->mode == b->mode && a->yaw == b->yaw && a->pitch == b->pitch && a->zoom == b->zoom;
+}
+
+static uint64_t hash_mix(uint64_t h, uint32_t v){
+    h ^= v;
+    return h * 0x100000001B3ull;
+}
+
+static uint64_t key_hash(const RenderKey *k){
+    uint32_t bits[3];
+    memcpy(&bits[0], &k->yaw, 4);
+    memcpy(&bits[1], &k->pitch, 4);
+    memcpy(&bits[2], &k->zoom, 4);
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = hash_mix(h, (uint32_t)k->compound);
+    h = hash_mix(h, (uint32_t)k->width);
+    h = hash_mix(h, (uint32_t)k->height);
+    h = hash_mix(h, (uint32_t)k->mode);
+    for(int i = 0; i < 3; i++) h = hash_mix(h, bits[i]);
+    return h ^ (h >> 29);
+}
+
+void image_cache_init(ImageCache *cache, size_t maxBytes){
+    memset(cache, 0, sizeof(*cache));
+    cache->maxBytes = maxBytes;
+}
+
+void image_cache_free(ImageCache *cache){
+    CachedImage *e = cache->newest;
+    while(e){
+        CachedImage *next = e->older;
+        free(e->data);
+        free(e);
+        e = next;
+    }
+    free(cache->buckets);
+    image_cache_init(cache, cache->maxBytes);
+}
+
+static CachedImage **bucket_of(ImageCache *cache, uint64_t hash){
+    return &cache->buckets[hash & (cache->bucketCount - 1)];
+}
+
+static void lru_unlink(ImageCache *cache, CachedImage *e){
+    if(e->newer) e->newer->older = e->older;
+    else cache->newest = e->older;
+    if(e->older) e->older->newer = e->newer;
+    else cache->oldest = e->newer;
+    e->newer = e->older = NULL;
+}
+
+static void lru_push_newest(ImageCache *cache, CachedImage *e){
+    e->newer = NULL;
+    e->older = cache->newest;
+    if(cache->newest) cache->newest->newer = e;
+    cache->newest = e;
+    if(!cache->oldest) cache->oldest = e;
+}
+
+static void remove_entry(ImageCache *cache, CachedImage *e){
+    CachedImage **link = bucket_of(cache, e->hash);
+    while(*link != e) link = &(*link)->hashNext;
+    *link = e->hashNext;
+    lru_unlink(cache, e);
+    cache->bytes -= e->size;
+    cache->count--;
+    free(e->data);
+    free(e);
+}
+
+static bool grow_buckets(ImageCache *cache){
+    size_t count = cache->bucketCount ? cache->bucketCount * 2 : 64;
+    CachedImage **buckets = calloc(count, sizeof(CachedImage*));
+    if(!buckets) return false;
+    for(CachedImage *e = cache->newest; e; e = e->older){
+        CachedImage **b = &buckets[e->hash & (count - 1)];
+        e->hashNext = *b;
+        *b = e;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucketCount = count;
+    return true;
+}
+
+static CachedImage *find(ImageCache *cache, const RenderKey *key, uint64_t hash){
+    if(!cache->bucketCount) return NULL;
+    for(CachedImage *e = *bucket_of(cache, hash); e; e = e->hashNext){
+        if(e->hash == hash && key_equal(&e->key, key)) return e;
+    }
+    return NULL;
+}
+
+const CachedImage *image_cache_get(ImageCache *cache, const RenderKey *key){
+    CachedImage *e = find(cache, key, key_hash(key));
+    if(!e){
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    if(cache->newest != e){
+        lru_unlink(cache, e);
+        lru_push_newest(cache, e);
+    }
+    return e;
+}
+
+bool image_cache_put(ImageCache *cache, const RenderKey *key, uint8_t *data, size_t size){
+    uint64_t hash = key_hash(key);
+    CachedImage *old = find(cache, key, hash);
+    if(old) remove_entry(cache, old);
+    if(size > cache->maxBytes){
+        free(data);
+        return false;
+    }
+    if(cache->count >= cache->bucketCount && !grow_buckets(cache)){
+        free(data);
+        return false;
+    }
+    CachedImage *e = malloc(sizeof(*e));
+    if(!e){
+        free(data);
+        return false;
+    }
+    e->key = *key;
+    e->hash = hash;
+    e->data = data;
+    e->size = size;
+    CachedImage **b = bucket_of(cache, hash);
+    e->hashNext = *b;
+    *b = e;
+    lru_push_newest(cache, e);
+    cache->bytes += size;
+    cache->count++;
+
+    while(cache->bytes > cache->maxBytes && cache->oldest != e){
+        remove_entry(cache, cache->oldest);
+        cache->evictions++;
+    }
+    return true;
+}
+
+size_t image_cache_drop_compounds(ImageCache *cache, int first, int count){
+    size_t dropped = 0;
+    CachedImage *e = cache->newest;
+    while(e){
+        CachedImage *next = e->older;
+        if(e->key.compound >= first && e->key.compound - first < count){
+            remove_entry(cache, e);
+            dropped++;
+        }
+        e = next;
+    }
+    return dropped;
+}
@@ -0,0 +1,52 @@
+#ifndef ATLAS_IMAGE_CACHE_H
+#define ATLAS_IMAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Rendered images keyed by everything that went into them, evicted least
+// recently used first once their total size passes a byte budget.
+
+typedef struct {
+    int32_t compound;
+    int32_t width, height;
+    int32_t mode;
+    float yaw, pitch, zoom;
+} RenderKey;
+
+typedef struct CachedImage {
+    RenderKey key;
+    uint64_t hash;
+    uint8_t *data;
+    size_t size;
+    struct CachedImage *hashNext;
+    struct CachedImage *newer, *older;
+} CachedImage;
+
+typedef struct {
+    CachedImage **buckets;
+    size_t bucketCount; // power of two
+    CachedImage *newest, *oldest;
+    size_t count;
+    size_t bytes, maxBytes;
+    uint64_t hits, misses, evictions;
+} ImageCache;
+
+void image_cache_init(ImageCache *cache, size_t maxBytes);
+void image_cache_free(ImageCache *cache);
+
+// The cached image for key, made most recent; NULL on a miss. The pointer
+// stays valid until the next image_cache_put().
+const CachedImage *image_cache_get(ImageCache *cache, const RenderKey *key);
+
+// Takes ownership of data (malloc'd), replacing any image already under
+// key, then evicts old images until the budget is met. An image larger
+// than the whole budget is freed rather than cached; returns false then.
+bool image_cache_put(ImageCache *cache, const RenderKey *key, uint8_t *data, size_t size);
+
+// Frees every image of compounds [first, first + count), for when their
+// geometry changes. Returns how many were dropped.
+size_t image_cache_drop_compounds(ImageCache *cache, int first, int count);
+
+#endif
@@ -0,0 +1,483 @@
+#include "isosurface.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK 8                  // voxels per block edge
+#define SAMPLES (BLOCK + 1)      // samples per block edge, shared faces duplicated
+#define CUTOFF_DENSITY 1e-3f
+#define MAX_CASE_TRIANGLES 8
+
+static const float vdwByLabel[5] = { 1.70f, 1.52f, 1.55f, 1.75f, 1.47f };
+
+// Cube corners and edges in the usual marching-cubes numbering.
+static const int cornerOffset[8][3] = {
+    {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+    {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1},
+};
+static const int edgeCorners[12][2] = {
+    {0,1}, {1,2}, {2,3}, {3,0},
+    {4,5}, {5,6}, {6,7}, {7,4},
+    {0,4}, {1,5}, {2,6}, {3,7},
+};
+// Face corners counter-clockwise when viewed from outside the cube.
+static const int faceCorners[6][4] = {
+    {0,3,2,1}, {4,5,6,7}, {0,1,5,4},
+    {2,3,7,6}, {3,0,4,7}, {1,2,6,5},
+};
+
+// triTable[config] lists edge triples, terminated by -1. It is generated
+// once instead of hand-copied: each face is resolved like marching squares
+// with inside corners kept apart, which every neighbouring cube agrees on,
+// so the surface stays crack-free.
+static int8_t triTable[256][MAX_CASE_TRIANGLES * 3 + 1];
+static pthread_once_t tableOnce = PTHREAD_ONCE_INIT;
+
+static int edge_between(int a, int b){
+    for(int e = 0; e < 12; e++){
+        if((edgeCorners[e][0] == a && edgeCorners[e][1] == b) ||
+           (edgeCorners[e][0] == b && edgeCorners[e][1] == a)) return e;
+    }
+    return -1;
+}
+
+static void build_tables(void){
+    for(int config = 0; config < 256; config++){
+        // next[e]: walking a face counter-clockwise, each run of inside
+        // corners is entered through one edge and left through another; the
+        // contour segment on that face links the exit back to the entry.
+        // Two laps catch runs that wrap around the first corner.
+        int next[12];
+        for(int e = 0; e < 12; e++) next[e] = -1;
+
+        for(int f = 0; f < 6; f++){
+            int entry = -1;
+            for(int step = 0; step < 8; step++){
+                int a = faceCorners[f][step & 3];
+                int b = faceCorners[f][(step + 1) & 3];
+                bool ain = (config >> a) & 1;
+                bool bin = (config >> b) & 1;
+                if(!ain && bin) entry = edge_between(a, b);
+                if(ain && !bin && entry >= 0){
+                    next[edge_between(a, b)] = entry;
+                    entry = -1;
+                }
+            }
+        }
+
+        int count = 0;
+        bool used[12] = {false};
+        for(int start = 0; start < 12; start++){
+            if(next[start] < 0 || used[start]) continue;
+            int loop[12];
+            int n = 0;
+            for(int e = start; e >= 0 && !used[e] && n < 12; e = next[e]){
+                used[e] = true;
+                loop[n++] = e;
+            }
+            for(int k = 1; k + 1 < n && count < MAX_CASE_TRIANGLES; k++){
+                triTable[config][count*3 + 0] = (int8_t)loop[0];
+                triTable[config][count*3 + 1] = (int8_t)loop[k + 1];
+                triTable[config][count*3 + 2] = (int8_t)loop[k];
+                count++;
+            }
+        }
+        triTable[config][count*3] = -1;
+    }
+}
+
+SurfaceOptions surface_default_options(void){
+    SurfaceOptions o = { 0.5f, 2.5f, 1.0f };
+    return o;
+}
+
+void surface_mesh_free(SurfaceMesh *mesh){
+    free(mesh->position);
+    free(mesh->normal);
+    mesh->position = NULL;
+    mesh->normal = NULL;
+    mesh->vertexCount = 0;
+}
+
+
+typedef struct {
+    int bx, by, bz;
+    int atomStart, atomCount; // slice of the block-atom CSR list
+} Block;
+
+typedef struct {
+    const Vec3 *pos;
+    const float *radius;
+    float origin[3];
+    SurfaceOptions opt;
+    float cutoffScale2;   // (influence distance / radius)^2
+
+    Block *blocks;
+    int blockCount;
+    int *blockAtoms;
+
+    // Per-block output, concatenated afterwards in block order.
+    Vec3 **outPos;
+    Vec3 **outNormal;
+    int *outCount;
+} BuildContext;
+
+typedef struct {
+    uint64_t *keys;
+    int *values;
+    int capacity;
+} BlockMap;
+
+static uint64_t pack_block(int x, int y, int z){
+    return ((uint64_t)(uint32_t)(x + (1 << 20)) << 42) |
+           ((uint64_t)(uint32_t)(y + (1 << 20)) << 21) |
+           (uint64_t)(uint32_t)(z + (1 << 20));
+}
+
+static int map_slot(const BlockMap *m, uint64_t key){
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    int slot = (int)(h >> 40) & (m->capacity - 1);
+    while(m->keys[slot] != 0 && m->keys[slot] != key) slot = (slot + 1) & (m->capacity - 1);
+    return slot;
+}
+
+static void atom_block_range(const BuildContext *ctx, int i, int lo[3], int hi[3]){
+    float reach = ctx->radius[i] * sqrtf(ctx->cutoffScale2);
+    float c[3] = { ctx->pos[i].x, ctx->pos[i].y, ctx->pos[i].z };
+    for(int k = 0; k < 3; k++){
+        // Sample indices the atom can touch, mapped to blocks; a sample on a
+        // block face belongs to both neighbours.
+        int s0 = (int)ceilf((c[k] - reach - ctx->origin[k]) / ctx->opt.spacing);
+        int s1 = (int)floorf((c[k] + reach - ctx->origin[k]) / ctx->opt.spacing);
+        if(s0 < 0) s0 = 0;
+        lo[k] = (s0 - 1) / BLOCK;
+        if(lo[k] < 0) lo[k] = 0;
+        hi[k] = s1 / BLOCK;
+    }
+}
+
+static void build_block(void *arg, int begin, int end){
+    BuildContext *ctx = arg;
+    float h = ctx->opt.spacing;
+    float B = ctx->opt.blobbiness;
+    float iso = ctx->opt.iso;
+
+    float *density = malloc(sizeof(float) * SAMPLES * SAMPLES * SAMPLES);
+    float *grad = malloc(sizeof(float) * 3 * SAMPLES * SAMPLES * SAMPLES);
+    if(!density || !grad){
+        free(density);
+        free(grad);
+        return;
+    }
+
+    for(int b = begin; b < end; b++){
+        const Block *blk = &ctx->blocks[b];
+        float base[3] = {
+            ctx->origin[0] + (float)(blk->bx * BLOCK) * h,
+            ctx->origin[1] + (float)(blk->by * BLOCK) * h,
+            ctx->origin[2] + (float)(blk->bz * BLOCK) * h,
+        };
+
+        memset(density, 0, sizeof(float) * SAMPLES * SAMPLES * SAMPLES);
+        memset(grad, 0, sizeof(float) * 3 * SAMPLES * SAMPLES * SAMPLES);
+
+        for(int a = 0; a < blk->atomCount; a++){
+            int i = ctx->blockAtoms[blk->atomStart + a];
+            Vec3 c = ctx->pos[i];
+            float inv2 = 1.0f / (ctx->radius[i] * ctx->radius[i]);
+            float reach2 = ctx->cutoffScale2 * ctx->radius[i] * ctx->radius[i];
+            float reach = sqrtf(reach2);
+
+            int lo[3], hi[3];
+            float cc[3] = { c.x, c.y, c.z };
+            for(int k = 0; k < 3; k++){
+                lo[k] = (int)ceilf((cc[k] - reach - base[k]) / h);
+                hi[k] = (int)floorf((cc[k] + reach - base[k]) / h);
+                if(lo[k] < 0) lo[k] = 0;
+                if(hi[k] > BLOCK) hi[k] = BLOCK;
+            }
+
+            for(int z = lo[2]; z <= hi[2]; z++){
+                float dz = base[2] + (float)z * h - c.z;
+                for(int y = lo[1]; y <= hi[1]; y++){
+                    float dy = base[1] + (float)y * h - c.y;
+                    int row = (z * SAMPLES + y) * SAMPLES;
+                    for(int x = lo[0]; x <= hi[0]; x++){
+                        float dx = base[0] + (float)x * h - c.x;
+                        float d2 = dx*dx + dy*dy + dz*dz;
+                        if(d2 >= reach2) continue;
+                        float e = expf(-B * (d2 * inv2 - 1.0f));
+                        float g = -2.0f * B * inv2 * e;
+                        density[row + x] += e;
+                        grad[3*(row + x) + 0] += g * dx;
+                        grad[3*(row + x) + 1] += g * dy;
+                        grad[3*(row + x) + 2] += g * dz;
+                    }
+                }
+            }
+        }
+
+        int cap = 0, count = 0;
+        Vec3 *vp = NULL, *vn = NULL;
+
+        for(int z = 0; z < BLOCK; z++){
+            for(int y = 0; y < BLOCK; y++){
+                for(int x = 0; x < BLOCK; x++){
+                    int sample[8];
+                    int config = 0;
+                    for(int k = 0; k < 8; k++){
+                        sample[k] = ((z + cornerOffset[k][2]) * SAMPLES + (y + cornerOffset[k][1])) * SAMPLES + (x + cornerOffset[k][0]);
+                        if(density[sample[k]] >= iso) config |= 1 << k;
+                    }
+                    if(config == 0 || config == 255) continue;
+
+                    const int8_t *tri = triTable[config];
+                    for(int t = 0; tri[t] >= 0; t++){
+                        if(count == cap){
+                            int grown = cap ? cap * 2 : 192;
+                            Vec3 *np = realloc(vp, sizeof(Vec3) * (size_t)grown);
+                            Vec3 *nn = np ? realloc(vn, sizeof(Vec3) * (size_t)grown) : NULL;
+                            if(!np || !nn){
+                                if(np) vp = np;
+                                break;
+                            }
+                            vp = np;
+                            vn = nn;
+                            cap = grown;
+                        }
+
+                        int e = tri[t];
+                        int c0 = edgeCorners[e][0];
+                        int c1 = edgeCorners[e][1];
+                        float v0 = density[sample[c0]];
+                        float v1 = density[sample[c1]];
+                        float s = (fabsf(v1 - v0) > 1e-12f) ? (iso - v0) / (v1 - v0) : 0.5f;
+
+                        float p[3], n[3];
+                        for(int k = 0; k < 3; k++){
+                            float a0 = (float)cornerOffset[c0][k];
+                            float a1 = (float)cornerOffset[c1][k];
+                            int cell = (k == 0) ? x : (k == 1 ? y : z);
+                            p[k] = base[k] + ((float)cell + a0 + (a1 - a0) * s) * h;
+                            n[k] = -(grad[3*sample[c0] + k] + (grad[3*sample[c1] + k] - grad[3*sample[c0] + k]) * s);
+                        }
+                        float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                        if(len > 1e-12f){
+                            n[0] /= len; n[1] /= len; n[2] /= len;
+                        }
+                        vp[count] = make_vec3(p[0], p[1], p[2]);
+                        vn[count] = make_vec3(n[0], n[1], n[2]);
+                        count++;
+                    }
+                }
+            }
+        }
+
+        ctx->outPos[b] = vp;
+        ctx->outNormal[b] = vn;
+        ctx->outCount[b] = count - count % 3;
+    }
+
+    free(density);
+    free(grad);
+}
+
+bool surface_build(const Vec3 *pos, const float *radius, int atomCount,
+                   const SurfaceOptions *options, SurfaceMesh *out){
+    PROF_SCOPE("surface_build");
+    pthread_once(&tableOnce, build_tables);
+    memset(out, 0, sizeof(*out));
+    if(atomCount <= 0) return true;
+
+    BuildContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.pos = pos;
+    ctx.radius = radius;
+    ctx.opt = options ? *options : surface_default_options();
+    ctx.cutoffScale2 = 1.0f + logf(1.0f / CUTOFF_DENSITY) / ctx.opt.blobbiness;
+
+    float maxReach = 0.0f;
+    for(int i = 0; i < atomCount; i++){
+        float r = radius[i] * sqrtf(ctx.cutoffScale2);
+        if(r > maxReach) maxReach = r;
+    }
+    for(int k = 0; k < 3; k++){
+        float lo = 0.0f;
+        for(int i = 0; i < atomCount; i++){
+            float c = (k == 0) ? pos[i].x : (k == 1 ? pos[i].y : pos[i].z);
+            if(i == 0 || c < lo) lo = c;
+        }
+        // Start one voxel outside the outermost influence so the mesh closes.
+        ctx.origin[k] = lo - maxReach - ctx.opt.spacing;
+    }
+
+    // Pass 1: find occupied blocks and count atoms per block.
+    BlockMap map;
+    map.capacity = 1024;
+    while(map.capacity < atomCount * 32) map.capacity <<= 1;
+    map.keys = calloc((size_t)map.capacity, sizeof(uint64_t));
+    map.values = malloc(sizeof(int) * (size_t)map.capacity);
+    int blockCap = 256;
+    ctx.blocks = malloc(sizeof(Block) * (size_t)blockCap);
+    if(!map.keys || !map.values || !ctx.blocks){
+        free(map.keys);
+        free(map.values);
+        free(ctx.blocks);
+        return false;
+    }
+
+    bool ok = true;
+    for(int i = 0; i < atomCount && ok; i++){
+        int lo[3], hi[3];
+        atom_block_range(&ctx, i, lo, hi);
+        for(int z = lo[2]; z <= hi[2] && ok; z++){
+            for(int y = lo[1]; y <= hi[1] && ok; y++){
+                for(int x = lo[0]; x <= hi[0] && ok; x++){
+                    uint64_t key = pack_block(x, y, z);
+                    int slot = map_slot(&map, key);
+                    if(map.keys[slot] == 0){
+                        if(ctx.blockCount * 2 >= map.capacity || ctx.blockCount == blockCap){
+                            // Grow both the table and block array, then retry.
+                            if(ctx.blockCount == blockCap){
+                                Block *grown = realloc(ctx.blocks, sizeof(Block) * (size_t)blockCap * 2);
+                                if(!grown){ ok = false; break; }
+                                ctx.blocks = grown;
+                                blockCap *= 2;
+                            }
+                            if(ctx.blockCount * 2 >= map.capacity){
+                                BlockMap bigger = { calloc((size_t)map.capacity * 2, sizeof(uint64_t)),
+                                                    malloc(sizeof(int) * (size_t)map.capacity * 2),
+                                                    map.capacity * 2 };
+                                if(!bigger.keys || !bigger.values){
+                                    free(bigger.keys);
+                                    free(bigger.values);
+                                    ok = false;
+                                    break;
+                                }
+                                for(int s = 0; s < map.capacity; s++){
+                                    if(map.keys[s] == 0) continue;
+                                    int ns = map_slot(&bigger, map.keys[s]);
+                                    bigger.keys[ns] = map.keys[s];
+                                    bigger.values[ns] = map.values[s];
+                                }
+                                free(map.keys);
+                                free(map.values);
+                                map = bigger;
+                            }
+                            slot = map_slot(&map, key);
+                        }
+                        map.keys[slot] = key;
+                        map.values[slot] = ctx.blockCount;
+                        ctx.blocks[ctx.blockCount++] = (Block){ x, y, z, 0, 0 };
+                    }
+                    ctx.blocks[map.values[slot]].atomCount++;
+                }
+            }
+        }
+    }
+
+    // Pass 2: prefix sums and fill the block-atom lists in atom order, so a
+    // sample shared by two blocks is summed identically in both.
+    long long total = 0;
+    for(int b = 0; b < ctx.blockCount && ok; b++){
+        ctx.blocks[b].atomStart = (int)total;
+        total += ctx.blocks[b].atomCount;
+        ctx.blocks[b].atomCount = 0;
+    }
+    ctx.blockAtoms = ok ? malloc(sizeof(int) * (size_t)(total > 0 ? total : 1)) : NULL;
+    ok = ok && ctx.blockAtoms;
+    for(int i = 0; i < atomCount && ok; i++){
+        int lo[3], hi[3];
+        atom_block_range(&ctx, i, lo, hi);
+        for(int z = lo[2]; z <= hi[2]; z++){
+            for(int y = lo[1]; y <= hi[1]; y++){
+                for(int x = lo[0]; x <= hi[0]; x++){
+                    Block *blk = &ctx.blocks[map.values[map_slot(&map, pack_block(x, y, z))]];
+                    ctx.blockAtoms[blk->atomStart + blk->atomCount++] = i;
+                }
+            }
+        }
+    }
+    free(map.keys);
+    free(map.values);
+
+    if(ok){
+        ctx.outPos = calloc((size_t)ctx.blockCount, sizeof(Vec3*));
+        ctx.outNormal = calloc((size_t)ctx.blockCount, sizeof(Vec3*));
+        ctx.outCount = calloc((size_t)ctx.blockCount, sizeof(int));
+        ok = ctx.outPos && ctx.outNormal && ctx.outCount;
+    }
+
+    if(ok){
+        parallel_for(ctx.blockCount, 4, build_block, &ctx);
+
+        long long vertices = 0;
+        for(int b = 0; b < ctx.blockCount; b++) vertices += ctx.outCount[b];
+        out->position = malloc(sizeof(Vec3) * (size_t)(vertices > 0 ? vertices : 1));
+        out->normal = malloc(sizeof(Vec3) * (size_t)(vertices > 0 ? vertices : 1));
+        ok = out->position && out->normal;
+        if(ok){
+            for(int b = 0; b < ctx.blockCount; b++){
+                memcpy(out->position + out->vertexCount, ctx.outPos[b], sizeof(Vec3) * (size_t)ctx.outCount[b]);
+                memcpy(out->normal + out->vertexCount, ctx.outNormal[b], sizeof(Vec3) * (size_t)ctx.outCount[b]);
+                out->vertexCount += ctx.outCount[b];
+            }
+        } else {
+            surface_mesh_free(out);
+        }
+    }
+
+    for(int b = 0; ctx.outPos && b < ctx.blockCount; b++){
+        free(ctx.outPos[b]);
+        free(ctx.outNormal[b]);
+    }
+    free(ctx.outPos);
+    free(ctx.outNormal);
+    free(ctx.outCount);
+    free(ctx.blockAtoms);
+    free(ctx.blocks);
+    return ok;
+}
+
+
+void surface_cache_init(SurfaceCache *cache){
+    memset(cache, 0, sizeof(*cache));
+}
+
+void surface_cache_free(SurfaceCache *cache){
+    surface_mesh_free(&cache->mesh);
+    cache->valid = false;
+}
+
+static uint64_t geometry_key(const MoleculeGeometry *mol){
+    uint64_t h = 1469598103934665603ull;
+    const unsigned char *bytes = (const unsigned char*)mol->atomPos;
+    for(size_t i = 0; i < sizeof(Vec3) * (size_t)mol->atomCount; i++) h = (h ^ bytes[i]) * 1099511628211ull;
+    for(int i = 0; i < mol->atomCount; i++) h = (h ^ mol->atomLabel[i]) * 1099511628211ull;
+    return h ^ (uint64_t)mol->atomCount;
+}
+
+bool surface_cache_update(SurfaceCache *cache, const MoleculeGeometry *mol){
+    uint64_t key = geometry_key(mol);
+    if(cache->valid && cache->key == key) return false;
+
+    float radius[MAX_ATOMS];
+    for(int i = 0; i < mol->atomCount; i++){
+        uint8_t l = mol->atomLabel[i];
+        radius[i] = vdwByLabel[l < 5 ? l : 0];
+    }
+
+    SurfaceMesh mesh;
+    SurfaceOptions options = surface_default_options();
+    if(!surface_build(mol->atomPos, radius, mol->atomCount, &options, &mesh)) return false;
+
+    surface_mesh_free(&cache->mesh);
+    cache->mesh = mesh;
+    cache->key = key;
+    cache->valid = true;
+    return true;
+}
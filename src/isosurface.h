@@ -0,0 +1,46 @@
+#ifndef ATLAS_ISOSURFACE_H
+#define ATLAS_ISOSURFACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+// Unindexed triangle list: vertices 3k, 3k+1, 3k+2 form triangle k, wound
+// counter-clockwise when seen from outside. Normals point outwards.
+typedef struct {
+    int vertexCount;
+    Vec3 *position;
+    Vec3 *normal;
+} SurfaceMesh;
+
+typedef struct {
+    float spacing;    // voxel edge length
+    float blobbiness; // Gaussian falloff; larger values hug the spheres tighter
+    float iso;        // density level extracted; 1.0 sits on the atom radius
+} SurfaceOptions;
+
+SurfaceOptions surface_default_options(void);
+
+// Evaluates sum_i exp(-B (|p - c_i|^2 / r_i^2 - 1)) on a sparse grid of
+// 8^3-voxel blocks touching atoms and runs marching cubes on each block
+// across the worker pool. Returns false on allocation failure.
+bool surface_build(const Vec3 *pos, const float *radius, int atomCount,
+                   const SurfaceOptions *options, SurfaceMesh *out);
+
+void surface_mesh_free(SurfaceMesh *mesh);
+
+// Per-molecule mesh cache keyed by a hash of the geometry.
+typedef struct {
+    bool valid;
+    uint64_t key;
+    SurfaceMesh mesh;
+} SurfaceCache;
+
+void surface_cache_init(SurfaceCache *cache);
+void surface_cache_free(SurfaceCache *cache);
+
+// Rebuilds the mesh when the geometry changed; returns true if it did.
+bool surface_cache_update(SurfaceCache *cache, const MoleculeGeometry *mol);
+
+#endif
@@ -0,0 +1,308 @@
+#include "library.h"
+#include "forcefield.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+void library_init(Library *lib){
+    memset(lib, 0, sizeof(*lib));
+}
+
+void library_free(Library *lib){
+    free(lib->entries);
+    library_init(lib);
+}
+
+int element_label(const char *symbol){
+    static const char *symbols[] = { "C", "O", "N", "Cl", "F" };
+    for(int i = 0; i < (int)(sizeof(symbols) / sizeof(symbols[0])); i++){
+        if(strcasecmp(symbol, symbols[i]) == 0) return i;
+    }
+    if(strcasecmp(symbol, "H") == 0 || strcasecmp(symbol, "D") == 0) return -2;
+    return -1;
+}
+
+float covalent_radius(uint8_t label){
+    static const float radii[] = { 0.76f, 0.66f, 0.71f, 1.02f, 0.57f };
+    return label < sizeof(radii) / sizeof(radii[0]) ? radii[label] : 0.76f;
+}
+
+void perceive_bonds(MoleculeGeometry *mol){
+    mol->bondCount = 0;
+    for(int a = 0; a < mol->atomCount; a++){
+        for(int b = a + 1; b < mol->atomCount; b++){
+            float dx = mol->atomPos[a].x - mol->atomPos[b].x;
+            float dy = mol->atomPos[a].y - mol->atomPos[b].y;
+            float dz = mol->atomPos[a].z - mol->atomPos[b].z;
+            float limit = 1.15f * (covalent_radius(mol->atomLabel[a]) + covalent_radius(mol->atomLabel[b]));
+            float d2 = dx*dx + dy*dy + dz*dz;
+            if(d2 > 0.16f && d2 < limit * limit) add_bond(mol, a, b, 1);
+        }
+    }
+}
+
+bool library_reserve(Library *lib, int count){
+    if(count <= lib->capacity) return true;
+    int capacity = lib->capacity ? lib->capacity : 32;
+    while(capacity < count) capacity *= 2;
+    LibraryEntry *grown = realloc(lib->entries, sizeof(LibraryEntry) * (size_t)capacity);
+    if(!grown) return false;
+    lib->entries = grown;
+    lib->capacity = capacity;
+    return true;
+}
+
+static LibraryEntry *push_entry(Library *lib){
+    if(!library_reserve(lib, lib->count + 1)) return NULL;
+    LibraryEntry *e = &lib->entries[lib->count];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+static void trim_copy(char *dst, size_t size, const char *src){
+    while(*src && isspace((unsigned char)*src)) src++;
+    size_t n = strlen(src);
+    while(n > 0 && isspace((unsigned char)src[n - 1])) n--;
+    if(n >= size) n = size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+bool library_add_builtin(Library *lib){
+    static MoleculeGeometry relaxed[COMPOUND_COUNT];
+    for(int i = 0; i < COMPOUND_COUNT; i++) apply_preset(&relaxed[i], compounds[i].presetType);
+    ff_relax_library(relaxed, COMPOUND_COUNT);
+    for(int i = 0; i < COMPOUND_COUNT; i++){
+        LibraryEntry *e = push_entry(lib);
+        if(!e) return false;
+        snprintf(e->name, sizeof(e->name), "%s", compounds[i].name);
+        e->mol = relaxed[i];
+        e->hydrogens = -1;
+        lib->count++;
+    }
+    return true;
+}
+
+#define XYZ_BLOCK (1 << 20)
+
+bool xyz_reader_open(XyzReader *r, const char *path){
+    memset(r, 0, sizeof(*r));
+    r->path = path;
+    r->ownsBuffer = true;
+    if(strcmp(path, "-") == 0){
+        r->f = stdin;
+        r->path = "<stdin>";
+        return true;
+    }
+    r->f = fopen(path, "r");
+    r->ownsFile = r->f != NULL;
+    return r->f != NULL;
+}
+
+void xyz_reader_open_memory(XyzReader *r, const char *text, size_t size, const char *path){
+    memset(r, 0, sizeof(*r));
+    r->path = path;
+    r->buffer = (char *)text; // never written: refill() stops at eof
+    r->size = r->capacity = size;
+    r->eof = true;
+}
+
+void xyz_reader_close(XyzReader *r){
+    if(r->ownsFile) fclose(r->f);
+    if(r->ownsBuffer) free(r->buffer);
+    r->f = NULL;
+    r->buffer = NULL;
+}
+
+// Moves unconsumed text to the front and appends more input. False once
+// the end of input was already reached (or memory ran out).
+static bool refill(XyzReader *r){
+    if(r->eof) return false;
+    memmove(r->buffer, r->buffer + r->pos, r->size - r->pos);
+    r->size -= r->pos;
+    r->pos = 0;
+    if(r->capacity - r->size < XYZ_BLOCK / 2){
+        size_t capacity = r->capacity ? r->capacity * 2 : XYZ_BLOCK;
+        char *grown = realloc(r->buffer, capacity);
+        if(!grown) return false;
+        r->buffer = grown;
+        r->capacity = capacity;
+    }
+    size_t n = fread(r->buffer + r->size, 1, r->capacity - r->size, r->f);
+    r->size += n;
+    if(n == 0) r->eof = true; // the caller rescans: a last line may lack its newline
+    return true;
+}
+
+// End of the line starting at p (past its newline), or NULL if the line is
+// not complete yet. At end of input the last line needs no newline.
+static const char *line_end(const XyzReader *r, const char *p){
+    const char *end = r->buffer + r->size;
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    if(nl) return nl + 1;
+    return r->eof && p < end ? end : NULL;
+}
+
+int xyz_reader_split(XyzReader *r, XyzRecord *out, int max, char *error, size_t errorSize){
+    int count = 0;
+    while(count < max){
+        const char *p = r->buffer ? r->buffer + r->pos : NULL;
+        const char *next = p ? line_end(r, p) : NULL;
+        if(!next){
+            if(count > 0 || !refill(r)) break;
+            continue;
+        }
+
+        // Skip blank lines between records.
+        const char *q = p;
+        while(q < next && isspace((unsigned char)*q)) q++;
+        if(q == next){
+            r->pos = (size_t)(next - r->buffer);
+            r->line++;
+            continue;
+        }
+
+        char *endNum;
+        long atoms = strtol(p, &endNum, 10);
+        if(atoms <= 0 || endNum > next){
+            snprintf(error, errorSize, "%s:%d: expected an atom count", r->path, r->line + 1);
+            return -1;
+        }
+        // The name line plus one line per atom must all be buffered.
+        const char *end = next;
+        long lines = 0;
+        while(lines < atoms + 1 && (next = line_end(r, end))){
+            end = next;
+            lines++;
+        }
+        if(lines < atoms + 1){
+            if(r->eof){
+                snprintf(error, errorSize, "%s:%d: record ends early", r->path, r->line + 2 + (int)lines);
+                return -1;
+            }
+            if(count > 0 || !refill(r)) break;
+            continue;
+        }
+        out[count++] = (XyzRecord){ p, (size_t)(end - p), r->line + 1, ++r->record };
+        r->line += (int)atoms + 2;
+        r->pos = (size_t)(end - r->buffer);
+    }
+    return count;
+}
+
+// "Element x y z" without sscanf, which dominates parsing time otherwise.
+static bool parse_atom_line(const char *p, char symbol[8], float *x, float *y, float *z){
+    while(isspace((unsigned char)*p)) p++;
+    int n = 0;
+    while(*p && !isspace((unsigned char)*p)){
+        if(n == 7) return false;
+        symbol[n++] = *p++;
+    }
+    symbol[n] = '\0';
+    float *out[3] = { x, y, z };
+    for(int i = 0; i < 3; i++){
+        char *end;
+        *out[i] = strtof(p, &end);
+        if(end == p) return false;
+        p = end;
+    }
+    return n > 0;
+}
+
+int xyz_parse_record(const XyzRecord *rec, const char *path, LibraryEntry *e, char *error, size_t errorSize){
+    memset(e, 0, sizeof(*e));
+    const char *p = rec->text, *end = rec->text + rec->length;
+    char line[512];
+    int lineNo = rec->line;
+    for(long i = -2; p < end; i++, lineNo++){
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = (size_t)((nl ? nl : end) - p);
+        if(n >= sizeof(line)) n = sizeof(line) - 1;
+        memcpy(line, p, n);
+        line[n] = '\0';
+        p = nl ? nl + 1 : end;
+
+        if(i == -2) continue; // the count, already checked by the split
+        if(i == -1){
+            trim_copy(e->name, sizeof(e->name), line);
+            if(e->name[0] == '\0') snprintf(e->name, sizeof(e->name), "record %d", rec->record);
+            continue;
+        }
+        char symbol[8];
+        float x, y, z;
+        if(!parse_atom_line(line, symbol, &x, &y, &z)){
+            snprintf(error, errorSize, "%s:%d: expected \"Element x y z\"", path, lineNo);
+            return -1;
+        }
+        int label = element_label(symbol);
+        if(label == -2){
+            e->hydrogens++;
+            continue;
+        }
+        if(label < 0){
+            snprintf(error, errorSize, "%s:%d: unsupported element %s", path, lineNo, symbol);
+            return -1;
+        }
+        if(e->mol.atomCount >= MAX_ATOMS){
+            snprintf(error, errorSize, "%s:%d: more than %d heavy atoms", path, lineNo, MAX_ATOMS);
+            return -1;
+        }
+        add_atom(&e->mol, make_vec3(x, y, z), (uint8_t)label);
+    }
+    if(e->mol.atomCount == 0) return 0;
+
+    // Centre on the origin like the presets, so views rotate in place.
+    Vec3 c = make_vec3(0, 0, 0);
+    for(int i = 0; i < e->mol.atomCount; i++){
+        c.x += e->mol.atomPos[i].x;
+        c.y += e->mol.atomPos[i].y;
+        c.z += e->mol.atomPos[i].z;
+    }
+    float inv = 1.0f / (float)e->mol.atomCount;
+    for(int i = 0; i < e->mol.atomCount; i++){
+        e->mol.atomPos[i].x -= c.x * inv;
+        e->mol.atomPos[i].y -= c.y * inv;
+        e->mol.atomPos[i].z -= c.z * inv;
+    }
+    perceive_bonds(&e->mol);
+    return 1;
+}
+
+bool library_load_xyz(Library *lib, const char *path, char *error, size_t errorSize){
+    XyzReader reader;
+    if(!xyz_reader_open(&reader, path)){
+        snprintf(error, errorSize, "%s: cannot open", path);
+        return false;
+    }
+    XyzRecord records[64];
+    bool ok = true;
+    int n;
+    while(ok && (n = xyz_reader_split(&reader, records, 64, error, errorSize)) != 0){
+        if(n < 0){
+            ok = false;
+            break;
+        }
+        for(int i = 0; i < n && ok; i++){
+            LibraryEntry *e = push_entry(lib);
+            if(!e){
+                snprintf(error, errorSize, "%s:%d: out of memory", reader.path, records[i].line);
+                ok = false;
+                break;
+            }
+            int parsed = xyz_parse_record(&records[i], reader.path, e, error, errorSize);
+            if(parsed < 0) ok = false;
+            if(parsed > 0) lib->count++;
+        }
+    }
+    xyz_reader_close(&reader);
+    return ok;
+}
+
+Compound library_compound(const Library *lib, int index){
+    const Compound *palette = &compounds[index % COMPOUND_COUNT];
+    Compound c = { lib->entries[index].name, palette->colorRGBA, -1, 1.0f };
+    return c;
+}
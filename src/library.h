@@ -0,0 +1,88 @@
+#ifndef ATLAS_LIBRARY_H
+#define ATLAS_LIBRARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "molecule.h"
+#include "presets.h"
+
+// Compound libraries loaded from multi-record XYZ files: each record is an
+// atom count line, a name line, then one "Element x y z" line per atom.
+// Hydrogens are dropped (the atlas draws heavy atoms only) and bonds are
+// perceived from covalent radii.
+
+#define LIBRARY_NAME_MAX 64
+
+typedef struct {
+    char name[LIBRARY_NAME_MAX];
+    MoleculeGeometry mol;
+    int hydrogens; // dropped from the source, or -1 when it never had them
+} LibraryEntry;
+
+typedef struct {
+    LibraryEntry *entries;
+    int count, capacity;
+} Library;
+
+void library_init(Library *lib);
+void library_free(Library *lib);
+// Grows capacity to at least count entries; false if memory ran out.
+bool library_reserve(Library *lib, int count);
+
+// Appends the built-in compounds, force-field relaxed, under their names.
+bool library_add_builtin(Library *lib);
+
+// Appends every record of the file. On a malformed record, stops and
+// reports "path:line: reason" in error; records before it are kept.
+bool library_load_xyz(Library *lib, const char *path, char *error, size_t errorSize);
+
+// Streaming XYZ input for files too large to hold in memory. Records are
+// first split off the input as text, cheaply and in order, so that the
+// parsing can be spread across threads.
+typedef struct {
+    const char *text; // atom count line through the last atom line
+    size_t length;
+    int line;         // line number of the count line
+    int record;       // 1-based, in file order
+} XyzRecord;
+
+typedef struct {
+    FILE *f;
+    const char *path;
+    bool ownsFile, ownsBuffer, eof;
+    char *buffer;
+    size_t size, capacity, pos;
+    int line, record;
+} XyzReader;
+
+// "-" reads stdin.
+bool xyz_reader_open(XyzReader *r, const char *path);
+// Splits text already in memory, such as a mapped file; the records point
+// into it.
+void xyz_reader_open_memory(XyzReader *r, const char *text, size_t size, const char *path);
+void xyz_reader_close(XyzReader *r);
+// Splits up to max complete records off the input. The spans point into
+// the reader's buffer and stay valid until the next call. Returns the
+// count, 0 at end of input, or -1 on a bad count line or truncated record.
+int xyz_reader_split(XyzReader *r, XyzRecord *out, int max, char *error, size_t errorSize);
+// Parses one record: 1 when it has heavy atoms, 0 when it has none (the
+// entry should be skipped), -1 on error ("path:line: reason").
+int xyz_parse_record(const XyzRecord *rec, const char *path, LibraryEntry *e, char *error, size_t errorSize);
+
+// Heavy-atom label code for an element symbol, or -1 if the atlas has no
+// colour for it. Hydrogen is -2.
+int element_label(const char *symbol);
+
+// Single-bond covalent radius in Angstrom for an atom label.
+float covalent_radius(uint8_t label);
+
+// Single bonds between atoms closer than 1.15x the sum of their covalent
+// radii. Replaces any bonds already present.
+void perceive_bonds(MoleculeGeometry *mol);
+
+// A Compound for drawing entry `index`, coloured from the preset palette.
+Compound library_compound(const Library *lib, int index);
+
+#endif
@@ -4,619 +4,796 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "molecule.h"
+#include "conformer.h"
+#include "descriptors.h"
+#include "dynamics.h"
+#include "export.h"
+#include "forcefield.h"
+#include "geometry.h"
+#include "governor.h"
+#include "isosurface.h"
+#include "library.h"
+#include "pipeline.h"
+#include "presets.h"
+#include "profiler.h"
+#include "raytrace.h"
+#include "reload.h"
+#include "render.h"
+#include "replay.h"
+#include "sasa.h"
+#include "server.h"
+#include "store.h"
+#include "text.h"
+#include "thread_pool.h"
+#include "thumbnails.h"
+#include "watch.h"
 
 #define WINDOW_WIDTH 1600
 #define WINDOW_HEIGHT 900
 
 #define GRID_COLS 5
 #define GRID_ROWS 4
-#define COMPOUND_COUNT 20
-
-#define MAX_ATOMS 64
-#define MAX_BONDS 96
-
-#define PI 3.14159265f
-
-typedef struct { float x, y, z; } Vec3;
-
-typedef struct { int from, to; int order; } Bond;
-
-typedef struct {
-    const char *name;
-    uint32_t colorRGBA;    
-    int presetType;
-    float baseScale;
-} Compound;
-
-typedef struct {
-    Vec3 atomPos[MAX_ATOMS];
-    uint8_t atomLabel[MAX_ATOMS]; // 0=C, 1=O, 2=N, 3=Cl, 4=F
-    int atomCount;
-
-    Bond bonds[MAX_BONDS];
-    int bondCount;
-} MoleculeGeometry;
-
-typedef struct { int x, y, w, h; } RectI;
-
-typedef struct {
-    float yaw;
-    float pitch;
-    float panX;
-    float panY;
-    float zoomMultiplier;
-} ViewControl;
 
 typedef struct {
-    int atomIndex;
-    float depth;
-    int screenX;
-    int screenY;
-    int radius;
-    uint32_t color;
-} AtomDraw;
-
-typedef struct {
-    int x1,y1,x2,y2;
-    float depth;
-    int order;
-    uint32_t color;
-    uint8_t alpha;
-} BondDraw;
-
-
-static inline uint8_t color_r(uint32_t c){ return (c >> 24) & 255; }
-static inline uint8_t color_g(uint32_t c){ return (c >> 16) & 255; }
-static inline uint8_t color_b(uint32_t c){ return (c >>  8) & 255; }
-
-static float clampf(float v, float lo, float hi){
-    if(v < lo) return lo;
-    if(v > hi) return hi;
-    return v;
-}
-
-static Vec3 make_vec3(float x, float y, float z){
-    Vec3 v = {x,y,z};
-    return v;
-}
-
-static void set_draw_color(SDL_Renderer *renderer, uint32_t rgba, uint8_t a){
-    SDL_SetRenderDrawColor(renderer, color_r(rgba), color_g(rgba), color_b(rgba), a);
-}
-
-static uint32_t lighten(uint32_t rgba, float t){
-    uint8_t r = color_r(rgba);
-    uint8_t g = color_g(rgba);
-    uint8_t b = color_b(rgba);
-
-    uint8_t nr = (uint8_t)clampf(r + (255 - r)*t, 0, 255);
-    uint8_t ng = (uint8_t)clampf(g + (255 - g)*t, 0, 255);
-    uint8_t nb = (uint8_t)clampf(b + (255 - b)*t, 0, 255);
-    return ((uint32_t)nr<<24) | ((uint32_t)ng<<16) | ((uint32_t)nb<<8) | 0xFF;
-}
-
-static uint32_t darken(uint32_t rgba, float t){
-    uint8_t r = color_r(rgba);
-    uint8_t g = color_g(rgba);
-    uint8_t b = color_b(rgba);
-
-    uint8_t nr = (uint8_t)clampf(r*(1.0f - t), 0, 255);
-    uint8_t ng = (uint8_t)clampf(g*(1.0f - t), 0, 255);
-    uint8_t nb = (uint8_t)clampf(b*(1.0f - t), 0, 255);
-    return ((uint32_t)nr<<24) | ((uint32_t)ng<<16) | ((uint32_t)nb<<8) | 0xFF;
-}
-
-
-static Vec3 rotate_yaw_pitch(Vec3 p, float yaw, float pitch){
-    float cy = cosf(yaw), sy = sinf(yaw);
-    float x1 =  cy * p.x + sy * p.z;
-    float z1 = -sy * p.x + cy * p.z;
-
-    float cp = cosf(pitch), sp = sinf(pitch);
-    float y2 =  cp * p.y - sp * z1;
-    float z2 =  sp * p.y + cp * z1;
-
-    return make_vec3(x1, y2, z2);
+    MoleculeGeometry molecules[COMPOUND_COUNT];
+    ConformerSet conformers[COMPOUND_COUNT];
+    int count;
+    bool relax; // presets are idealized; library files keep their coordinates
+} LibraryPrep;
+
+static void prepare_library_job(void *ctx){
+    LibraryPrep *prep = ctx;
+    if(prep->relax) ff_relax_library(prep->molecules, prep->count);
+
+    ConformerOptions options = conformer_default_options();
+    for(int i = 0; i < prep->count; i++){
+        conformer_enumerate(&prep->molecules[i], &options, &prep->conformers[i]);
+    }
 }
 
-static void project_to_screen(Vec3 p, float zoom, int centerX, int centerY, int *outX, int *outY, float *outDepth){
-    float perspective = 900.0f / (900.0f + p.z);
-    *outX = (int)lroundf(centerX + p.x * zoom * perspective);
-    *outY = (int)lroundf(centerY - p.y * zoom * perspective);
-    *outDepth = p.z;
+// A --watch reload, or with --shared the swap to a generation another
+// process published, run off the UI thread. The main loop leaves the
+// library alone until it is joined, then refreshes only the tiles marked
+// changed; their conformers are enumerated here too.
+typedef struct {
+    LibrarySource *src;
+    Library *lib;
+    LibraryDelta delta;
+    bool ok;
+    char error[256];
+    double ms;
+    int tileCount;
+    bool tileChanged[COMPOUND_COUNT];
+    ConformerSet conformers[COMPOUND_COUNT];
+
+    LibraryStore *store;    // --shared: republished after a reload, or followed
+    const Library *current; // following: the snapshot the tiles show
+    LibrarySnapshot next;   // following: the one replacing it
+    bool published;
+    double publishMs;
+    char storeError[256];
+} LibraryReload;
+
+static double ms_since(uint64_t start){
+    return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
 }
 
-
-static void draw_filled_circle(SDL_Renderer *renderer, int cx, int cy, int radius){
-    for(int y = -radius; y <= radius; y++){
-        for(int x = -radius; x <= radius; x++){
-            if(x*x + y*y <= radius*radius){
-                SDL_RenderDrawPoint(renderer, cx + x, cy + y);
-            }
-        }
+static void enumerate_changed(LibraryReload *r){
+    ConformerOptions options = conformer_default_options();
+    for(int i = 0; i < r->tileCount; i++){
+        if(r->tileChanged[i]) conformer_enumerate(&r->lib->entries[i].mol, &options, &r->conformers[i]);
     }
 }
 
-static void draw_thick_line(SDL_Renderer *renderer, int x1, int y1, int x2, int y2, int thickness){
-    if(thickness < 2) thickness = 2;
-
-    float dx = (float)(x2 - x1);
-    float dy = (float)(y2 - y1);
-    float len = sqrtf(dx*dx + dy*dy);
-    if(len < 1e-4f) return;
-
-    float normalX = -dy / len;
-    float normalY =  dx / len;
-
-    int steps = (int)len;
-    float half = thickness * 0.5f;
-
-    for(int i = 0; i <= steps; i++){
-        float t = (steps == 0) ? 0.0f : (float)i / (float)steps;
-        int x = (int)lroundf((float)x1 + dx * t);
-        int y = (int)lroundf((float)y1 + dy * t);
-
-        for(int j = -(int)half; j <= (int)half; j++){
-            int px = x + (int)lroundf(normalX * (float)j);
-            int py = y + (int)lroundf(normalY * (float)j);
-            SDL_RenderDrawPoint(renderer, px, py);
+static void reload_library_job(void *ctx){
+    LibraryReload *r = ctx;
+    uint64_t start = SDL_GetPerformanceCounter();
+    uint64_t stamp = 0;
+    bool stamped = r->store && library_store_stamp(r->store->path, &stamp);
+    r->ok = library_source_reload(r->src, r->lib, &r->delta, r->error, sizeof(r->error));
+    r->tileCount = r->lib->count < COMPOUND_COUNT ? r->lib->count : COMPOUND_COUNT;
+    memset(r->tileChanged, 0, sizeof(r->tileChanged));
+    if(r->ok){
+        for(int i = 0; i < r->delta.changedCount; i++){
+            if(r->delta.changed[i] < r->tileCount) r->tileChanged[r->delta.changed[i]] = true;
+        }
+        for(int i = r->delta.shiftedFrom < 0 ? r->tileCount : r->delta.shiftedFrom; i < r->tileCount; i++){
+            r->tileChanged[i] = true;
         }
     }
-}
-
-static void draw_stick(SDL_Renderer *renderer, int x1,int y1,int x2,int y2, int order, uint32_t baseColor, uint8_t alpha){
-    int outer = (order == 1) ? 6 : (order == 2 ? 8 : 10);
-    int inner = (order == 1) ? 3 : (order == 2 ? 4 : 5);
-
-    uint32_t dark = darken(baseColor, 0.35f);
-    uint32_t bright = lighten(baseColor, 0.35f);
-
-    set_draw_color(renderer, dark, alpha);
-    draw_thick_line(renderer, x1,y1,x2,y2, outer);
-
-    set_draw_color(renderer, bright, alpha);
-    draw_thick_line(renderer, x1,y1,x2,y2, inner);
-
-    if(order == 2){
-        set_draw_color(renderer, dark, alpha);
-        draw_thick_line(renderer, x1+3,y1-3,x2+3,y2-3, outer-2);
-        set_draw_color(renderer, bright, alpha);
-        draw_thick_line(renderer, x1+3,y1-3,x2+3,y2-3, inner-1);
+    r->ms = ms_since(start);
+
+    // Viewers following the store swap to the new generation.
+    r->published = false;
+    r->storeError[0] = '\0';
+    if(r->ok && stamped && r->lib->count > 0 && (r->delta.changedCount > 0 || r->delta.shiftedFrom >= 0)){
+        uint64_t publishStart = SDL_GetPerformanceCounter();
+        r->published = library_store_publish(r->store, r->lib, stamp, r->storeError, sizeof(r->storeError));
+        r->publishMs = ms_since(publishStart);
     }
+    enumerate_changed(r);
 }
 
-
-static void draw_glyph3x5(SDL_Renderer *renderer, int x, int y, int scale, const uint8_t bits[5]){
-    for(int row = 0; row < 5; row++){
-        for(int col = 0; col < 3; col++){
-            if(bits[row] & (1 << (2 - col))){
-                SDL_Rect px = { x + col * scale, y + row * scale, scale, scale };
-                SDL_RenderFillRect(renderer, &px);
-            }
-        }
+static void follow_store_job(void *ctx){
+    LibraryReload *r = ctx;
+    uint64_t start = SDL_GetPerformanceCounter();
+    r->ok = library_store_map(r->store, &r->next, r->error, sizeof(r->error));
+    r->lib = &r->next.lib;
+    r->tileCount = r->ok && r->lib->count < COMPOUND_COUNT ? r->lib->count : r->ok ? COMPOUND_COUNT : 0;
+    for(int i = 0; i < r->tileCount; i++){
+        r->tileChanged[i] = i >= r->current->count ||
+                            memcmp(&r->lib->entries[i], &r->current->entries[i], sizeof(LibraryEntry)) != 0;
     }
+    r->ms = ms_since(start);
+    enumerate_changed(r);
 }
 
-static const uint8_t GL_C[5] = {0b111,0b100,0b100,0b100,0b111};
-static const uint8_t GL_O[5] = {0b111,0b101,0b101,0b101,0b111};
-static const uint8_t GL_N[5] = {0b101,0b111,0b111,0b111,0b101};
-static const uint8_t GL_F[5] = {0b111,0b100,0b110,0b100,0b100};
-static const uint8_t GL_L[5] = {0b100,0b100,0b100,0b100,0b111};
-
-static void draw_atom_label(SDL_Renderer *renderer, int x, int y, int labelCode){
-    int scale = 2;
-    if(labelCode == 0) draw_glyph3x5(renderer, x, y, scale, GL_C);
-    else if(labelCode == 1) draw_glyph3x5(renderer, x, y, scale, GL_O);
-    else if(labelCode == 2) draw_glyph3x5(renderer, x, y, scale, GL_N);
-    else if(labelCode == 4) draw_glyph3x5(renderer, x, y, scale, GL_F);
-    else if(labelCode == 3){
-        draw_glyph3x5(renderer, x, y, scale, GL_C);
-        draw_glyph3x5(renderer, x + 8, y, scale, GL_L);
+static bool load_library(LibrarySource *source, Library *lib, const char *path){
+    char error[256];
+    if(!library_source_load(source, lib, path, error, sizeof(error))){
+        fprintf(stderr, "library: %s\n", error);
+        return false;
+    }
+    if(lib->count == 0){
+        fprintf(stderr, "library: %s has no compounds\n", path);
+        return false;
     }
+    printf("library: %d compounds from %s\n", lib->count, path);
+    return true;
 }
 
-
-static void add_atom(MoleculeGeometry *mol, Vec3 p, uint8_t label){
-    if(mol->atomCount >= MAX_ATOMS) return;
-    mol->atomPos[mol->atomCount] = p;
-    mol->atomLabel[mol->atomCount] = label;
-    mol->atomCount++;
+// Tile i shows entry i of source: library entries in the palette colours,
+// or the built-in compounds as themselves.
+static void load_tile(const Library *source, bool builtin, int i,
+                      MoleculeGeometry *mol, Compound *compound, char name[LIBRARY_NAME_MAX]){
+    *mol = source->entries[i].mol;
+    *compound = builtin ? compounds[i] : library_compound(source, i);
+    snprintf(name, LIBRARY_NAME_MAX, "%s", compound->name);
+    compound->name = name;
 }
 
-static void add_bond(MoleculeGeometry *mol, int a, int b, int order){
-    if(mol->bondCount >= MAX_BONDS) return;
-    mol->bonds[mol->bondCount++] = (Bond){a,b,order};
+// Returns the geometry to draw for a compound: the cached one, or a copy
+// carrying the latest positions from the vibration simulation.
+static const MoleculeGeometry *animated_geometry(MdSimulation *sim, int index,
+                                                 const MoleculeGeometry *base,
+                                                 MoleculeGeometry *scratch){
+    if(!md_is_running(sim)) return base;
+    scratch->atomCount = base->atomCount;
+    memcpy(scratch->atomLabel, base->atomLabel, sizeof(base->atomLabel));
+    scratch->bondCount = base->bondCount;
+    memcpy(scratch->bonds, base->bonds, sizeof(Bond) * (size_t)base->bondCount);
+    if(!md_read_positions(sim, index, scratch->atomPos, base->atomCount)) return base;
+    return scratch;
 }
 
-static void build_steroid_core(MoleculeGeometry *mol){
-    mol->atomCount = 0;
-    mol->bondCount = 0;
-
-    int baseA = mol->atomCount;
-    for(int i = 0; i < 6; i++){
-        float ang = i * PI / 3.0f;
-        add_atom(mol, make_vec3(cosf(ang) * 1.8f, sinf(ang) * 1.8f, 0.0f), 0);
+// Drawable size in pixels. On HiDPI displays it is larger than the window
+// size in points, and dpiScale converts fixed sizes from points to pixels.
+// Mouse input stays in points: pan offsets are stored that way and scaled
+// by compute_view_transform().
+typedef struct {
+    int width, height;
+    float dpiScale;
+} Layout;
+
+static void update_layout(Layout *layout, SDL_Window *window, SDL_Renderer *renderer){
+    int w = 0, h = 0;
+    if(SDL_GetRendererOutputSize(renderer, &w, &h) != 0 || w <= 0 || h <= 0) return;
+    layout->width = w;
+    layout->height = h;
+    layout->dpiScale = 1.0f;
+    if(window){
+        int pointsW = 0, pointsH = 0;
+        SDL_GetWindowSize(window, &pointsW, &pointsH);
+        if(pointsW > 0) layout->dpiScale = (float)w / (float)pointsW;
     }
-    for(int i = 0; i < 6; i++) add_bond(mol, baseA+i, baseA+((i+1)%6), 1);
+}
 
-    int baseB = mol->atomCount;
-    for(int i = 0; i < 6; i++){
-        float ang = i * PI / 3.0f;
-        add_atom(mol, make_vec3(2.8f + cosf(ang) * 1.8f, sinf(ang) * 1.8f, 0.2f), 0);
-    }
-    for(int i = 0; i < 6; i++) add_bond(mol, baseB+i, baseB+((i+1)%6), 1);
-    add_bond(mol, baseA+1, baseB+4, 1);
-    add_bond(mol, baseA+2, baseB+5, 1);
+static RectI get_tile_rect(const Layout *layout, int index){
+    int col = index % GRID_COLS;
+    int row = index / GRID_COLS;
 
-    int baseC = mol->atomCount;
-    for(int i = 0; i < 5; i++){
-        float ang = i * 2.0f * PI / 5.0f;
-        add_atom(mol, make_vec3(2.8f + cosf(ang) * 1.6f, 2.8f + sinf(ang) * 1.6f, -0.2f), 0);
-    }
-    for(int i = 0; i < 5; i++) add_bond(mol, baseC+i, baseC+((i+1)%5), 1);
-    add_bond(mol, baseB+1, baseC+3, 1);
-    add_bond(mol, baseB+2, baseC+4, 1);
+    int padding = (int)lroundf(14.0f * layout->dpiScale);
+    int tileW = (layout->width - padding * (GRID_COLS + 1)) / GRID_COLS;
+    int tileH = (layout->height - padding * (GRID_ROWS + 1)) / GRID_ROWS;
 
-    int baseD = mol->atomCount;
-    for(int i = 0; i < 5; i++){
-        float ang = i * 2.0f * PI / 5.0f;
-        add_atom(mol, make_vec3(4.8f + cosf(ang) * 1.3f, 4.3f + sinf(ang) * 1.3f, 0.15f), 0);
-    }
-    for(int i = 0; i < 5; i++) add_bond(mol, baseD+i, baseD+((i+1)%5), 1);
-    add_bond(mol, baseC+1, baseD+3, 1);
-    add_bond(mol, baseC+2, baseD+4, 1);
+    int x = padding + col * (tileW + padding);
+    int y = padding + row * (tileH + padding);
+    return (RectI){x, y, tileW, tileH};
 }
 
-static void add_ester_tail(MoleculeGeometry *mol, int attachAtom, int segmentCount, float zWiggle){
-    int previous = attachAtom;
-    for(int i = 0; i < segmentCount; i++){
-        Vec3 base = mol->atomPos[attachAtom];
-        float step = 1.1f;
-        Vec3 next = make_vec3(base.x + (i+1)*step, base.y - 0.4f*(float)i, base.z + zWiggle*(float)i);
-        add_atom(mol, next, 0);
-        int current = mol->atomCount - 1;
-        add_bond(mol, previous, current, 1);
-        previous = current;
-    }
+static RectI get_focus_rect(const Layout *layout){
+    int margin = (int)lroundf(20.0f * layout->dpiScale);
+    return (RectI){ margin, margin, layout->width - 2 * margin, layout->height - 2 * margin };
 }
 
-static void apply_preset(MoleculeGeometry *mol, int presetType){
-    build_steroid_core(mol);
-
-    int attachHydroxyl = 2;
-    int attachCarbonyl = 8;
-    int attachEster = 14;
-
-    add_atom(mol, make_vec3(mol->atomPos[attachHydroxyl].x - 0.2f,
-                            mol->atomPos[attachHydroxyl].y + 1.4f,
-                            mol->atomPos[attachHydroxyl].z + 0.8f), 1);
-    add_bond(mol, attachHydroxyl, mol->atomCount-1, 1);
-
-    add_atom(mol, make_vec3(mol->atomPos[attachCarbonyl].x + 0.3f,
-                            mol->atomPos[attachCarbonyl].y - 1.2f,
-                            mol->atomPos[attachCarbonyl].z - 0.6f), 1);
-    add_bond(mol, attachCarbonyl, mol->atomCount-1, 2);
-
-    if(presetType == 1) add_ester_tail(mol, attachEster, 6, 0.10f);
-    if(presetType == 2) add_ester_tail(mol, attachEster, 7, -0.05f);
-    if(presetType == 18) add_ester_tail(mol, attachEster, 3, 0.05f);
-    if(presetType == 19) add_ester_tail(mol, attachEster, 3, -0.06f);
-
-    if(presetType == 6 || presetType == 16 || presetType == 17){
-        add_atom(mol, make_vec3(mol->atomPos[5].x - 1.2f, mol->atomPos[5].y + 0.6f, mol->atomPos[5].z + 0.2f), 0);
-        add_bond(mol, 5, mol->atomCount-1, 1);
+// Everything needed to record one frame, snapshotted by the main loop so it
+// can go on handling input while the builder thread works.
+typedef struct {
+    Layout layout;
+    bool focused;
+    bool traced;        // the focus view is ray traced on the render thread
+    bool renderTargets;
+    int selectedIndex;
+    RenderMode mode;
+    float timeSeconds;
+    bool autoRotate;
+    int tileCount;
+    Compound compounds[COMPOUND_COUNT];
+    char names[COMPOUND_COUNT][LIBRARY_NAME_MAX]; // what compounds[].name points at
+    unsigned generation[COMPOUND_COUNT];           // bumped when a tile shows a new molecule
+    ViewControl views[COMPOUND_COUNT];
+    MoleculeGeometry geometry[COMPOUND_COUNT]; // only the molecules on screen
+    TileQuality quality[COMPOUND_COUNT];
+
+    // Filled in by the builder for the title bar.
+    float sasaArea;
+    double sasaRate;
+    int surfaceTriangles;
+} FrameJob;
+
+// Derived data only the builder touches.
+typedef struct {
+    SasaCache sasa[COMPOUND_COUNT];
+    SurfaceCache surface[COMPOUND_COUNT];
+    unsigned generation[COMPOUND_COUNT];
+} FrameBuilder;
+
+// FrameBuildFn: transforms, depth sorts and shading for one frame.
+static void build_frame(void *ctx, void *jobPtr, CommandBuffer *out){
+    FrameBuilder *b = ctx;
+    FrameJob *job = jobPtr;
+
+    // A reloaded tile starts its surfaces over rather than updating them
+    // incrementally from an unrelated molecule.
+    for(int i = 0; i < job->tileCount; i++){
+        if(b->generation[i] == job->generation[i]) continue;
+        b->generation[i] = job->generation[i];
+        b->sasa[i].valid = false;
+        b->surface[i].valid = false;
     }
 
-    if(presetType == 3 || presetType == 5){
-        if(mol->bondCount > 10){
-            mol->bonds[3].order = 2;
-            mol->bonds[8].order = 2;
-        }
-        if(presetType == 3 && mol->bondCount > 15){
-            mol->bonds[12].order = 2;
+    if(!job->focused){
+        for(int i = 0; i < job->tileCount; i++){
+            RectI tile = get_tile_rect(&job->layout, i);
+            const MoleculeGeometry *geometry = &job->geometry[i];
+            if(job->mode == RENDER_DOTS) sasa_update(&b->sasa[i], geometry);
+            if(job->mode == RENDER_SURFACE) surface_cache_update(&b->surface[i], geometry);
+
+            build_molecule_tile(out,
+                                i,
+                                job->renderTargets,
+                                &job->compounds[i],
+                                geometry,
+                                &tile,
+                                i == job->selectedIndex,
+                                job->mode,
+                                &b->sasa[i],
+                                &b->surface[i],
+                                job->timeSeconds,
+                                &job->views[i],
+                                job->autoRotate,
+                                &job->quality[i]);
         }
+        return;
     }
 
-    if(presetType == 8){
-        add_atom(mol, make_vec3(mol->atomPos[0].x - 1.6f, mol->atomPos[0].y + 0.2f, mol->atomPos[0].z), 2);
-        add_bond(mol, 0, mol->atomCount-1, 1);
+    int s = job->selectedIndex;
+    const MoleculeGeometry *geometry = &job->geometry[s];
+    if(job->mode == RENDER_DOTS){
+        sasa_update(&b->sasa[s], geometry);
+        job->sasaArea = b->sasa[s].totalArea;
+        job->sasaRate = sasa_atoms_per_second(&b->sasa[s]);
     }
-
-    if(presetType == 12 || presetType == 17){
-        add_atom(mol, make_vec3(mol->atomPos[1].x - 1.2f, mol->atomPos[1].y + 1.0f, mol->atomPos[1].z + 0.1f), 3);
-        add_bond(mol, 1, mol->atomCount-1, 1);
+    if(job->mode == RENDER_SURFACE){
+        surface_cache_update(&b->surface[s], geometry);
+        job->surfaceTriangles = b->surface[s].mesh.vertexCount / 3;
     }
+    if(job->traced) return;
+
+    RectI focusRect = get_focus_rect(&job->layout);
+    build_molecule(out,
+                   &job->compounds[s],
+                   geometry,
+                   &focusRect,
+                   true,
+                   job->mode,
+                   &b->sasa[s],
+                   &b->surface[s],
+                   job->timeSeconds,
+                   &job->views[s],
+                   job->autoRotate,
+                   &job->quality[s]);
+}
 
-    if(presetType == 13){
-        add_atom(mol, make_vec3(mol->atomPos[9].x + 1.1f, mol->atomPos[9].y + 0.8f, mol->atomPos[9].z - 0.2f), 4);
-        add_bond(mol, 9, mol->atomCount-1, 1);
+// Profiler overlay: rolling frame times on the left (16.7 and 33.3 ms
+// guides), their distribution in 4 ms buckets on the right.
+static void draw_profiler_hud(SDL_Renderer *renderer, const Layout *layout){
+    float ms[PROF_HISTORY];
+    int count = profiler_frame_history(ms, PROF_HISTORY);
+
+    const int barW = 2;
+    const int graphH = 90;
+    const float msScale = (float)graphH / 50.0f;
+    int x0 = 30, y0 = layout->height - graphH - 30;
+    int graphW = PROF_HISTORY * barW;
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_Rect panel = { x0 - 8, y0 - 8, graphW + 16 + 12 * 10 + 16, graphH + 16 };
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 190);
+    SDL_RenderFillRect(renderer, &panel);
+
+    SDL_Rect bars[PROF_HISTORY];
+    for(int pass = 0; pass < 3; pass++){
+        int n = 0;
+        for(int i = 0; i < count; i++){
+            int bucket = ms[i] < 16.7f ? 0 : (ms[i] < 33.3f ? 1 : 2);
+            if(bucket != pass) continue;
+            int h = (int)clampf(ms[i] * msScale, 1.0f, (float)graphH);
+            bars[n++] = (SDL_Rect){ x0 + (PROF_HISTORY - count + i) * barW, y0 + graphH - h, barW, h };
+        }
+        if(pass == 0) SDL_SetRenderDrawColor(renderer, 46, 204, 113, 230);
+        if(pass == 1) SDL_SetRenderDrawColor(renderer, 241, 196, 15, 230);
+        if(pass == 2) SDL_SetRenderDrawColor(renderer, 231, 76, 60, 230);
+        SDL_RenderFillRects(renderer, bars, n);
     }
 
-    if(presetType == 7 || presetType == 9){
-        add_atom(mol, make_vec3(mol->atomPos[10].x + 0.2f, mol->atomPos[10].y + 1.1f, mol->atomPos[10].z - 0.4f), 1);
-        add_bond(mol, 10, mol->atomCount-1, 1);
-    }
+    SDL_SetRenderDrawColor(renderer, 200, 200, 220, 120);
+    SDL_RenderDrawLine(renderer, x0, y0 + graphH - (int)(16.7f * msScale), x0 + graphW, y0 + graphH - (int)(16.7f * msScale));
+    SDL_RenderDrawLine(renderer, x0, y0 + graphH - (int)(33.3f * msScale), x0 + graphW, y0 + graphH - (int)(33.3f * msScale));
 
-    if(presetType == 4 || presetType == 10 || presetType == 14 || presetType == 15){
-        add_atom(mol, make_vec3(mol->atomPos[11].x + 0.9f, mol->atomPos[11].y - 0.9f, mol->atomPos[11].z + 0.3f), 0);
-        add_bond(mol, 11, mol->atomCount-1, 1);
+    int buckets[12] = {0};
+    int most = 1;
+    for(int i = 0; i < count; i++){
+        int b = (int)(ms[i] / 4.0f);
+        if(b > 11) b = 11;
+        if(++buckets[b] > most) most = buckets[b];
     }
-
-    if(presetType == 11){
-        add_atom(mol, make_vec3(mol->atomPos[6].x + 0.7f, mol->atomPos[6].y + 1.0f, mol->atomPos[6].z), 0);
-        add_bond(mol, 6, mol->atomCount-1, 1);
+    int hx = x0 + graphW + 16;
+    SDL_SetRenderDrawColor(renderer, 120, 170, 255, 230);
+    for(int b = 0; b < 12; b++){
+        int h = buckets[b] * graphH / most;
+        SDL_Rect r = { hx + b * 10, y0 + graphH - h, 8, h };
+        SDL_RenderFillRect(renderer, &r);
     }
 }
 
-static float compute_bounding_radius(const MoleculeGeometry *mol){
-    float maxR2 = 0.0f;
-    for(int i = 0; i < mol->atomCount; i++){
-        float x = mol->atomPos[i].x;
-        float y = mol->atomPos[i].y;
-        float z = mol->atomPos[i].z;
-        float r2 = x*x + y*y + z*z;
-        if(r2 > maxR2) maxR2 = r2;
-    }
-    float r = sqrtf(maxR2);
-    if(r < 0.001f) r = 1.0f;
-    return r;
+// One-line summary of the last frames for the window title.
+static void format_profiler_text(char *out, size_t size){
+    float ms[PROF_HISTORY];
+    int count = profiler_frame_history(ms, PROF_HISTORY);
+    uint64_t counters[PROF_COUNTER_COUNT];
+    profiler_last_counters(counters);
+
+    float sum = 0.0f, worst = 0.0f;
+    for(int i = 0; i < count; i++){
+        sum += ms[i];
+        if(ms[i] > worst) worst = ms[i];
+    }
+    snprintf(out, size, " | P: %.1f ms avg, %.1f max, %llu draws, %llu px, %llu atoms | D: dump trace",
+             count ? sum / (float)count : 0.0f, worst,
+             (unsigned long long)counters[PROF_DRAW_CALLS],
+             (unsigned long long)counters[PROF_PIXELS],
+             (unsigned long long)counters[PROF_ATOMS]);
 }
 
-static void reset_view_control(ViewControl *v){
-    v->yaw = 0.0f;
-    v->pitch = 0.5f;
-    v->panX = 0.0f;
-    v->panY = 0.0f;
-    v->zoomMultiplier = 1.0f;
+// SDL_SetWindowTitle round-trips to the window system, so it only runs
+// when the text actually changes.
+static void update_window_title(SDL_Window *window, char *current, size_t size, const char *title){
+    if(!window || strcmp(current, title) == 0) return;
+    snprintf(current, size, "%s", title);
+    SDL_SetWindowTitle(window, title);
 }
 
-
-static const Compound compounds[COMPOUND_COUNT] = {
-    {"Testosterone",                 0xE74C3CFF, 0,  1.00f},
-    {"Testosterone Enanthate",       0x00D2D3FF, 1,  1.00f},
-    {"Testosterone Cypionate",       0xF1C40FFF, 2,  1.00f},
-    {"Trenbolone",                   0xE056FDFF, 3,  1.00f},
-    {"Nandrolone / Deca",            0x2ECC71FF, 4,  1.00f},
-    {"Boldenone / EQ",               0xE67E22FF, 5,  1.00f},
-    {"Dianabol",                     0x3498DBFF, 6,  1.00f},
-    {"Anavar (Oxandrolone)",         0xFF6B81FF, 7,  1.00f},
-    {"Winstrol (Stanozolol)",        0xF1C40FFF, 8,  1.00f},
-    {"Anadrol (Oxymetholone)",       0x8E1B1BFF, 9,  1.00f},
-    {"Masteron (Drostanolone)",      0x7BED9FFF,10,  1.00f},
-    {"Primobolan (Methenolone)",     0x9B59B6FF,11,  1.00f},
-    {"Turinabol",                    0x00D2D3FF,12,  1.00f},
-    {"Halotestin (Fluoxymesterone)", 0xE67E22FF,13,  1.00f},
-    {"Proviron (Mesterolone)",       0x6C5CE7FF,14,  1.00f},
-    {"Mibolerone",                   0xA55EEAFF,15,  1.00f},
-    {"Superdrol",                    0x8E44ADFF,16,  1.00f},
-    {"Oral Turinabol",               0x1ABC9CFF,17,  1.00f},
-    {"Testosterone Propionate",      0xFF6B81FF,18,  1.00f},
-    {"NPP",                          0x00CEC9FF,19,  1.00f},
-};
-
-
-static RectI get_tile_rect(int index){
-    int col = index % GRID_COLS;
-    int row = index / GRID_COLS;
-
-    int padding = 14;
-    int tileW = (WINDOW_WIDTH - padding * (GRID_COLS + 1)) / GRID_COLS;
-    int tileH = (WINDOW_HEIGHT - padding * (GRID_ROWS + 1)) / GRID_ROWS;
-
-    int x = padding + col * (tileW + padding);
-    int y = padding + row * (tileH + padding);
-    return (RectI){x, y, tileW, tileH};
+typedef struct {
+    const char *recordPath;
+    const char *replayPath;
+    const char *timingsPath;
+    bool fast;     // replay without waiting for the recorded timestamps
+    bool headless; // replay into an offscreen software renderer
+    const char *libraryPath; // tiles show its first entries instead of the presets
+    bool watch;              // reload the library when the file is saved
+    bool shared;             // map the library from shared memory, or publish it there
+
+    // Turntable export
+    const char *exportPath;
+    const char *compound; // index or name
+    int width, height;
+    int frames, fps;
+    float pitch;
+    RenderMode mode;
+} RunOptions;
+
+static void print_usage(const char *argv0){
+    fprintf(stderr,
+            "usage: %s [--library FILE.xyz [--watch]] [--shared] [--record FILE]\n"
+            "       %s --replay FILE [--fast] [--headless] [--timings FILE.csv]\n"
+            "       %s --export DIR|FILE.y4m [--compound INDEX|NAME] [--size WxH] [--frames N]\n"
+            "          [--fps N] [--pitch RADIANS] [--mode ball|wire|dots|surface]\n"
+            "       %s thumbnails --out DIR [options]   (see %s thumbnails --help)\n"
+            "       %s serve --socket PATH [options]    (see %s serve --help)\n"
+            "       %s descriptors [--library FILE.xyz|-] [--format csv|binary]\n",
+            argv0, argv0, argv0, argv0, argv0, argv0, argv0, argv0);
 }
 
-
-static int sort_bonds_far_to_near(const void *a, const void *b){
-    const BondDraw *A = (const BondDraw*)a;
-    const BondDraw *B = (const BondDraw*)b;
-    if(A->depth < B->depth) return -1;
-    if(A->depth > B->depth) return  1;
-    return 0;
+static bool is_export_option(const char *arg){
+    static const char *names[] = { "--compound", "--size", "--frames", "--fps", "--pitch", "--mode" };
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if(strcmp(arg, names[i]) == 0) return true;
+    }
+    return false;
 }
 
-static int sort_atoms_far_to_near(const void *a, const void *b){
-    const AtomDraw *A = (const AtomDraw*)a;
-    const AtomDraw *B = (const AtomDraw*)b;
-    if(A->depth < B->depth) return -1;
-    if(A->depth > B->depth) return  1;
-    return 0;
+static bool parse_options(int argc, char **argv, RunOptions *opt){
+    memset(opt, 0, sizeof(*opt));
+    opt->compound = "0";
+    opt->width = 1280;
+    opt->height = 720;
+    opt->frames = 120;
+    opt->fps = 30;
+    opt->pitch = 0.35f;
+    opt->mode = RENDER_BALL_AND_STICK;
+    bool exportOnly = false; // an option that only applies to --export
+    for(int i = 1; i < argc; i++){
+        if(is_export_option(argv[i])) exportOnly = true;
+        if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) opt->recordPath = argv[++i];
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc) opt->replayPath = argv[++i];
+        else if(strcmp(argv[i], "--timings") == 0 && i + 1 < argc) opt->timingsPath = argv[++i];
+        else if(strcmp(argv[i], "--library") == 0 && i + 1 < argc) opt->libraryPath = argv[++i];
+        else if(strcmp(argv[i], "--watch") == 0) opt->watch = true;
+        else if(strcmp(argv[i], "--shared") == 0) opt->shared = true;
+        else if(strcmp(argv[i], "--fast") == 0) opt->fast = true;
+        else if(strcmp(argv[i], "--headless") == 0) opt->headless = opt->fast = true;
+        else if(strcmp(argv[i], "--export") == 0 && i + 1 < argc) opt->exportPath = argv[++i];
+        else if(strcmp(argv[i], "--compound") == 0 && i + 1 < argc) opt->compound = argv[++i];
+        else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc){
+            if(sscanf(argv[++i], "%dx%d", &opt->width, &opt->height) != 2) return false;
+        }
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) opt->frames = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc) opt->fps = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pitch") == 0 && i + 1 < argc) opt->pitch = (float)atof(argv[++i]);
+        else if(strcmp(argv[i], "--mode") == 0 && i + 1 < argc){
+            if(!render_mode_parse(argv[++i], &opt->mode)) return false;
+        }
+        else return false;
+    }
+    if(opt->recordPath && opt->replayPath) return false;
+    if((opt->fast || opt->timingsPath) && !opt->replayPath) return false;
+    if(opt->exportPath && (opt->recordPath || opt->replayPath)) return false;
+    if(exportOnly && !opt->exportPath) return false;
+    if(opt->libraryPath && opt->exportPath) return false;
+    if(opt->watch && (!opt->libraryPath || opt->replayPath)) return false;
+    if(opt->shared && (opt->exportPath || opt->replayPath)) return false;
+    if(opt->width < 16 || opt->height < 16 || opt->frames < 1 || opt->fps < 1) return false;
+    return true;
 }
 
-
-static void draw_molecule(SDL_Renderer *renderer,
-                          const Compound *compound,
-                          const MoleculeGeometry *mol,
-                          const RectI *rect,
-                          bool isSelected,
-                          bool isWireframe,
-                          float timeSeconds,
-                          const ViewControl *view,
-                          bool autoRotateEnabled){
-    SDL_Rect clip = { rect->x, rect->y, rect->w, rect->h };
-    SDL_RenderSetClipRect(renderer, &clip);
-
-    SDL_SetRenderDrawColor(renderer, 16,16,20,255);
-    SDL_RenderFillRect(renderer, &clip);
-
-    if(isSelected) SDL_SetRenderDrawColor(renderer, 240,240,255,255);
-    else SDL_SetRenderDrawColor(renderer, 60,60,75,255);
-    SDL_RenderDrawRect(renderer, &clip);
-
-    int centerX = rect->x + rect->w / 2;
-    int centerY = rect->y + rect->h / 2;
-
-    float radius = compute_bounding_radius(mol);
-    float minDim = (float)((rect->w < rect->h) ? rect->w : rect->h);
-    float baseZoom = (minDim * 0.38f) / radius;
-    float zoom = baseZoom * compound->baseScale * view->zoomMultiplier;
-
-    float autoYaw = 0.0f;
-    float autoPitch = 0.0f;
-    if(autoRotateEnabled){
-        autoYaw = timeSeconds * 0.7f;
-        autoPitch = timeSeconds * 0.25f;
+static int find_compound(const char *key){
+    char *end;
+    long index = strtol(key, &end, 10);
+    if(*end == '\0') return (index >= 0 && index < COMPOUND_COUNT) ? (int)index : -1;
+    for(int i = 0; i < COMPOUND_COUNT; i++){
+        if(strcasecmp(compounds[i].name, key) == 0) return i;
     }
+    return -1;
+}
 
-    float yaw = autoYaw + view->yaw;
-    float pitch = autoPitch + view->pitch;
-
-    int panX = (int)lroundf(view->panX);
-    int panY = (int)lroundf(view->panY);
-
-    BondDraw bondDraws[MAX_BONDS];
-    int bondDrawCount = 0;
-
-    AtomDraw atomDraws[MAX_ATOMS];
-    int atomDrawCount = 0;
-
-    int projectedX[MAX_ATOMS];
-    int projectedY[MAX_ATOMS];
-    float projectedDepth[MAX_ATOMS];
+#define EXPORT_RING_SIZE 4
 
-    for(int i = 0; i < mol->atomCount; i++){
-        Vec3 rp = rotate_yaw_pitch(mol->atomPos[i], yaw, pitch);
-        int sx, sy;
-        float d;
-        project_to_screen(rp, zoom, centerX + panX, centerY + panY, &sx, &sy, &d);
-        projectedX[i] = sx;
-        projectedY[i] = sy;
-        projectedDepth[i] = d;
+// Renders one full yaw turn of a compound at a fixed pitch, offscreen and
+// as fast as the CPU allows. Frame i is at yaw 2*pi*i/frames, so the clip
+// loops and two exports with the same options are identical.
+static int run_export(const RunOptions *opt){
+    int index = find_compound(opt->compound);
+    if(index < 0){
+        fprintf(stderr, "export: no compound '%s'\n", opt->compound);
+        return 2;
     }
-
-    for(int i = 0; i < mol->bondCount; i++){
-        Bond b = mol->bonds[i];
-
-        int x1 = projectedX[b.from];
-        int y1 = projectedY[b.from];
-        int x2 = projectedX[b.to];
-        int y2 = projectedY[b.to];
-
-        float depth = (projectedDepth[b.from] + projectedDepth[b.to]) * 0.5f;
-
-        uint8_t alpha = isSelected ? 230 : 140;
-
-        bondDraws[bondDrawCount++] = (BondDraw){
-            x1,y1,x2,y2,
-            depth,
-            b.order,
-            compound->colorRGBA,
-            alpha
-        };
+    ExportFormat format = export_format_for_path(opt->exportPath);
+    if(format == EXPORT_Y4M && (opt->width % 2 || opt->height % 2)){
+        fprintf(stderr, "export: Y4M needs an even width and height\n");
+        return 2;
     }
 
-    for(int i = 0; i < mol->atomCount; i++){
-        uint32_t atomColor = compound->colorRGBA;
-        if(mol->atomLabel[i] == 1) atomColor = 0xFF4757FF; // O
-        if(mol->atomLabel[i] == 2) atomColor = 0x5F27CDFF; // N
-        if(mol->atomLabel[i] == 3) atomColor = 0x1DD1A1FF; // Cl
-        if(mol->atomLabel[i] == 4) atomColor = 0x48DBFBFF; // F
-
-        float depthScale = clampf(1.0f - projectedDepth[i] * 0.05f, 0.6f, 1.35f);
-
-        float baseSize = isWireframe ? 3.5f : 7.0f;
-        if(mol->atomLabel[i] == 1) baseSize = isWireframe ? 4.0f : 8.0f;
-        if(mol->atomLabel[i] == 3 || mol->atomLabel[i] == 4) baseSize = isWireframe ? 4.2f : 9.0f;
+    if(SDL_Init(0) != 0) return 1;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, opt->width, opt->height, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    FrameWriter *writer = renderer ? frame_writer_open(opt->exportPath, format, opt->width, opt->height,
+                                                       opt->fps, EXPORT_RING_SIZE) : NULL;
+    if(!writer){
+        fprintf(stderr, "export: cannot write %s\n", opt->exportPath);
+        if(renderer) SDL_DestroyRenderer(renderer);
+        if(surface) SDL_FreeSurface(surface);
+        SDL_Quit();
+        return 1;
+    }
 
-        int rad = (int)lroundf(baseSize * depthScale);
+    MoleculeGeometry mol;
+    apply_preset(&mol, compounds[index].presetType);
+    ff_relax_library(&mol, 1);
+    SasaCache sasa;
+    sasa_cache_init(&sasa);
+    SurfaceCache mesh;
+    surface_cache_init(&mesh);
+    if(opt->mode == RENDER_DOTS) sasa_update(&sasa, &mol);
+    if(opt->mode == RENDER_SURFACE) surface_cache_update(&mesh, &mol);
+
+    SubmitResources resources = { NULL, 0, glyph_atlas_create(renderer) };
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    RectI rect = { 0, 0, opt->width, opt->height };
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    for(int i = 0; i < opt->frames; i++){
+        ViewControl view;
+        reset_view_control(&view);
+        view.yaw = 2.0f * PI * (float)i / (float)opt->frames;
+        view.pitch = opt->pitch;
+
+        command_buffer_reset(&cb);
+        build_molecule(&cb, &compounds[index], &mol, &rect, false, opt->mode, &sasa, &mesh,
+                       0.0f, &view, false, &tileQualityFull);
+        SDL_SetRenderDrawColor(renderer, 10,10,14,255);
+        SDL_RenderClear(renderer);
+        command_buffer_submit(&cb, renderer, &resources);
 
-        atomDraws[atomDrawCount++] = (AtomDraw){
-            i,
-            projectedDepth[i],
-            projectedX[i],
-            projectedY[i],
-            rad,
-            atomColor
-        };
+        // Waits only if the writer has fallen a whole ring behind.
+        uint32_t *pixels = frame_writer_acquire(writer);
+        SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, pixels, opt->width * (int)sizeof(uint32_t));
+        frame_writer_submit(writer);
+    }
+    bool ok = frame_writer_close(writer);
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+    if(ok){
+        printf("export: %d frames of %s at %dx%d in %.2f s (%.1f fps, %.1fx real time at %d fps)\n",
+               opt->frames, compounds[index].name, opt->width, opt->height, seconds,
+               opt->frames / seconds, opt->frames / seconds / opt->fps, opt->fps);
+    } else {
+        fprintf(stderr, "export: write to %s failed\n", opt->exportPath);
     }
 
-    qsort(bondDraws, bondDrawCount, sizeof(BondDraw), sort_bonds_far_to_near);
-    qsort(atomDraws, atomDrawCount, sizeof(AtomDraw), sort_atoms_far_to_near);
-
-    for(int i = 0; i < bondDrawCount; i++){
-        BondDraw bd = bondDraws[i];
+    command_buffer_free(&cb);
+    surface_cache_free(&mesh);
+    if(resources.glyphs) SDL_DestroyTexture(resources.glyphs);
+    thread_pool_shutdown();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
 
-        if(isWireframe){
-            uint32_t bright = lighten(bd.color, 0.20f);
-            set_draw_color(renderer, darken(bd.color, 0.55f), bd.alpha);
-            draw_thick_line(renderer, bd.x1,bd.y1,bd.x2,bd.y2, 4);
+typedef struct {
+    uint32_t *clockMs; // virtual time of each frame
+    float *ms;         // CPU time spent on it
+    int count, capacity;
+} FrameTimings;
+
+static void timings_push(FrameTimings *t, uint32_t clockMs, float ms){
+    if(t->count == t->capacity){
+        int capacity = t->capacity ? t->capacity * 2 : 1024;
+        uint32_t *clock = realloc(t->clockMs, sizeof(uint32_t) * (size_t)capacity);
+        if(clock) t->clockMs = clock;
+        float *grown = realloc(t->ms, sizeof(float) * (size_t)capacity);
+        if(grown) t->ms = grown;
+        if(!clock || !grown) return;
+        t->capacity = capacity;
+    }
+    t->clockMs[t->count] = clockMs;
+    t->ms[t->count++] = ms;
+}
 
-            set_draw_color(renderer, bright, bd.alpha);
-            draw_thick_line(renderer, bd.x1,bd.y1,bd.x2,bd.y2, 2);
+static int compare_floats(const void *a, const void *b){
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
 
-            if(bd.order == 2){
-                set_draw_color(renderer, bright, bd.alpha);
-                draw_thick_line(renderer, bd.x1+2,bd.y1-2,bd.x2+2,bd.y2-2, 2);
-            }
+// Per-frame CPU time of a replay (pacing delay excluded) as CSV, plus a
+// summary on stdout.
+static void report_timings(const FrameTimings *t, const char *path){
+    if(t->count == 0) return;
+    if(path){
+        FILE *f = fopen(path, "w");
+        if(f){
+            fprintf(f, "frame,time_ms,frame_ms\n");
+            for(int i = 0; i < t->count; i++) fprintf(f, "%d,%u,%.4f\n", i, t->clockMs[i], t->ms[i]);
+            fclose(f);
         } else {
-            draw_stick(renderer, bd.x1,bd.y1,bd.x2,bd.y2, bd.order, bd.color, bd.alpha);
+            printf("replay: could not write %s\n", path);
         }
     }
 
-    for(int i = 0; i < atomDrawCount; i++){
-        AtomDraw ad = atomDraws[i];
-
-        if(isWireframe){
-            uint32_t c = lighten(ad.color, 0.05f);
-            set_draw_color(renderer, c, isSelected ? 220 : 170);
-            draw_filled_circle(renderer, ad.screenX, ad.screenY, (int)clampf(ad.radius, 2, 5));
-            continue;
-        }
-
-        set_draw_color(renderer, darken(ad.color, 0.40f), 255);
-        draw_filled_circle(renderer, ad.screenX, ad.screenY, ad.radius + 2);
-
-        set_draw_color(renderer, ad.color, 255);
-        draw_filled_circle(renderer, ad.screenX, ad.screenY, ad.radius);
-
-        int hx = ad.screenX - ad.radius/3;
-        int hy = ad.screenY - ad.radius/3;
-        uint32_t hi = lighten(ad.color, 0.60f);
-        set_draw_color(renderer, hi, 220);
-        draw_filled_circle(renderer, hx, hy, (int)clampf(ad.radius*0.45f, 2, 12));
+    float *sorted = malloc(sizeof(float) * (size_t)t->count);
+    if(!sorted) return;
+    memcpy(sorted, t->ms, sizeof(float) * (size_t)t->count);
+    qsort(sorted, (size_t)t->count, sizeof(float), compare_floats);
+    double sum = 0.0;
+    for(int i = 0; i < t->count; i++) sum += sorted[i];
+    printf("replay: %d frames, mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f\n",
+           t->count, sum / t->count,
+           sorted[t->count / 2],
+           sorted[(int)((t->count - 1) * 0.95)],
+           sorted[(int)((t->count - 1) * 0.99)],
+           sorted[t->count - 1]);
+    free(sorted);
+}
 
-        set_draw_color(renderer, 0xFFFFFFFF, 200);
-        draw_filled_circle(renderer, hx - 2, hy - 2, (int)clampf(ad.radius*0.12f, 1, 4));
+int main(int argc, char **argv){
+    if(argc > 1 && strcmp(argv[1], "thumbnails") == 0) return thumbnails_main(argc - 1, argv + 1);
+    if(argc > 1 && strcmp(argv[1], "serve") == 0) return server_main(argc - 1, argv + 1);
+    if(argc > 1 && strcmp(argv[1], "descriptors") == 0) return descriptors_main(argc - 1, argv + 1);
 
-        int label = mol->atomLabel[ad.atomIndex];
-        if(isSelected && label != 0){
-            SDL_SetRenderDrawColor(renderer, 245,245,255,255);
-            draw_atom_label(renderer, ad.screenX + ad.radius + 4, ad.screenY - 6, label);
+    RunOptions options;
+    if(!parse_options(argc, argv, &options)){
+        print_usage(argv[0]);
+        return 2;
+    }
+    if(options.exportPath) return run_export(&options);
+
+    // --shared viewers draw from a snapshot in shared memory, except one
+    // that also watches: it keeps a private copy to reload and republishes
+    // it for the others to follow.
+    static Library lib;
+    static LibrarySource source;
+    static LibraryStore store;
+    static LibrarySnapshot snapshot;
+    library_init(&lib);
+    bool privateLibrary = options.libraryPath && (!options.shared || options.watch);
+    uint64_t loadedStamp = 0;
+    if(privateLibrary && options.shared) library_store_stamp(options.libraryPath, &loadedStamp);
+    if(privateLibrary && !load_library(&source, &lib, options.libraryPath)) return 1;
+    bool shared = false;
+    if(options.shared){
+        uint64_t start = SDL_GetPerformanceCounter();
+        char error[256];
+        shared = library_store_open(&store, options.libraryPath, privateLibrary ? &lib : NULL, loadedStamp, error, sizeof(error)) &&
+                 (privateLibrary || library_store_map(&store, &snapshot, error, sizeof(error)));
+        if(shared){
+            printf("store: %s generation %llu in %.1f ms, %d compounds\n", store.built ? "published" : "attached to",
+                   (unsigned long long)library_store_generation(&store), ms_since(start),
+                   privateLibrary ? lib.count : snapshot.lib.count);
+        } else {
+            fprintf(stderr, "store: %s; using a private copy\n", error);
+            library_store_close(&store);
+            if(options.libraryPath && !privateLibrary){
+                privateLibrary = true;
+                if(!load_library(&source, &lib, options.libraryPath)) return 1;
+            }
+        }
+    }
+    bool following = shared && !privateLibrary;
+    const Library *tileSource = following ? &snapshot.lib : privateLibrary ? &lib : NULL;
+
+    InputReplay *replay = NULL;
+    if(options.replayPath){
+        replay = replay_open(options.replayPath);
+        if(!replay){
+            fprintf(stderr, "replay: cannot read %s\n", options.replayPath);
+            return 1;
         }
     }
 
-    SDL_RenderSetClipRect(renderer, NULL);
-}
-
-
-int main(void){
-    if(SDL_Init(SDL_INIT_VIDEO) != 0) return 1;
-
-    SDL_Window *window = SDL_CreateWindow(
-        "pk_rk4 | Structural Atlas",
-        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        WINDOW_WIDTH, WINDOW_HEIGHT,
-        SDL_WINDOW_SHOWN
-    );
-    if(!window) return 1;
-
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if(SDL_Init(options.headless ? 0 : SDL_INIT_VIDEO) != 0) return 1;
+
+    SDL_Window *window = NULL;
+    SDL_Surface *offscreen = NULL;
+    SDL_Renderer *renderer = NULL;
+    if(options.headless){
+        // Offscreen at the recorded drawable size; the layout stays put.
+        int w, h;
+        replay_window_size(replay, &w, &h);
+        offscreen = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+        if(!offscreen) return 1;
+        renderer = SDL_CreateSoftwareRenderer(offscreen);
+    } else {
+        window = SDL_CreateWindow(
+            "pk_rk4 | Structural Atlas",
+            SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+            WINDOW_WIDTH, WINDOW_HEIGHT,
+            SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
+        );
+        if(!window) return 1;
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+    }
     if(!renderer) return 1;
 
+    Layout layout = { WINDOW_WIDTH, WINDOW_HEIGHT, 1.0f };
+    update_layout(&layout, window, renderer);
+
+    // Unselected tiles give up detail first when frames run long;
+    // ATLAS_FRAME_BUDGET_MS sets the target (default 16.7).
+    QualityGovernor governor;
+    const char *budgetEnv = getenv("ATLAS_FRAME_BUDGET_MS");
+    governor_init(&governor, budgetEnv ? (float)atof(budgetEnv) : 16.7f);
+    TileTexture tileTextures[COMPOUND_COUNT];
+    memset(tileTextures, 0, sizeof(tileTextures));
+    SubmitResources resources = { tileTextures, COMPOUND_COUNT, glyph_atlas_create(renderer) };
+    char windowTitle[512] = "";
+
+    InputRecorder *recorder = NULL;
+    if(options.recordPath){
+        recorder = recorder_open(options.recordPath, layout.width, layout.height);
+        if(!recorder) fprintf(stderr, "record: cannot write %s\n", options.recordPath);
+    }
+    FrameTimings timings = {0};
+
+    // Tiles show the presets, or the first entries of --library or of the
+    // shared store.
+    bool builtin = !options.libraryPath;
     MoleculeGeometry moleculeCache[COMPOUND_COUNT];
-    for(int i = 0; i < COMPOUND_COUNT; i++){
-        apply_preset(&moleculeCache[i], compounds[i].presetType);
+    Compound tileCompounds[COMPOUND_COUNT];
+    char tileNames[COMPOUND_COUNT][LIBRARY_NAME_MAX];
+    unsigned tileGeneration[COMPOUND_COUNT] = {0};
+    int tileCount = tileSource && tileSource->count < COMPOUND_COUNT ? tileSource->count : COMPOUND_COUNT;
+    for(int i = 0; i < tileCount; i++){
+        if(tileSource){
+            load_tile(tileSource, builtin, i, &moleculeCache[i], &tileCompounds[i], tileNames[i]);
+        } else {
+            apply_preset(&moleculeCache[i], compounds[i].presetType);
+            tileCompounds[i] = compounds[i];
+            snprintf(tileNames[i], sizeof(tileNames[i]), "%s", tileCompounds[i].name);
+            tileCompounds[i].name = tileNames[i];
+        }
     }
 
+    // Presets are drawn immediately; force-field relaxed geometry and its
+    // conformers replace them once the background pass finishes. A shared
+    // store already holds the relaxed ones.
+    static LibraryPrep prep;
+    memcpy(prep.molecules, moleculeCache, sizeof(prep.molecules));
+    prep.count = tileCount;
+    prep.relax = !tileSource;
+    BackgroundTask *prepTask = background_task_start(prepare_library_job, &prep);
+    const ConformerSet *conformers = NULL;
+    int conformerIndex[COMPOUND_COUNT] = {0};
+
     ViewControl viewControls[COMPOUND_COUNT];
     for(int i = 0; i < COMPOUND_COUNT; i++) reset_view_control(&viewControls[i]);
 
     int selectedIndex = 0;
-    bool isWireframe = false;
+    RenderMode renderMode = RENDER_BALL_AND_STICK;
+    static FrameBuilder builder;
+    for(int i = 0; i < COMPOUND_COUNT; i++) sasa_cache_init(&builder.sasa[i]);
+    for(int i = 0; i < COMPOUND_COUNT; i++) surface_cache_init(&builder.surface[i]);
+
+    // Frame N+1 is recorded on the builder thread while frame N is
+    // submitted here, at the cost of one frame of latency. ATLAS_PIPELINE=0
+    // builds and submits each frame in turn.
+    const char *pipelineEnv = getenv("ATLAS_PIPELINE");
+    FramePipeline *pipeline = NULL;
+    if(!pipelineEnv || atoi(pipelineEnv) != 0) pipeline = pipeline_create(build_frame, &builder);
+    static FrameJob frameJobs[2];
+    int jobIndex = 0;
+    CommandBuffer syncBuffer;
+    command_buffer_init(&syncBuffer);
+    bool renderTargets = SDL_RenderTargetSupported(renderer);
     bool isFocused = false;
     bool autoRotateEnabled = true;
+    bool vibrationEnabled = false;
+    bool traceEnabled = true;
+    TraceTarget traceTarget = { tracer_create(), NULL, 0, 0, 0 };
+
+    MdSimulation *vibration = md_create(COMPOUND_COUNT);
+    // A replay must not depend on how fast this machine is: vibration
+    // advances per recorded frame and tracing by a fixed sample count.
+    if(replay){
+        md_set_stepped(vibration, true);
+        traceTarget.samplesPerFrame = 1;
+    }
+    bool vibrationLoaded = false;
+
+    FileWatch watch = { -1, -1, "" };
+    if(options.watch && !file_watch_open(&watch, options.libraryPath)){
+        fprintf(stderr, "library: cannot watch %s\n", options.libraryPath);
+    }
+    static LibraryReload reload;
+    BackgroundTask *reloadTask = NULL;
+    bool reloadPending = false;
+    if(shared) reload.store = &store;
+    uint64_t requested = 0, unmappable = 0; // a generation that failed to map is not retried
 
     bool leftDragging = false;
     bool rightDragging = false;
@@ -624,27 +801,80 @@ int main(void){
     int lastMouseY = 0;
 
     uint32_t startTicks = SDL_GetTicks();
+    uint64_t replayStart = SDL_GetPerformanceCounter();
     bool running = true;
 
     while(running){
+        PROF_SCOPE("frame");
+        uint64_t frameStart = SDL_GetPerformanceCounter();
+
+        // The frame clock is the only time source the scene sees, so a
+        // replay reproduces the recorded animation exactly.
+        uint32_t frameMs = SDL_GetTicks() - startTicks;
+        if(replay){
+            if(!replay_next_frame(replay, &frameMs)) break;
+            if(!options.fast){
+                double due = (double)frameMs * 0.001;
+                double now = (double)(SDL_GetPerformanceCounter() - replayStart) / (double)SDL_GetPerformanceFrequency();
+                if(due > now) SDL_Delay((uint32_t)((due - now) * 1000.0));
+                frameStart = SDL_GetPerformanceCounter();
+            }
+            if(window){
+                SDL_Event live;
+                while(SDL_PollEvent(&live)){
+                    if(live.type == SDL_QUIT) running = false;
+                    if(live.type == SDL_KEYDOWN && live.key.keysym.sym == SDLK_ESCAPE) running = false;
+                }
+            }
+        }
+        recorder_frame(recorder, frameMs);
+
+        ProfScope eventsScope = PROF_BEGIN("events");
         SDL_Event e;
-        while(SDL_PollEvent(&e)){
+        while(replay ? replay_poll_event(replay, &e) : SDL_PollEvent(&e)){
+            recorder_event(recorder, &e);
             if(e.type == SDL_QUIT) running = false;
 
             if(e.type == SDL_KEYDOWN){
                 SDL_Keycode key = e.key.keysym.sym;
 
                 if(key == SDLK_ESCAPE) running = false;
-                if(key == SDLK_SPACE) isWireframe = !isWireframe;
+                if(key == SDLK_SPACE) renderMode = (RenderMode)((renderMode + 1) % RENDER_MODE_COUNT);
                 if(key == SDLK_RETURN) isFocused = !isFocused;
                 if(key == SDLK_r) reset_view_control(&viewControls[selectedIndex]);
                 if(key == SDLK_a) autoRotateEnabled = !autoRotateEnabled;
+                if(key == SDLK_t) traceEnabled = !traceEnabled;
+                if(key == SDLK_g) governor_set_enabled(&governor, !governor.enabled);
+                if(key == SDLK_p) profiler_set_enabled(!profiler_enabled());
+                if(key == SDLK_d){
+                    const char *path = getenv("ATLAS_TRACE_FILE");
+                    if(!path) path = "pk_rk4_trace.json";
+                    if(profiler_dump_chrome_trace(path)) printf("profiler: trace written to %s\n", path);
+                    else printf("profiler: could not write %s\n", path);
+                }
+                if(key == SDLK_v && vibration){
+                    vibrationEnabled = !vibrationEnabled;
+                    if(vibrationEnabled && !vibrationLoaded){
+                        for(int i = 0; i < tileCount; i++) md_load(vibration, i, &moleculeCache[i]);
+                        vibrationLoaded = true;
+                    }
+                    md_set_running(vibration, vibrationEnabled);
+                }
+
+                if(key == SDLK_c && isFocused && conformers){
+                    const ConformerSet *set = &conformers[selectedIndex];
+                    int next = (conformerIndex[selectedIndex] + 1) % set->count;
+                    conformerIndex[selectedIndex] = next;
+                    MoleculeGeometry *mol = &moleculeCache[selectedIndex];
+                    memcpy(mol->atomPos, set->pos[next], sizeof(Vec3) * (size_t)mol->atomCount);
+                    if(vibrationLoaded) md_load(vibration, selectedIndex, mol);
+                }
 
                 if(!isFocused){
                     if(key == SDLK_LEFT)  selectedIndex = (selectedIndex % GRID_COLS == 0) ? selectedIndex : selectedIndex - 1;
-                    if(key == SDLK_RIGHT) selectedIndex = (selectedIndex % GRID_COLS == GRID_COLS - 1) ? selectedIndex : selectedIndex + 1;
+                    if(key == SDLK_RIGHT) selectedIndex = (selectedIndex % GRID_COLS == GRID_COLS - 1 || selectedIndex + 1 >= tileCount) ? selectedIndex : selectedIndex + 1;
                     if(key == SDLK_UP)    selectedIndex = (selectedIndex - GRID_COLS >= 0) ? selectedIndex - GRID_COLS : selectedIndex;
-                    if(key == SDLK_DOWN)  selectedIndex = (selectedIndex + GRID_COLS < COMPOUND_COUNT) ? selectedIndex + GRID_COLS : selectedIndex;
+                    if(key == SDLK_DOWN)  selectedIndex = (selectedIndex + GRID_COLS < tileCount) ? selectedIndex + GRID_COLS : selectedIndex;
                 }
             }
 
@@ -691,64 +921,254 @@ int main(void){
                 ViewControl *v = &viewControls[selectedIndex];
                 if(e.wheel.y > 0) v->zoomMultiplier *= 1.08f;
                 if(e.wheel.y < 0) v->zoomMultiplier *= 0.92f;
-                v->zoomMultiplier = clampf(v->zoomMultiplier, 0.35f, 4.0f);
+                v->zoomMultiplier = clampf(v->zoomMultiplier, VIEW_ZOOM_MIN, VIEW_ZOOM_MAX);
+            }
+        }
+        PROF_END(eventsScope);
+
+        bool libraryReady = prepTask && (replay ? (replay_frame_markers(replay) & REPLAY_MARKER_LIBRARY_READY) != 0
+                                                : background_task_done(prepTask));
+        if(libraryReady){
+            // A replay waits here for the relaxation if this machine is
+            // slower than the recording one.
+            background_task_join(prepTask);
+            recorder_marker(recorder, REPLAY_MARKER_LIBRARY_READY);
+            prepTask = NULL;
+            memcpy(moleculeCache, prep.molecules, sizeof(moleculeCache));
+            conformers = prep.conformers;
+            if(vibrationLoaded){
+                for(int i = 0; i < tileCount; i++) md_load(vibration, i, &moleculeCache[i]);
+            }
+        }
+
+        // Saves made while a reload runs are picked up by the next one.
+        if(file_watch_changed(&watch)) reloadPending = true;
+        if(reloadPending && !reloadTask && !prepTask){
+            reloadPending = false;
+            reload.src = &source;
+            reload.lib = &lib;
+            reloadTask = background_task_start(reload_library_job, &reload);
+        }
+        // Following viewers only poll the generation word; the new snapshot
+        // is mapped and compared off the UI thread.
+        uint64_t latest = following ? library_store_generation(&store) : 0;
+        if(following && !reloadTask && !prepTask && latest != snapshot.generation && latest != unmappable){
+            requested = latest;
+            reload.current = &snapshot.lib;
+            reloadTask = background_task_start(follow_store_job, &reload);
+        }
+        if(reloadTask && background_task_done(reloadTask)){
+            background_task_join(reloadTask);
+            reloadTask = NULL;
+            if(!reload.ok && following){
+                fprintf(stderr, "store: %s; keeping generation %llu\n", reload.error, (unsigned long long)snapshot.generation);
+                unmappable = requested;
+            } else if(!reload.ok){
+                fprintf(stderr, "library: %s; keeping the last good version\n", reload.error);
+            } else if(reload.tileCount == 0){
+                printf("library: %s has no compounds; keeping the tiles\n", options.libraryPath);
+                if(following) unmappable = reload.next.generation;
+                library_snapshot_unmap(&reload.next);
+            } else {
+                int refreshed = 0;
+                tileCount = reload.tileCount;
+                for(int i = 0; i < tileCount; i++){
+                    if(!reload.tileChanged[i]) continue;
+                    load_tile(reload.lib, builtin, i, &moleculeCache[i], &tileCompounds[i], tileNames[i]);
+                    tileGeneration[i]++;
+                    prep.conformers[i] = reload.conformers[i];
+                    conformerIndex[i] = 0;
+                    if(vibrationLoaded) md_load(vibration, i, &moleculeCache[i]);
+                    refreshed++;
+                }
+                if(selectedIndex >= tileCount) selectedIndex = tileCount - 1;
+                if(following){
+                    // Nothing points into the old snapshot any more.
+                    library_snapshot_unmap(&snapshot);
+                    snapshot = reload.next;
+                    memset(&reload.next, 0, sizeof(reload.next));
+                    printf("store: swapped to generation %llu in %.1f ms, %d tiles refreshed\n",
+                           (unsigned long long)snapshot.generation, reload.ms, refreshed);
+                } else {
+                    printf("library: reloaded in %.1f ms, %d records parsed, %d tiles refreshed\n",
+                           reload.ms, reload.delta.recordsParsed, refreshed);
+                    if(reload.published){
+                        printf("store: published generation %llu in %.1f ms\n",
+                               (unsigned long long)library_store_generation(&store), reload.publishMs);
+                    } else if(reload.storeError[0]){
+                        fprintf(stderr, "store: %s\n", reload.storeError);
+                    }
+                }
             }
+            library_delta_free(&reload.delta);
+        }
+
+        for(int i = 0; i < tileCount; i++){
+            md_set_active(vibration, i, !isFocused || i == selectedIndex);
+        }
+        md_step_frame(vibration);
+
+        float timeSeconds = frameMs * 0.001f;
+        if(window) update_layout(&layout, window, renderer);
+
+        FrameJob *job = &frameJobs[jobIndex];
+        job->layout = layout;
+        job->focused = isFocused;
+        // Accumulation restarts whenever the view moves, so tracing waits
+        // until auto-rotation and vibration stop animating it.
+        bool animating = autoRotateEnabled || vibrationEnabled;
+        job->traced = isFocused && traceEnabled && !animating && traceTarget.tracer && renderMode == RENDER_BALL_AND_STICK;
+        job->renderTargets = renderTargets;
+        job->selectedIndex = selectedIndex;
+        job->mode = renderMode;
+        job->timeSeconds = timeSeconds;
+        job->autoRotate = autoRotateEnabled;
+        job->tileCount = tileCount;
+        memcpy(job->views, viewControls, sizeof(job->views));
+        for(int i = 0; i < tileCount; i++){
+            memcpy(job->names[i], tileNames[i], sizeof(job->names[i]));
+            job->compounds[i] = tileCompounds[i];
+            job->compounds[i].name = job->names[i];
+            job->generation[i] = tileGeneration[i];
+            if(isFocused && i != selectedIndex) continue;
+            const MoleculeGeometry *geometry = animated_geometry(vibration, i, &moleculeCache[i], &job->geometry[i]);
+            if(geometry != &job->geometry[i]) job->geometry[i] = *geometry;
+            job->quality[i] = governor_tile_quality(&governor, i == selectedIndex, layout.dpiScale);
+            job->quality[i].carbonLabels = isFocused;
         }
 
-        float timeSeconds = (SDL_GetTicks() - startTicks) * 0.001f;
+        // Collect the frame built last time round, then start on this one.
+        CommandBuffer *ready;
+        const FrameJob *shown;
+        if(pipeline){
+            ready = pipeline_wait(pipeline);
+            shown = ready ? &frameJobs[jobIndex ^ 1] : NULL;
+            pipeline_begin(pipeline, job);
+        } else {
+            command_buffer_reset(&syncBuffer);
+            build_frame(&builder, job, &syncBuffer);
+            ready = &syncBuffer;
+            shown = job;
+        }
+        jobIndex ^= 1;
 
         SDL_SetRenderDrawColor(renderer, 10,10,14,255);
         SDL_RenderClear(renderer);
+        if(ready) command_buffer_submit(ready, renderer, &resources);
+
+        char profileText[128] = "";
+        if(profiler_enabled()) format_profiler_text(profileText, sizeof(profileText));
 
-        if(!isFocused){
-            for(int i = 0; i < COMPOUND_COUNT; i++){
-                RectI tile = get_tile_rect(i);
-                bool tileSelected = (i == selectedIndex);
-
-                draw_molecule(renderer,
-                              &compounds[i],
-                              &moleculeCache[i],
-                              &tile,
-                              tileSelected,
-                              isWireframe,
-                              timeSeconds,
-                              &viewControls[i],
-                              autoRotateEnabled);
+        if(shown && !shown->focused){
+            char qualityText[48] = "G: quality fixed";
+            if(governor.enabled){
+                TileQuality q = governor_tile_quality(&governor, false, 1.0f);
+                snprintf(qualityText, sizeof(qualityText), "G: quality %d%%%s",
+                         (int)lroundf(q.resolution * 100.0f), q.highlights ? "" : " lite");
             }
 
-            char title[320];
+            char title[480];
             snprintf(title, sizeof(title),
-                     "pk_rk4 | Structural Atlas | selected: %s | Space: mode | Enter: focus | Arrows: move | Mouse: rotate/pan/zoom | R: reset | A: auto %s",
-                     compounds[selectedIndex].name,
-                     autoRotateEnabled ? "ON" : "OFF");
-            SDL_SetWindowTitle(window, title);
-        } else {
-            RectI focusRect = { 20, 20, WINDOW_WIDTH - 40, WINDOW_HEIGHT - 40 };
-
-            draw_molecule(renderer,
-                          &compounds[selectedIndex],
-                          &moleculeCache[selectedIndex],
-                          &focusRect,
-                          true,
-                          isWireframe,
-                          timeSeconds,
-                          &viewControls[selectedIndex],
-                          autoRotateEnabled);
-
-            char title[320];
+                     "pk_rk4 | Structural Atlas | selected: %s | Space: mode | Enter: focus | Arrows: move | Mouse: rotate/pan/zoom | R: reset | A: auto %s | V: vibrate %s | %s%s",
+                     shown->compounds[shown->selectedIndex].name,
+                     autoRotateEnabled ? "ON" : "OFF",
+                     vibrationEnabled ? "ON" : "OFF",
+                     qualityText,
+                     profileText);
+            update_window_title(window, windowTitle, sizeof(windowTitle), title);
+        } else if(shown){
+            int s = shown->selectedIndex;
+            if(shown->traced){
+                // The tracer keeps its own texture and refines across
+                // frames, so it stays on this thread.
+                RectI focusRect = get_focus_rect(&shown->layout);
+                ViewTransform vt = compute_view_transform(&shown->compounds[s], &shown->geometry[s], &focusRect,
+                                                          shown->timeSeconds, &shown->views[s], shown->autoRotate,
+                                                          shown->layout.dpiScale);
+                draw_traced_molecule(renderer, &traceTarget, &shown->compounds[s], &shown->geometry[s], &focusRect, &vt);
+            }
+
+            char conformerText[48] = "C: conformers pending";
+            if(conformers){
+                snprintf(conformerText, sizeof(conformerText), "C: conformer %d/%d",
+                         conformerIndex[s] + 1, conformers[s].count);
+            }
+
+            char surfaceText[64] = "";
+            if(shown->mode == RENDER_DOTS){
+                snprintf(surfaceText, sizeof(surfaceText), " | SASA %.0f A^2 (%.0f atoms/s)",
+                         shown->sasaArea, shown->sasaRate);
+            }
+            if(shown->mode == RENDER_SURFACE){
+                snprintf(surfaceText, sizeof(surfaceText), " | surface %d triangles", shown->surfaceTriangles);
+            }
+            if(shown->mode == RENDER_BALL_AND_STICK){
+                if(shown->traced) snprintf(surfaceText, sizeof(surfaceText), " | T: trace ON (%d spp)", tracer_samples(traceTarget.tracer));
+                else if(traceEnabled) snprintf(surfaceText, sizeof(surfaceText), " | T: trace paused (stop A/V)");
+                else snprintf(surfaceText, sizeof(surfaceText), " | T: trace OFF");
+            }
+
+            char title[512];
             snprintf(title, sizeof(title),
-                     "pk_rk4 | Focus: %s | Space: mode | Enter: back | Mouse: rotate/pan/zoom | R: reset | A: auto %s",
-                     compounds[selectedIndex].name,
-                     autoRotateEnabled ? "ON" : "OFF");
-            SDL_SetWindowTitle(window, title);
+                     "pk_rk4 | Focus: %s | Space: mode | Enter: back | Mouse: rotate/pan/zoom | R: reset | A: auto %s | V: vibrate %s | %s%s%s",
+                     shown->compounds[s].name,
+                     autoRotateEnabled ? "ON" : "OFF",
+                     vibrationEnabled ? "ON" : "OFF",
+                     conformerText,
+                     surfaceText,
+                     profileText);
+            update_window_title(window, windowTitle, sizeof(windowTitle), title);
         }
 
+        if(profiler_enabled()) draw_profiler_hud(renderer, &layout);
+
+        ProfScope presentScope = PROF_BEGIN("present");
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
+        PROF_END(presentScope);
+        profiler_frame_end();
+
+        float workMs = (float)((double)(SDL_GetPerformanceCounter() - frameStart) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+        // A replay stays at full quality, so what it draws does not depend
+        // on how fast this machine is.
+        if(!replay) governor_frame(&governor, workMs);
+
+        if(replay){
+            timings_push(&timings, frameMs, workMs);
+        } else {
+            SDL_Delay(16);
+        }
+    }
+
+    if(replay){
+        report_timings(&timings, options.timingsPath);
+        replay_close(replay);
     }
+    free(timings.clockMs);
+    free(timings.ms);
+    if(recorder && !recorder_close(recorder)) fprintf(stderr, "record: write to %s failed\n", options.recordPath);
+
+    background_task_join(prepTask);
+    background_task_join(reloadTask);
+    library_delta_free(&reload.delta);
+    file_watch_close(&watch);
+    library_source_free(&source);
+    library_free(&lib);
+    library_snapshot_unmap(&reload.next);
+    library_snapshot_unmap(&snapshot);
+    if(shared) library_store_close(&store);
+    pipeline_destroy(pipeline);
+    command_buffer_free(&syncBuffer);
+    md_destroy(vibration);
+    for(int i = 0; i < COMPOUND_COUNT; i++) surface_cache_free(&builder.surface[i]);
+    for(int i = 0; i < COMPOUND_COUNT; i++) tile_texture_free(&tileTextures[i]);
+    if(resources.glyphs) SDL_DestroyTexture(resources.glyphs);
+    tracer_destroy(traceTarget.tracer);
+    if(traceTarget.texture) SDL_DestroyTexture(traceTarget.texture);
+    thread_pool_shutdown();
 
     SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    if(window) SDL_DestroyWindow(window);
+    if(offscreen) SDL_FreeSurface(offscreen);
     SDL_Quit();
     return 0;
 }
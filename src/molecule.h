@@ -0,0 +1,29 @@
+#ifndef ATLAS_MOLECULE_H
+#define ATLAS_MOLECULE_H
+
+#include <stdint.h>
+
+#define MAX_ATOMS 64
+#define MAX_BONDS 96
+
+#define PI 3.14159265f
+
+typedef struct { float x, y, z; } Vec3;
+
+typedef struct { int from, to; int order; } Bond;
+
+typedef struct {
+    Vec3 atomPos[MAX_ATOMS];
+    uint8_t atomLabel[MAX_ATOMS]; // 0=C, 1=O, 2=N, 3=Cl, 4=F
+    int atomCount;
+
+    Bond bonds[MAX_BONDS];
+    int bondCount;
+} MoleculeGeometry;
+
+static inline Vec3 make_vec3(float x, float y, float z){
+    Vec3 v = {x,y,z};
+    return v;
+}
+
+#endif
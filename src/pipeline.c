@@ -0,0 +1,105 @@
+#include "pipeline.h"
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+struct FramePipeline {
+    FrameBuildFn build;
+    void *ctx;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    CommandBuffer buffers[2];
+    int building;    // buffer the next or current build writes into
+    void *job;       // non-NULL while a build is queued or running
+    bool finished;   // the build in flight has completed
+    bool stopping;
+};
+
+static void *builder_main(void *arg){
+    FramePipeline *p = arg;
+    pthread_mutex_lock(&p->lock);
+    for(;;){
+        while(!p->stopping && (!p->job || p->finished)) pthread_cond_wait(&p->wake, &p->lock);
+        if(p->stopping) break;
+        void *job = p->job;
+        CommandBuffer *out = &p->buffers[p->building];
+        pthread_mutex_unlock(&p->lock);
+
+        command_buffer_reset(out);
+        {
+            PROF_SCOPE("build_frame");
+            p->build(p->ctx, job, out);
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->finished = true;
+        pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+FramePipeline *pipeline_create(FrameBuildFn build, void *ctx){
+    FramePipeline *p = calloc(1, sizeof(FramePipeline));
+    if(!p) return NULL;
+    p->build = build;
+    p->ctx = ctx;
+    command_buffer_init(&p->buffers[0]);
+    command_buffer_init(&p->buffers[1]);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    if(pthread_create(&p->thread, NULL, builder_main, p) != 0){
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->wake);
+        pthread_cond_destroy(&p->done);
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void pipeline_begin(FramePipeline *p, void *job){
+    pthread_mutex_lock(&p->lock);
+    p->job = job;
+    p->finished = false;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+CommandBuffer *pipeline_wait(FramePipeline *p){
+    PROF_SCOPE("pipeline_wait");
+    pthread_mutex_lock(&p->lock);
+    if(!p->job){
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+    }
+    while(!p->finished) pthread_cond_wait(&p->done, &p->lock);
+    CommandBuffer *ready = &p->buffers[p->building];
+    p->building ^= 1;
+    p->job = NULL;
+    pthread_mutex_unlock(&p->lock);
+    return ready;
+}
+
+void pipeline_destroy(FramePipeline *p){
+    if(!p) return;
+    pipeline_wait(p);
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    command_buffer_free(&p->buffers[0]);
+    command_buffer_free(&p->buffers[1]);
+    free(p);
+}
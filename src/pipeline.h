@@ -0,0 +1,32 @@
+#ifndef ATLAS_PIPELINE_H
+#define ATLAS_PIPELINE_H
+
+#include <stdbool.h>
+
+#include "cmdbuf.h"
+
+// Two-stage frame pipeline: a builder thread records frame N+1 into one
+// command buffer while the render thread submits frame N from the other.
+// Presented frames lag input by at most one frame.
+
+// Records `job` into `out`, which arrives reset. Runs on the builder thread.
+typedef void (*FrameBuildFn)(void *ctx, void *job, CommandBuffer *out);
+
+typedef struct FramePipeline FramePipeline;
+
+FramePipeline *pipeline_create(FrameBuildFn build, void *ctx);
+
+// Starts building `job` into the buffer not handed out by the last
+// pipeline_wait(). The previous build must have been collected first; job
+// must stay untouched until the matching pipeline_wait() returns.
+void pipeline_begin(FramePipeline *p, void *job);
+
+// Blocks until the build in flight finishes and returns its buffer. It stays
+// valid across one more pipeline_begin() (which fills the other buffer) and
+// is reused by the one after. NULL when nothing is in flight.
+CommandBuffer *pipeline_wait(FramePipeline *p);
+
+// Waits for any build in flight, stops the thread and frees both buffers.
+void pipeline_destroy(FramePipeline *p);
+
+#endif
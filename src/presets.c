@@ -0,0 +1,180 @@
+#include "presets.h"
+
+#include <math.h>
+#include <string.h>
+
+const Compound compounds[COMPOUND_COUNT] = {
+    {"Testosterone",                 0xE74C3CFF, 0,  1.00f},
+    {"Testosterone Enanthate",       0x00D2D3FF, 1,  1.00f},
+    {"Testosterone Cypionate",       0xF1C40FFF, 2,  1.00f},
+    {"Trenbolone",                   0xE056FDFF, 3,  1.00f},
+    {"Nandrolone / Deca",            0x2ECC71FF, 4,  1.00f},
+    {"Boldenone / EQ",               0xE67E22FF, 5,  1.00f},
+    {"Dianabol",                     0x3498DBFF, 6,  1.00f},
+    {"Anavar (Oxandrolone)",         0xFF6B81FF, 7,  1.00f},
+    {"Winstrol (Stanozolol)",        0xF1C40FFF, 8,  1.00f},
+    {"Anadrol (Oxymetholone)",       0x8E1B1BFF, 9,  1.00f},
+    {"Masteron (Drostanolone)",      0x7BED9FFF,10,  1.00f},
+    {"Primobolan (Methenolone)",     0x9B59B6FF,11,  1.00f},
+    {"Turinabol",                    0x00D2D3FF,12,  1.00f},
+    {"Halotestin (Fluoxymesterone)", 0xE67E22FF,13,  1.00f},
+    {"Proviron (Mesterolone)",       0x6C5CE7FF,14,  1.00f},
+    {"Mibolerone",                   0xA55EEAFF,15,  1.00f},
+    {"Superdrol",                    0x8E44ADFF,16,  1.00f},
+    {"Oral Turinabol",               0x1ABC9CFF,17,  1.00f},
+    {"Testosterone Propionate",      0xFF6B81FF,18,  1.00f},
+    {"NPP",                          0x00CEC9FF,19,  1.00f},
+};
+
+void add_atom(MoleculeGeometry *mol, Vec3 p, uint8_t label){
+    if(mol->atomCount >= MAX_ATOMS) return;
+    mol->atomPos[mol->atomCount] = p;
+    mol->atomLabel[mol->atomCount] = label;
+    mol->atomCount++;
+}
+
+void add_bond(MoleculeGeometry *mol, int a, int b, int order){
+    if(mol->bondCount >= MAX_BONDS) return;
+    mol->bonds[mol->bondCount++] = (Bond){a,b,order};
+}
+
+void build_steroid_core(MoleculeGeometry *mol){
+    mol->atomCount = 0;
+    mol->bondCount = 0;
+
+    int baseA = mol->atomCount;
+    for(int i = 0; i < 6; i++){
+        float ang = i * PI / 3.0f;
+        add_atom(mol, make_vec3(cosf(ang) * 1.8f, sinf(ang) * 1.8f, 0.0f), 0);
+    }
+    for(int i = 0; i < 6; i++) add_bond(mol, baseA+i, baseA+((i+1)%6), 1);
+
+    int baseB = mol->atomCount;
+    for(int i = 0; i < 6; i++){
+        float ang = i * PI / 3.0f;
+        add_atom(mol, make_vec3(2.8f + cosf(ang) * 1.8f, sinf(ang) * 1.8f, 0.2f), 0);
+    }
+    for(int i = 0; i < 6; i++) add_bond(mol, baseB+i, baseB+((i+1)%6), 1);
+    add_bond(mol, baseA+1, baseB+4, 1);
+    add_bond(mol, baseA+2, baseB+5, 1);
+
+    int baseC = mol->atomCount;
+    for(int i = 0; i < 5; i++){
+        float ang = i * 2.0f * PI / 5.0f;
+        add_atom(mol, make_vec3(2.8f + cosf(ang) * 1.6f, 2.8f + sinf(ang) * 1.6f, -0.2f), 0);
+    }
+    for(int i = 0; i < 5; i++) add_bond(mol, baseC+i, baseC+((i+1)%5), 1);
+    add_bond(mol, baseB+1, baseC+3, 1);
+    add_bond(mol, baseB+2, baseC+4, 1);
+
+    int baseD = mol->atomCount;
+    for(int i = 0; i < 5; i++){
+        float ang = i * 2.0f * PI / 5.0f;
+        add_atom(mol, make_vec3(4.8f + cosf(ang) * 1.3f, 4.3f + sinf(ang) * 1.3f, 0.15f), 0);
+    }
+    for(int i = 0; i < 5; i++) add_bond(mol, baseD+i, baseD+((i+1)%5), 1);
+    add_bond(mol, baseC+1, baseD+3, 1);
+    add_bond(mol, baseC+2, baseD+4, 1);
+}
+
+void add_ester_tail(MoleculeGeometry *mol, int attachAtom, int segmentCount, float zWiggle){
+    int previous = attachAtom;
+    for(int i = 0; i < segmentCount; i++){
+        Vec3 base = mol->atomPos[attachAtom];
+        float step = 1.1f;
+        Vec3 next = make_vec3(base.x + (i+1)*step, base.y - 0.4f*(float)i, base.z + zWiggle*(float)i);
+        add_atom(mol, next, 0);
+        int current = mol->atomCount - 1;
+        add_bond(mol, previous, current, 1);
+        previous = current;
+    }
+}
+
+void build_ring_with_chain(MoleculeGeometry *mol, int chainLength, bool carbonyl){
+    memset(mol, 0, sizeof(*mol));
+    for(int i = 0; i < 6; i++){
+        float ang = i * PI / 3.0f;
+        add_atom(mol, make_vec3(cosf(ang) * 1.5f, sinf(ang) * 1.5f, 0.0f), 0);
+    }
+    for(int i = 0; i < 6; i++) add_bond(mol, i, (i+1)%6, 1);
+
+    int previous = 0;
+    for(int i = 0; i < chainLength; i++){
+        add_atom(mol, make_vec3(1.5f + (i+1)*1.3f, (i % 2) ? 0.6f : -0.2f, 0.05f*(float)i), 0);
+        add_bond(mol, previous, mol->atomCount-1, 1);
+        previous = mol->atomCount-1;
+    }
+
+    if(carbonyl){
+        add_atom(mol, make_vec3(mol->atomPos[4].x * 1.8f, mol->atomPos[4].y * 1.8f, -0.6f), 1);
+        add_bond(mol, 4, mol->atomCount-1, 2);
+    }
+}
+
+void apply_preset(MoleculeGeometry *mol, int presetType){
+    build_steroid_core(mol);
+
+    int attachHydroxyl = 2;
+    int attachCarbonyl = 8;
+    int attachEster = 14;
+
+    add_atom(mol, make_vec3(mol->atomPos[attachHydroxyl].x - 0.2f,
+                            mol->atomPos[attachHydroxyl].y + 1.4f,
+                            mol->atomPos[attachHydroxyl].z + 0.8f), 1);
+    add_bond(mol, attachHydroxyl, mol->atomCount-1, 1);
+
+    add_atom(mol, make_vec3(mol->atomPos[attachCarbonyl].x + 0.3f,
+                            mol->atomPos[attachCarbonyl].y - 1.2f,
+                            mol->atomPos[attachCarbonyl].z - 0.6f), 1);
+    add_bond(mol, attachCarbonyl, mol->atomCount-1, 2);
+
+    if(presetType == 1) add_ester_tail(mol, attachEster, 6, 0.10f);
+    if(presetType == 2) add_ester_tail(mol, attachEster, 7, -0.05f);
+    if(presetType == 18) add_ester_tail(mol, attachEster, 3, 0.05f);
+    if(presetType == 19) add_ester_tail(mol, attachEster, 3, -0.06f);
+
+    if(presetType == 6 || presetType == 16 || presetType == 17){
+        add_atom(mol, make_vec3(mol->atomPos[5].x - 1.2f, mol->atomPos[5].y + 0.6f, mol->atomPos[5].z + 0.2f), 0);
+        add_bond(mol, 5, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 3 || presetType == 5){
+        if(mol->bondCount > 10){
+            mol->bonds[3].order = 2;
+            mol->bonds[8].order = 2;
+        }
+        if(presetType == 3 && mol->bondCount > 15){
+            mol->bonds[12].order = 2;
+        }
+    }
+
+    if(presetType == 8){
+        add_atom(mol, make_vec3(mol->atomPos[0].x - 1.6f, mol->atomPos[0].y + 0.2f, mol->atomPos[0].z), 2);
+        add_bond(mol, 0, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 12 || presetType == 17){
+        add_atom(mol, make_vec3(mol->atomPos[1].x - 1.2f, mol->atomPos[1].y + 1.0f, mol->atomPos[1].z + 0.1f), 3);
+        add_bond(mol, 1, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 13){
+        add_atom(mol, make_vec3(mol->atomPos[9].x + 1.1f, mol->atomPos[9].y + 0.8f, mol->atomPos[9].z - 0.2f), 4);
+        add_bond(mol, 9, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 7 || presetType == 9){
+        add_atom(mol, make_vec3(mol->atomPos[10].x + 0.2f, mol->atomPos[10].y + 1.1f, mol->atomPos[10].z - 0.4f), 1);
+        add_bond(mol, 10, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 4 || presetType == 10 || presetType == 14 || presetType == 15){
+        add_atom(mol, make_vec3(mol->atomPos[11].x + 0.9f, mol->atomPos[11].y - 0.9f, mol->atomPos[11].z + 0.3f), 0);
+        add_bond(mol, 11, mol->atomCount-1, 1);
+    }
+
+    if(presetType == 11){
+        add_atom(mol, make_vec3(mol->atomPos[6].x + 0.7f, mol->atomPos[6].y + 1.0f, mol->atomPos[6].z), 0);
+        add_bond(mol, 6, mol->atomCount-1, 1);
+    }
+}
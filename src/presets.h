@@ -0,0 +1,33 @@
+#ifndef ATLAS_PRESETS_H
+#define ATLAS_PRESETS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+#define COMPOUND_COUNT 20
+
+typedef struct {
+    const char *name;
+    uint32_t colorRGBA;
+    int presetType;
+    float baseScale;
+} Compound;
+
+extern const Compound compounds[COMPOUND_COUNT];
+
+void add_atom(MoleculeGeometry *mol, Vec3 p, uint8_t label);
+void add_bond(MoleculeGeometry *mol, int a, int b, int order);
+void build_steroid_core(MoleculeGeometry *mol);
+void add_ester_tail(MoleculeGeometry *mol, int attachAtom, int segmentCount, float zWiggle);
+
+// Fixture for tests: a flat six-ring (atoms 0-5) with a carbon chain
+// zigzagging off atom 0 and, with carbonyl, an oxygen double-bonded to
+// atom 4 after it. Unrelaxed, as crude as the presets.
+void build_ring_with_chain(MoleculeGeometry *mol, int chainLength, bool carbonyl);
+
+// Builds the hand-placed geometry for one of the compounds' preset types.
+void apply_preset(MoleculeGeometry *mol, int presetType);
+
+#endif
@@ -0,0 +1,265 @@
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_HAVE_TSC 1
+#endif
+
+typedef struct {
+    const char *name;
+    uint64_t start, end;
+} ProfEvent;
+
+typedef struct ThreadRing {
+    ProfEvent events[PROF_RING_EVENTS];
+    atomic_ullong head; // total events ever written
+    int tid;
+    struct ThreadRing *nextFree;
+} ThreadRing;
+
+typedef struct {
+    uint64_t endTicks;
+    float ms;
+    uint64_t counters[PROF_COUNTER_COUNT];
+} FrameRecord;
+
+atomic_bool profilerActive = false;
+
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadRing *rings[PROF_MAX_THREADS];
+static atomic_int ringCount = 0;
+static ThreadRing *freeRings = NULL; // rings of exited threads, under ringLock
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+static _Thread_local ThreadRing *threadRing = NULL;
+static atomic_ullong droppedEvents = 0;
+
+static atomic_ullong counters[PROF_COUNTER_COUNT];
+
+// Frame history is only touched by the thread calling profiler_frame_end.
+static FrameRecord frames[PROF_HISTORY];
+static int frameHead = 0;
+static int frameCount = 0;
+static double lastFrameSeconds = 0.0;
+
+// Pair of (ticks, seconds) taken at enable, used to convert ticks later.
+static uint64_t baseTicks = 0;
+static double baseSeconds = 0.0;
+
+static const char *counterNames[PROF_COUNTER_COUNT] = { "draw calls", "pixels", "atoms" };
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+uint64_t profiler_ticks(void){
+#ifdef PROF_HAVE_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Ticks per second, measured against the monotonic clock since enable.
+static double tick_rate(void){
+#ifdef PROF_HAVE_TSC
+    double elapsed = now_seconds() - baseSeconds;
+    uint64_t ticks = profiler_ticks() - baseTicks;
+    if(elapsed < 1e-3) return 1e9;
+    return (double)ticks / elapsed;
+#else
+    return 1e9;
+#endif
+}
+
+// Runs as a thread exits. Its ring, buffered events included, goes to the
+// next thread that needs one, so short-lived threads share a few rings.
+static void release_ring(void *ptr){
+    ThreadRing *ring = ptr;
+    pthread_mutex_lock(&ringLock);
+    ring->nextFree = freeRings;
+    freeRings = ring;
+    pthread_mutex_unlock(&ringLock);
+}
+
+static void create_ring_key(void){
+    pthread_key_create(&ringKey, release_ring);
+}
+
+static ThreadRing *acquire_ring(void){
+    if(threadRing) return threadRing;
+    pthread_once(&ringKeyOnce, create_ring_key);
+    pthread_mutex_lock(&ringLock);
+    ThreadRing *ring = freeRings;
+    if(ring){
+        freeRings = ring->nextFree;
+    } else {
+        int n = atomic_load(&ringCount);
+        if(n < PROF_MAX_THREADS && (ring = calloc(1, sizeof(ThreadRing)))){
+            ring->tid = n;
+            rings[n] = ring;
+            atomic_store(&ringCount, n + 1);
+        }
+    }
+    pthread_mutex_unlock(&ringLock);
+    if(ring){
+        pthread_setspecific(ringKey, ring);
+        threadRing = ring;
+    }
+    return ring;
+}
+
+void profiler_record(const char *name, uint64_t start, uint64_t end){
+    ThreadRing *ring = acquire_ring();
+    if(!ring){
+        // More than PROF_MAX_THREADS threads alive at once.
+        atomic_fetch_add_explicit(&droppedEvents, 1, memory_order_relaxed);
+        return;
+    }
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ProfEvent *e = &ring->events[head & (PROF_RING_EVENTS - 1)];
+    e->name = name;
+    e->start = start;
+    e->end = end;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void profiler_add(ProfCounter counter, uint64_t amount){
+    atomic_fetch_add_explicit(&counters[counter], amount, memory_order_relaxed);
+}
+
+void profiler_set_enabled(bool enabled){
+    if(enabled && !atomic_load(&profilerActive)){
+        baseTicks = profiler_ticks();
+        baseSeconds = now_seconds();
+        lastFrameSeconds = baseSeconds;
+        for(int i = 0; i < PROF_COUNTER_COUNT; i++) atomic_store(&counters[i], 0);
+    }
+    atomic_store(&profilerActive, enabled);
+}
+
+bool profiler_enabled(void){
+    return atomic_load_explicit(&profilerActive, memory_order_relaxed);
+}
+
+void profiler_frame_end(void){
+    if(!profiler_enabled()) return;
+    double now = now_seconds();
+    FrameRecord *f = &frames[frameHead];
+    f->endTicks = profiler_ticks();
+    f->ms = (float)((now - lastFrameSeconds) * 1000.0);
+    for(int i = 0; i < PROF_COUNTER_COUNT; i++){
+        f->counters[i] = atomic_exchange_explicit(&counters[i], 0, memory_order_relaxed);
+    }
+    lastFrameSeconds = now;
+    frameHead = (frameHead + 1) % PROF_HISTORY;
+    if(frameCount < PROF_HISTORY) frameCount++;
+}
+
+int profiler_frame_history(float *ms, int max){
+    int n = frameCount < max ? frameCount : max;
+    for(int i = 0; i < n; i++){
+        int idx = (frameHead - n + i + PROF_HISTORY) % PROF_HISTORY;
+        ms[i] = frames[idx].ms;
+    }
+    return n;
+}
+
+void profiler_last_counters(uint64_t out[PROF_COUNTER_COUNT]){
+    if(frameCount == 0){
+        memset(out, 0, sizeof(uint64_t) * PROF_COUNTER_COUNT);
+        return;
+    }
+    const FrameRecord *f = &frames[(frameHead + PROF_HISTORY - 1) % PROF_HISTORY];
+    memcpy(out, f->counters, sizeof(uint64_t) * PROF_COUNTER_COUNT);
+}
+
+const char *profiler_counter_name(ProfCounter counter){
+    return counter < PROF_COUNTER_COUNT ? counterNames[counter] : "?";
+}
+
+uint64_t profiler_dropped_events(void){
+    return atomic_load_explicit(&droppedEvents, memory_order_relaxed);
+}
+
+// Scope names are string literals from our own code; escape anyway so a
+// stray quote can't break the file.
+static void write_json_string(FILE *f, const char *s){
+    fputc('"', f);
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\') fputc('\\', f);
+        if((unsigned char)*s >= 0x20) fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+bool profiler_dump_chrome_trace(const char *path){
+    ProfEvent *copy = malloc(sizeof(ProfEvent) * PROF_RING_EVENTS);
+    if(!copy) return false;
+    FILE *f = fopen(path, "w");
+    if(!f){
+        free(copy);
+        return false;
+    }
+
+    double usPerTick = 1e6 / tick_rate();
+    bool first = true;
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    int n = atomic_load(&ringCount);
+    for(int r = 0; r < n; r++){
+        ThreadRing *ring = rings[r];
+        unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned long long begin = head > PROF_RING_EVENTS ? head - PROF_RING_EVENTS : 0;
+        for(unsigned long long i = begin; i < head; i++){
+            copy[i & (PROF_RING_EVENTS - 1)] = ring->events[i & (PROF_RING_EVENTS - 1)];
+        }
+        // The writer keeps going while we copy; entries it may have lapped
+        // in the meantime are skipped rather than written torn.
+        atomic_thread_fence(memory_order_acquire);
+        unsigned long long after = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if(after >= PROF_RING_EVENTS && begin <= after - PROF_RING_EVENTS) begin = after - PROF_RING_EVENTS + 1;
+        for(unsigned long long i = begin; i < head; i++){
+            const ProfEvent *e = &copy[i & (PROF_RING_EVENTS - 1)];
+            // Events recorded before the last enable have no valid time base.
+            if(e->start < baseTicks) continue;
+            fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(f, e->name);
+            fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    ring->tid,
+                    (double)(e->start - baseTicks) * usPerTick,
+                    (double)(e->end - e->start) * usPerTick);
+            first = false;
+        }
+    }
+
+    for(int i = 0; i < frameCount; i++){
+        const FrameRecord *fr = &frames[(frameHead - frameCount + i + PROF_HISTORY) % PROF_HISTORY];
+        if(fr->endTicks < baseTicks) continue;
+        double ts = (double)(fr->endTicks - baseTicks) * usPerTick;
+        fprintf(f, "%s{\"name\":\"frame\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"ms\":%.3f",
+                first ? "" : ",\n", ts, fr->ms);
+        for(int c = 0; c < PROF_COUNTER_COUNT; c++){
+            fprintf(f, ",\"%s\":%llu", counterNames[c], (unsigned long long)fr->counters[c]);
+        }
+        fprintf(f, "}}");
+        first = false;
+    }
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%llu}}\n",
+            (unsigned long long)profiler_dropped_events());
+    free(copy);
+    bool ok = !ferror(f);
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
@@ -0,0 +1,87 @@
+#ifndef ATLAS_PROFILER_H
+#define ATLAS_PROFILER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame profiler. Scopes land in per-thread ring buffers stamped with the
+// CPU timestamp counter (clock_gettime where there is none); counters and
+// frame times feed the HUD. The PROF_* macros compile away unless
+// ATLAS_PROFILE is defined, and cost one relaxed load and a branch while
+// the profiler is switched off.
+
+#define PROF_RING_EVENTS 16384   // per thread, power of two
+#define PROF_HISTORY 240         // frames kept for the HUD
+#define PROF_MAX_THREADS 64
+
+typedef enum {
+    PROF_DRAW_CALLS,
+    PROF_PIXELS,
+    PROF_ATOMS,
+    PROF_COUNTER_COUNT
+} ProfCounter;
+
+typedef struct {
+    const char *name; // NULL when the profiler was off at scope entry
+    uint64_t start;
+} ProfScope;
+
+extern atomic_bool profilerActive;
+
+uint64_t profiler_ticks(void);
+void profiler_record(const char *name, uint64_t start, uint64_t end);
+void profiler_add(ProfCounter counter, uint64_t amount);
+
+void profiler_set_enabled(bool enabled);
+bool profiler_enabled(void);
+
+// Closes the current frame: stores its duration and counter totals, then
+// zeroes the counters. Call once per frame from the main loop.
+void profiler_frame_end(void);
+
+// Copies up to max frame times in milliseconds, oldest first.
+int profiler_frame_history(float *ms, int max);
+void profiler_last_counters(uint64_t out[PROF_COUNTER_COUNT]);
+const char *profiler_counter_name(ProfCounter counter);
+
+// Events lost because more than PROF_MAX_THREADS threads were recording at
+// once. Rings of exited threads are reused, so only live threads count.
+uint64_t profiler_dropped_events(void);
+
+// Writes every buffered scope and per-frame counter as Chrome trace JSON
+// (chrome://tracing, Perfetto). Returns false if the file can't be written.
+bool profiler_dump_chrome_trace(const char *path);
+
+static inline ProfScope profiler_scope_begin(const char *name){
+    ProfScope s = { NULL, 0 };
+    if(atomic_load_explicit(&profilerActive, memory_order_relaxed)){
+        s.name = name;
+        s.start = profiler_ticks();
+    }
+    return s;
+}
+
+static inline void profiler_scope_end(ProfScope *s){
+    if(s->name) profiler_record(s->name, s->start, profiler_ticks());
+}
+
+#ifdef ATLAS_PROFILE
+#define PROF_JOIN_(a, b) a##b
+#define PROF_JOIN(a, b) PROF_JOIN_(a, b)
+#define PROF_SCOPE(name) \
+    ProfScope PROF_JOIN(profScope_, __LINE__) __attribute__((cleanup(profiler_scope_end))) = profiler_scope_begin(name)
+#define PROF_BEGIN(name) profiler_scope_begin(name)
+#define PROF_END(scope) profiler_scope_end(&(scope))
+#define PROF_COUNT(counter, amount) do { \
+        if(atomic_load_explicit(&profilerActive, memory_order_relaxed)) profiler_add((counter), (uint64_t)(amount)); \
+    } while(0)
+#else
+#define PROF_SCOPE(name) ((void)0)
+#define PROF_BEGIN(name) ((ProfScope){ NULL, 0 })
+#define PROF_END(scope) ((void)(scope))
+#define PROF_COUNT(counter, amount) ((void)sizeof((counter) + (amount)))
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+#include "raster.h"
+#include "profiler.h"
+#include "text.h"
+
+#include <math.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint8_t r, g, b, a;
+    bool blend;
+    int clipX0, clipY0, clipX1, clipY1; // half-open
+} RasterState;
+
+void canvas_clear(Canvas *canvas, uint32_t argb){
+    for(int y = 0; y < canvas->height; y++){
+        uint32_t *row = canvas->pixels + (size_t)y * (size_t)canvas->pitch;
+        for(int x = 0; x < canvas->width; x++) row[x] = argb;
+    }
+}
+
+static inline uint32_t blend_pixel(uint32_t dst, int r, int g, int b, int a, bool blend){
+    if(!blend || a == 255) return ((uint32_t)a << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+    if(a == 0) return dst;
+    int inv = 255 - a;
+    int dr = (int)((dst >> 16) & 255), dg = (int)((dst >> 8) & 255), db = (int)(dst & 255), da = (int)(dst >> 24);
+    int outR = (r * a + dr * inv + 127) / 255;
+    int outG = (g * a + dg * inv + 127) / 255;
+    int outB = (b * a + db * inv + 127) / 255;
+    int outA = a + (da * inv + 127) / 255;
+    return ((uint32_t)outA << 24) | ((uint32_t)outR << 16) | ((uint32_t)outG << 8) | (uint32_t)outB;
+}
+
+static void fill_span(Canvas *c, const RasterState *st, int x0, int x1, int y){
+    if(y < st->clipY0 || y >= st->clipY1) return;
+    if(x0 < st->clipX0) x0 = st->clipX0;
+    if(x1 > st->clipX1) x1 = st->clipX1;
+    uint32_t *row = c->pixels + (size_t)y * (size_t)c->pitch;
+    for(int x = x0; x < x1; x++) row[x] = blend_pixel(row[x], st->r, st->g, st->b, st->a, st->blend);
+}
+
+static float edge(const SDL_FPoint *a, const SDL_FPoint *b, float px, float py){
+    return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+static bool top_left(const SDL_FPoint *a, const SDL_FPoint *b){
+    float dx = b->x - a->x, dy = b->y - a->y;
+    return dy < 0.0f || (dy == 0.0f && dx > 0.0f);
+}
+
+// One triangle with per-vertex colour, optionally modulated by the glyph
+// mask sampled at the nearest texel.
+static void fill_triangle(Canvas *c, const RasterState *st, const SDL_Vertex *v0, const SDL_Vertex *v1,
+                          const SDL_Vertex *v2, const uint8_t *mask, int maskW, int maskH, bool blend){
+    float area = edge(&v0->position, &v1->position, v2->position.x, v2->position.y);
+    if(area == 0.0f) return;
+    if(area < 0.0f){
+        const SDL_Vertex *t = v1;
+        v1 = v2;
+        v2 = t;
+        area = -area;
+    }
+    const SDL_FPoint *p0 = &v0->position, *p1 = &v1->position, *p2 = &v2->position;
+    int minX = (int)floorf(fminf(p0->x, fminf(p1->x, p2->x)));
+    int maxX = (int)ceilf(fmaxf(p0->x, fmaxf(p1->x, p2->x)));
+    int minY = (int)floorf(fminf(p0->y, fminf(p1->y, p2->y)));
+    int maxY = (int)ceilf(fmaxf(p0->y, fmaxf(p1->y, p2->y)));
+    if(minX < st->clipX0) minX = st->clipX0;
+    if(minY < st->clipY0) minY = st->clipY0;
+    if(maxX > st->clipX1) maxX = st->clipX1;
+    if(maxY > st->clipY1) maxY = st->clipY1;
+
+    bool tl0 = top_left(p1, p2), tl1 = top_left(p2, p0), tl2 = top_left(p0, p1);
+    float invArea = 1.0f / area;
+    for(int y = minY; y < maxY; y++){
+        float py = (float)y + 0.5f;
+        uint32_t *row = c->pixels + (size_t)y * (size_t)c->pitch;
+        for(int x = minX; x < maxX; x++){
+            float px = (float)x + 0.5f;
+            float w0 = edge(p1, p2, px, py);
+            float w1 = edge(p2, p0, px, py);
+            float w2 = edge(p0, p1, px, py);
+            if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+            if((w0 == 0.0f && !tl0) || (w1 == 0.0f && !tl1) || (w2 == 0.0f && !tl2)) continue;
+            float l0 = w0 * invArea, l1 = w1 * invArea, l2 = w2 * invArea;
+
+            int r = (int)(v0->color.r * l0 + v1->color.r * l1 + v2->color.r * l2 + 0.5f);
+            int g = (int)(v0->color.g * l0 + v1->color.g * l1 + v2->color.g * l2 + 0.5f);
+            int b = (int)(v0->color.b * l0 + v1->color.b * l1 + v2->color.b * l2 + 0.5f);
+            int a = (int)(v0->color.a * l0 + v1->color.a * l1 + v2->color.a * l2 + 0.5f);
+            if(mask){
+                float u = v0->tex_coord.x * l0 + v1->tex_coord.x * l1 + v2->tex_coord.x * l2;
+                float t = v0->tex_coord.y * l0 + v1->tex_coord.y * l1 + v2->tex_coord.y * l2;
+                int tx = (int)(u * (float)maskW), ty = (int)(t * (float)maskH);
+                if(tx < 0) tx = 0;
+                if(tx >= maskW) tx = maskW - 1;
+                if(ty < 0) ty = 0;
+                if(ty >= maskH) ty = maskH - 1;
+                a = a * mask[ty * maskW + tx] / 255;
+                if(a == 0) continue;
+            }
+            row[x] = blend_pixel(row[x], r > 255 ? 255 : r, g > 255 ? 255 : g, b > 255 ? 255 : b,
+                                 a > 255 ? 255 : a, blend);
+        }
+    }
+}
+
+void command_buffer_rasterize(const CommandBuffer *cb, Canvas *canvas){
+    PROF_SCOPE("rasterize");
+    if(cb->failed) return;
+    RasterState st = { 255, 255, 255, 255, false, 0, 0, canvas->width, canvas->height };
+    int maskW, maskH;
+    const uint8_t *mask = glyph_atlas_mask(&maskW, &maskH);
+
+    for(int i = 0; i < cb->cmdCount; i++){
+        const DrawCommand *c = &cb->cmds[i];
+        switch(c->type){
+            case CMD_COLOR:
+                st.r = c->r;
+                st.g = c->g;
+                st.b = c->b;
+                st.a = c->a;
+                break;
+            case CMD_BLEND:
+                st.blend = (SDL_BlendMode)c->slot == SDL_BLENDMODE_BLEND;
+                break;
+            case CMD_CLIP:
+                st.clipX0 = 0;
+                st.clipY0 = 0;
+                st.clipX1 = canvas->width;
+                st.clipY1 = canvas->height;
+                if(c->rect.w > 0){
+                    if(c->rect.x > st.clipX0) st.clipX0 = c->rect.x;
+                    if(c->rect.y > st.clipY0) st.clipY0 = c->rect.y;
+                    if(c->rect.x + c->rect.w < st.clipX1) st.clipX1 = c->rect.x + c->rect.w;
+                    if(c->rect.y + c->rect.h < st.clipY1) st.clipY1 = c->rect.y + c->rect.h;
+                }
+                break;
+            case CMD_POINTS:
+                for(int k = 0; k < c->count; k++){
+                    const SDL_Point *p = &cb->points[c->first + k];
+                    fill_span(canvas, &st, p->x, p->x + 1, p->y);
+                }
+                break;
+            case CMD_FILL_RECTS:
+                for(int k = 0; k < c->count; k++){
+                    const SDL_Rect *r = &cb->rects[c->first + k];
+                    for(int y = r->y; y < r->y + r->h; y++) fill_span(canvas, &st, r->x, r->x + r->w, y);
+                }
+                break;
+            case CMD_DRAW_RECT: {
+                const SDL_Rect *r = &c->rect;
+                if(r->w <= 0 || r->h <= 0) break;
+                fill_span(canvas, &st, r->x, r->x + r->w, r->y);
+                if(r->h > 1) fill_span(canvas, &st, r->x, r->x + r->w, r->y + r->h - 1);
+                for(int y = r->y + 1; y < r->y + r->h - 1; y++){
+                    fill_span(canvas, &st, r->x, r->x + 1, y);
+                    if(r->w > 1) fill_span(canvas, &st, r->x + r->w - 1, r->x + r->w, y);
+                }
+                break;
+            }
+            case CMD_GEOMETRY:
+            case CMD_GLYPHS: {
+                bool glyphs = c->type == CMD_GLYPHS;
+                const SDL_Vertex *v = cb->vertices + c->first;
+                for(int k = 0; k + 2 < c->count; k += 3){
+                    fill_triangle(canvas, &st, &v[k], &v[k + 1], &v[k + 2],
+                                  glyphs ? mask : NULL, maskW, maskH, glyphs || st.blend);
+                }
+                break;
+            }
+            case CMD_TILE_BEGIN:
+                while(i + 1 < cb->cmdCount && cb->cmds[i + 1].type != CMD_TILE_END) i++;
+                i++;
+                break;
+            case CMD_TILE_END:
+                break;
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef ATLAS_RASTER_H
+#define ATLAS_RASTER_H
+
+#include <stdint.h>
+
+#include "cmdbuf.h"
+
+// CPU rasterizer for command buffers. Unlike an SDL renderer it touches no
+// global state, so any number of threads can rasterize at once; it is what
+// the headless tools render with.
+
+// ARGB8888 pixels; pitch is in pixels, so a canvas can be a cell of a
+// larger image.
+typedef struct {
+    uint32_t *pixels;
+    int width, height, pitch;
+} Canvas;
+
+void canvas_clear(Canvas *canvas, uint32_t argb);
+
+// Replays cb like command_buffer_submit() with no tile textures (tile
+// contents are skipped) and the glyph atlas mask for text. Pixel centres
+// sit at +0.5 and triangle edges follow the top-left rule.
+void command_buffer_rasterize(const CommandBuffer *cb, Canvas *canvas);
+
+#endif
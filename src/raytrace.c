@@ -0,0 +1,692 @@
+#include "raytrace.h"
+#include "geometry.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TILE 16
+#define COARSE 4                    // preview block size in pixels
+#define MAX_PRIMS (MAX_ATOMS + MAX_BONDS * 2)
+#define MAX_NODES (MAX_PRIMS * 2)
+#define LEAF_SIZE 4
+#define AO_DISTANCE 3.5f
+#define LIGHT_SPREAD 0.15f          // soft-shadow cone, radians-ish
+#define RAY_EPSILON 1e-3f
+
+static const float atomRadiusByLabel[5] = { 0.40f, 0.42f, 0.40f, 0.55f, 0.50f };
+#define BOND_RADIUS 0.13f
+#define DOUBLE_BOND_RADIUS 0.09f
+#define DOUBLE_BOND_OFFSET 0.14f
+
+typedef enum { PRIM_SPHERE, PRIM_CYLINDER } PrimKind;
+
+typedef struct {
+    Vec3 a, b;          // centre, or cylinder end points
+    Vec3 axis;          // unit cylinder axis
+    float length;
+    float radius;
+    float color[3];
+    PrimKind kind;
+} Primitive;
+
+typedef struct {
+    float min[3], max[3];
+    int start, count;   // leaf primitives when count > 0
+    int left, right;
+} BvhNode;
+
+struct Tracer {
+    uint64_t key;
+    bool hasScene;
+    TraceScene scene;
+    float background[3];
+
+    Primitive prims[MAX_PRIMS];
+    int order[MAX_PRIMS];
+    int primCount;
+    BvhNode nodes[MAX_NODES];
+    int nodeCount;
+    float top;          // z above every primitive, where primary rays start
+
+    int width, height;
+    int tilesX, tilesY;
+    float *accum;       // rgb per pixel
+    uint32_t *pixels;
+    int *tileSamples;
+    bool *tileCoarse;   // holds a preview that the first real sample replaces
+    int coarseNext;     // tiles before this one hold the preview
+    int cursor;
+    int *batch;
+};
+
+static inline Vec3 v_add(Vec3 a, Vec3 b){ return make_vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline Vec3 v_sub(Vec3 a, Vec3 b){ return make_vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline Vec3 v_scale(Vec3 a, float s){ return make_vec3(a.x * s, a.y * s, a.z * s); }
+static inline float v_dot(Vec3 a, Vec3 b){ return a.x*b.x + a.y*b.y + a.z*b.z; }
+static inline Vec3 v_cross(Vec3 a, Vec3 b){
+    return make_vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+static inline Vec3 v_normalize(Vec3 a){
+    float len = sqrtf(v_dot(a, a));
+    return len > 1e-12f ? v_scale(a, 1.0f / len) : a;
+}
+static inline float v_axis(Vec3 a, int k){ return k == 0 ? a.x : (k == 1 ? a.y : a.z); }
+
+static Vec3 rotate_view(Vec3 p, float cy, float sy, float cp, float sp){
+    float x1 =  cy * p.x + sy * p.z;
+    float z1 = -sy * p.x + cy * p.z;
+    return make_vec3(x1, cp * p.y - sp * z1, sp * p.y + cp * z1);
+}
+
+static void unpack_color(uint32_t rgba, float out[3]){
+    out[0] = (float)((rgba >> 24) & 255) / 255.0f;
+    out[1] = (float)((rgba >> 16) & 255) / 255.0f;
+    out[2] = (float)((rgba >>  8) & 255) / 255.0f;
+}
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t hash32(uint32_t x){
+    x ^= x >> 16; x *= 0x7feb352dU;
+    x ^= x >> 15; x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline float next_random(uint32_t *state){
+    *state = hash32(*state + 0x9E3779B9U);
+    return (float)(*state >> 8) * (1.0f / 16777216.0f);
+}
+
+
+Tracer *tracer_create(void){
+    Tracer *t = calloc(1, sizeof(Tracer));
+    return t;
+}
+
+static void release_image(Tracer *t){
+    free(t->accum);
+    free(t->pixels);
+    free(t->tileSamples);
+    free(t->tileCoarse);
+    free(t->batch);
+    t->accum = NULL;
+    t->pixels = NULL;
+    t->tileSamples = NULL;
+    t->tileCoarse = NULL;
+    t->batch = NULL;
+    t->width = t->height = 0;
+}
+
+void tracer_destroy(Tracer *tracer){
+    if(!tracer) return;
+    release_image(tracer);
+    free(tracer);
+}
+
+static void prim_bounds(const Primitive *p, float mn[3], float mx[3]){
+    for(int k = 0; k < 3; k++){
+        float a = v_axis(p->a, k);
+        float b = p->kind == PRIM_CYLINDER ? v_axis(p->b, k) : a;
+        mn[k] = fminf(a, b) - p->radius;
+        mx[k] = fmaxf(a, b) + p->radius;
+    }
+}
+
+static float prim_centroid(const Primitive *p, int k){
+    if(p->kind == PRIM_SPHERE) return v_axis(p->a, k);
+    return 0.5f * (v_axis(p->a, k) + v_axis(p->b, k));
+}
+
+static int build_node(Tracer *t, int start, int count){
+    int index = t->nodeCount++;
+    BvhNode *node = &t->nodes[index];
+    float cmin[3] = { 1e30f, 1e30f, 1e30f }, cmax[3] = { -1e30f, -1e30f, -1e30f };
+    for(int k = 0; k < 3; k++){ node->min[k] = 1e30f; node->max[k] = -1e30f; }
+
+    for(int i = start; i < start + count; i++){
+        const Primitive *p = &t->prims[t->order[i]];
+        float mn[3], mx[3];
+        prim_bounds(p, mn, mx);
+        for(int k = 0; k < 3; k++){
+            node->min[k] = fminf(node->min[k], mn[k]);
+            node->max[k] = fmaxf(node->max[k], mx[k]);
+            float c = prim_centroid(p, k);
+            cmin[k] = fminf(cmin[k], c);
+            cmax[k] = fmaxf(cmax[k], c);
+        }
+    }
+
+    if(count <= LEAF_SIZE){
+        node->start = start;
+        node->count = count;
+        node->left = node->right = -1;
+        return index;
+    }
+
+    int axis = 0;
+    for(int k = 1; k < 3; k++){
+        if(cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) axis = k;
+    }
+    // Median split; primitive counts are tiny, so insertion sort is enough.
+    for(int i = start + 1; i < start + count; i++){
+        int v = t->order[i];
+        float c = prim_centroid(&t->prims[v], axis);
+        int j = i - 1;
+        while(j >= start && prim_centroid(&t->prims[t->order[j]], axis) > c){
+            t->order[j + 1] = t->order[j];
+            j--;
+        }
+        t->order[j + 1] = v;
+    }
+
+    int half = count / 2;
+    int left = build_node(t, start, half);
+    int right = build_node(t, start + half, count - half);
+    node = &t->nodes[index];
+    node->start = 0;
+    node->count = 0;
+    node->left = left;
+    node->right = right;
+    return index;
+}
+
+typedef struct {
+    Vec3 origin, dir;
+    float o[3], inv[3];
+} Ray;
+
+static Ray make_ray(Vec3 origin, Vec3 dir){
+    Ray r = { origin, dir, { origin.x, origin.y, origin.z }, { 1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z } };
+    return r;
+}
+
+// Entry distance into the node's box, or +inf when the ray misses it
+// before tmax.
+static float hit_box(const BvhNode *node, const Ray *ray, float tmax){
+    float t0 = 0.0f, t1 = tmax;
+    for(int k = 0; k < 3; k++){
+        float a = (node->min[k] - ray->o[k]) * ray->inv[k];
+        float b = (node->max[k] - ray->o[k]) * ray->inv[k];
+        float lo = a < b ? a : b;
+        float hi = a < b ? b : a;
+        // Written so the NaN of an axis-parallel ray on a slab edge is ignored.
+        t0 = lo > t0 ? lo : t0;
+        t1 = hi < t1 ? hi : t1;
+        if(t0 > t1) return INFINITY;
+    }
+    return t0;
+}
+
+static float hit_sphere(const Primitive *p, const Ray *ray){
+    Vec3 oc = v_sub(ray->origin, p->a);
+    float b = v_dot(oc, ray->dir);
+    float c = v_dot(oc, oc) - p->radius * p->radius;
+    float disc = b*b - c;
+    if(disc < 0.0f) return -1.0f;
+    return -b - sqrtf(disc);
+}
+
+// Open cylinder; the atom spheres cap both ends.
+static float hit_cylinder(const Primitive *p, const Ray *ray){
+    if(p->length < 1e-6f) return -1.0f;
+    Vec3 u = p->axis;
+    float len = p->length;
+    Vec3 oc = v_sub(ray->origin, p->a);
+    Vec3 dp = v_sub(ray->dir, v_scale(u, v_dot(ray->dir, u)));
+    Vec3 op = v_sub(oc, v_scale(u, v_dot(oc, u)));
+    float a = v_dot(dp, dp);
+    if(a < 1e-12f) return -1.0f;
+    float b = v_dot(op, dp);
+    float c = v_dot(op, op) - p->radius * p->radius;
+    float disc = b*b - a*c;
+    if(disc < 0.0f) return -1.0f;
+    float t = (-b - sqrtf(disc)) / a;
+    float s = v_dot(oc, u) + t * v_dot(ray->dir, u);
+    if(s < 0.0f || s > len) return -1.0f;
+    return t;
+}
+
+static float hit_prim(const Primitive *p, const Ray *ray){
+    return p->kind == PRIM_SPHERE ? hit_sphere(p, ray) : hit_cylinder(p, ray);
+}
+
+// Closest hit when anyHit is false, otherwise the first hit before tmax.
+static int trace(const Tracer *t, const Ray *ray, float tmax, bool anyHit, float *outT){
+    if(t->nodeCount == 0) return -1;
+    int stack[64];
+    int depth = 0;
+    int best = -1;
+    float bestT = tmax;
+    if(hit_box(&t->nodes[0], ray, bestT) == INFINITY) return -1;
+    stack[depth++] = 0;
+
+    while(depth > 0){
+        const BvhNode *node = &t->nodes[stack[--depth]];
+        if(node->count > 0){
+            for(int i = node->start; i < node->start + node->count; i++){
+                float h = hit_prim(&t->prims[t->order[i]], ray);
+                if(h > 0.0f && h < bestT){
+                    bestT = h;
+                    best = t->order[i];
+                    if(anyHit){
+                        *outT = h;
+                        return best;
+                    }
+                }
+            }
+        } else if(depth + 2 <= 64){
+            // Push the farther child first so the nearer one is tried first
+            // and shrinks bestT for its sibling.
+            float tl = hit_box(&t->nodes[node->left], ray, bestT);
+            float tr = hit_box(&t->nodes[node->right], ray, bestT);
+            int near = tl <= tr ? node->left : node->right;
+            int far = tl <= tr ? node->right : node->left;
+            float farT = tl <= tr ? tr : tl;
+            if(farT != INFINITY) stack[depth++] = far;
+            if(fminf(tl, tr) != INFINITY) stack[depth++] = near;
+        }
+    }
+    *outT = bestT;
+    return best;
+}
+
+float tracer_cast(const Tracer *tracer, Vec3 origin, Vec3 dir){
+    Ray ray = make_ray(origin, v_normalize(dir));
+    float t;
+    return trace(tracer, &ray, 1e30f, false, &t) >= 0 ? t : -1.0f;
+}
+
+static Vec3 prim_normal(const Primitive *p, Vec3 hit){
+    if(p->kind == PRIM_SPHERE) return v_normalize(v_sub(hit, p->a));
+    Vec3 u = p->axis;
+    Vec3 rel = v_sub(hit, p->a);
+    return v_normalize(v_sub(rel, v_scale(u, v_dot(rel, u))));
+}
+
+
+static uint64_t scene_key(const TraceScene *s){
+    uint64_t h = 1469598103934665603ull;
+#define MIX(ptr, bytes) do { \
+        const unsigned char *m_ = (const unsigned char*)(ptr); \
+        for(size_t k_ = 0; k_ < (bytes); k_++) h = (h ^ m_[k_]) * 1099511628211ull; \
+    } while(0)
+    const MoleculeGeometry *mol = s->mol;
+    MIX(&s->yaw, sizeof(float));
+    MIX(&s->pitch, sizeof(float));
+    MIX(&s->zoom, sizeof(float));
+    MIX(&s->centerX, sizeof(float));
+    MIX(&s->centerY, sizeof(float));
+    MIX(&s->width, sizeof(int));
+    MIX(&s->height, sizeof(int));
+    MIX(&s->bondColor, sizeof(uint32_t));
+    MIX(&s->background, sizeof(uint32_t));
+    MIX(&mol->atomCount, sizeof(int));
+    MIX(mol->atomPos, sizeof(Vec3) * (size_t)mol->atomCount);
+    MIX(s->atomColor, sizeof(uint32_t) * (size_t)mol->atomCount);
+    MIX(mol->atomLabel, (size_t)mol->atomCount);
+    MIX(&mol->bondCount, sizeof(int));
+    MIX(mol->bonds, sizeof(Bond) * (size_t)mol->bondCount);
+#undef MIX
+    return h;
+}
+
+static void build_scene(Tracer *t, const TraceScene *s){
+    const MoleculeGeometry *mol = s->mol;
+    float cy = cosf(s->yaw), sy = sinf(s->yaw), cp = cosf(s->pitch), sp = sinf(s->pitch);
+    Vec3 view[MAX_ATOMS];
+
+    t->primCount = 0;
+    for(int i = 0; i < mol->atomCount; i++){
+        view[i] = rotate_view(mol->atomPos[i], cy, sy, cp, sp);
+        Primitive *p = &t->prims[t->primCount++];
+        uint8_t label = mol->atomLabel[i];
+        p->kind = PRIM_SPHERE;
+        p->a = p->b = view[i];
+        p->radius = atomRadiusByLabel[label < 5 ? label : 0];
+        unpack_color(s->atomColor[i], p->color);
+    }
+
+    float bondColor[3];
+    unpack_color(s->bondColor, bondColor);
+    for(int i = 0; i < mol->bondCount; i++){
+        Vec3 a = view[mol->bonds[i].from];
+        Vec3 b = view[mol->bonds[i].to];
+        if(mol->bonds[i].order == 2){
+            // Side by side across the screen, as the 2D renderer draws them.
+            Vec3 side = v_cross(v_sub(b, a), make_vec3(0.0f, 0.0f, 1.0f));
+            if(v_dot(side, side) < 1e-8f) side = make_vec3(1.0f, 0.0f, 0.0f);
+            side = v_scale(v_normalize(side), DOUBLE_BOND_OFFSET);
+            for(int k = -1; k <= 1; k += 2){
+                Primitive *p = &t->prims[t->primCount++];
+                p->kind = PRIM_CYLINDER;
+                p->a = v_add(a, v_scale(side, (float)k));
+                p->b = v_add(b, v_scale(side, (float)k));
+                p->radius = DOUBLE_BOND_RADIUS;
+                memcpy(p->color, bondColor, sizeof(bondColor));
+            }
+        } else {
+            Primitive *p = &t->prims[t->primCount++];
+            p->kind = PRIM_CYLINDER;
+            p->a = a;
+            p->b = b;
+            p->radius = BOND_RADIUS;
+            memcpy(p->color, bondColor, sizeof(bondColor));
+        }
+    }
+
+    t->top = 1.0f;
+    for(int i = 0; i < t->primCount; i++){
+        Primitive *p = &t->prims[i];
+        Vec3 axis = v_sub(p->b, p->a);
+        p->length = sqrtf(v_dot(axis, axis));
+        p->axis = p->length > 1e-6f ? v_scale(axis, 1.0f / p->length) : make_vec3(0.0f, 0.0f, 1.0f);
+        float mn[3], mx[3];
+        prim_bounds(&t->prims[i], mn, mx);
+        if(mx[2] + 1.0f > t->top) t->top = mx[2] + 1.0f;
+        t->order[i] = i;
+    }
+    t->nodeCount = 0;
+    if(t->primCount > 0) build_node(t, 0, t->primCount);
+}
+
+bool tracer_set_scene(Tracer *tracer, const TraceScene *scene){
+    uint64_t key = scene_key(scene);
+    if(tracer->hasScene && key == tracer->key) return false;
+
+    if(scene->width != tracer->width || scene->height != tracer->height){
+        release_image(tracer);
+        int w = scene->width > 0 ? scene->width : 1;
+        int h = scene->height > 0 ? scene->height : 1;
+        tracer->tilesX = (w + TILE - 1) / TILE;
+        tracer->tilesY = (h + TILE - 1) / TILE;
+        int tiles = tracer->tilesX * tracer->tilesY;
+        tracer->accum = malloc(sizeof(float) * 3 * (size_t)w * (size_t)h);
+        tracer->pixels = malloc(sizeof(uint32_t) * (size_t)w * (size_t)h);
+        tracer->tileSamples = malloc(sizeof(int) * (size_t)tiles);
+        tracer->tileCoarse = malloc(sizeof(bool) * (size_t)tiles);
+        tracer->batch = malloc(sizeof(int) * (size_t)tiles);
+        if(!tracer->accum || !tracer->pixels || !tracer->tileSamples || !tracer->tileCoarse || !tracer->batch){
+            release_image(tracer);
+            tracer->hasScene = false;
+            return false;
+        }
+        tracer->width = w;
+        tracer->height = h;
+        // Shown until the preview covers it.
+        uint32_t clear = 0xFF000000u | (scene->background >> 8);
+        for(size_t i = 0; i < (size_t)w * (size_t)h; i++) tracer->pixels[i] = clear;
+    }
+
+    tracer->scene = *scene;
+    tracer->scene.mol = NULL;
+    tracer->scene.atomColor = NULL;
+    unpack_color(scene->background, tracer->background);
+    build_scene(tracer, scene);
+
+    int tiles = tracer->tilesX * tracer->tilesY;
+    memset(tracer->tileSamples, 0, sizeof(int) * (size_t)tiles);
+    memset(tracer->tileCoarse, 0, sizeof(bool) * (size_t)tiles);
+    tracer->coarseNext = 0;
+    tracer->cursor = 0;
+    tracer->key = key;
+    tracer->hasScene = true;
+    return true;
+}
+
+
+// One path sample through image position (px, py): primary hit, a shadow
+// ray towards a jittered point on the key light, and one cosine-weighted
+// ambient-occlusion ray.
+static void shade_sample(const Tracer *t, float px, float py, uint32_t *rng, float out[3]){
+    const TraceScene *s = &t->scene;
+    // The line project_to_screen() maps onto this pixel runs through the
+    // perspective centre at z = -PERSPECTIVE_DISTANCE. It is entered from
+    // the front, so larger z occludes as in the rasterizer's draw order.
+    float u = (px - s->centerX) / s->zoom, v = (s->centerY - py) / s->zoom;
+    float spread = (PERSPECTIVE_DISTANCE + t->top) / PERSPECTIVE_DISTANCE;
+    Vec3 origin = make_vec3(u * spread, v * spread, t->top);
+    Ray primary = make_ray(origin, v_normalize(make_vec3(-u, -v, -PERSPECTIVE_DISTANCE)));
+
+    float hitT;
+    int prim = trace(t, &primary, 1e30f, false, &hitT);
+    if(prim < 0){
+        memcpy(out, t->background, sizeof(float) * 3);
+        return;
+    }
+
+    const Primitive *p = &t->prims[prim];
+    Vec3 hit = v_add(origin, v_scale(primary.dir, hitT));
+    Vec3 n = prim_normal(p, hit);
+    if(v_dot(n, primary.dir) > 0.0f) n = v_scale(n, -1.0f);
+    Vec3 start = v_add(hit, v_scale(n, RAY_EPSILON));
+
+    // Key light from the upper left, slightly towards the viewer.
+    const Vec3 key = { -0.42f, 0.56f, 0.71f };
+    const Vec3 keyU = { 0.80f, 0.60f, 0.0f };
+    const Vec3 keyV = { -0.43f, 0.57f, -0.70f };
+    float r1 = next_random(rng) * 2.0f * PI;
+    float r2 = sqrtf(next_random(rng)) * LIGHT_SPREAD;
+    Vec3 light = v_normalize(v_add(key, v_add(v_scale(keyU, cosf(r1) * r2), v_scale(keyV, sinf(r1) * r2))));
+
+    float diffuse = v_dot(n, light);
+    float visible = 0.0f;
+    if(diffuse > 0.0f){
+        Ray shadow = make_ray(start, light);
+        float tt;
+        visible = trace(t, &shadow, 1e30f, true, &tt) < 0 ? 1.0f : 0.0f;
+    } else {
+        diffuse = 0.0f;
+    }
+
+    Vec3 tangent = fabsf(n.x) > 0.9f ? make_vec3(0.0f, 1.0f, 0.0f) : make_vec3(1.0f, 0.0f, 0.0f);
+    Vec3 bx = v_normalize(v_cross(tangent, n));
+    Vec3 by = v_cross(n, bx);
+    float a1 = next_random(rng) * 2.0f * PI;
+    float a2 = next_random(rng);
+    float rr = sqrtf(a2);
+    Vec3 aoDir = v_add(v_add(v_scale(bx, cosf(a1) * rr), v_scale(by, sinf(a1) * rr)), v_scale(n, sqrtf(1.0f - a2)));
+    Ray aoRay = make_ray(start, aoDir);
+    float tt;
+    float ambient = trace(t, &aoRay, AO_DISTANCE, true, &tt) < 0 ? 1.0f : 0.0f;
+
+    Vec3 halfway = v_normalize(v_add(light, make_vec3(0.0f, 0.0f, 1.0f)));
+    float spec = fmaxf(v_dot(n, halfway), 0.0f);
+    spec *= spec; spec *= spec; spec *= spec; spec *= spec; spec *= spec;
+    spec *= 0.45f * visible;
+
+    for(int k = 0; k < 3; k++){
+        out[k] = p->color[k] * (0.30f * ambient + 0.85f * diffuse * visible) + spec;
+    }
+}
+
+static uint32_t to_argb(const float rgb[3], float scale){
+    uint32_t c = 0xFF000000u;
+    for(int k = 0; k < 3; k++){
+        float v = rgb[k] * scale;
+        int b = (int)(v * 255.0f + 0.5f);
+        if(b < 0) b = 0;
+        if(b > 255) b = 255;
+        c |= (uint32_t)b << (16 - 8 * k);
+    }
+    return c;
+}
+
+static void tile_rect(const Tracer *t, int tile, int *x0, int *y0, int *x1, int *y1){
+    *x0 = (tile % t->tilesX) * TILE;
+    *y0 = (tile / t->tilesX) * TILE;
+    *x1 = *x0 + TILE < t->width ? *x0 + TILE : t->width;
+    *y1 = *y0 + TILE < t->height ? *y0 + TILE : t->height;
+}
+
+static void fill_tile(Tracer *t, int tile, const float rgb[3]){
+    int x0, y0, x1, y1;
+    tile_rect(t, tile, &x0, &y0, &x1, &y1);
+    uint32_t c = to_argb(rgb, 1.0f);
+    for(int y = y0; y < y1; y++){
+        for(int x = x0; x < x1; x++){
+            size_t i = (size_t)y * (size_t)t->width + (size_t)x;
+            memcpy(&t->accum[3*i], rgb, sizeof(float) * 3);
+            t->pixels[i] = c;
+        }
+    }
+}
+
+// Tiles whose screen footprint misses every primitive are background forever.
+static bool tile_is_empty(const Tracer *t, int tile){
+    if(t->nodeCount == 0) return true;
+    int x0, y0, x1, y1;
+    tile_rect(t, tile, &x0, &y0, &x1, &y1);
+    const TraceScene *s = &t->scene;
+    float minX = ((float)x0 - s->centerX) / s->zoom, maxX = ((float)x1 - s->centerX) / s->zoom;
+    float minY = (s->centerY - (float)y1) / s->zoom, maxY = (s->centerY - (float)y0) / s->zoom;
+    for(int i = 0; i < t->primCount; i++){
+        float mn[3], mx[3];
+        prim_bounds(&t->prims[i], mn, mx);
+        // Projected footprint of the bounds: x * D / (D + z) is monotonic in
+        // x and z, so the corners give its extent.
+        float grow = PERSPECTIVE_DISTANCE / (PERSPECTIVE_DISTANCE + mn[2]);
+        float shrink = PERSPECTIVE_DISTANCE / (PERSPECTIVE_DISTANCE + mx[2]);
+        float loX = mn[0] * (mn[0] < 0.0f ? grow : shrink), hiX = mx[0] * (mx[0] > 0.0f ? grow : shrink);
+        float loY = mn[1] * (mn[1] < 0.0f ? grow : shrink), hiY = mx[1] * (mx[1] > 0.0f ? grow : shrink);
+        if(hiX >= minX && loX <= maxX && hiY >= minY && loY <= maxY) return false;
+    }
+    return true;
+}
+
+static void coarse_tiles(void *ctx, int begin, int end){
+    Tracer *t = ctx;
+    for(int b = begin; b < end; b++){
+        int tile = t->batch[b];
+        if(tile_is_empty(t, tile)){
+            fill_tile(t, tile, t->background);
+            t->tileSamples[tile] = TRACE_MAX_SAMPLES;
+            continue;
+        }
+        int x0, y0, x1, y1;
+        tile_rect(t, tile, &x0, &y0, &x1, &y1);
+        for(int by = y0; by < y1; by += COARSE){
+            for(int bx = x0; bx < x1; bx += COARSE){
+                uint32_t rng = hash32((uint32_t)(by * t->width + bx) ^ 0xC0A45Eu);
+                float rgb[3];
+                shade_sample(t, (float)bx + COARSE * 0.5f, (float)by + COARSE * 0.5f, &rng, rgb);
+                uint32_t c = to_argb(rgb, 1.0f);
+                for(int y = by; y < by + COARSE && y < y1; y++){
+                    for(int x = bx; x < bx + COARSE && x < x1; x++){
+                        size_t i = (size_t)y * (size_t)t->width + (size_t)x;
+                        memcpy(&t->accum[3*i], rgb, sizeof(rgb));
+                        t->pixels[i] = c;
+                    }
+                }
+            }
+        }
+        t->tileCoarse[tile] = true;
+    }
+}
+
+static void sample_tiles(void *ctx, int begin, int end){
+    Tracer *t = ctx;
+    for(int b = begin; b < end; b++){
+        int tile = t->batch[b];
+        int sample = t->tileSamples[tile];
+        bool replace = t->tileCoarse[tile];
+        float scale = 1.0f / (float)(sample + 1);
+        int x0, y0, x1, y1;
+        tile_rect(t, tile, &x0, &y0, &x1, &y1);
+        for(int y = y0; y < y1; y++){
+            for(int x = x0; x < x1; x++){
+                size_t i = (size_t)y * (size_t)t->width + (size_t)x;
+                uint32_t rng = hash32((uint32_t)i * 0x2545F491u ^ hash32((uint32_t)sample));
+                float rgb[3];
+                shade_sample(t, (float)x + next_random(&rng), (float)y + next_random(&rng), &rng, rgb);
+                float *acc = &t->accum[3*i];
+                for(int k = 0; k < 3; k++) acc[k] = replace ? rgb[k] : acc[k] + rgb[k];
+                t->pixels[i] = to_argb(acc, scale);
+            }
+        }
+        t->tileCoarse[tile] = false;
+        t->tileSamples[tile] = sample + 1;
+    }
+}
+
+static int batch_size(void){
+    return (thread_pool_size() + 1) * 4;
+}
+
+// Draws the next batch of preview tiles; false once the preview is done.
+static bool coarse_batch(Tracer *tracer, int batchSize){
+    int tiles = tracer->tilesX * tracer->tilesY;
+    if(tracer->coarseNext >= tiles) return false;
+    int count = tiles - tracer->coarseNext;
+    if(count > batchSize * 8) count = batchSize * 8;
+    for(int k = 0; k < count; k++) tracer->batch[k] = tracer->coarseNext + k;
+    parallel_for(count, 8, coarse_tiles, tracer);
+    tracer->coarseNext += count;
+    return true;
+}
+
+// Adds a sample to a batch of the tiles furthest behind, round-robin, so a
+// pass cut short resumes where it stopped. False once every tile is full.
+static bool sample_batch(Tracer *tracer, int batchSize){
+    int tiles = tracer->tilesX * tracer->tilesY;
+    int least = tracer_samples(tracer);
+    if(least >= TRACE_MAX_SAMPLES) return false;
+    int count = 0;
+    for(int k = 0; k < tiles && count < batchSize; k++){
+        int tile = (tracer->cursor + k) % tiles;
+        if(tracer->tileSamples[tile] == least) tracer->batch[count++] = tile;
+    }
+    tracer->cursor = (tracer->batch[count - 1] + 1) % tiles;
+    parallel_for(count, 1, sample_tiles, tracer);
+    return true;
+}
+
+void tracer_render(Tracer *tracer, double budgetSeconds){
+    if(!tracer->hasScene) return;
+    PROF_SCOPE("tracer_render");
+    double start = now_seconds();
+    int batchSize = batch_size();
+
+    // The preview is spent from the same budget, a batch of tiles at a
+    // time; until it covers the image the previous one stays underneath.
+    // Every call makes at least one batch of progress.
+    while(coarse_batch(tracer, batchSize)){
+        if(now_seconds() - start >= budgetSeconds) return;
+    }
+    while(now_seconds() - start < budgetSeconds && sample_batch(tracer, batchSize)){}
+}
+
+void tracer_render_samples(Tracer *tracer, int samples){
+    if(!tracer->hasScene) return;
+    PROF_SCOPE("tracer_render");
+    int batchSize = batch_size();
+    while(coarse_batch(tracer, batchSize)){}
+    int target = tracer_samples(tracer) + samples;
+    while(tracer_samples(tracer) < target && sample_batch(tracer, batchSize)){}
+}
+
+const uint32_t *tracer_pixels(const Tracer *tracer){
+    return tracer->pixels;
+}
+
+bool tracer_preview_done(const Tracer *tracer){
+    return tracer->hasScene && tracer->coarseNext >= tracer->tilesX * tracer->tilesY;
+}
+
+int tracer_samples(const Tracer *tracer){
+    if(!tracer->hasScene) return 0;
+    int tiles = tracer->tilesX * tracer->tilesY;
+    int least = TRACE_MAX_SAMPLES;
+    for(int i = 0; i < tiles; i++){
+        if(tracer->tileSamples[i] < least) least = tracer->tileSamples[i];
+    }
+    return least;
+}
@@ -0,0 +1,57 @@
+#ifndef ATLAS_RAYTRACE_H
+#define ATLAS_RAYTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+#define TRACE_MAX_SAMPLES 256
+
+typedef struct Tracer Tracer;
+
+// Molecule in model space; the tracer applies yaw/pitch and the same
+// perspective screen mapping as project_to_screen(), so the traced view
+// lines up with draw_molecule.
+typedef struct {
+    const MoleculeGeometry *mol;
+    const uint32_t *atomColor; // RGBA per atom
+    uint32_t bondColor;        // RGBA
+    uint32_t background;       // RGBA
+    float yaw, pitch;
+    float zoom;                // pixels per angstrom
+    float centerX, centerY;    // image position of the molecule origin
+    int width, height;
+} TraceScene;
+
+Tracer *tracer_create(void);
+void tracer_destroy(Tracer *tracer);
+
+// Adopts the scene; accumulation restarts only when something that affects
+// the image changed. Returns true if it restarted.
+bool tracer_set_scene(Tracer *tracer, const TraceScene *scene);
+
+// Adds samples until the time budget is spent. After a restart the budget
+// first goes to a coarse preview, drawn over the previous image; every
+// call advances it by at least one batch of tiles, so it also completes
+// under a zero budget.
+void tracer_render(Tracer *tracer, double budgetSeconds);
+
+// Finishes the preview, then adds the given number of samples to every
+// pixel (up to TRACE_MAX_SAMPLES) however long that takes. Replays use it
+// so each frame draws the same image on any machine.
+void tracer_render_samples(Tracer *tracer, int samples);
+
+// True once the preview covers the whole image.
+bool tracer_preview_done(const Tracer *tracer);
+
+// ARGB8888 pixels, width*height, row-major.
+const uint32_t *tracer_pixels(const Tracer *tracer);
+
+// Samples every pixel has received so far.
+int tracer_samples(const Tracer *tracer);
+
+// Closest hit distance along a ray in view space, or -1. Exposed for tests.
+float tracer_cast(const Tracer *tracer, Vec3 origin, Vec3 dir);
+
+#endif
@@ -0,0 +1,485 @@
+#include "reload.h"
+#include "thread_pool.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RELOAD_CHUNK 4096
+
+// ---- mapping and fingerprints ----
+
+typedef struct {
+    const char *text;
+    size_t size;
+} MappedFile;
+
+static bool map_file(MappedFile *m, const char *path, char *error, size_t errorSize){
+    m->text = NULL;
+    m->size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        snprintf(error, errorSize, "%s: cannot open", path);
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        snprintf(error, errorSize, "%s: not a regular file", path);
+        close(fd);
+        return false;
+    }
+    m->size = (size_t)st.st_size;
+    if(m->size > 0){
+        void *p = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED){
+            snprintf(error, errorSize, "%s: cannot map", path);
+            close(fd);
+            return false;
+        }
+        madvise(p, m->size, MADV_SEQUENTIAL);
+        m->text = p;
+    }
+    close(fd);
+    return true;
+}
+
+static void unmap_file(MappedFile *m){
+    if(m->text) munmap((void *)m->text, m->size);
+    m->text = NULL;
+}
+
+static inline uint64_t rotl64(uint64_t v, int s){
+    return (v << s) | (v >> (64 - s));
+}
+
+// Four independent multiply chains, so hashing runs at memory speed. The
+// length is mixed in so a short final block never matches a full one.
+static uint64_t hash_bytes(const char *p, size_t n){
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h[4] = { n, n ^ 0x243F6A8885A308D3ull, n ^ 0x13198A2E03707344ull, n ^ 0xA4093822299F31D0ull };
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        uint64_t w[4];
+        memcpy(w, p + i, 32);
+        for(int l = 0; l < 4; l++) h[l] = rotl64(h[l] ^ w[l], 31) * k;
+    }
+    uint64_t w[4] = { 0, 0, 0, 0 };
+    memcpy(w, p + i, n - i);
+    for(int l = 0; l < 4; l++) h[l] = rotl64(h[l] ^ w[l], 31) * k;
+    uint64_t r = h[0] ^ rotl64(h[1], 17) ^ rotl64(h[2], 34) ^ rotl64(h[3], 51);
+    return (r ^ (r >> 29)) * k;
+}
+
+static void blocks_free(BlockList *list){
+    free(list->hash);
+    free(list->end);
+    memset(list, 0, sizeof(*list));
+}
+
+static bool blocks_reserve(BlockList *list, int count){
+    if(count <= list->capacity) return true;
+    int capacity = list->capacity ? list->capacity : 1024;
+    while(capacity < count) capacity *= 2;
+    uint64_t *hash = realloc(list->hash, sizeof(uint64_t) * (size_t)capacity);
+    if(hash) list->hash = hash;
+    long long *end = realloc(list->end, sizeof(long long) * (size_t)capacity);
+    if(end) list->end = end;
+    if(!hash || !end) return false;
+    list->capacity = capacity;
+    return true;
+}
+
+static long long block_start(const BlockList *list, int i){
+    return i > 0 ? list->end[i - 1] : 0;
+}
+
+// Hashes blocks [first, first + count) of a list as they would sit in text
+// moved by `shift` bytes.
+typedef struct {
+    const char *text;
+    const BlockList *list;
+    int first;
+    long long shift;
+    uint64_t *out;
+} HashJob;
+
+static void hash_blocks(void *ctx, int begin, int end){
+    HashJob *job = ctx;
+    for(int i = begin; i < end; i++){
+        int b = job->first + i;
+        long long start = block_start(job->list, b);
+        job->out[i] = hash_bytes(job->text + start + job->shift, (size_t)(job->list->end[b] - start));
+    }
+}
+
+static void hash_list(const char *text, const BlockList *list, int first, int count, long long shift, uint64_t *out){
+    HashJob job = { text, list, first, shift, out };
+    parallel_for(count, 256, hash_blocks, &job);
+}
+
+// Appends blocks covering text bytes [from, to).
+static bool blocks_append(BlockList *list, const char *text, long long from, long long to){
+    int first = list->count;
+    int count = (int)((to - from + LIBRARY_BLOCK - 1) / LIBRARY_BLOCK);
+    if(!blocks_reserve(list, first + count)) return false;
+    for(int i = 0; i < count; i++){
+        long long end = from + (long long)(i + 1) * LIBRARY_BLOCK;
+        list->end[first + i] = end < to ? end : to;
+    }
+    list->count += count;
+    hash_list(text, list, first, count, 0, list->hash + first);
+    return true;
+}
+
+// ---- record tables ----
+
+static void table_free(XyzRecordTable *t){
+    free(t->offset);
+    free(t->line);
+    free(t->entryStart);
+    free(t->unnamed);
+    memset(t, 0, sizeof(*t));
+}
+
+static bool table_reserve(XyzRecordTable *t, int count){
+    if(count <= t->capacity) return true;
+    int capacity = t->capacity ? t->capacity : 1024;
+    while(capacity < count) capacity *= 2;
+    long long *offset = realloc(t->offset, sizeof(long long) * (size_t)capacity);
+    if(offset) t->offset = offset;
+    int *line = realloc(t->line, sizeof(int) * (size_t)capacity);
+    if(line) t->line = line;
+    int *entryStart = realloc(t->entryStart, sizeof(int) * (size_t)capacity);
+    if(entryStart) t->entryStart = entryStart;
+    unsigned char *unnamed = realloc(t->unnamed, (size_t)capacity);
+    if(unnamed) t->unnamed = unnamed;
+    if(!offset || !line || !entryStart || !unnamed) return false;
+    t->capacity = capacity;
+    return true;
+}
+
+static bool name_line_blank(const XyzRecord *rec){
+    const char *end = rec->text + rec->length;
+    const char *p = memchr(rec->text, '\n', rec->length);
+    if(!p) return true;
+    for(p++; p < end && *p != '\n'; p++){
+        if(!isspace((unsigned char)*p)) return false;
+    }
+    return true;
+}
+
+// ---- parsing ----
+
+typedef struct {
+    const XyzRecord *records;
+    const char *path;
+    LibraryEntry *entries;
+    signed char *status;
+} ParseJob;
+
+static void parse_records(void *ctx, int begin, int end){
+    ParseJob *job = ctx;
+    char error[8];
+    for(int i = begin; i < end; i++){
+        job->status[i] = (signed char)xyz_parse_record(&job->records[i], job->path, &job->entries[i],
+                                                       error, sizeof(error));
+    }
+}
+
+// Splits and parses text that starts at a record boundary `base` bytes into
+// the file, after `line` lines and `record` records. Entries are appended
+// to out and records to table, their entryStart counted from entryBase. On
+// error out and table are left at whatever was appended; callers roll back.
+static bool parse_region(const char *text, size_t size, const char *path, long long base, int line, int record,
+                         Library *out, XyzRecordTable *table, int entryBase, int *endLine,
+                         char *error, size_t errorSize){
+    XyzReader reader;
+    xyz_reader_open_memory(&reader, text, size, path);
+    reader.line = line;
+    reader.record = record;
+    XyzRecord *records = malloc(sizeof(XyzRecord) * RELOAD_CHUNK);
+    signed char *status = malloc(RELOAD_CHUNK);
+    bool ok = records && status;
+    if(!ok) snprintf(error, errorSize, "%s: out of memory", path);
+    int produced = 0;
+    while(ok){
+        size_t start = reader.pos;
+        int startLine = reader.line;
+        int n = xyz_reader_split(&reader, records, RELOAD_CHUNK, error, errorSize);
+        if(n <= 0){
+            ok = n == 0;
+            break;
+        }
+        if(!library_reserve(out, out->count + n) || !table_reserve(table, table->count + n)){
+            snprintf(error, errorSize, "%s: out of memory", path);
+            ok = false;
+            break;
+        }
+        ParseJob job = { records, path, out->entries + out->count, status };
+        parallel_for(n, 64, parse_records, &job);
+
+        // Drop the records without heavy atoms, recording where each began.
+        int first = out->count;
+        for(int i = 0; i < n; i++){
+            if(status[i] < 0){
+                LibraryEntry entry;
+                xyz_parse_record(&records[i], path, &entry, error, errorSize);
+                ok = false;
+                break;
+            }
+            int t = table->count++;
+            table->offset[t] = base + (long long)start;
+            table->line[t] = startLine;
+            table->entryStart[t] = entryBase + produced;
+            table->unnamed[t] = name_line_blank(&records[i]);
+            start = (size_t)(records[i].text + records[i].length - text);
+            startLine = records[i].line - 1 + (int)strtol(records[i].text, NULL, 10) + 2;
+            if(status[i] > 0){
+                if(out->count != first + i) out->entries[out->count] = out->entries[first + i];
+                out->count++;
+                produced++;
+            }
+        }
+    }
+    *endLine = reader.line;
+    xyz_reader_close(&reader);
+    free(records);
+    free(status);
+    return ok;
+}
+
+// ---- load ----
+
+bool library_source_load(LibrarySource *src, Library *lib, const char *path, char *error, size_t errorSize){
+    memset(src, 0, sizeof(*src));
+    MappedFile m;
+    if(!map_file(&m, path, error, errorSize)) return false;
+    src->path = strdup(path);
+    src->size = (long long)m.size;
+    src->firstEntry = lib->count;
+    int endLine;
+    bool ok = src->path && blocks_append(&src->blocks, m.text, 0, (long long)m.size);
+    if(!ok) snprintf(error, errorSize, "%s: out of memory", path);
+    if(ok) ok = parse_region(m.text, m.size, path, 0, 0, 0, lib, &src->records, 0, &endLine, error, errorSize);
+    unmap_file(&m);
+    if(!ok){
+        lib->count = src->firstEntry;
+        library_source_free(src);
+        return false;
+    }
+    src->entryCount = lib->count - src->firstEntry;
+    return true;
+}
+
+// ---- reload ----
+
+static int record_entry(const LibrarySource *src, int r){
+    return r < src->records.count ? src->records.entryStart[r] : src->entryCount;
+}
+
+#define SCAN_BATCH 4096
+
+// How many blocks of list, from `first` towards `last` (inclusive, either
+// direction), hash the same in text moved by `shift` bytes. Hashed in
+// batches so a change near the start of the scan stops it early.
+static int matching_run(const char *text, const BlockList *list, int first, int last, long long shift,
+                        uint64_t *scratch){
+    int dir = last >= first ? 1 : -1;
+    int total = dir * (last - first) + 1, matched = 0;
+    while(matched < total){
+        int n = total - matched < SCAN_BATCH ? total - matched : SCAN_BATCH;
+        int b = first + dir * matched;
+        int low = dir > 0 ? b : b - n + 1;
+        hash_list(text, list, low, n, shift, scratch);
+        for(int i = 0; i < n; i++){
+            int q = dir > 0 ? i : n - 1 - i;
+            if(scratch[q] != list->hash[low + q]) return matched + i;
+        }
+        matched += n;
+    }
+    return matched;
+}
+
+static bool delta_push(LibraryDelta *delta, int entry, int *capacity){
+    if(delta->changedCount == *capacity){
+        int grown = *capacity ? *capacity * 2 : 16;
+        int *changed = realloc(delta->changed, sizeof(int) * (size_t)grown);
+        if(!changed) return false;
+        delta->changed = changed;
+        *capacity = grown;
+    }
+    delta->changed[delta->changedCount++] = entry;
+    return true;
+}
+
+bool library_source_reload(LibrarySource *src, Library *lib, LibraryDelta *delta, char *error, size_t errorSize){
+    memset(delta, 0, sizeof(*delta));
+    delta->shiftedFrom = -1;
+    delta->oldCount = lib->count;
+
+    MappedFile m;
+    if(!map_file(&m, src->path, error, errorSize)) return false;
+    uint64_t *scratch = malloc(sizeof(uint64_t) * SCAN_BATCH);
+    if(!scratch){
+        snprintf(error, errorSize, "%s: out of memory", src->path);
+        unmap_file(&m);
+        return false;
+    }
+
+    // The blocks that still match where they were, counted from the start,
+    // then from the end with the size change applied.
+    const BlockList *blocks = &src->blocks;
+    long long oldSize = src->size, newSize = (long long)m.size, shift = newSize - oldSize;
+    int fits = 0;
+    while(fits < blocks->count && blocks->end[fits] <= newSize) fits++;
+    int h = fits > 0 ? matching_run(m.text, blocks, 0, fits - 1, 0, scratch) : 0;
+    long long prefix = block_start(blocks, h);
+    if(h == blocks->count && oldSize == newSize){
+        free(scratch);
+        unmap_file(&m);
+        return true;
+    }
+    int low = h;
+    while(low < blocks->count && block_start(blocks, low) + shift < prefix) low++;
+    int t = low < blocks->count ? matching_run(m.text, blocks, blocks->count - 1, low, shift, scratch) : 0;
+    long long suffix = oldSize - block_start(blocks, blocks->count - t);
+    free(scratch);
+
+    // Records k..j-1 overlap the change. k ends before the first changed
+    // byte and j starts after the last, so both boundaries sit between
+    // unchanged bytes and a new split from k reaches j exactly, unless the
+    // edit moved record boundaries past j; then split through to the end.
+    const XyzRecordTable *old = &src->records;
+    int n = old->count, k = 0, j;
+    while(k + 1 < n && old->offset[k + 1] < prefix) k++;
+    long long changedEnd = oldSize - suffix;
+    j = k + 1;
+    while(j < n && old->offset[j] <= changedEnd) j++;
+    if(j > n) j = n;
+
+    XyzRecordTable table;
+    memset(&table, 0, sizeof(table));
+    Library mid;
+    library_init(&mid);
+    bool ok = false;
+    for(int attempt = 0; attempt < 2 && !ok; attempt++){
+        if(attempt == 1){
+            if(j == n) break;
+            j = n;
+        }
+        table.count = 0;
+        mid.count = 0;
+        long long begin = k < n ? old->offset[k] : 0;
+        long long end = j < n ? old->offset[j] + shift : newSize;
+        int endLine;
+        ok = table_reserve(&table, n + 1);
+        if(ok){
+            memcpy(table.offset, old->offset, sizeof(long long) * (size_t)k);
+            memcpy(table.line, old->line, sizeof(int) * (size_t)k);
+            memcpy(table.entryStart, old->entryStart, sizeof(int) * (size_t)k);
+            memcpy(table.unnamed, old->unnamed, (size_t)k);
+            table.count = k;
+            ok = parse_region(m.text + begin, (size_t)(end - begin), src->path, begin, k < n ? old->line[k] : 0, k,
+                              &mid, &table, record_entry(src, k), &endLine, error, errorSize);
+        }
+        if(ok && j < n){
+            int lineShift = endLine - old->line[j];
+            int entryShift = record_entry(src, k) + mid.count - record_entry(src, j);
+            ok = table_reserve(&table, table.count + n - j);
+            for(int r = j; ok && r < n; r++){
+                int q = table.count++;
+                table.offset[q] = old->offset[r] + shift;
+                table.line[q] = old->line[r] + lineShift;
+                table.entryStart[q] = old->entryStart[r] + entryShift;
+                table.unnamed[q] = old->unnamed[r];
+            }
+        }
+    }
+
+    // Only the changed span is hashed again; blocks at either end carry over.
+    BlockList fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    if(ok){
+        ok = blocks_reserve(&fresh, h + 1);
+        if(ok){
+            memcpy(fresh.hash, blocks->hash, sizeof(uint64_t) * (size_t)h);
+            memcpy(fresh.end, blocks->end, sizeof(long long) * (size_t)h);
+            fresh.count = h;
+            ok = blocks_append(&fresh, m.text, prefix, newSize - suffix) && blocks_reserve(&fresh, fresh.count + t);
+        }
+        for(int b = blocks->count - t; ok && b < blocks->count; b++){
+            fresh.hash[fresh.count] = blocks->hash[b];
+            fresh.end[fresh.count++] = blocks->end[b] + shift;
+        }
+        if(!ok) snprintf(error, errorSize, "%s: out of memory", src->path);
+    }
+    unmap_file(&m);
+    int oldMid = record_entry(src, j) - record_entry(src, k);
+    if(ok) ok = library_reserve(lib, lib->count + mid.count - oldMid);
+    if(!ok){
+        blocks_free(&fresh);
+        table_free(&table);
+        library_free(&mid);
+        return false;
+    }
+    delta->recordsParsed = table.count - k - (n - j);
+
+    // Entries that differ at the front of the parsed range are edits; past
+    // the first difference, a changed count means the rest moved.
+    int at = src->firstEntry + record_entry(src, k), capacity = 0;
+    int same = 0;
+    while(same < mid.count && same < oldMid &&
+          memcmp(&mid.entries[same], &lib->entries[at + same], sizeof(LibraryEntry)) == 0) same++;
+    if(mid.count != oldMid){
+        delta->shiftedFrom = at + same;
+    } else {
+        for(int i = same; i < mid.count && ok; i++){
+            if(memcmp(&mid.entries[i], &lib->entries[at + i], sizeof(LibraryEntry)) != 0) ok = delta_push(delta, at + i, &capacity);
+        }
+    }
+    memmove(&lib->entries[at + mid.count], &lib->entries[at + oldMid],
+            sizeof(LibraryEntry) * (size_t)(lib->count - at - oldMid));
+    memcpy(&lib->entries[at], mid.entries, sizeof(LibraryEntry) * (size_t)mid.count);
+    lib->count += mid.count - oldMid;
+    src->entryCount += mid.count - oldMid;
+
+    // Unnamed records after the edit are named after their new position.
+    int recordShift = table.count - n;
+    if(recordShift != 0){
+        for(int r = k + delta->recordsParsed; r < table.count && ok; r++){
+            if(!table.unnamed[r]) continue;
+            int next = r + 1 < table.count ? table.entryStart[r + 1] : src->entryCount;
+            if(table.entryStart[r] == next) continue; // no heavy atoms, no entry
+            int e = src->firstEntry + table.entryStart[r];
+            memset(lib->entries[e].name, 0, sizeof(lib->entries[e].name));
+            snprintf(lib->entries[e].name, sizeof(lib->entries[e].name), "record %d", r + 1);
+            if(delta->shiftedFrom < 0) ok = delta_push(delta, e, &capacity);
+        }
+    }
+
+    table_free(&src->records);
+    src->records = table;
+    blocks_free(&src->blocks);
+    src->blocks = fresh;
+    src->size = newSize;
+    library_free(&mid);
+    if(!ok) snprintf(error, errorSize, "%s: out of memory", src->path);
+    return ok;
+}
+
+void library_source_free(LibrarySource *src){
+    free(src->path);
+    blocks_free(&src->blocks);
+    table_free(&src->records);
+    memset(src, 0, sizeof(*src));
+}
+
+void library_delta_free(LibraryDelta *delta){
+    free(delta->changed);
+    memset(delta, 0, sizeof(*delta));
+}
@@ -0,0 +1,62 @@
+#ifndef ATLAS_RELOAD_H
+#define ATLAS_RELOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "library.h"
+
+// XYZ libraries that are re-read after an edit without parsing the whole
+// file again. The file is fingerprinted as a run of hashed blocks; after an
+// edit, the blocks that still match at their old place (from the start) or
+// at their old distance from the end bound the changed bytes. Only the
+// records overlapping them are split and parsed, only entries that actually
+// differ are reported, and only the changed span is hashed into new blocks.
+
+#define LIBRARY_BLOCK 4096
+
+typedef struct {
+    uint64_t *hash;
+    long long *end;  // block i is bytes [end[i - 1], end[i]), at most LIBRARY_BLOCK of them
+    int count, capacity;
+} BlockList;
+
+typedef struct {
+    long long *offset;      // where splitting resumes for the record: just past the one before
+    int *line;              // lines before offset
+    int *entryStart;        // first entry the record made, counted from firstEntry
+    unsigned char *unnamed; // blank name line, so the name is "record N" after its position
+    int count, capacity;
+} XyzRecordTable;
+
+typedef struct {
+    char *path;
+    long long size;
+    int firstEntry, entryCount; // the file made lib->entries[firstEntry, firstEntry + entryCount)
+    BlockList blocks;
+    XyzRecordTable records;
+} LibrarySource;
+
+typedef struct {
+    int *changed;        // entries before shiftedFrom whose name or geometry differ, ascending
+    int changedCount;
+    int shiftedFrom;     // entries from here on were added, removed or moved; -1 if none were
+    int oldCount;        // lib->count before the reload
+    int recordsParsed;
+} LibraryDelta;
+
+// Appends every record of a regular file to lib, parsing across the worker
+// pool, and fingerprints the file. On error nothing is appended.
+bool library_source_load(LibrarySource *src, Library *lib, const char *path, char *error, size_t errorSize);
+
+// Re-reads the file after a change and updates the entries it made in
+// place. If the new text does not parse, lib and src are left as they were
+// and false is returned, so the next save is compared against the last good
+// one.
+bool library_source_reload(LibrarySource *src, Library *lib, LibraryDelta *delta, char *error, size_t errorSize);
+
+void library_source_free(LibrarySource *src);
+void library_delta_free(LibraryDelta *delta);
+
+#endif
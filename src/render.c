@@ -0,0 +1,640 @@
+#include "render.h"
+#include "profiler.h"
+#include "rings.h"
+#include "text.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void set_draw_color(CommandBuffer *cb, uint32_t rgba, uint8_t a){
+    cmd_color(cb, color_r(rgba), color_g(rgba), color_b(rgba), a);
+}
+
+uint32_t lighten(uint32_t rgba, float t){
+    uint8_t r = color_r(rgba);
+    uint8_t g = color_g(rgba);
+    uint8_t b = color_b(rgba);
+
+    uint8_t nr = (uint8_t)clampf(r + (255 - r)*t, 0, 255);
+    uint8_t ng = (uint8_t)clampf(g + (255 - g)*t, 0, 255);
+    uint8_t nb = (uint8_t)clampf(b + (255 - b)*t, 0, 255);
+    return ((uint32_t)nr<<24) | ((uint32_t)ng<<16) | ((uint32_t)nb<<8) | 0xFF;
+}
+
+uint32_t darken(uint32_t rgba, float t){
+    uint8_t r = color_r(rgba);
+    uint8_t g = color_g(rgba);
+    uint8_t b = color_b(rgba);
+
+    uint8_t nr = (uint8_t)clampf(r*(1.0f - t), 0, 255);
+    uint8_t ng = (uint8_t)clampf(g*(1.0f - t), 0, 255);
+    uint8_t nb = (uint8_t)clampf(b*(1.0f - t), 0, 255);
+    return ((uint32_t)nr<<24) | ((uint32_t)ng<<16) | ((uint32_t)nb<<8) | 0xFF;
+}
+
+// One span per row covering exactly the pixels with x*x + y*y <= r*r.
+void draw_filled_circle(CommandBuffer *cb, int cx, int cy, int radius){
+    int points = 0;
+    for(int y = -radius; y <= radius; y++){
+        int rem = radius*radius - y*y;
+        int half = (int)sqrtf((float)rem);
+        while(half*half > rem) half--;
+        while((half+1)*(half+1) <= rem) half++;
+        cmd_fill_rect(cb, cx - half, cy + y, 2*half + 1, 1);
+        points += 2*half + 1;
+    }
+    PROF_COUNT(PROF_PIXELS, points);
+}
+
+void draw_thick_line(CommandBuffer *cb, int x1, int y1, int x2, int y2, int thickness){
+    if(thickness < 2) thickness = 2;
+
+    float dx = (float)(x2 - x1);
+    float dy = (float)(y2 - y1);
+    float len = sqrtf(dx*dx + dy*dy);
+    if(len < 1e-4f) return;
+
+    float normalX = -dy / len;
+    float normalY =  dx / len;
+
+    int steps = (int)len;
+    float half = thickness * 0.5f;
+    int points = (steps + 1) * (2 * (int)half + 1);
+    PROF_COUNT(PROF_PIXELS, points);
+
+    for(int i = 0; i <= steps; i++){
+        float t = (steps == 0) ? 0.0f : (float)i / (float)steps;
+        int x = (int)lroundf((float)x1 + dx * t);
+        int y = (int)lroundf((float)y1 + dy * t);
+
+        for(int j = -(int)half; j <= (int)half; j++){
+            int px = x + (int)lroundf(normalX * (float)j);
+            int py = y + (int)lroundf(normalY * (float)j);
+            cmd_point(cb, px, py);
+        }
+    }
+}
+
+const TileQuality tileQualityFull = { 1.0f, 1.0f, true, true, false };
+
+static int scaled(float pixels, float scale){
+    return (int)lroundf(pixels * scale);
+}
+
+void draw_stick(CommandBuffer *cb, int x1,int y1,int x2,int y2, int order, uint32_t baseColor, uint8_t alpha, float scale){
+    int outer = scaled((order == 1) ? 6 : (order == 2 ? 8 : 10), scale);
+    int inner = scaled((order == 1) ? 3 : (order == 2 ? 4 : 5), scale);
+    int offset = scaled(3, scale);
+
+    uint32_t dark = darken(baseColor, 0.35f);
+    uint32_t bright = lighten(baseColor, 0.35f);
+
+    set_draw_color(cb, dark, alpha);
+    draw_thick_line(cb, x1,y1,x2,y2, outer);
+
+    set_draw_color(cb, bright, alpha);
+    draw_thick_line(cb, x1,y1,x2,y2, inner);
+
+    if(order == 2){
+        set_draw_color(cb, dark, alpha);
+        draw_thick_line(cb, x1+offset,y1-offset,x2+offset,y2-offset, outer - scaled(2, scale));
+        set_draw_color(cb, bright, alpha);
+        draw_thick_line(cb, x1+offset,y1-offset,x2+offset,y2-offset, inner - scaled(1, scale));
+    }
+}
+
+// Delocalized rings get a circle inset from their atoms, in the ring's own
+// plane so it foreshortens with the molecule.
+static void draw_aromatic_rings(CommandBuffer *cb, const MoleculeGeometry *mol, const RingInfo *rings,
+                                const ViewTransform *vt, uint32_t color, uint8_t alpha, float s){
+    enum { SEGMENTS = 20 };
+    set_draw_color(cb, lighten(color, 0.35f), alpha);
+    for(int r = 0; r < rings->ringCount; r++){
+        if(!ring_is_aromatic(rings, r)) continue;
+        const uint8_t *atoms = &rings->atoms[rings->ringStart[r]];
+        int size = ring_size(rings, r);
+
+        Vec3 c = {0, 0, 0}, n = {0, 0, 0};
+        for(int k = 0; k < size; k++){
+            Vec3 p = mol->atomPos[atoms[k]], q = mol->atomPos[atoms[(k + 1) % size]];
+            c.x += p.x; c.y += p.y; c.z += p.z;
+            n.x += (p.y - q.y) * (p.z + q.z);
+            n.y += (p.z - q.z) * (p.x + q.x);
+            n.z += (p.x - q.x) * (p.y + q.y);
+        }
+        c.x /= (float)size; c.y /= (float)size; c.z /= (float)size;
+        float radius = 0.0f;
+        for(int k = 0; k < size; k++){
+            Vec3 p = mol->atomPos[atoms[k]];
+            radius += sqrtf((p.x-c.x)*(p.x-c.x) + (p.y-c.y)*(p.y-c.y) + (p.z-c.z)*(p.z-c.z));
+        }
+        radius *= 0.6f / (float)size;
+
+        float nl = sqrtf(n.x*n.x + n.y*n.y + n.z*n.z);
+        Vec3 u = { mol->atomPos[atoms[0]].x - c.x, mol->atomPos[atoms[0]].y - c.y, mol->atomPos[atoms[0]].z - c.z };
+        float ul = sqrtf(u.x*u.x + u.y*u.y + u.z*u.z);
+        if(nl <= 0.0f || ul <= 0.0f) continue;
+        n.x /= nl; n.y /= nl; n.z /= nl;
+        u.x /= ul; u.y /= ul; u.z /= ul;
+        Vec3 v = { n.y*u.z - n.z*u.y, n.z*u.x - n.x*u.z, n.x*u.y - n.y*u.x };
+
+        int px[SEGMENTS], py[SEGMENTS];
+        for(int k = 0; k < SEGMENTS; k++){
+            float a = 2.0f * PI * (float)k / SEGMENTS;
+            float cu = cosf(a) * radius, sv = sinf(a) * radius;
+            Vec3 p = { c.x + u.x*cu + v.x*sv, c.y + u.y*cu + v.y*sv, c.z + u.z*cu + v.z*sv };
+            float depth;
+            project_to_screen(rotate_yaw_pitch(p, vt->yaw, vt->pitch), vt->zoom, vt->originX, vt->originY,
+                              &px[k], &py[k], &depth);
+        }
+        for(int k = 0; k < SEGMENTS; k++){
+            int next = (k + 1) % SEGMENTS;
+            draw_thick_line(cb, px[k], py[k], px[next], py[next], scaled(2, s));
+        }
+    }
+}
+
+const char *element_symbol(uint8_t label){
+    static const char *symbols[] = { "C", "O", "N", "Cl", "F" };
+    return label < sizeof(symbols) / sizeof(symbols[0]) ? symbols[label] : "?";
+}
+
+int text_scale(float scale){
+    int ts = (int)lroundf(scale);
+    return ts < 1 ? 1 : ts;
+}
+
+// Compound name in the tile's bottom-left corner.
+static void draw_tile_caption(CommandBuffer *cb, const Compound *compound, const RectI *rect, bool isSelected, float s){
+    int ts = text_scale(s);
+    int margin = scaled(6, s);
+    draw_text(cb, rect->x + margin, rect->y + rect->h - margin - GLYPH_HEIGHT * ts, ts,
+              isSelected ? 0xF0F0FFFF : 0xA0A0B4FF, compound->name);
+}
+
+TileQuality tile_quality_for_size(int width, int height){
+    int size = width < height ? width : height;
+    float scale = (float)size / 300.0f;
+    TileQuality q = { 1.0f, scale < 0.25f ? 0.25f : scale, true, size >= 128, false };
+    return q;
+}
+
+bool render_mode_parse(const char *name, RenderMode *mode){
+    static const char *names[RENDER_MODE_COUNT] = { "ball", "wire", "dots", "surface" };
+    for(int m = 0; m < RENDER_MODE_COUNT; m++){
+        if(strcmp(name, names[m]) == 0){
+            *mode = (RenderMode)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+void reset_view_control(ViewControl *v){
+    v->yaw = 0.0f;
+    v->pitch = 0.5f;
+    v->panX = 0.0f;
+    v->panY = 0.0f;
+    v->zoomMultiplier = 1.0f;
+}
+
+int sort_bonds_far_to_near(const void *a, const void *b){
+    const BondDraw *A = (const BondDraw*)a;
+    const BondDraw *B = (const BondDraw*)b;
+    if(A->depth < B->depth) return -1;
+    if(A->depth > B->depth) return  1;
+    return 0;
+}
+
+int sort_atoms_far_to_near(const void *a, const void *b){
+    const AtomDraw *A = (const AtomDraw*)a;
+    const AtomDraw *B = (const AtomDraw*)b;
+    if(A->depth < B->depth) return -1;
+    if(A->depth > B->depth) return  1;
+    return 0;
+}
+
+int sort_triangles_far_to_near(const void *a, const void *b){
+    const TriangleDraw *A = (const TriangleDraw*)a;
+    const TriangleDraw *B = (const TriangleDraw*)b;
+    if(A->depth < B->depth) return -1;
+    if(A->depth > B->depth) return  1;
+    return A->first - B->first;
+}
+
+// Draws a cached isosurface as one SDL_RenderGeometry batch: back faces are
+// culled, the rest painter-sorted, with Blinn-Phong shading per vertex.
+void draw_surface_mesh(CommandBuffer *cb, const SurfaceMesh *mesh, uint32_t color, uint8_t alpha,
+                       float yaw, float pitch, float zoom, int centerX, int centerY){
+    // Scratch per thread: frames may be built off the render thread.
+    static _Thread_local TriangleDraw *triangles = NULL;
+    static _Thread_local Vec3 *rotated = NULL;
+    static _Thread_local SDL_Vertex *projected = NULL;
+    static _Thread_local int capacity = 0;
+
+    PROF_SCOPE("draw_surface_mesh");
+    if(mesh->vertexCount <= 0) return;
+    if(mesh->vertexCount > capacity){
+        int grown = mesh->vertexCount + mesh->vertexCount / 2;
+        SDL_Vertex *p = realloc(projected, sizeof(SDL_Vertex) * (size_t)grown);
+        if(p) projected = p;
+        Vec3 *r = realloc(rotated, sizeof(Vec3) * (size_t)grown);
+        if(r) rotated = r;
+        TriangleDraw *t = realloc(triangles, sizeof(TriangleDraw) * (size_t)(grown / 3 + 1));
+        if(t) triangles = t;
+        if(!p || !r || !t) return;
+        capacity = grown;
+    }
+
+    float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+    const Vec3 light = { -0.35f, 0.45f, 0.82f };
+    const Vec3 half = { -0.19f, 0.24f, 0.95f }; // normalize(light + view)
+
+    for(int i = 0; i < mesh->vertexCount; i++){
+        Vec3 p = rotate_cos_sin(mesh->position[i], cy, sy, cp, sp);
+        Vec3 n = rotate_cos_sin(mesh->normal[i], cy, sy, cp, sp);
+        rotated[i] = p;
+
+        float perspective = PERSPECTIVE_DISTANCE / (PERSPECTIVE_DISTANCE + p.z);
+        float diffuse = clampf(n.x*light.x + n.y*light.y + n.z*light.z, 0.0f, 1.0f);
+        float specular = clampf(n.x*half.x + n.y*half.y + n.z*half.z, 0.0f, 1.0f);
+        specular *= specular; specular *= specular; specular *= specular; specular *= specular;
+        float shade = 0.22f + 0.78f * diffuse;
+        float highlight = 90.0f * specular;
+
+        projected[i].position.x = centerX + p.x * zoom * perspective;
+        projected[i].position.y = centerY - p.y * zoom * perspective;
+        projected[i].color.r = (uint8_t)clampf(color_r(color) * shade + highlight, 0.0f, 255.0f);
+        projected[i].color.g = (uint8_t)clampf(color_g(color) * shade + highlight, 0.0f, 255.0f);
+        projected[i].color.b = (uint8_t)clampf(color_b(color) * shade + highlight, 0.0f, 255.0f);
+        projected[i].color.a = alpha;
+        projected[i].tex_coord.x = 0.0f;
+        projected[i].tex_coord.y = 0.0f;
+    }
+
+    int triangleCount = 0;
+    for(int t = 0; t + 2 < mesh->vertexCount; t += 3){
+        Vec3 a = rotated[t], b = rotated[t+1], c = rotated[t+2];
+        float facing = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if(facing <= 0.0f) continue;
+        triangles[triangleCount++] = (TriangleDraw){ a.z + b.z + c.z, t };
+    }
+    ProfScope sortScope = PROF_BEGIN("sort_triangles");
+    qsort(triangles, triangleCount, sizeof(TriangleDraw), sort_triangles_far_to_near);
+    PROF_END(sortScope);
+
+    cmd_blend(cb, SDL_BLENDMODE_BLEND);
+    SDL_Vertex *vertices = cmd_geometry(cb, triangleCount * 3);
+    if(!vertices) return;
+    for(int i = 0; i < triangleCount; i++){
+        int t = triangles[i].first;
+        vertices[3*i + 0] = projected[t];
+        vertices[3*i + 1] = projected[t + 1];
+        vertices[3*i + 2] = projected[t + 2];
+    }
+}
+
+uint32_t atom_color(const Compound *compound, uint8_t label){
+    if(label == 1) return 0xFF4757FF; // O
+    if(label == 2) return 0x5F27CDFF; // N
+    if(label == 3) return 0x1DD1A1FF; // Cl
+    if(label == 4) return 0x48DBFBFF; // F
+    return compound->colorRGBA;
+}
+
+ViewTransform compute_view_transform(const Compound *compound,
+                                     const MoleculeGeometry *mol,
+                                     const RectI *rect,
+                                     float timeSeconds,
+                                     const ViewControl *view,
+                                     bool autoRotateEnabled,
+                                     float pixelScale){
+    ViewTransform vt;
+
+    float radius = compute_bounding_radius(mol);
+    float minDim = (float)((rect->w < rect->h) ? rect->w : rect->h);
+    float baseZoom = (minDim * 0.38f) / radius;
+    vt.zoom = baseZoom * compound->baseScale * view->zoomMultiplier;
+
+    float autoYaw = 0.0f;
+    float autoPitch = 0.0f;
+    if(autoRotateEnabled){
+        autoYaw = timeSeconds * 0.7f;
+        autoPitch = timeSeconds * 0.25f;
+    }
+
+    vt.yaw = autoYaw + view->yaw;
+    vt.pitch = autoPitch + view->pitch;
+    vt.originX = rect->x + rect->w / 2 + (int)lroundf(view->panX * pixelScale);
+    vt.originY = rect->y + rect->h / 2 + (int)lroundf(view->panY * pixelScale);
+    return vt;
+}
+
+#define TRACE_FRAME_BUDGET 0.010
+
+// Focus-view renderer: ray-traced spheres and cylinders with ambient
+// occlusion and soft shadows, refined a little more every frame the view
+// stays still.
+void draw_traced_molecule(SDL_Renderer *renderer,
+                          TraceTarget *target,
+                          const Compound *compound,
+                          const MoleculeGeometry *mol,
+                          const RectI *rect,
+                          const ViewTransform *vt){
+    PROF_SCOPE("draw_traced_molecule");
+    PROF_COUNT(PROF_ATOMS, mol->atomCount);
+    if(target->width != rect->w || target->height != rect->h || !target->texture){
+        if(target->texture) SDL_DestroyTexture(target->texture);
+        target->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, rect->w, rect->h);
+        target->width = rect->w;
+        target->height = rect->h;
+    }
+
+    uint32_t colors[MAX_ATOMS];
+    for(int i = 0; i < mol->atomCount; i++) colors[i] = atom_color(compound, mol->atomLabel[i]);
+
+    TraceScene scene = {
+        mol, colors,
+        darken(compound->colorRGBA, 0.25f),
+        0x101014FF,
+        vt->yaw, vt->pitch, vt->zoom,
+        (float)(vt->originX - rect->x), (float)(vt->originY - rect->y),
+        rect->w, rect->h
+    };
+    tracer_set_scene(target->tracer, &scene);
+    if(target->samplesPerFrame > 0) tracer_render_samples(target->tracer, target->samplesPerFrame);
+    else tracer_render(target->tracer, TRACE_FRAME_BUDGET);
+
+    SDL_Rect dst = { rect->x, rect->y, rect->w, rect->h };
+    const uint32_t *pixels = tracer_pixels(target->tracer);
+    if(target->texture && pixels){
+        SDL_UpdateTexture(target->texture, NULL, pixels, rect->w * (int)sizeof(uint32_t));
+        SDL_RenderCopy(renderer, target->texture, NULL, &dst);
+        PROF_COUNT(PROF_DRAW_CALLS, 1);
+        PROF_COUNT(PROF_PIXELS, rect->w * rect->h);
+    }
+
+    SDL_SetRenderDrawColor(renderer, 240,240,255,255);
+    SDL_RenderDrawRect(renderer, &dst);
+}
+
+void build_molecule(CommandBuffer *cb,
+                    const Compound *compound,
+                    const MoleculeGeometry *mol,
+                    const RectI *rect,
+                    bool isSelected,
+                    RenderMode mode,
+                    const SasaCache *surface,
+                    const SurfaceCache *mesh,
+                    float timeSeconds,
+                    const ViewControl *view,
+                    bool autoRotateEnabled,
+                    const TileQuality *quality){
+    PROF_SCOPE("build_molecule");
+    if(!quality) quality = &tileQualityFull;
+    float s = quality->scale;
+    PROF_COUNT(PROF_ATOMS, mol->atomCount);
+    bool isWireframe = (mode != RENDER_BALL_AND_STICK);
+
+    SDL_Rect clip = { rect->x, rect->y, rect->w, rect->h };
+    cmd_clip(cb, &clip);
+
+    cmd_color(cb, 16,16,20,255);
+    cmd_fill_rect(cb, clip.x, clip.y, clip.w, clip.h);
+
+    if(isSelected) cmd_color(cb, 240,240,255,255);
+    else cmd_color(cb, 60,60,75,255);
+    cmd_draw_rect(cb, &clip);
+
+    ViewTransform vt = compute_view_transform(compound, mol, rect, timeSeconds, view, autoRotateEnabled, s);
+    float yaw = vt.yaw;
+    float pitch = vt.pitch;
+    float zoom = vt.zoom;
+
+    if(mode == RENDER_SURFACE){
+        if(mesh && mesh->valid){
+            draw_surface_mesh(cb, &mesh->mesh, compound->colorRGBA, isSelected ? 255 : 235,
+                              yaw, pitch, zoom, vt.originX, vt.originY);
+        }
+        draw_tile_caption(cb, compound, rect, isSelected, s);
+        cmd_clip(cb, NULL);
+        return;
+    }
+
+    BondDraw bondDraws[MAX_BONDS];
+    int bondDrawCount = 0;
+
+    AtomDraw atomDraws[MAX_ATOMS];
+    int atomDrawCount = 0;
+
+    int projectedX[MAX_ATOMS];
+    int projectedY[MAX_ATOMS];
+    float projectedDepth[MAX_ATOMS];
+
+    ProfScope projectScope = PROF_BEGIN("project");
+    for(int i = 0; i < mol->atomCount; i++){
+        Vec3 rp = rotate_yaw_pitch(mol->atomPos[i], yaw, pitch);
+        int sx, sy;
+        float d;
+        project_to_screen(rp, zoom, vt.originX, vt.originY, &sx, &sy, &d);
+        projectedX[i] = sx;
+        projectedY[i] = sy;
+        projectedDepth[i] = d;
+    }
+    PROF_END(projectScope);
+
+    // aromatic bonds are drawn single and the ring gets a circle instead
+    const RingInfo *rings = ring_info_cached(mol);
+
+    for(int i = 0; i < mol->bondCount; i++){
+        Bond b = mol->bonds[i];
+
+        int x1 = projectedX[b.from];
+        int y1 = projectedY[b.from];
+        int x2 = projectedX[b.to];
+        int y2 = projectedY[b.to];
+
+        float depth = (projectedDepth[b.from] + projectedDepth[b.to]) * 0.5f;
+
+        uint8_t alpha = isSelected ? 230 : 140;
+
+        bondDraws[bondDrawCount++] = (BondDraw){
+            x1,y1,x2,y2,
+            depth,
+            ring_bond_test(rings->aromaticBondMask, i) ? 1 : b.order,
+            compound->colorRGBA,
+            alpha
+        };
+    }
+
+    for(int i = 0; i < mol->atomCount; i++){
+        uint32_t atomColor = atom_color(compound, mol->atomLabel[i]);
+
+        float depthScale = clampf(1.0f - projectedDepth[i] * 0.05f, 0.6f, 1.35f);
+
+        float baseSize = isWireframe ? 3.5f : 7.0f;
+        if(mol->atomLabel[i] == 1) baseSize = isWireframe ? 4.0f : 8.0f;
+        if(mol->atomLabel[i] == 3 || mol->atomLabel[i] == 4) baseSize = isWireframe ? 4.2f : 9.0f;
+
+        int rad = (int)lroundf(baseSize * depthScale * s);
+
+        atomDraws[atomDrawCount++] = (AtomDraw){
+            i,
+            projectedDepth[i],
+            projectedX[i],
+            projectedY[i],
+            rad,
+            atomColor
+        };
+    }
+
+    ProfScope sortScope = PROF_BEGIN("sort");
+    qsort(bondDraws, bondDrawCount, sizeof(BondDraw), sort_bonds_far_to_near);
+    qsort(atomDraws, atomDrawCount, sizeof(AtomDraw), sort_atoms_far_to_near);
+    PROF_END(sortScope);
+
+    ProfScope bondScope = PROF_BEGIN("draw_bonds");
+    for(int i = 0; i < bondDrawCount; i++){
+        BondDraw bd = bondDraws[i];
+
+        if(isWireframe){
+            uint32_t bright = lighten(bd.color, 0.20f);
+            set_draw_color(cb, darken(bd.color, 0.55f), bd.alpha);
+            draw_thick_line(cb, bd.x1,bd.y1,bd.x2,bd.y2, scaled(4, s));
+
+            set_draw_color(cb, bright, bd.alpha);
+            draw_thick_line(cb, bd.x1,bd.y1,bd.x2,bd.y2, scaled(2, s));
+
+            if(bd.order == 2){
+                int offset = scaled(2, s);
+                set_draw_color(cb, bright, bd.alpha);
+                draw_thick_line(cb, bd.x1+offset,bd.y1-offset,bd.x2+offset,bd.y2-offset, scaled(2, s));
+            }
+        } else {
+            draw_stick(cb, bd.x1,bd.y1,bd.x2,bd.y2, bd.order, bd.color, bd.alpha, s);
+        }
+    }
+    if(rings->aromaticRings){
+        draw_aromatic_rings(cb, mol, rings, &vt, compound->colorRGBA, isSelected ? 230 : 140, s);
+    }
+
+    PROF_END(bondScope);
+
+    ProfScope atomScope = PROF_BEGIN("draw_atoms");
+    for(int i = 0; i < atomDrawCount; i++){
+        AtomDraw ad = atomDraws[i];
+
+        if(mode == RENDER_DOTS) break;
+
+        if(isWireframe){
+            uint32_t c = lighten(ad.color, 0.05f);
+            set_draw_color(cb, c, isSelected ? 220 : 170);
+            draw_filled_circle(cb, ad.screenX, ad.screenY, (int)clampf(ad.radius, 2 * s, 5 * s));
+            continue;
+        }
+
+        set_draw_color(cb, darken(ad.color, 0.40f), 255);
+        draw_filled_circle(cb, ad.screenX, ad.screenY, ad.radius + scaled(2, s));
+
+        set_draw_color(cb, ad.color, 255);
+        draw_filled_circle(cb, ad.screenX, ad.screenY, ad.radius);
+
+        if(quality->highlights){
+            int hx = ad.screenX - ad.radius/3;
+            int hy = ad.screenY - ad.radius/3;
+            uint32_t hi = lighten(ad.color, 0.60f);
+            set_draw_color(cb, hi, 220);
+            draw_filled_circle(cb, hx, hy, (int)clampf(ad.radius*0.45f, 2 * s, 12 * s));
+
+            set_draw_color(cb, 0xFFFFFFFF, 200);
+            int spot = scaled(2, s);
+            draw_filled_circle(cb, hx - spot, hy - spot, (int)clampf(ad.radius*0.12f, s, 4 * s));
+        }
+    }
+
+    PROF_END(atomScope);
+
+    // Labels go on top of every atom so they batch into one textured call.
+    if(quality->labels){
+        int ts = text_scale(s);
+        for(int i = 0; i < atomDrawCount; i++){
+            const AtomDraw *ad = &atomDraws[i];
+            uint8_t label = mol->atomLabel[ad->atomIndex];
+            if(label == 0 && !quality->carbonLabels) continue;
+            draw_text(cb, ad->screenX + ad->radius + scaled(2, s), ad->screenY - GLYPH_HEIGHT * ts / 2, ts,
+                      0xF5F5FFFF, element_symbol(label));
+        }
+    }
+
+    if(mode == RENDER_DOTS && surface && surface->valid && surface->atomCount == mol->atomCount){
+        PROF_SCOPE("draw_dots");
+        // Solvent-accessible directions placed on each van der Waals sphere,
+        // drawn far to near with depth-cued brightness.
+        const Vec3 *sphere = sasa_sphere_points();
+        float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+
+        for(int i = 0; i < atomDrawCount; i++){
+            const AtomDraw *ad = &atomDraws[i];
+            int a = ad->atomIndex;
+            float r = sasa_vdw_radius(mol->atomLabel[a]);
+            int count = 0;
+
+            for(int k = 0; k < SASA_POINTS; k++){
+                if(!(surface->exposed[a][k >> 6] & (1ull << (k & 63)))) continue;
+                Vec3 p = make_vec3(mol->atomPos[a].x + sphere[k].x * r,
+                                   mol->atomPos[a].y + sphere[k].y * r,
+                                   mol->atomPos[a].z + sphere[k].z * r);
+                int sx, sy2;
+                float d;
+                project_to_screen(rotate_cos_sin(p, cy, sy, cp, sp), zoom, vt.originX, vt.originY, &sx, &sy2, &d);
+                if(count == 0){
+                    float shade = clampf(0.55f - ad->depth * 0.06f, 0.0f, 0.8f);
+                    set_draw_color(cb, lighten(ad->color, shade), isSelected ? 255 : 200);
+                }
+                cmd_point(cb, sx, sy2);
+                count++;
+            }
+            PROF_COUNT(PROF_PIXELS, count);
+        }
+    }
+
+    draw_tile_caption(cb, compound, rect, isSelected, s);
+    cmd_clip(cb, NULL);
+}
+
+
+void build_molecule_tile(CommandBuffer *cb,
+                         int slot,
+                         bool renderTargets,
+                         const Compound *compound,
+                         const MoleculeGeometry *mol,
+                         const RectI *rect,
+                         bool isSelected,
+                         RenderMode mode,
+                         const SasaCache *surface,
+                         const SurfaceCache *mesh,
+                         float timeSeconds,
+                         const ViewControl *view,
+                         bool autoRotateEnabled,
+                         const TileQuality *quality){
+    int w = (int)lroundf((float)rect->w * quality->resolution);
+    int h = (int)lroundf((float)rect->h * quality->resolution);
+    bool reduced = quality->resolution < 0.999f && w >= 16 && h >= 16;
+
+    if(!reduced || !renderTargets){
+        TileQuality direct = *quality;
+        direct.scale /= quality->resolution;
+        direct.resolution = 1.0f;
+        build_molecule(cb, compound, mol, rect, isSelected, mode, surface, mesh,
+                       timeSeconds, view, autoRotateEnabled, &direct);
+        return;
+    }
+
+    RectI local = { 0, 0, w, h };
+    SDL_Rect dst = { rect->x, rect->y, rect->w, rect->h };
+    cmd_tile_begin(cb, slot, w, h);
+    build_molecule(cb, compound, mol, &local, isSelected, mode, surface, mesh,
+                   timeSeconds, view, autoRotateEnabled, quality);
+    cmd_tile_end(cb, slot, &dst);
+}
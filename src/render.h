@@ -0,0 +1,170 @@
+#ifndef ATLAS_RENDER_H
+#define ATLAS_RENDER_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cmdbuf.h"
+#include "geometry.h"
+#include "isosurface.h"
+#include "presets.h"
+#include "raytrace.h"
+#include "sasa.h"
+
+typedef struct { int x, y, w, h; } RectI;
+
+typedef enum {
+    RENDER_BALL_AND_STICK,
+    RENDER_WIREFRAME,
+    RENDER_DOTS,
+    RENDER_SURFACE,
+    RENDER_MODE_COUNT
+} RenderMode;
+
+// "ball", "wire", "dots" or "surface"; false for anything else.
+bool render_mode_parse(const char *name, RenderMode *mode);
+
+typedef struct {
+    float yaw;
+    float pitch;
+    float panX;
+    float panY;
+    float zoomMultiplier;
+} ViewControl;
+
+// The zoom multipliers the viewer lets the mouse wheel reach.
+#define VIEW_ZOOM_MIN 0.35f
+#define VIEW_ZOOM_MAX 4.0f
+
+typedef struct {
+    int atomIndex;
+    float depth;
+    int screenX;
+    int screenY;
+    int radius;
+    uint32_t color;
+} AtomDraw;
+
+typedef struct {
+    int x1,y1,x2,y2;
+    float depth;
+    int order;
+    uint32_t color;
+    uint8_t alpha;
+} BondDraw;
+
+typedef struct {
+    float depth;
+    int first; // index of the triangle's first vertex
+} TriangleDraw;
+
+typedef struct {
+    float yaw, pitch, zoom;
+    int originX, originY; // screen position of the molecule origin, pan included
+} ViewTransform;
+
+typedef struct {
+    Tracer *tracer;
+    SDL_Texture *texture;
+    int width, height;
+    int samplesPerFrame; // > 0 replaces the time budget, for replays
+} TraceTarget;
+
+// Detail a tile is drawn with. The quality governor lowers it for tiles
+// that are not selected when frames run over budget.
+typedef struct {
+    float resolution; // fraction of the tile's pixels actually rendered
+    float scale;      // pixels per layout unit: HiDPI factor times resolution
+    bool highlights;  // specular spots on ball-and-stick atoms
+    bool labels;      // element symbols on heteroatoms
+    bool carbonLabels; // ...and on carbons too (the focus view)
+} TileQuality;
+
+extern const TileQuality tileQualityFull;
+
+// Full-resolution quality for an offscreen image of the given size: atoms
+// and bonds are scaled from the ~300 px grid tiles, labels need 128 px.
+TileQuality tile_quality_for_size(int width, int height);
+
+static inline uint8_t color_r(uint32_t c){ return (c >> 24) & 255; }
+static inline uint8_t color_g(uint32_t c){ return (c >> 16) & 255; }
+static inline uint8_t color_b(uint32_t c){ return (c >>  8) & 255; }
+
+// The draw_* primitives record into a command buffer; see cmdbuf.h.
+void set_draw_color(CommandBuffer *cb, uint32_t rgba, uint8_t a);
+uint32_t lighten(uint32_t rgba, float t);
+uint32_t darken(uint32_t rgba, float t);
+
+void draw_filled_circle(CommandBuffer *cb, int cx, int cy, int radius);
+void draw_thick_line(CommandBuffer *cb, int x1, int y1, int x2, int y2, int thickness);
+void draw_stick(CommandBuffer *cb, int x1,int y1,int x2,int y2, int order, uint32_t baseColor, uint8_t alpha, float scale);
+// "C", "O", "N", "Cl" or "F" for an atom label code.
+const char *element_symbol(uint8_t label);
+// Integer text scale for a tile's pixel scale, at least 1.
+int text_scale(float scale);
+
+// qsort comparators: far (small depth) first, so nearer items paint over.
+int sort_bonds_far_to_near(const void *a, const void *b);
+int sort_atoms_far_to_near(const void *a, const void *b);
+int sort_triangles_far_to_near(const void *a, const void *b);
+
+// Carbon takes the compound colour; heteroatoms use fixed element colours.
+uint32_t atom_color(const Compound *compound, uint8_t label);
+void reset_view_control(ViewControl *v);
+
+// Rotation, zoom and screen origin for a molecule in its tile at this time.
+ViewTransform compute_view_transform(const Compound *compound,
+                                     const MoleculeGeometry *mol,
+                                     const RectI *rect,
+                                     float timeSeconds,
+                                     const ViewControl *view,
+                                     bool autoRotateEnabled,
+                                     float pixelScale);
+
+void draw_surface_mesh(CommandBuffer *cb, const SurfaceMesh *mesh, uint32_t color, uint8_t alpha,
+                       float yaw, float pitch, float zoom, int centerX, int centerY);
+
+// Ray-traced focus view; each call refines the image for a few ms, or by
+// target->samplesPerFrame samples when that is set.
+void draw_traced_molecule(SDL_Renderer *renderer,
+                          TraceTarget *target,
+                          const Compound *compound,
+                          const MoleculeGeometry *mol,
+                          const RectI *rect,
+                          const ViewTransform *vt);
+
+// Records one molecule into its tile: background, frame and the chosen
+// mode. A NULL quality means tileQualityFull. Safe off the render thread.
+void build_molecule(CommandBuffer *cb,
+                    const Compound *compound,
+                    const MoleculeGeometry *mol,
+                    const RectI *rect,
+                    bool isSelected,
+                    RenderMode mode,
+                    const SasaCache *surface,
+                    const SurfaceCache *mesh,
+                    float timeSeconds,
+                    const ViewControl *view,
+                    bool autoRotateEnabled,
+                    const TileQuality *quality);
+
+// build_molecule at quality->resolution into tile texture `slot`, stretched
+// over rect on submit. Records a direct build when the resolution is full
+// or the renderer has no render targets.
+void build_molecule_tile(CommandBuffer *cb,
+                         int slot,
+                         bool renderTargets,
+                         const Compound *compound,
+                         const MoleculeGeometry *mol,
+                         const RectI *rect,
+                         bool isSelected,
+                         RenderMode mode,
+                         const SasaCache *surface,
+                         const SurfaceCache *mesh,
+                         float timeSeconds,
+                         const ViewControl *view,
+                         bool autoRotateEnabled,
+                         const TileQuality *quality);
+
+#endif
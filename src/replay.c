@@ -0,0 +1,319 @@
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char REPLAY_MAGIC[4] = { 'P', 'K', 'R', 'R' };
+
+enum {
+    REC_FRAME = 1,
+    REC_MARKER,
+    REC_QUIT,
+    REC_KEY_DOWN,
+    REC_KEY_UP,
+    REC_BUTTON_DOWN,
+    REC_BUTTON_UP,
+    REC_MOTION,
+    REC_WHEEL,
+    REC_WINDOW,
+    REC_OTHER,
+};
+
+struct InputRecorder {
+    FILE *file;
+    bool ok;
+    uint32_t lastTime;
+    int32_t lastX, lastY;
+};
+
+struct InputReplay {
+    FILE *file;
+    int width, height;
+    uint32_t time;
+    int32_t lastX, lastY;
+    int frameIndex;
+
+    SDL_Event *events;
+    int eventCount, eventCapacity, eventNext;
+    uint32_t markers;
+};
+
+static uint32_t zigzag(int32_t v){ return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v){ return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static void put_varint(InputRecorder *rec, uint32_t v){
+    uint8_t buf[5];
+    int n = 0;
+    do {
+        uint8_t byte = v & 0x7F;
+        v >>= 7;
+        buf[n++] = byte | (v ? 0x80 : 0);
+    } while(v);
+    if(fwrite(buf, 1, (size_t)n, rec->file) != (size_t)n) rec->ok = false;
+}
+
+static void put_tag(InputRecorder *rec, uint8_t tag){
+    if(fputc(tag, rec->file) == EOF) rec->ok = false;
+}
+
+static void put_position(InputRecorder *rec, int32_t x, int32_t y){
+    put_varint(rec, zigzag(x - rec->lastX));
+    put_varint(rec, zigzag(y - rec->lastY));
+    rec->lastX = x;
+    rec->lastY = y;
+}
+
+InputRecorder *recorder_open(const char *path, int width, int height){
+    InputRecorder *rec = calloc(1, sizeof(InputRecorder));
+    if(!rec) return NULL;
+    rec->file = fopen(path, "wb");
+    if(!rec->file){
+        free(rec);
+        return NULL;
+    }
+    rec->ok = true;
+
+    fwrite(REPLAY_MAGIC, 1, sizeof(REPLAY_MAGIC), rec->file);
+    put_varint(rec, REPLAY_VERSION);
+    put_varint(rec, (uint32_t)width);
+    put_varint(rec, (uint32_t)height);
+    return rec;
+}
+
+void recorder_frame(InputRecorder *rec, uint32_t timeMs){
+    if(!rec) return;
+    put_tag(rec, REC_FRAME);
+    put_varint(rec, timeMs - rec->lastTime);
+    rec->lastTime = timeMs;
+}
+
+void recorder_marker(InputRecorder *rec, uint32_t marker){
+    if(!rec) return;
+    put_tag(rec, REC_MARKER);
+    put_varint(rec, marker);
+}
+
+void recorder_event(InputRecorder *rec, const SDL_Event *e){
+    if(!rec) return;
+    switch(e->type){
+        case SDL_QUIT:
+            put_tag(rec, REC_QUIT);
+            break;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            put_tag(rec, e->type == SDL_KEYDOWN ? REC_KEY_DOWN : REC_KEY_UP);
+            put_varint(rec, (uint32_t)e->key.keysym.sym);
+            put_varint(rec, e->key.keysym.mod);
+            put_varint(rec, e->key.repeat);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            put_tag(rec, e->type == SDL_MOUSEBUTTONDOWN ? REC_BUTTON_DOWN : REC_BUTTON_UP);
+            put_varint(rec, e->button.button);
+            put_varint(rec, e->button.clicks);
+            put_position(rec, e->button.x, e->button.y);
+            break;
+        case SDL_MOUSEMOTION:
+            put_tag(rec, REC_MOTION);
+            put_varint(rec, e->motion.state);
+            put_position(rec, e->motion.x, e->motion.y);
+            break;
+        case SDL_MOUSEWHEEL:
+            put_tag(rec, REC_WHEEL);
+            put_varint(rec, zigzag(e->wheel.x));
+            put_varint(rec, zigzag(e->wheel.y));
+            break;
+        case SDL_WINDOWEVENT:
+            put_tag(rec, REC_WINDOW);
+            put_varint(rec, e->window.event);
+            put_varint(rec, zigzag(e->window.data1));
+            put_varint(rec, zigzag(e->window.data2));
+            break;
+        default:
+            // Nothing in the loop reads these beyond their type.
+            put_tag(rec, REC_OTHER);
+            put_varint(rec, e->type);
+            break;
+    }
+}
+
+bool recorder_close(InputRecorder *rec){
+    if(!rec) return false;
+    bool ok = rec->ok;
+    if(fclose(rec->file) != 0) ok = false;
+    free(rec);
+    return ok;
+}
+
+static bool get_varint(InputReplay *rp, uint32_t *out){
+    uint32_t v = 0;
+    for(int shift = 0; shift < 35; shift += 7){
+        int c = fgetc(rp->file);
+        if(c == EOF) return false;
+        v |= (uint32_t)(c & 0x7F) << shift;
+        if(!(c & 0x80)){
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_position(InputReplay *rp, Sint32 *x, Sint32 *y){
+    uint32_t dx, dy;
+    if(!get_varint(rp, &dx) || !get_varint(rp, &dy)) return false;
+    rp->lastX += unzigzag(dx);
+    rp->lastY += unzigzag(dy);
+    *x = rp->lastX;
+    *y = rp->lastY;
+    return true;
+}
+
+InputReplay *replay_open(const char *path){
+    InputReplay *rp = calloc(1, sizeof(InputReplay));
+    if(!rp) return NULL;
+    rp->file = fopen(path, "rb");
+    rp->frameIndex = -1;
+
+    char magic[4];
+    uint32_t version = 0, width = 0, height = 0;
+    if(!rp->file || fread(magic, 1, sizeof(magic), rp->file) != sizeof(magic) ||
+       memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 ||
+       !get_varint(rp, &version) || version != REPLAY_VERSION ||
+       !get_varint(rp, &width) || !get_varint(rp, &height)){
+        replay_close(rp);
+        return NULL;
+    }
+    rp->width = (int)width;
+    rp->height = (int)height;
+    return rp;
+}
+
+void replay_close(InputReplay *rp){
+    if(!rp) return;
+    if(rp->file) fclose(rp->file);
+    free(rp->events);
+    free(rp);
+}
+
+void replay_window_size(const InputReplay *rp, int *width, int *height){
+    *width = rp->width;
+    *height = rp->height;
+}
+
+static SDL_Event *push_event(InputReplay *rp){
+    if(rp->eventCount == rp->eventCapacity){
+        int capacity = rp->eventCapacity ? rp->eventCapacity * 2 : 32;
+        SDL_Event *grown = realloc(rp->events, sizeof(SDL_Event) * (size_t)capacity);
+        if(!grown) return NULL;
+        rp->events = grown;
+        rp->eventCapacity = capacity;
+    }
+    SDL_Event *e = &rp->events[rp->eventCount++];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+// Reads one record after the frame tag. Returns false on a truncated file.
+static bool read_record(InputReplay *rp, int tag){
+    uint32_t a, b, c;
+    if(tag == REC_MARKER){
+        if(!get_varint(rp, &a)) return false;
+        rp->markers |= a;
+        return true;
+    }
+
+    SDL_Event *e = push_event(rp);
+    if(!e) return false;
+    switch(tag){
+        case REC_QUIT:
+            e->type = SDL_QUIT;
+            return true;
+        case REC_KEY_DOWN:
+        case REC_KEY_UP:
+            if(!get_varint(rp, &a) || !get_varint(rp, &b) || !get_varint(rp, &c)) return false;
+            e->type = tag == REC_KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+            e->key.keysym.sym = (SDL_Keycode)a;
+            e->key.keysym.mod = (Uint16)b;
+            e->key.repeat = (Uint8)c;
+            e->key.state = tag == REC_KEY_DOWN;
+            return true;
+        case REC_BUTTON_DOWN:
+        case REC_BUTTON_UP:
+            if(!get_varint(rp, &a) || !get_varint(rp, &b)) return false;
+            e->type = tag == REC_BUTTON_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+            e->button.button = (Uint8)a;
+            e->button.clicks = (Uint8)b;
+            e->button.state = tag == REC_BUTTON_DOWN;
+            return get_position(rp, &e->button.x, &e->button.y);
+        case REC_MOTION: {
+            if(!get_varint(rp, &a)) return false;
+            int32_t prevX = rp->lastX, prevY = rp->lastY;
+            e->type = SDL_MOUSEMOTION;
+            e->motion.state = a;
+            if(!get_position(rp, &e->motion.x, &e->motion.y)) return false;
+            e->motion.xrel = e->motion.x - prevX;
+            e->motion.yrel = e->motion.y - prevY;
+            return true;
+        }
+        case REC_WHEEL:
+            if(!get_varint(rp, &a) || !get_varint(rp, &b)) return false;
+            e->type = SDL_MOUSEWHEEL;
+            e->wheel.x = unzigzag(a);
+            e->wheel.y = unzigzag(b);
+            return true;
+        case REC_WINDOW:
+            if(!get_varint(rp, &a) || !get_varint(rp, &b) || !get_varint(rp, &c)) return false;
+            e->type = SDL_WINDOWEVENT;
+            e->window.event = (Uint8)a;
+            e->window.data1 = unzigzag(b);
+            e->window.data2 = unzigzag(c);
+            return true;
+        case REC_OTHER:
+            if(!get_varint(rp, &a)) return false;
+            e->type = a;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool replay_next_frame(InputReplay *rp, uint32_t *timeMs){
+    rp->eventCount = 0;
+    rp->eventNext = 0;
+    rp->markers = 0;
+
+    uint32_t delta;
+    if(fgetc(rp->file) != REC_FRAME || !get_varint(rp, &delta)) return false;
+    rp->time += delta;
+
+    for(;;){
+        int tag = fgetc(rp->file);
+        if(tag == EOF) break;
+        if(tag == REC_FRAME){
+            ungetc(tag, rp->file);
+            break;
+        }
+        // A damaged tail ends the session at the last complete frame.
+        if(!read_record(rp, tag)) break;
+    }
+
+    rp->frameIndex++;
+    *timeMs = rp->time;
+    return true;
+}
+
+bool replay_poll_event(InputReplay *rp, SDL_Event *e){
+    if(rp->eventNext >= rp->eventCount) return false;
+    *e = rp->events[rp->eventNext++];
+    return true;
+}
+
+uint32_t replay_frame_markers(const InputReplay *rp){
+    return rp->markers;
+}
+
+int replay_frame_index(const InputReplay *rp){
+    return rp->frameIndex;
+}
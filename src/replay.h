@@ -0,0 +1,46 @@
+#ifndef ATLAS_REPLAY_H
+#define ATLAS_REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Input session files: a header followed by one record per frame (the
+// frame's timestamp) and the events and markers handled during it. Integers
+// are LEB128 varints and mouse positions are deltas from the previous one,
+// so an idle frame costs two bytes and a mouse move usually four.
+
+#define REPLAY_VERSION 1
+
+// Things that happen to the main loop from outside the event queue and
+// must land on the same frame when replayed.
+enum {
+    REPLAY_MARKER_LIBRARY_READY = 1u << 0, // relaxed geometry swapped in
+};
+
+typedef struct InputRecorder InputRecorder;
+
+InputRecorder *recorder_open(const char *path, int width, int height);
+// Starts a frame at timeMs since the session began; events and markers
+// that follow belong to it.
+void recorder_frame(InputRecorder *rec, uint32_t timeMs);
+void recorder_event(InputRecorder *rec, const SDL_Event *e);
+void recorder_marker(InputRecorder *rec, uint32_t marker);
+// Flushes and closes; false if any write failed.
+bool recorder_close(InputRecorder *rec);
+
+typedef struct InputReplay InputReplay;
+
+// NULL if the file is missing, not a session file or another version.
+InputReplay *replay_open(const char *path);
+void replay_close(InputReplay *rp);
+void replay_window_size(const InputReplay *rp, int *width, int *height);
+
+// Loads the next frame; false once the session is over.
+bool replay_next_frame(InputReplay *rp, uint32_t *timeMs);
+// Hands out the current frame's events in order, like SDL_PollEvent.
+bool replay_poll_event(InputReplay *rp, SDL_Event *e);
+uint32_t replay_frame_markers(const InputReplay *rp);
+int replay_frame_index(const InputReplay *rp);
+
+#endif
@@ -0,0 +1,512 @@
+#include "rings.h"
+#include "library.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void adjacency_build(const MoleculeGeometry *mol, Adjacency *adj){
+    int n = mol->atomCount;
+    uint16_t fill[MAX_ATOMS + 1] = {0};
+    for(int b = 0; b < mol->bondCount; b++){
+        fill[mol->bonds[b].from + 1]++;
+        fill[mol->bonds[b].to + 1]++;
+    }
+    for(int i = 0; i < n; i++) fill[i + 1] += fill[i];
+    memcpy(adj->offset, fill, sizeof(uint16_t) * (size_t)(n + 1));
+    for(int b = 0; b < mol->bondCount; b++){
+        int i = mol->bonds[b].from, j = mol->bonds[b].to;
+        adj->neighbor[fill[i]] = (uint8_t)j;
+        adj->bond[fill[i]++] = (uint8_t)b;
+        adj->neighbor[fill[j]] = (uint8_t)i;
+        adj->bond[fill[j]++] = (uint8_t)b;
+    }
+}
+
+static inline void mask_set(uint64_t mask[2], int bond){
+    mask[bond >> 6] |= 1ull << (bond & 63);
+}
+
+// Tarjan's bridge finding with an explicit stack. Every bond that is not a
+// bridge lies on some cycle; returns the number of connected components.
+static int find_ring_bonds(const MoleculeGeometry *mol, const Adjacency *adj, uint64_t ringBonds[2]){
+    int n = mol->atomCount;
+    int order[MAX_ATOMS], low[MAX_ATOMS], parentBond[MAX_ATOMS];
+    uint16_t cursor[MAX_ATOMS];
+    uint8_t stack[MAX_ATOMS];
+    int visited = 0, components = 0;
+    uint64_t bridges[2] = {0, 0};
+
+    for(int i = 0; i < n; i++) order[i] = -1;
+    for(int root = 0; root < n; root++){
+        if(order[root] >= 0) continue;
+        components++;
+        int top = 0;
+        stack[top++] = (uint8_t)root;
+        order[root] = low[root] = visited++;
+        parentBond[root] = -1;
+        cursor[root] = adj->offset[root];
+        while(top > 0){
+            int v = stack[top - 1];
+            if(cursor[v] < adj->offset[v + 1]){
+                int k = cursor[v]++;
+                int w = adj->neighbor[k], b = adj->bond[k];
+                if(b == parentBond[v]) continue;
+                if(order[w] < 0){
+                    order[w] = low[w] = visited++;
+                    parentBond[w] = b;
+                    cursor[w] = adj->offset[w];
+                    stack[top++] = (uint8_t)w;
+                } else if(order[w] < low[v]){
+                    low[v] = order[w];
+                }
+                continue;
+            }
+            top--;
+            if(top > 0){
+                int u = stack[top - 1];
+                if(low[v] < low[u]) low[u] = low[v];
+                if(low[v] > order[u]) mask_set(bridges, parentBond[v]);
+            }
+        }
+    }
+
+    ringBonds[0] = ringBonds[1] = 0;
+    for(int b = 0; b < mol->bondCount; b++){
+        if(!ring_bond_test(bridges, b)) mask_set(ringBonds, b);
+    }
+    return components;
+}
+
+typedef struct {
+    uint64_t bonds[2];
+    uint8_t size;
+    uint8_t atoms[MAX_ATOMS];
+} RingCandidate;
+
+static int bond_to(const Adjacency *adj, int v, int w){
+    for(int k = adj->offset[v]; k < adj->offset[v + 1]; k++){
+        if(adj->neighbor[k] == w) return adj->bond[k];
+    }
+    return -1;
+}
+
+// The shortest cycle through ring bond b: the shortest path between its
+// ends that avoids b itself, closed by b. The search runs level by level on
+// neighbour bitmasks, then walks back from the far end one level at a time.
+static bool shortest_cycle_through(const MoleculeGeometry *mol, const Adjacency *adj, const uint64_t *ringNeighbors,
+                                   int b, RingCandidate *out){
+    int from = mol->bonds[b].from, to = mol->bonds[b].to;
+    uint64_t level[MAX_ATOMS];
+    level[0] = 1ull << from;
+    uint64_t visited = level[0];
+    int depth = 0;
+    while(!(level[depth] >> to & 1)){
+        uint64_t next = 0;
+        for(uint64_t f = level[depth]; f; f &= f - 1){
+            int v = __builtin_ctzll(f);
+            next |= v == from ? ringNeighbors[v] & ~(1ull << to) : ringNeighbors[v];
+        }
+        next &= ~visited;
+        if(!next) return false;
+        visited |= next;
+        level[++depth] = next;
+    }
+
+    memset(out->bonds, 0, sizeof(out->bonds));
+    mask_set(out->bonds, b);
+    int v = to, count = 0;
+    out->atoms[count++] = (uint8_t)v;
+    for(int d = depth - 1; d >= 0; d--){
+        int w = __builtin_ctzll(ringNeighbors[v] & level[d]);
+        mask_set(out->bonds, bond_to(adj, v, w));
+        v = w;
+        out->atoms[count++] = (uint8_t)v;
+    }
+    out->size = (uint8_t)count;
+    return true;
+}
+
+static int compare_candidates(const void *a, const void *b){
+    const RingCandidate *x = a, *y = b;
+    return (int)x->size - (int)y->size;
+}
+
+// Rows of the elimination are indexed by their lowest set bond (the pivot).
+typedef struct {
+    uint64_t rows[2 * 64][2];
+    uint64_t havePivot[2];
+    int rank;
+} Basis;
+
+static void basis_clear(Basis *basis){
+    basis->havePivot[0] = basis->havePivot[1] = 0;
+    basis->rank = 0;
+}
+
+// Reduces the candidate against the basis; keeps it if anything is left.
+// Each step clears the lowest set bond, and rows only hold bonds at or
+// above their pivot, so it ends within one pass over the bonds.
+static bool basis_insert(Basis *basis, const uint64_t bonds[2]){
+    uint64_t v[2] = { bonds[0], bonds[1] };
+    while(v[0] | v[1]){
+        int pivot = v[0] ? __builtin_ctzll(v[0]) : 64 + __builtin_ctzll(v[1]);
+        if(!ring_bond_test(basis->havePivot, pivot)){
+            if(basis->rank == MAX_RINGS) return false;
+            basis->rows[pivot][0] = v[0];
+            basis->rows[pivot][1] = v[1];
+            mask_set(basis->havePivot, pivot);
+            basis->rank++;
+            return true;
+        }
+        v[0] ^= basis->rows[pivot][0];
+        v[1] ^= basis->rows[pivot][1];
+    }
+    return false;
+}
+
+static void add_ring(RingInfo *out, const RingCandidate *c){
+    int start = out->ringStart[out->ringCount];
+    if(out->ringCount == MAX_RINGS || start + c->size > RING_ATOMS_MAX){
+        out->truncated = true;
+        return;
+    }
+    memcpy(&out->atoms[start], c->atoms, c->size);
+    out->ringBonds[out->ringCount][0] = c->bonds[0];
+    out->ringBonds[out->ringCount][1] = c->bonds[1];
+    out->ringCount++;
+    out->ringStart[out->ringCount] = (uint16_t)(start + c->size);
+}
+
+static bool same_cycle(const RingCandidate *a, const RingCandidate *b){
+    return a->bonds[0] == b->bonds[0] && a->bonds[1] == b->bonds[1];
+}
+
+// Shortest-path tree over ring bonds from one root, with the atoms and
+// bonds on each tree path as masks so any candidate cycle is O(1) to form.
+typedef struct {
+    int8_t dist[MAX_ATOMS];          // -1: not reached
+    uint8_t parent[MAX_ATOMS];
+    uint64_t pathAtoms[MAX_ATOMS];   // root..v inclusive
+    uint64_t pathBonds[MAX_ATOMS][2];
+} PathTree;
+
+static void path_tree_build(const Adjacency *adj, const uint64_t ringBonds[2], int n, int root, PathTree *t){
+    uint8_t queue[MAX_ATOMS];
+    int head = 0, tail = 0;
+    memset(t->dist, -1, (size_t)n);
+    t->dist[root] = 0;
+    t->pathAtoms[root] = 1ull << root;
+    t->pathBonds[root][0] = t->pathBonds[root][1] = 0;
+    queue[tail++] = (uint8_t)root;
+    while(head < tail){
+        int v = queue[head++];
+        for(int k = adj->offset[v]; k < adj->offset[v + 1]; k++){
+            int w = adj->neighbor[k], b = adj->bond[k];
+            if(t->dist[w] >= 0 || !ring_bond_test(ringBonds, b)) continue;
+            t->dist[w] = (int8_t)(t->dist[v] + 1);
+            t->parent[w] = (uint8_t)v;
+            t->pathAtoms[w] = t->pathAtoms[v] | 1ull << w;
+            t->pathBonds[w][0] = t->pathBonds[v][0];
+            t->pathBonds[w][1] = t->pathBonds[v][1];
+            mask_set(t->pathBonds[w], b);
+            queue[tail++] = (uint8_t)w;
+        }
+    }
+}
+
+typedef struct {
+    uint64_t bonds[2];
+    uint8_t root, bond, size;
+} HortonCandidate;
+
+#define HORTON_MAX (MAX_ATOMS * MAX_BONDS)
+#define HORTON_TABLE 16384 // power of two above 2 * HORTON_MAX
+
+// Worst-case buffers, allocated once per thread on first use.
+typedef struct {
+    PathTree trees[MAX_ATOMS];
+    HortonCandidate found[HORTON_MAX], sorted[HORTON_MAX];
+    uint64_t seen[HORTON_TABLE][2];
+} HortonScratch;
+
+// Horton's candidate set: for every root and ring bond (x, y) off its
+// shortest-path tree, the cycle root..x, y..root when the two paths only
+// meet at the root. The set contains a minimum cycle basis, so picking
+// from it greedily by size is exact, just slower than the first pass.
+// Candidates are bucketed by size and the same cycle seen from several
+// roots is kept once.
+static void sssr_from_horton(const MoleculeGeometry *mol, const Adjacency *adj, const uint64_t ringBonds[2],
+                             int needed, Basis *basis, RingInfo *out){
+    int n = mol->atomCount;
+    int maxCandidates = n * mol->bondCount;
+    int tableSize = 1;
+    while(tableSize < 2 * maxCandidates) tableSize <<= 1;
+    static _Thread_local HortonScratch *scratch = NULL;
+    if(!scratch) scratch = malloc(sizeof(HortonScratch));
+    if(!scratch){
+        out->truncated = true;
+        return;
+    }
+    PathTree *trees = scratch->trees;
+    HortonCandidate *found = scratch->found, *sorted = scratch->sorted;
+    uint64_t (*seen)[2] = scratch->seen;
+    memset(seen, 0, sizeof(uint64_t[2]) * (size_t)tableSize);
+
+    int count = 0;
+    int bySize[MAX_ATOMS + 2] = {0};
+    for(int root = 0; root < n; root++){
+        PathTree *t = &trees[root];
+        path_tree_build(adj, ringBonds, n, root, t);
+        for(int b = 0; b < mol->bondCount; b++){
+            int x = mol->bonds[b].from, y = mol->bonds[b].to;
+            if(!ring_bond_test(ringBonds, b) || t->dist[x] < 0) continue;
+            if((x != root && t->parent[x] == y) || (y != root && t->parent[y] == x)) continue;
+            if((t->pathAtoms[x] & t->pathAtoms[y]) != 1ull << root) continue;
+
+            HortonCandidate c = { { t->pathBonds[x][0] ^ t->pathBonds[y][0], t->pathBonds[x][1] ^ t->pathBonds[y][1] },
+                                  (uint8_t)root, (uint8_t)b, (uint8_t)(t->dist[x] + t->dist[y] + 1) };
+            mask_set(c.bonds, b);
+            uint64_t h = (c.bonds[0] * 0x9E3779B97F4A7C15ull) ^ (c.bonds[1] * 0xC2B2AE3D27D4EB4Full);
+            int slot = (int)((h ^ (h >> 32)) & (uint64_t)(tableSize - 1));
+            while(seen[slot][0] | seen[slot][1]){
+                if(seen[slot][0] == c.bonds[0] && seen[slot][1] == c.bonds[1]) break;
+                slot = (slot + 1) & (tableSize - 1);
+            }
+            if(seen[slot][0] | seen[slot][1]) continue;
+            seen[slot][0] = c.bonds[0];
+            seen[slot][1] = c.bonds[1];
+            found[count++] = c;
+            bySize[c.size + 1]++;
+        }
+    }
+    // counting sort by ring size; stable, so ties stay in root order
+    for(int s = 1; s <= MAX_ATOMS + 1; s++) bySize[s] += bySize[s - 1];
+    for(int i = 0; i < count; i++) sorted[bySize[found[i].size]++] = found[i];
+
+    for(int i = 0; i < count && basis->rank < needed; i++){
+        const HortonCandidate *h = &sorted[i];
+        if(!basis_insert(basis, h->bonds)) continue;
+        // walk x..root, then root..y, around the ring
+        const PathTree *t = &trees[h->root];
+        int x = mol->bonds[h->bond].from, y = mol->bonds[h->bond].to;
+        RingCandidate c;
+        c.bonds[0] = h->bonds[0];
+        c.bonds[1] = h->bonds[1];
+        int size = 0;
+        for(int v = x; v != h->root; v = t->parent[v]) c.atoms[size++] = (uint8_t)v;
+        c.atoms[size++] = h->root;
+        size += t->dist[y];
+        for(int v = y, k = size - 1; v != h->root; v = t->parent[v], k--) c.atoms[k] = (uint8_t)v;
+        c.size = (uint8_t)size;
+        add_ring(out, &c);
+    }
+}
+
+static void find_sssr(const MoleculeGeometry *mol, const Adjacency *adj, RingInfo *out){
+    uint64_t ringBonds[2];
+    int components = find_ring_bonds(mol, adj, ringBonds);
+    int needed = mol->bondCount - mol->atomCount + components;
+    out->ringBondMask[0] = ringBonds[0];
+    out->ringBondMask[1] = ringBonds[1];
+    if(needed <= 0) return;
+
+    uint64_t ringNeighbors[MAX_ATOMS] = {0};
+    for(int b = 0; b < mol->bondCount; b++){
+        if(!ring_bond_test(ringBonds, b)) continue;
+        ringNeighbors[mol->bonds[b].from] |= 1ull << mol->bonds[b].to;
+        ringNeighbors[mol->bonds[b].to] |= 1ull << mol->bonds[b].from;
+    }
+
+    RingCandidate candidates[MAX_BONDS];
+    int count = 0;
+    for(int b = 0; b < mol->bondCount; b++){
+        if(!ring_bond_test(ringBonds, b)) continue;
+        RingCandidate c;
+        if(!shortest_cycle_through(mol, adj, ringNeighbors, b, &c)) continue;
+        bool duplicate = false;
+        for(int i = 0; i < count && !duplicate; i++) duplicate = same_cycle(&candidates[i], &c);
+        if(!duplicate) candidates[count++] = c;
+    }
+    // insertion sort keeps equal sizes in bond order, so results are stable
+    for(int i = 1; i < count; i++){
+        RingCandidate c = candidates[i];
+        int j = i - 1;
+        while(j >= 0 && compare_candidates(&candidates[j], &c) > 0){
+            candidates[j + 1] = candidates[j];
+            j--;
+        }
+        candidates[j + 1] = c;
+    }
+
+    Basis basis;
+    basis_clear(&basis);
+    for(int i = 0; i < count && basis.rank < needed; i++){
+        if(basis_insert(&basis, candidates[i].bonds)) add_ring(out, &candidates[i]);
+    }
+    // More independent cycles than MAX_RINGS is a clump of overlapping
+    // atoms rather than a molecule; keep what the first pass found.
+    if(basis.rank < needed && needed <= MAX_RINGS){
+        // the first pass may already hold a ring larger than one it missed,
+        // so start over rather than topping it up
+        basis_clear(&basis);
+        out->ringCount = 0;
+        out->truncated = false;
+        sssr_from_horton(mol, adj, ringBonds, needed, &basis, out);
+    }
+    if(basis.rank < needed) out->truncated = true;
+}
+
+// Hückel count over the ring's atoms using bond orders.
+static bool aromatic_by_bond_orders(const MoleculeGeometry *mol, const Adjacency *adj, const RingInfo *info, int ring){
+    int electrons = 0;
+    for(int k = info->ringStart[ring]; k < info->ringStart[ring + 1]; k++){
+        int a = info->atoms[k];
+        uint8_t label = mol->atomLabel[a];
+        if(label != 0 && label != 1 && label != 2) return false;
+        int endocyclic = 0, exocyclic = -1;
+        for(int e = adj->offset[a]; e < adj->offset[a + 1]; e++){
+            int b = adj->bond[e];
+            int order = mol->bonds[b].order;
+            if(order > 2) return false;
+            if(order < 2) continue;
+            if(ring_bond_test(info->ringBonds[ring], b)) endocyclic++;
+            else exocyclic = adj->neighbor[e];
+        }
+        if(endocyclic > 1) return false;
+        if(endocyclic == 1) electrons += 1;
+        // a double bond into a fused ring still donates; a carbonyl takes
+        // the electron out of the ring
+        else if(exocyclic >= 0) electrons += mol->atomLabel[exocyclic] == 1 ? 0 : 1;
+        else if(label == 1 || label == 2) electrons += 2;
+        else return false;
+    }
+    return electrons % 4 == 2;
+}
+
+// Without bond orders: planar, and every bond clearly shorter than a
+// single bond between the same elements.
+static bool aromatic_by_geometry(const MoleculeGeometry *mol, const RingInfo *info, int ring){
+    int start = info->ringStart[ring], size = ring_size(info, ring);
+    Vec3 centre = {0, 0, 0}, normal = {0, 0, 0};
+    for(int k = 0; k < size; k++){
+        int a = info->atoms[start + k];
+        uint8_t label = mol->atomLabel[a];
+        if(label != 0 && label != 1 && label != 2) return false;
+        Vec3 p = mol->atomPos[a], q = mol->atomPos[info->atoms[start + (k + 1) % size]];
+        centre.x += p.x; centre.y += p.y; centre.z += p.z;
+        normal.x += (p.y - q.y) * (p.z + q.z);
+        normal.y += (p.z - q.z) * (p.x + q.x);
+        normal.z += (p.x - q.x) * (p.y + q.y);
+        float dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+        float single = covalent_radius(label) + covalent_radius(mol->atomLabel[info->atoms[start + (k + 1) % size]]);
+        if(dx*dx + dy*dy + dz*dz > 0.97f * 0.97f * single * single) return false;
+    }
+    float len = sqrtf(normal.x*normal.x + normal.y*normal.y + normal.z*normal.z);
+    if(len <= 0.0f) return false;
+    centre.x /= (float)size; centre.y /= (float)size; centre.z /= (float)size;
+    for(int k = 0; k < size; k++){
+        Vec3 p = mol->atomPos[info->atoms[start + k]];
+        float offPlane = ((p.x - centre.x) * normal.x + (p.y - centre.y) * normal.y + (p.z - centre.z) * normal.z) / len;
+        if(fabsf(offPlane) > 0.15f) return false;
+    }
+    return true;
+}
+
+void perceive_rings(const MoleculeGeometry *mol, RingInfo *out){
+    memset(out, 0, sizeof(*out));
+    Adjacency adj;
+    adjacency_build(mol, &adj);
+    find_sssr(mol, &adj, out);
+
+    bool haveOrders = false;
+    for(int b = 0; b < mol->bondCount && !haveOrders; b++) haveOrders = mol->bonds[b].order > 1;
+
+    for(int r = 0; r < out->ringCount; r++){
+        for(int k = out->ringStart[r]; k < out->ringStart[r + 1]; k++) out->ringAtoms |= 1ull << out->atoms[k];
+        int size = ring_size(out, r);
+        if(size < 5 || size > 7) continue;
+        bool aromatic = haveOrders ? aromatic_by_bond_orders(mol, &adj, out, r) : aromatic_by_geometry(mol, out, r);
+        if(!aromatic) continue;
+        out->aromaticRings |= 1ull << r;
+        for(int k = out->ringStart[r]; k < out->ringStart[r + 1]; k++) out->aromaticAtoms |= 1ull << out->atoms[k];
+        out->aromaticBondMask[0] |= out->ringBonds[r][0];
+        out->aromaticBondMask[1] |= out->ringBonds[r][1];
+    }
+}
+
+#define RING_CACHE_SETS 16
+#define RING_CACHE_WAYS 4
+
+typedef struct {
+    uint64_t hash;
+    uint64_t lastUse;               // 0: empty
+    int atomCount, bondCount;
+    uint8_t labels[MAX_ATOMS];
+    uint8_t bonds[MAX_BONDS][3];
+    RingInfo info;
+} RingCacheSlot;
+
+static uint64_t hash_mix(uint64_t h, uint32_t v){
+    h ^= v;
+    return h * 0x100000001B3ull;
+}
+
+static bool slot_matches(const RingCacheSlot *slot, const MoleculeGeometry *mol, uint64_t hash){
+    if(!slot->lastUse || slot->hash != hash ||
+       slot->atomCount != mol->atomCount || slot->bondCount != mol->bondCount ||
+       memcmp(slot->labels, mol->atomLabel, (size_t)mol->atomCount) != 0) return false;
+    for(int b = 0; b < mol->bondCount; b++){
+        const Bond *bond = &mol->bonds[b];
+        if(slot->bonds[b][0] != bond->from || slot->bonds[b][1] != bond->to || slot->bonds[b][2] != bond->order) return false;
+    }
+    return true;
+}
+
+const RingInfo *ring_info_cached(const MoleculeGeometry *mol){
+    static _Thread_local RingCacheSlot *slots = NULL;
+    static _Thread_local uint64_t useClock = 0;
+    static _Thread_local RingInfo fallback;
+    if(!slots){
+        slots = calloc(RING_CACHE_SETS * RING_CACHE_WAYS, sizeof(RingCacheSlot));
+        if(!slots){
+            perceive_rings(mol, &fallback);
+            return &fallback;
+        }
+    }
+
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = hash_mix(h, (uint32_t)mol->atomCount);
+    for(int i = 0; i < mol->atomCount; i++) h = hash_mix(h, mol->atomLabel[i]);
+    for(int b = 0; b < mol->bondCount; b++){
+        const Bond *bond = &mol->bonds[b];
+        h = hash_mix(h, (uint32_t)(bond->from | bond->to << 8 | bond->order << 16));
+    }
+    h ^= h >> 29;
+
+    // a few ways per set so two molecules on screen sharing a set do not
+    // keep evicting each other
+    RingCacheSlot *set = &slots[(h % RING_CACHE_SETS) * RING_CACHE_WAYS];
+    RingCacheSlot *victim = &set[0];
+    useClock++;
+    for(int w = 0; w < RING_CACHE_WAYS; w++){
+        if(slot_matches(&set[w], mol, h)){
+            set[w].lastUse = useClock;
+            return &set[w].info;
+        }
+        if(set[w].lastUse < victim->lastUse) victim = &set[w];
+    }
+
+    victim->hash = h;
+    victim->lastUse = useClock;
+    victim->atomCount = mol->atomCount;
+    victim->bondCount = mol->bondCount;
+    memcpy(victim->labels, mol->atomLabel, (size_t)mol->atomCount);
+    for(int b = 0; b < mol->bondCount; b++){
+        victim->bonds[b][0] = (uint8_t)mol->bonds[b].from;
+        victim->bonds[b][1] = (uint8_t)mol->bonds[b].to;
+        victim->bonds[b][2] = (uint8_t)mol->bonds[b].order;
+    }
+    perceive_rings(mol, &victim->info);
+    return &victim->info;
+}
@@ -0,0 +1,69 @@
+#ifndef ATLAS_RINGS_H
+#define ATLAS_RINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+// Ring perception: the smallest set of smallest rings (SSSR) and aromatic
+// flags. MAX_ATOMS is 64, so atom sets are single uint64_t masks and bond
+// sets are two.
+
+#define MAX_RINGS 48
+#define RING_ATOMS_MAX 384
+
+// Compressed sparse row adjacency: the neighbours of atom i are
+// neighbor[offset[i] .. offset[i + 1]), reached through bond[...].
+typedef struct {
+    uint16_t offset[MAX_ATOMS + 1];
+    uint8_t neighbor[2 * MAX_BONDS];
+    uint8_t bond[2 * MAX_BONDS];
+} Adjacency;
+
+void adjacency_build(const MoleculeGeometry *mol, Adjacency *adj);
+
+typedef struct {
+    int ringCount;
+    bool truncated;                    // rings past MAX_RINGS/RING_ATOMS_MAX were dropped
+    uint16_t ringStart[MAX_RINGS + 1]; // ring r is atoms[ringStart[r] .. ringStart[r + 1])
+    uint8_t atoms[RING_ATOMS_MAX];     // in order around each ring
+    uint64_t ringBonds[MAX_RINGS][2];
+    uint64_t aromaticRings;            // bit r set for aromatic ring r
+    uint64_t ringAtoms, aromaticAtoms;
+    uint64_t ringBondMask[2], aromaticBondMask[2];
+} RingInfo;
+
+// Bridges are found first with one DFS, so only ring bonds are searched.
+// Candidate rings are the shortest cycle through each ring bond, sorted by
+// size and kept when they are independent of the rings already chosen
+// (Gaussian elimination over GF(2)). Only if that leaves the basis short is
+// it rebuilt from Horton's candidates.
+//
+// A ring of 5-7 atoms is aromatic when its pi electrons number 4n+2 (one
+// per atom with a double bond, two per N or O lone pair, any sp3 atom
+// disqualifies). Molecules without any bond order above one, like XYZ
+// imports, are judged by geometry instead: a planar ring whose bonds are
+// all well short of single-bond length.
+void perceive_rings(const MoleculeGeometry *mol, RingInfo *out);
+
+// perceive_rings() through a small per-thread cache keyed by the atom
+// labels and bonds only; positions are read only when a topology is first
+// seen. A molecule without bond orders is thus judged aromatic or not from
+// the geometry it was first drawn with, its rest geometry, and vibrating
+// or switching conformers neither misses the cache nor flips the flags.
+const RingInfo *ring_info_cached(const MoleculeGeometry *mol);
+
+static inline bool ring_bond_test(const uint64_t mask[2], int bond){
+    return (mask[bond >> 6] >> (bond & 63)) & 1;
+}
+
+static inline int ring_size(const RingInfo *info, int ring){
+    return info->ringStart[ring + 1] - info->ringStart[ring];
+}
+
+static inline bool ring_is_aromatic(const RingInfo *info, int ring){
+    return (info->aromaticRings >> ring) & 1;
+}
+
+#endif
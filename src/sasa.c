@@ -0,0 +1,306 @@
+#include "sasa.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SASA_SIMD 1
+#endif
+
+#define MOVE_EPSILON 1e-5f
+#define MAX_GRID_CELLS (1 << 18)
+
+static const float vdwByLabel[5] = { 1.70f, 1.52f, 1.55f, 1.75f, 1.47f };
+
+static Vec3 spherePoints[SASA_POINTS];
+static float spherePx[SASA_POINTS], spherePy[SASA_POINTS], spherePz[SASA_POINTS];
+static pthread_once_t sphereOnce = PTHREAD_ONCE_INIT;
+
+static void build_sphere(void){
+    const float golden = PI * (3.0f - sqrtf(5.0f));
+    for(int i = 0; i < SASA_POINTS; i++){
+        float y = 1.0f - 2.0f * ((float)i + 0.5f) / (float)SASA_POINTS;
+        float r = sqrtf(1.0f - y*y);
+        float phi = golden * (float)i;
+        spherePoints[i] = make_vec3(cosf(phi) * r, y, sinf(phi) * r);
+        spherePx[i] = spherePoints[i].x;
+        spherePy[i] = spherePoints[i].y;
+        spherePz[i] = spherePoints[i].z;
+    }
+}
+
+const Vec3 *sasa_sphere_points(void){
+    pthread_once(&sphereOnce, build_sphere);
+    return spherePoints;
+}
+
+float sasa_vdw_radius(uint8_t label){
+    return vdwByLabel[label < 5 ? label : 0];
+}
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    float lo[3];
+    float cell;
+    int dims[3];
+    int *head;
+    int *next;
+} CellGrid;
+
+static bool grid_build(CellGrid *g, const Vec3 *pos, int n, float cell){
+    g->lo[0] = g->lo[1] = g->lo[2] = 0.0f;
+    float hi[3] = {0.0f, 0.0f, 0.0f};
+    for(int i = 0; i < n; i++){
+        float p[3] = { pos[i].x, pos[i].y, pos[i].z };
+        for(int k = 0; k < 3; k++){
+            if(i == 0 || p[k] < g->lo[k]) g->lo[k] = p[k];
+            if(i == 0 || p[k] > hi[k]) hi[k] = p[k];
+        }
+    }
+
+    // Grow the cell until the grid fits the cap; a coarser grid only costs
+    // extra distance tests.
+    for(;;){
+        long long total = 1;
+        for(int k = 0; k < 3; k++){
+            g->dims[k] = (int)((hi[k] - g->lo[k]) / cell) + 1;
+            total *= g->dims[k];
+        }
+        if(total <= MAX_GRID_CELLS) break;
+        cell *= 1.5f;
+    }
+    g->cell = cell;
+
+    int cells = g->dims[0] * g->dims[1] * g->dims[2];
+    g->head = malloc(sizeof(int) * (size_t)cells);
+    g->next = malloc(sizeof(int) * (size_t)(n > 0 ? n : 1));
+    if(!g->head || !g->next){
+        free(g->head);
+        free(g->next);
+        return false;
+    }
+    memset(g->head, -1, sizeof(int) * (size_t)cells);
+
+    for(int i = 0; i < n; i++){
+        int c[3];
+        float p[3] = { pos[i].x, pos[i].y, pos[i].z };
+        for(int k = 0; k < 3; k++){
+            c[k] = (int)((p[k] - g->lo[k]) / g->cell);
+            if(c[k] >= g->dims[k]) c[k] = g->dims[k] - 1;
+        }
+        int idx = (c[2] * g->dims[1] + c[1]) * g->dims[0] + c[0];
+        g->next[i] = g->head[idx];
+        g->head[idx] = i;
+    }
+    return true;
+}
+
+static void grid_free(CellGrid *g){
+    free(g->head);
+    free(g->next);
+}
+
+// Marks sphere points of one atom that fall inside any neighbour sphere.
+// Loops over points in blocks of four so each neighbour is one broadcast.
+static int count_exposed(Vec3 center, float r, const float *nx, const float *ny, const float *nz,
+                         const float *nr2, int neighbourCount, uint64_t *mask){
+    float buried[SASA_POINTS];
+    float px[SASA_POINTS], py[SASA_POINTS], pz[SASA_POINTS];
+    for(int k = 0; k < SASA_POINTS; k++){
+        px[k] = center.x + r * spherePx[k];
+        py[k] = center.y + r * spherePy[k];
+        pz[k] = center.z + r * spherePz[k];
+        buried[k] = 0.0f;
+    }
+
+    for(int j = 0; j < neighbourCount; j++){
+#if SASA_SIMD
+        __m128 cx = _mm_set1_ps(nx[j]);
+        __m128 cy = _mm_set1_ps(ny[j]);
+        __m128 cz = _mm_set1_ps(nz[j]);
+        __m128 rr = _mm_set1_ps(nr2[j]);
+        for(int k = 0; k < SASA_POINTS; k += 4){
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(px + k), cx);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(py + k), cy);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(pz + k), cz);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            __m128 hit = _mm_cmplt_ps(d2, rr);
+            _mm_storeu_ps(buried + k, _mm_or_ps(_mm_loadu_ps(buried + k), hit));
+        }
+#else
+        for(int k = 0; k < SASA_POINTS; k++){
+            float dx = px[k] - nx[j];
+            float dy = py[k] - ny[j];
+            float dz = pz[k] - nz[j];
+            if(dx*dx + dy*dy + dz*dz < nr2[j]) buried[k] = 1.0f;
+        }
+#endif
+    }
+
+    int exposed = 0;
+    if(mask) memset(mask, 0, sizeof(uint64_t) * SASA_MASK_WORDS);
+    for(int k = 0; k < SASA_POINTS; k++){
+        uint32_t bits;
+        memcpy(&bits, &buried[k], sizeof(bits));
+        if(bits == 0){
+            exposed++;
+            if(mask) mask[k >> 6] |= 1ull << (k & 63);
+        }
+    }
+    return exposed;
+}
+
+void sasa_compute(const Vec3 *pos, const float *radius, int atomCount,
+                  const int *which, int whichCount,
+                  float *area, uint64_t (*exposed)[SASA_MASK_WORDS]){
+    PROF_SCOPE("sasa_compute");
+    pthread_once(&sphereOnce, build_sphere);
+    if(atomCount <= 0) return;
+    if(!which) whichCount = atomCount;
+
+    float maxR = 0.0f;
+    for(int i = 0; i < atomCount; i++){
+        if(radius[i] + SASA_PROBE > maxR) maxR = radius[i] + SASA_PROBE;
+    }
+
+    CellGrid grid;
+    if(!grid_build(&grid, pos, atomCount, 2.0f * maxR)) return;
+    int reach = (int)ceilf(2.0f * maxR / grid.cell);
+
+    // Sized for the worst case, every other atom overlapping, so dense or
+    // overlapping inputs are never cut short.
+    float *nx = malloc(sizeof(float) * 4 * (size_t)atomCount);
+    if(!nx){
+        grid_free(&grid);
+        return;
+    }
+    float *ny = nx + atomCount, *nz = ny + atomCount, *nr2 = nz + atomCount;
+
+    for(int w = 0; w < whichCount; w++){
+        int i = which ? which[w] : w;
+        float ri = radius[i] + SASA_PROBE;
+        Vec3 ci = pos[i];
+        int c[3] = {
+            (int)((ci.x - grid.lo[0]) / grid.cell),
+            (int)((ci.y - grid.lo[1]) / grid.cell),
+            (int)((ci.z - grid.lo[2]) / grid.cell),
+        };
+
+        int count = 0;
+        for(int z = c[2] - reach; z <= c[2] + reach; z++){
+            if(z < 0 || z >= grid.dims[2]) continue;
+            for(int y = c[1] - reach; y <= c[1] + reach; y++){
+                if(y < 0 || y >= grid.dims[1]) continue;
+                for(int x = c[0] - reach; x <= c[0] + reach; x++){
+                    if(x < 0 || x >= grid.dims[0]) continue;
+                    for(int j = grid.head[(z * grid.dims[1] + y) * grid.dims[0] + x]; j >= 0; j = grid.next[j]){
+                        if(j == i) continue;
+                        float rj = radius[j] + SASA_PROBE;
+                        float dx = pos[j].x - ci.x;
+                        float dy = pos[j].y - ci.y;
+                        float dz = pos[j].z - ci.z;
+                        float reachIJ = ri + rj;
+                        if(dx*dx + dy*dy + dz*dz >= reachIJ * reachIJ) continue;
+
+                        nx[count] = pos[j].x;
+                        ny[count] = pos[j].y;
+                        nz[count] = pos[j].z;
+                        nr2[count] = rj * rj;
+                        count++;
+                    }
+                }
+            }
+        }
+
+        int open = count_exposed(ci, ri, nx, ny, nz, nr2, count, exposed ? exposed[i] : NULL);
+        area[i] = 4.0f * PI * ri * ri * (float)open / (float)SASA_POINTS;
+    }
+
+    free(nx);
+    grid_free(&grid);
+}
+
+
+void sasa_cache_init(SasaCache *cache){
+    memset(cache, 0, sizeof(*cache));
+}
+
+int sasa_update(SasaCache *cache, const MoleculeGeometry *mol){
+    int n = mol->atomCount;
+    bool full = !cache->valid || cache->atomCount != n ||
+                memcmp(cache->lastLabel, mol->atomLabel, (size_t)n) != 0;
+
+    float radius[MAX_ATOMS];
+    float reach = 0.0f;
+    for(int i = 0; i < n; i++){
+        radius[i] = sasa_vdw_radius(mol->atomLabel[i]);
+        if(radius[i] + SASA_PROBE > reach) reach = radius[i] + SASA_PROBE;
+    }
+    reach *= 2.0f;
+
+    int which[MAX_ATOMS];
+    int whichCount = 0;
+
+    if(full){
+        for(int i = 0; i < n; i++) which[whichCount++] = i;
+    } else {
+        uint64_t moved = 0;
+        for(int i = 0; i < n; i++){
+            float dx = mol->atomPos[i].x - cache->lastPos[i].x;
+            float dy = mol->atomPos[i].y - cache->lastPos[i].y;
+            float dz = mol->atomPos[i].z - cache->lastPos[i].z;
+            if(dx*dx + dy*dy + dz*dz > MOVE_EPSILON * MOVE_EPSILON) moved |= 1ull << i;
+        }
+        if(moved == 0) return 0;
+
+        // An atom needs recomputing if it moved or a moved atom is (or was)
+        // within occlusion range of it.
+        float reach2 = reach * reach;
+        for(int i = 0; i < n; i++){
+            bool dirty = (moved >> i) & 1;
+            for(int j = 0; j < n && !dirty; j++){
+                if(!((moved >> j) & 1)) continue;
+                const Vec3 *sets[2][2] = {
+                    { &mol->atomPos[i], &mol->atomPos[j] },
+                    { &cache->lastPos[i], &cache->lastPos[j] },
+                };
+                for(int s = 0; s < 2 && !dirty; s++){
+                    float dx = sets[s][0]->x - sets[s][1]->x;
+                    float dy = sets[s][0]->y - sets[s][1]->y;
+                    float dz = sets[s][0]->z - sets[s][1]->z;
+                    dirty = dx*dx + dy*dy + dz*dz < reach2;
+                }
+            }
+            if(dirty) which[whichCount++] = i;
+        }
+    }
+
+    double start = now_seconds();
+    sasa_compute(mol->atomPos, radius, n, which, whichCount, cache->atomArea, cache->exposed);
+    cache->secondsSpent += now_seconds() - start;
+    cache->atomsComputed += whichCount;
+
+    cache->valid = true;
+    cache->atomCount = n;
+    memcpy(cache->lastPos, mol->atomPos, sizeof(Vec3) * (size_t)n);
+    memcpy(cache->lastLabel, mol->atomLabel, (size_t)n);
+
+    cache->totalArea = 0.0f;
+    for(int i = 0; i < n; i++) cache->totalArea += cache->atomArea[i];
+    return whichCount;
+}
+
+double sasa_atoms_per_second(const SasaCache *cache){
+    if(cache->secondsSpent <= 0.0) return 0.0;
+    return (double)cache->atomsComputed / cache->secondsSpent;
+}
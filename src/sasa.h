@@ -0,0 +1,49 @@
+#ifndef ATLAS_SASA_H
+#define ATLAS_SASA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "molecule.h"
+
+#define SASA_POINTS 256
+#define SASA_MASK_WORDS (SASA_POINTS / 64)
+#define SASA_PROBE 1.4f
+
+// Unit Fibonacci-sphere directions shared by every computation.
+const Vec3 *sasa_sphere_points(void);
+
+float sasa_vdw_radius(uint8_t label);
+
+// Shrake-Rupley over an arbitrary atom set. Only atoms listed in `which`
+// (or all of them when which is NULL) are evaluated; every atom still
+// occludes. `exposed` may be NULL; otherwise it receives one bit per
+// sphere point that is solvent accessible.
+void sasa_compute(const Vec3 *pos, const float *radius, int atomCount,
+                  const int *which, int whichCount,
+                  float *area, uint64_t (*exposed)[SASA_MASK_WORDS]);
+
+// Per-molecule cache. sasa_update() compares against the geometry it last
+// saw and only recomputes atoms that moved or whose neighbours moved.
+typedef struct {
+    bool valid;
+    int atomCount;
+    Vec3 lastPos[MAX_ATOMS];
+    uint8_t lastLabel[MAX_ATOMS];
+
+    float atomArea[MAX_ATOMS];
+    uint64_t exposed[MAX_ATOMS][SASA_MASK_WORDS];
+    float totalArea;
+
+    long long atomsComputed;
+    double secondsSpent;
+} SasaCache;
+
+void sasa_cache_init(SasaCache *cache);
+
+// Returns the number of atoms recomputed (0 when nothing changed).
+int sasa_update(SasaCache *cache, const MoleculeGeometry *mol);
+
+double sasa_atoms_per_second(const SasaCache *cache);
+
+#endif
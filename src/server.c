@@ -0,0 +1,626 @@
+#include "server.h"
+#include "export.h"
+#include "image_cache.h"
+#include "isosurface.h"
+#include "library.h"
+#include "profiler.h"
+#include "raster.h"
+#include "reload.h"
+#include "render.h"
+#include "sasa.h"
+#include "thread_pool.h"
+#include "watch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_LINE_MAX 256
+#define SERVER_BACKLOG_LIMIT (8u << 20) // unsent bytes before a client stops being read
+
+typedef struct {
+    int fd;
+    char in[SERVER_LINE_MAX];
+    size_t inLen;
+    uint8_t *out;
+    size_t outLen, outSent, outCapacity;
+    bool closed;
+    bool hangup;  // close once everything queued has been sent
+    bool waiting; // an earlier request this round is still being rendered
+} Client;
+
+// One request line, answered in arrival order per client.
+typedef struct {
+    int client;
+    int job;                // index into jobs, or -1 when ready
+    const uint8_t *data;    // ready reply: a cache entry or text
+    size_t size;
+    bool sent;
+    char text[160];
+} Request;
+
+typedef struct {
+    RenderKey key;
+    uint8_t *reply; // "ok N\n" + PNG
+    size_t size;
+} RenderJob;
+
+typedef struct {
+    Library lib;
+    LibrarySource source; // with --watch
+    FileWatch watch;
+    ImageCache cache;
+    SasaCache **sasa;      // per compound, built on first dots request
+    SurfaceCache *surface; // per compound, built on first surface request
+
+    Client *clients;
+    int clientCount, clientCapacity;
+    Request *requests;
+    int requestCount, requestCapacity;
+    RenderJob *jobs;
+    int jobCount, jobCapacity;
+
+    uint64_t rendered, batches, maxBatch;
+} Server;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void on_stop_signal(int sig){
+    (void)sig;
+    stopRequested = 1;
+}
+
+static bool reserve(void **array, int *capacity, int needed, size_t size){
+    if(needed <= *capacity) return true;
+    int grown = *capacity ? *capacity * 2 : 16;
+    while(grown < needed) grown *= 2;
+    void *p = realloc(*array, size * (size_t)grown);
+    if(!p) return false;
+    *array = p;
+    *capacity = grown;
+    return true;
+}
+
+static void client_append(Client *c, const void *data, size_t size){
+    if(c->closed) return;
+    if(c->outLen + size > c->outCapacity){
+        size_t capacity = c->outCapacity ? c->outCapacity : 4096;
+        while(capacity < c->outLen + size) capacity *= 2;
+        uint8_t *grown = realloc(c->out, capacity);
+        if(!grown){
+            c->closed = true;
+            return;
+        }
+        c->out = grown;
+        c->outCapacity = capacity;
+    }
+    memcpy(c->out + c->outLen, data, size);
+    c->outLen += size;
+}
+
+static void client_flush(Client *c){
+    while(!c->closed && c->outSent < c->outLen){
+        ssize_t n = send(c->fd, c->out + c->outSent, c->outLen - c->outSent, MSG_NOSIGNAL);
+        if(n > 0) c->outSent += (size_t)n;
+        else if(n < 0 && errno == EINTR) continue;
+        else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        else c->closed = true;
+    }
+    c->outLen = c->outSent = 0;
+    if(c->hangup && !c->waiting) c->closed = true; // a render still owes it replies
+}
+
+static Request *push_request(Server *s, int client){
+    if(!reserve((void**)&s->requests, &s->requestCapacity, s->requestCount + 1, sizeof(Request))) return NULL;
+    Request *r = &s->requests[s->requestCount++];
+    memset(r, 0, sizeof(*r));
+    r->client = client;
+    r->job = -1;
+    return r;
+}
+
+static void reply_text(Request *r, const char *text){
+    snprintf(r->text, sizeof(r->text), "%s", text);
+    r->data = (const uint8_t*)r->text;
+    r->size = strlen(r->text);
+}
+
+static bool parse_size(const char *token, int *w, int *h){
+    char tail;
+    if(sscanf(token, "%dx%d%c", w, h, &tail) == 2) return true;
+    if(sscanf(token, "%d%c", w, &tail) != 1) return false;
+    *h = *w;
+    return true;
+}
+
+bool render_request_parse(const char *line, int compoundCount, RenderKey *key, char *error, size_t errorSize){
+    int compound, w, h;
+    char size[32], mode[16], tail;
+    memset(key, 0, sizeof(*key));
+    RenderMode renderMode;
+    if(sscanf(line, "render %d %31s %f %f %f %15s %c", &compound, size, &key->yaw, &key->pitch, &key->zoom, mode, &tail) != 6){
+        snprintf(error, errorSize, "expected: render COMPOUND SIZE YAW PITCH ZOOM MODE");
+        return false;
+    }
+    if(compound < 0 || compound >= compoundCount){
+        snprintf(error, errorSize, "no such compound");
+        return false;
+    }
+    if(!parse_size(size, &w, &h) || w < 16 || h < 16 || w > 2048 || h > 2048){
+        snprintf(error, errorSize, "size must be 16..2048");
+        return false;
+    }
+    if(!render_mode_parse(mode, &renderMode)){
+        snprintf(error, errorSize, "mode must be ball, wire, dots or surface");
+        return false;
+    }
+    if(!isfinite(key->yaw) || !isfinite(key->pitch)){
+        snprintf(error, errorSize, "yaw and pitch must be finite");
+        return false;
+    }
+    if(!(key->zoom >= VIEW_ZOOM_MIN && key->zoom <= VIEW_ZOOM_MAX)){
+        snprintf(error, errorSize, "zoom must be %.2f..%.0f", VIEW_ZOOM_MIN, VIEW_ZOOM_MAX);
+        return false;
+    }
+    key->compound = compound;
+    key->width = w;
+    key->height = h;
+    key->mode = (int32_t)renderMode;
+    return true;
+}
+
+static void handle_line(Server *s, int client, const char *line){
+    Request *r = push_request(s, client);
+    if(!r){
+        s->clients[client].closed = true;
+        return;
+    }
+    if(strcmp(line, "stats") == 0){
+        char body[128];
+        int n = snprintf(body, sizeof(body), "entries=%zu bytes=%zu hits=%llu misses=%llu rendered=%llu batches=%llu\n",
+                         s->cache.count, s->cache.bytes, (unsigned long long)s->cache.hits,
+                         (unsigned long long)s->cache.misses, (unsigned long long)s->rendered,
+                         (unsigned long long)s->batches);
+        if(n >= (int)sizeof(body)) n = (int)sizeof(body) - 1;
+        snprintf(r->text, sizeof(r->text), "ok %d\n%s", n, body);
+        r->data = (const uint8_t*)r->text;
+        r->size = strlen(r->text);
+        return;
+    }
+
+    RenderKey key;
+    char error[96], text[128];
+    if(!render_request_parse(line, s->lib.count, &key, error, sizeof(error))){
+        snprintf(text, sizeof(text), "err %s\n", error);
+        reply_text(r, text);
+        return;
+    }
+
+    const CachedImage *hit = image_cache_get(&s->cache, &key);
+    if(hit){
+        r->data = hit->data;
+        r->size = hit->size;
+        return;
+    }
+    // Identical misses in one batch render once.
+    for(int j = 0; j < s->jobCount; j++){
+        if(memcmp(&s->jobs[j].key, &key, sizeof(key)) == 0){
+            r->job = j;
+            return;
+        }
+    }
+    if(!reserve((void**)&s->jobs, &s->jobCapacity, s->jobCount + 1, sizeof(RenderJob))){
+        reply_text(r, "err out of memory\n");
+        return;
+    }
+    r->job = s->jobCount;
+    s->jobs[s->jobCount++] = (RenderJob){ key, NULL, 0 };
+}
+
+static void read_client(Server *s, int index){
+    Client *c = &s->clients[index];
+    while(!c->hangup){
+        ssize_t n = recv(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen, 0);
+        if(n == 0){
+            c->hangup = true; // the client is done sending; answer what it asked
+            return;
+        }
+        if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+            c->closed = true;
+            return;
+        }
+        if(n < 0){
+            if(errno == EINTR) continue;
+            return;
+        }
+        c->inLen += (size_t)n;
+
+        size_t start = 0;
+        for(size_t i = 0; i < c->inLen; i++){
+            if(c->in[i] != '\n') continue;
+            c->in[i] = '\0';
+            if(i > start && c->in[i - 1] == '\r') c->in[i - 1] = '\0';
+            if(c->in[start]) handle_line(s, index, c->in + start);
+            start = i + 1;
+        }
+        memmove(c->in, c->in + start, c->inLen - start);
+        c->inLen -= start;
+        if(c->inLen == sizeof(c->in)){
+            Request *r = push_request(s, index);
+            if(r) reply_text(r, "err line too long\n");
+            c->inLen = 0;
+            c->hangup = true;
+            return;
+        }
+    }
+}
+
+static void render_jobs(void *ctx, int begin, int end){
+    Server *s = ctx;
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    for(int j = begin; j < end; j++){
+        RenderJob *job = &s->jobs[j];
+        const RenderKey *k = &job->key;
+        uint32_t *pixels = malloc(sizeof(uint32_t) * (size_t)k->width * (size_t)k->height);
+        if(!pixels) continue;
+        Canvas canvas = { pixels, k->width, k->height, k->width };
+
+        Compound compound = library_compound(&s->lib, k->compound);
+        ViewControl view;
+        reset_view_control(&view);
+        view.yaw = k->yaw;
+        view.pitch = k->pitch;
+        view.zoomMultiplier = k->zoom;
+        TileQuality quality = tile_quality_for_size(k->width, k->height);
+        RectI rect = { 0, 0, k->width, k->height };
+        command_buffer_reset(&cb);
+        build_molecule(&cb, &compound, &s->lib.entries[k->compound].mol, &rect, false, (RenderMode)k->mode,
+                       s->sasa ? s->sasa[k->compound] : NULL, s->surface ? &s->surface[k->compound] : NULL,
+                       0.0f, &view, false, &quality);
+        command_buffer_rasterize(&cb, &canvas);
+
+        char *png = NULL;
+        size_t pngSize = 0;
+        FILE *f = open_memstream(&png, &pngSize);
+        bool ok = f && png_write(f, pixels, k->width, k->height);
+        if(f && fclose(f) != 0) ok = false;
+        free(pixels);
+        if(ok){
+            char header[32];
+            int n = snprintf(header, sizeof(header), "ok %zu\n", pngSize);
+            job->reply = malloc((size_t)n + pngSize);
+            if(job->reply){
+                memcpy(job->reply, header, (size_t)n);
+                memcpy(job->reply + n, png, pngSize);
+                job->size = (size_t)n + pngSize;
+            }
+        }
+        free(png);
+    }
+    command_buffer_free(&cb);
+}
+
+// Dots and surface modes draw from per-compound caches, built here on the
+// main thread the first time a batch needs them.
+static void prepare_caches(Server *s){
+    for(int j = 0; j < s->jobCount; j++){
+        int c = s->jobs[j].key.compound;
+        RenderMode mode = (RenderMode)s->jobs[j].key.mode;
+        if(mode == RENDER_DOTS){
+            if(!s->sasa) s->sasa = calloc((size_t)s->lib.count, sizeof(SasaCache*));
+            if(s->sasa && !s->sasa[c] && (s->sasa[c] = malloc(sizeof(SasaCache)))){
+                sasa_cache_init(s->sasa[c]);
+                sasa_update(s->sasa[c], &s->lib.entries[c].mol);
+            }
+        }
+        if(mode == RENDER_SURFACE){
+            if(!s->surface){
+                s->surface = malloc(sizeof(SurfaceCache) * (size_t)s->lib.count);
+                if(s->surface) for(int i = 0; i < s->lib.count; i++) surface_cache_init(&s->surface[i]);
+            }
+            if(s->surface) surface_cache_update(&s->surface[c], &s->lib.entries[c].mol);
+        }
+    }
+}
+
+// Forgets the dots and surface caches of compounds [first, last).
+static void drop_derived(Server *s, int first, int last){
+    for(int c = first; c < last; c++){
+        if(s->sasa){
+            free(s->sasa[c]);
+            s->sasa[c] = NULL;
+        }
+        if(s->surface){
+            surface_cache_free(&s->surface[c]);
+            surface_cache_init(&s->surface[c]);
+        }
+    }
+}
+
+// Resizes the per-compound caches after the library grew or shrank; the
+// entries past the old end start empty. On failure they are dropped and
+// rebuilt on demand.
+static void resize_derived(Server *s, int oldCount){
+    int count = s->lib.count > 0 ? s->lib.count : 1;
+    if(s->sasa){
+        SasaCache **grown = realloc(s->sasa, sizeof(SasaCache*) * (size_t)count);
+        if(grown){
+            s->sasa = grown;
+            for(int c = oldCount; c < s->lib.count; c++) s->sasa[c] = NULL;
+        } else {
+            for(int c = 0; c < oldCount && c < s->lib.count; c++) free(s->sasa[c]);
+            free(s->sasa);
+            s->sasa = NULL;
+        }
+    }
+    if(s->surface){
+        SurfaceCache *grown = realloc(s->surface, sizeof(SurfaceCache) * (size_t)count);
+        if(grown){
+            s->surface = grown;
+            for(int c = oldCount; c < s->lib.count; c++) surface_cache_init(&s->surface[c]);
+        } else {
+            for(int c = 0; c < oldCount && c < s->lib.count; c++) surface_cache_free(&s->surface[c]);
+            free(s->surface);
+            s->surface = NULL;
+        }
+    }
+}
+
+// Re-reads the library after a save, between batches so that no reply
+// mixes versions, and forgets only what was derived from changed entries.
+static void reload_library(Server *s){
+    LibraryDelta delta;
+    char error[256];
+    if(!library_source_reload(&s->source, &s->lib, &delta, error, sizeof(error))){
+        fprintf(stderr, "serve: %s; keeping the last good version\n", error);
+        library_delta_free(&delta);
+        return;
+    }
+    size_t dropped = 0;
+    for(int i = 0; i < delta.changedCount; i++){
+        int c = delta.changed[i];
+        dropped += image_cache_drop_compounds(&s->cache, c, 1);
+        drop_derived(s, c, c + 1);
+    }
+    if(delta.shiftedFrom >= 0){
+        dropped += image_cache_drop_compounds(&s->cache, delta.shiftedFrom, INT_MAX - delta.shiftedFrom);
+        drop_derived(s, delta.shiftedFrom, delta.oldCount);
+        resize_derived(s, delta.oldCount);
+    }
+    printf("serve: reloaded, %d compounds, %d records parsed, %d changed%s, %zu images dropped\n",
+           s->lib.count, delta.recordsParsed, delta.changedCount,
+           delta.shiftedFrom >= 0 ? " and the rest shifted" : "", dropped);
+    fflush(stdout);
+    library_delta_free(&delta);
+}
+
+// Sends every reply that does not have to wait behind a render, then
+// renders the batch and sends the rest in order.
+static void answer_requests(Server *s){
+    for(int i = 0; i < s->clientCount; i++) s->clients[i].waiting = false;
+    for(int i = 0; i < s->requestCount; i++){
+        Request *r = &s->requests[i];
+        Client *c = &s->clients[r->client];
+        if(r->job >= 0) c->waiting = true;
+        if(c->waiting) continue;
+        client_append(c, r->data, r->size);
+        r->sent = true;
+    }
+    for(int i = 0; i < s->clientCount; i++) client_flush(&s->clients[i]);
+    if(s->jobCount == 0) return;
+
+    PROF_SCOPE("serve_batch");
+    prepare_caches(s);
+    parallel_for(s->jobCount, 1, render_jobs, s);
+    s->rendered += (uint64_t)s->jobCount;
+    s->batches++;
+    if((uint64_t)s->jobCount > s->maxBatch) s->maxBatch = (uint64_t)s->jobCount;
+
+    static const char failed[] = "err render failed\n";
+    for(int i = 0; i < s->requestCount; i++){
+        Request *r = &s->requests[i];
+        if(r->sent) continue;
+        Client *c = &s->clients[r->client];
+        if(r->job < 0) client_append(c, r->data, r->size);
+        else if(s->jobs[r->job].reply) client_append(c, s->jobs[r->job].reply, s->jobs[r->job].size);
+        else client_append(c, failed, sizeof(failed) - 1);
+        c->waiting = false;
+    }
+    // Cached only now: putting may evict entries the replies above pointed at.
+    for(int j = 0; j < s->jobCount; j++){
+        if(s->jobs[j].reply) image_cache_put(&s->cache, &s->jobs[j].key, s->jobs[j].reply, s->jobs[j].size);
+    }
+    for(int i = 0; i < s->clientCount; i++) client_flush(&s->clients[i]);
+}
+
+static void drop_closed_clients(Server *s){
+    int kept = 0;
+    for(int i = 0; i < s->clientCount; i++){
+        Client *c = &s->clients[i];
+        if(c->closed){
+            close(c->fd);
+            free(c->out);
+            continue;
+        }
+        s->clients[kept++] = *c;
+    }
+    s->clientCount = kept;
+}
+
+static void accept_clients(Server *s, int listener){
+    for(;;){
+        int fd = accept(listener, NULL, NULL);
+        if(fd < 0) return;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if(!reserve((void**)&s->clients, &s->clientCapacity, s->clientCount + 1, sizeof(Client))){
+            close(fd);
+            return;
+        }
+        Client *c = &s->clients[s->clientCount++];
+        memset(c, 0, sizeof(*c));
+        c->fd = fd;
+    }
+}
+
+static int open_listener(const char *path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "serve: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Replace a stale socket from an earlier run, but never a regular file.
+    struct stat st;
+    if(lstat(path, &st) == 0){
+        if(!S_ISSOCK(st.st_mode)){
+            fprintf(stderr, "serve: %s exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0){
+        fprintf(stderr, "serve: cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static int run_server(Server *s, const char *path){
+    int listener = open_listener(path);
+    if(listener < 0) return 1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    printf("serve: listening on %s (%d compounds, %d threads, %zu MB cache)\n",
+           path, s->lib.count, thread_pool_size(), s->cache.maxBytes >> 20);
+    fflush(stdout);
+
+    struct pollfd *fds = NULL;
+    int fdCapacity = 0;
+    while(!stopRequested){
+        if(!reserve((void**)&fds, &fdCapacity, s->clientCount + 2, sizeof(struct pollfd))) break;
+        fds[0] = (struct pollfd){ listener, POLLIN, 0 };
+        for(int i = 0; i < s->clientCount; i++){
+            Client *c = &s->clients[i];
+            short events = !c->hangup && c->outLen - c->outSent < SERVER_BACKLOG_LIMIT ? POLLIN : 0;
+            if(c->outSent < c->outLen) events |= POLLOUT;
+            fds[i + 1] = (struct pollfd){ c->fd, events, 0 };
+        }
+        int polled = s->clientCount;
+        fds[polled + 1] = (struct pollfd){ s->watch.fd, POLLIN, 0 }; // ignored while -1
+        if(poll(fds, (nfds_t)polled + 2, -1) < 0){
+            if(errno == EINTR) continue;
+            break;
+        }
+
+        if((fds[polled + 1].revents & POLLIN) && file_watch_changed(&s->watch)) reload_library(s);
+        s->requestCount = 0;
+        s->jobCount = 0;
+        for(int i = 0; i < polled; i++){
+            if(fds[i + 1].revents & POLLOUT) client_flush(&s->clients[i]);
+            if(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) read_client(s, i);
+        }
+        if(fds[0].revents & POLLIN) accept_clients(s, listener);
+        answer_requests(s);
+        drop_closed_clients(s);
+    }
+    free(fds);
+    for(int i = 0; i < s->clientCount; i++) s->clients[i].closed = true;
+    drop_closed_clients(s);
+    close(listener);
+    unlink(path);
+    printf("serve: %llu hits, %llu misses, %llu rendered in %llu batches (largest %llu)\n",
+           (unsigned long long)s->cache.hits, (unsigned long long)s->cache.misses,
+           (unsigned long long)s->rendered, (unsigned long long)s->batches, (unsigned long long)s->maxBatch);
+    return 0;
+}
+
+static void print_server_usage(void){
+    fprintf(stderr,
+            "usage: pk_rk4 serve --socket PATH [--library FILE.xyz [--watch]] [--cache-mb N]\n"
+            "Requests, one per line:\n"
+            "  render COMPOUND SIZE|WxH YAW PITCH ZOOM ball|wire|dots|surface\n"
+            "  stats\n"
+            "Replies: \"ok BYTES\\n\" then BYTES of PNG or text, or \"err MESSAGE\\n\".\n");
+}
+
+int server_main(int argc, char **argv){
+    const char *socketPath = NULL;
+    const char *libraryPath = NULL;
+    bool watch = false;
+    int cacheMb = 256;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc) socketPath = argv[++i];
+        else if(strcmp(argv[i], "--library") == 0 && i + 1 < argc) libraryPath = argv[++i];
+        else if(strcmp(argv[i], "--watch") == 0) watch = true;
+        else if(strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) cacheMb = atoi(argv[++i]);
+        else {
+            print_server_usage();
+            return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+    if(!socketPath || cacheMb < 0 || (watch && !libraryPath)){
+        print_server_usage();
+        return 2;
+    }
+
+    static Server server;
+    memset(&server, 0, sizeof(server));
+    library_init(&server.lib);
+    server.watch.fd = -1;
+    char error[256] = "out of memory";
+    bool loaded;
+    if(watch){
+        loaded = library_source_load(&server.source, &server.lib, libraryPath, error, sizeof(error));
+        if(loaded && !file_watch_open(&server.watch, libraryPath)){
+            snprintf(error, sizeof(error), "cannot watch %s", libraryPath);
+            loaded = false;
+        }
+    } else {
+        loaded = libraryPath ? library_load_xyz(&server.lib, libraryPath, error, sizeof(error))
+                             : library_add_builtin(&server.lib);
+    }
+    int status = 1;
+    if(loaded){
+        image_cache_init(&server.cache, (size_t)cacheMb << 20);
+        status = run_server(&server, socketPath);
+        image_cache_free(&server.cache);
+    } else {
+        fprintf(stderr, "serve: %s\n", error);
+    }
+
+    for(int i = 0; server.sasa && i < server.lib.count; i++) free(server.sasa[i]);
+    free(server.sasa);
+    for(int i = 0; server.surface && i < server.lib.count; i++) surface_cache_free(&server.surface[i]);
+    free(server.surface);
+    free(server.clients);
+    free(server.requests);
+    free(server.jobs);
+    file_watch_close(&server.watch);
+    library_source_free(&server.source);
+    library_free(&server.lib);
+    thread_pool_shutdown();
+    return status;
+}
@@ -0,0 +1,28 @@
+#ifndef ATLAS_SERVER_H
+#define ATLAS_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "image_cache.h"
+
+// `pk_rk4 serve`: a long-running render service on a Unix domain socket.
+// The compound library stays loaded, and clients send one request per line:
+//
+//   render COMPOUND SIZE|WxH YAW PITCH ZOOM ball|wire|dots|surface
+//   stats
+//
+// Each request is answered in order with "ok BYTES\n" followed by BYTES of
+// payload (a PNG for render, text for stats), or "err MESSAGE\n". Requests
+// that arrive together are answered from the image cache first. The
+// misses are deduplicated and rendered as one batch across the worker
+// pool. argv[0] is "serve"; returns a process exit code.
+int server_main(int argc, char **argv);
+
+// Parses and checks a render request line for a library of compoundCount
+// compounds. On a bad request returns false with the reason to send back
+// in error. Angles must be finite and zoom within the viewer's range, since
+// the cost of drawing grows with the zoom.
+bool render_request_parse(const char *line, int compoundCount, RenderKey *key, char *error, size_t errorSize);
+
+#endif
@@ -0,0 +1,316 @@
+#include "store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "forcefield.h"
+#include "presets.h"
+
+static const char STORE_MAGIC[8] = "PKSTORE";
+static const char SNAPSHOT_MAGIC[8] = "PKSNAP";
+
+struct StoreControl {
+    char magic[8];
+    uint32_t layout, entrySize;
+    _Atomic uint64_t generation; // 0 until the first publish
+    uint64_t stamp;              // of the source the generation was built from; written under the lock
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t layout, entrySize;
+    uint64_t generation;
+    int64_t count;
+} SnapshotHeader;
+
+// Entries start on a page of their own.
+#define SNAPSHOT_HEADER 4096
+
+static uint64_t hash_mix(uint64_t h, const void *data, size_t size){
+    const unsigned char *p = data;
+    for(size_t i = 0; i < size; i++){
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+bool library_store_stamp(const char *path, uint64_t *stamp){
+    uint64_t h = 0xcbf29ce484222325ull;
+    if(!path){
+        int version = FF_RELAX_VERSION;
+        h = hash_mix(h, &version, sizeof(version));
+        for(int i = 0; i < COMPOUND_COUNT; i++){
+            MoleculeGeometry mol;
+            memset(&mol, 0, sizeof(mol));
+            apply_preset(&mol, compounds[i].presetType);
+            h = hash_mix(h, &mol, sizeof(mol));
+        }
+        *stamp = h;
+        return true;
+    }
+    struct stat st;
+    if(stat(path, &st) != 0) return false;
+    h = hash_mix(h, &st.st_dev, sizeof(st.st_dev));
+    h = hash_mix(h, &st.st_ino, sizeof(st.st_ino));
+    h = hash_mix(h, &st.st_size, sizeof(st.st_size));
+    h = hash_mix(h, &st.st_mtim, sizeof(st.st_mtim));
+    *stamp = h;
+    return true;
+}
+
+static void snapshot_name(const LibraryStore *store, uint64_t generation, char *name, size_t size){
+    snprintf(name, size, "%s-%llu", store->name, (unsigned long long)generation);
+}
+
+// Another user could create a segment under our name first, or a shared
+// one could be written by others.
+static bool trusted(int fd, const char *name, char *error, size_t errorSize){
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        snprintf(error, errorSize, "%s: %s", name, strerror(errno));
+        return false;
+    }
+    if(st.st_uid != geteuid() || (st.st_mode & 022) != 0){
+        snprintf(error, errorSize, "%s is not owned by this user alone; not trusting it", name);
+        return false;
+    }
+    return true;
+}
+
+static void lock(int fd, int how){
+    while(flock(fd, how) != 0 && errno == EINTR){}
+}
+
+static bool publish_locked(LibraryStore *store, const Library *lib, uint64_t stamp, char *error, size_t errorSize){
+    uint64_t previous = atomic_load(&store->control->generation);
+    uint64_t next = previous + 1;
+    char name[96];
+    snapshot_name(store, next, name, sizeof(name));
+    shm_unlink(name); // left by a publisher that died before switching to it
+
+    size_t size = SNAPSHOT_HEADER + (size_t)lib->count * sizeof(LibraryEntry);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0){
+        snprintf(error, errorSize, "cannot create %s: %s", name, strerror(errno));
+        return false;
+    }
+    // Allocated up front: a full /dev/shm fails here instead of faulting
+    // in the copy below.
+    int err = posix_fallocate(fd, 0, (off_t)size);
+    void *map = err == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if(map == MAP_FAILED){
+        snprintf(error, errorSize, "cannot allocate %zu bytes for %s: %s", size, name, strerror(err ? err : errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    SnapshotHeader *header = map;
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->layout = STORE_LAYOUT_VERSION;
+    header->entrySize = sizeof(LibraryEntry);
+    header->generation = next;
+    header->count = lib->count;
+    if(lib->count > 0) memcpy((char *)map + SNAPSHOT_HEADER, lib->entries, (size_t)lib->count * sizeof(LibraryEntry));
+    munmap(map, size);
+    fchmod(fd, 0400); // nobody writes a published snapshot
+    close(fd);
+
+    store->control->stamp = stamp;
+    atomic_store(&store->control->generation, next);
+    if(previous){
+        snapshot_name(store, previous, name, sizeof(name));
+        shm_unlink(name);
+    }
+    return true;
+}
+
+// Maps the control segment, initializing it if this is the first process,
+// and publishes unless an up-to-date generation exists. Runs under the lock.
+static bool open_locked(LibraryStore *store, const Library *loaded, uint64_t loadedStamp, char *error, size_t errorSize){
+    struct stat st;
+    if(!trusted(store->fd, store->name, error, errorSize)) return false;
+    if(fstat(store->fd, &st) != 0){
+        snprintf(error, errorSize, "%s: %s", store->name, strerror(errno));
+        return false;
+    }
+    if(st.st_size < (off_t)sizeof(StoreControl) && ftruncate(store->fd, sizeof(StoreControl)) != 0){
+        snprintf(error, errorSize, "cannot initialize %s", store->name);
+        return false;
+    }
+    void *map = mmap(NULL, sizeof(StoreControl), PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if(map == MAP_FAILED){
+        snprintf(error, errorSize, "cannot map %s: %s", store->name, strerror(errno));
+        return false;
+    }
+    store->control = map;
+    // Still zero if its creator died before getting here.
+    if(store->control->magic[0] == '\0'){
+        memcpy(store->control->magic, STORE_MAGIC, sizeof(store->control->magic));
+        store->control->layout = STORE_LAYOUT_VERSION;
+        store->control->entrySize = sizeof(LibraryEntry);
+    }
+    if(memcmp(store->control->magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 ||
+       store->control->layout != STORE_LAYOUT_VERSION || store->control->entrySize != sizeof(LibraryEntry)){
+        snprintf(error, errorSize, "%s has an incompatible layout", store->name);
+        return false;
+    }
+
+    // Taken before parsing, so a file edited meanwhile is not published
+    // under its new stamp.
+    uint64_t stamp;
+    if(!library_store_stamp(store->path, &stamp)){
+        snprintf(error, errorSize, "%s: %s", store->path, strerror(errno));
+        return false;
+    }
+    if(atomic_load(&store->control->generation) != 0 && store->control->stamp == stamp) return true;
+    if(loaded) return store->built = publish_locked(store, loaded, loadedStamp, error, errorSize);
+
+    Library lib;
+    library_init(&lib);
+    bool ok = store->path ? library_load_xyz(&lib, store->path, error, errorSize) : library_add_builtin(&lib);
+    if(!ok && !store->path) snprintf(error, errorSize, "out of memory");
+    if(ok && lib.count == 0){
+        snprintf(error, errorSize, "%s has no compounds", store->path);
+        ok = false;
+    }
+    store->built = ok && publish_locked(store, &lib, stamp, error, errorSize);
+    library_free(&lib);
+    return store->built;
+}
+
+bool library_store_open(LibraryStore *store, const char *path, const Library *loaded, uint64_t loadedStamp,
+                        char *error, size_t errorSize){
+    memset(store, 0, sizeof(*store));
+    store->fd = -1;
+    uint64_t key = 0xcbf29ce484222325ull;
+    if(path){
+        char full[PATH_MAX];
+        if(!realpath(path, full)){
+            snprintf(error, errorSize, "%s: %s", path, strerror(errno));
+            return false;
+        }
+        store->path = strdup(full);
+        if(!store->path){
+            snprintf(error, errorSize, "out of memory");
+            return false;
+        }
+        key = hash_mix(key, full, strlen(full));
+    } else {
+        key = hash_mix(key, "builtin", 7);
+    }
+    snprintf(store->name, sizeof(store->name), "/pk_rk4-%d-%u-%016llx", STORE_LAYOUT_VERSION,
+             (unsigned)geteuid(), (unsigned long long)key);
+
+    store->fd = shm_open(store->name, O_RDWR | O_CREAT, 0600);
+    if(store->fd < 0){
+        snprintf(error, errorSize, "cannot open %s: %s", store->name, strerror(errno));
+        library_store_close(store);
+        return false;
+    }
+    // Held while publishing, so processes opening the same library at
+    // once wait for the first one instead of all parsing it.
+    lock(store->fd, LOCK_EX);
+    bool ok = open_locked(store, loaded, loadedStamp, error, errorSize);
+    lock(store->fd, LOCK_UN);
+    if(!ok) library_store_close(store);
+    return ok;
+}
+
+void library_store_close(LibraryStore *store){
+    if(store->control) munmap(store->control, sizeof(StoreControl));
+    if(store->fd >= 0) close(store->fd);
+    free(store->path);
+    store->control = NULL;
+    store->path = NULL;
+    store->fd = -1;
+}
+
+bool library_store_publish(LibraryStore *store, const Library *lib, uint64_t stamp, char *error, size_t errorSize){
+    lock(store->fd, LOCK_EX);
+    bool ok = publish_locked(store, lib, stamp, error, errorSize);
+    lock(store->fd, LOCK_UN);
+    return ok;
+}
+
+uint64_t library_store_generation(const LibraryStore *store){
+    return atomic_load_explicit(&store->control->generation, memory_order_acquire);
+}
+
+bool library_store_map(LibraryStore *store, LibrarySnapshot *snap, char *error, size_t errorSize){
+    memset(snap, 0, sizeof(*snap));
+    // A publish may unlink the generation just read; the next read sees
+    // its replacement.
+    for(int attempt = 0; attempt < 16; attempt++){
+        uint64_t generation = library_store_generation(store);
+        if(generation == 0){
+            snprintf(error, errorSize, "%s has nothing published", store->name);
+            return false;
+        }
+        char name[96];
+        snapshot_name(store, generation, name, sizeof(name));
+        int fd = shm_open(name, O_RDONLY, 0);
+        if(fd < 0 && errno == ENOENT && library_store_generation(store) != generation) continue;
+        if(fd < 0){
+            snprintf(error, errorSize, "cannot open %s: %s", name, strerror(errno));
+            return false;
+        }
+        if(!trusted(fd, name, error, errorSize)){
+            close(fd);
+            return false;
+        }
+        struct stat st;
+        void *map = MAP_FAILED;
+        if(fstat(fd, &st) == 0 && st.st_size >= SNAPSHOT_HEADER){
+            map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if(map == MAP_FAILED){
+            snprintf(error, errorSize, "cannot map %s", name);
+            return false;
+        }
+        const SnapshotHeader *header = map;
+        if(memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+           header->layout != STORE_LAYOUT_VERSION || header->entrySize != sizeof(LibraryEntry) ||
+           header->generation != generation || header->count < 0 || header->count > INT_MAX ||
+           (uint64_t)header->count > ((uint64_t)st.st_size - SNAPSHOT_HEADER) / sizeof(LibraryEntry)){
+            munmap(map, (size_t)st.st_size);
+            snprintf(error, errorSize, "%s is not a snapshot of this layout", name);
+            return false;
+        }
+        snap->generation = generation;
+        snap->map = map;
+        snap->size = (size_t)st.st_size;
+        snap->lib.entries = (LibraryEntry *)((char *)map + SNAPSHOT_HEADER);
+        snap->lib.count = (int)header->count;
+        return true;
+    }
+    snprintf(error, errorSize, "%s is being republished too often to map", store->name);
+    return false;
+}
+
+void library_snapshot_unmap(LibrarySnapshot *snap){
+    if(snap->map) munmap(snap->map, snap->size);
+    memset(snap, 0, sizeof(*snap));
+}
+
+void library_store_remove(LibraryStore *store){
+    lock(store->fd, LOCK_EX);
+    uint64_t generation = atomic_load(&store->control->generation);
+    if(generation){
+        char name[96];
+        snapshot_name(store, generation, name, sizeof(name));
+        shm_unlink(name);
+    }
+    shm_unlink(store->name);
+    lock(store->fd, LOCK_UN);
+}
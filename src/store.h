@@ -0,0 +1,74 @@
+#ifndef ATLAS_STORE_H
+#define ATLAS_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "library.h"
+
+// Compound libraries shared between processes through POSIX shared memory.
+// The first process to open a library publishes its entries as a
+// read-only snapshot segment; later ones map that segment, so every viewer
+// of the same library shares one set of physical pages and skips the
+// parse. A small control segment holds the current generation. Publishing
+// again writes a new snapshot, bumps the generation and unlinks the old
+// one, which stays valid for processes that still map it until they unmap.
+//
+// Segments are named after the layout version, the user and the library's
+// real path (or "builtin"), so builds with a different LibraryEntry never
+// meet. Entries are used as they are, without bounds checks, so only
+// segments owned by this user and writable by nobody else are trusted.
+
+#define STORE_LAYOUT_VERSION 1
+
+typedef struct StoreControl StoreControl;
+
+typedef struct {
+    char name[64];     // control segment; snapshots append "-GENERATION"
+    char *path;        // real path of the library, NULL for the built-in compounds
+    int fd;            // control segment, also the lock serializing publishers
+    StoreControl *control;
+    bool built;        // this open parsed the library and published it
+} LibraryStore;
+
+typedef struct {
+    uint64_t generation; // 0 when nothing is mapped
+    void *map;
+    size_t size;
+    Library lib;         // read-only view into map; never library_free() it
+} LibrarySnapshot;
+
+// Identifies the version of a library file (its identity, size and
+// modification time), or of the built-in compounds and the force field
+// relaxing them when path is NULL. Take it before parsing: a file edited
+// during the parse is then published under the older stamp and parsed
+// again by the next open, rather than passed off as current.
+bool library_store_stamp(const char *path, uint64_t *stamp);
+
+// Opens the store for a library file, or for the force-field relaxed
+// built-in compounds when path is NULL. If nothing is published yet, or the
+// file changed since it was, the library is published first: loaded (the
+// caller's copy of the same file when it passes one, parsed after taking
+// loadedStamp) while other processes opening it wait.
+bool library_store_open(LibraryStore *store, const char *path, const Library *loaded, uint64_t loadedStamp,
+                        char *error, size_t errorSize);
+void library_store_close(LibraryStore *store);
+
+// Publishes lib, parsed after taking stamp, as the next generation.
+bool library_store_publish(LibraryStore *store, const Library *lib, uint64_t stamp, char *error, size_t errorSize);
+
+// The generation last published, without locking; cheap enough to poll
+// every frame.
+uint64_t library_store_generation(const LibraryStore *store);
+
+// Maps the latest snapshot. Pages are shared with every other process
+// mapping it and read in as they are touched.
+bool library_store_map(LibraryStore *store, LibrarySnapshot *snap, char *error, size_t errorSize);
+void library_snapshot_unmap(LibrarySnapshot *snap);
+
+// Unlinks the store's segments so the next open publishes afresh. Existing
+// mappings stay valid.
+void library_store_remove(LibraryStore *store);
+
+#endif
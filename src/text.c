@@ -0,0 +1,119 @@
+#include "text.h"
+#include "profiler.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define GLYPH_FIRST 32
+#define GLYPH_COUNT 95
+#define ATLAS_COLS 16
+#define ATLAS_ROWS 6
+#define ATLAS_WIDTH (ATLAS_COLS * GLYPH_ADVANCE)
+#define ATLAS_HEIGHT (ATLAS_ROWS * (GLYPH_HEIGHT + 1))
+
+// Classic 5x7 font, one byte per column, bit 0 at the top.
+static const uint8_t font5x7[GLYPH_COUNT][GLYPH_WIDTH] = {
+    {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, // space ! "
+    {0x14,0x7F,0x14,0x7F,0x14}, {0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, // # $ %
+    {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00}, {0x00,0x1C,0x22,0x41,0x00}, // & ' (
+    {0x00,0x41,0x22,0x1C,0x00}, {0x08,0x2A,0x1C,0x2A,0x08}, {0x08,0x08,0x3E,0x08,0x08}, // ) * +
+    {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, // , - .
+    {0x20,0x10,0x08,0x04,0x02}, {0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, // / 0 1
+    {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31}, {0x18,0x14,0x12,0x7F,0x10}, // 2 3 4
+    {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03}, // 5 6 7
+    {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E}, {0x00,0x36,0x36,0x00,0x00}, // 8 9 :
+    {0x00,0x56,0x36,0x00,0x00}, {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, // ; < =
+    {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06}, {0x32,0x49,0x79,0x41,0x3E}, // > ? @
+    {0x7E,0x11,0x11,0x11,0x7E}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22}, // A B C
+    {0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, // D E F
+    {0x3E,0x41,0x49,0x49,0x7A}, {0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, // G H I
+    {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41}, {0x7F,0x40,0x40,0x40,0x40}, // J K L
+    {0x7F,0x02,0x0C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E}, // M N O
+    {0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, // P Q R
+    {0x46,0x49,0x49,0x49,0x31}, {0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F}, // S T U
+    {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F}, {0x63,0x14,0x08,0x14,0x63}, // V W X
+    {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00}, // Y Z [
+    {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00}, {0x04,0x02,0x01,0x02,0x04}, // \ ] ^
+    {0x40,0x40,0x40,0x40,0x40}, {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, // _ ` a
+    {0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, {0x38,0x44,0x44,0x48,0x7F}, // b c d
+    {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E}, // e f g
+    {0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x44,0x3D,0x00}, // h i j
+    {0x7F,0x10,0x28,0x44,0x00}, {0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78}, // k l m
+    {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, {0x7C,0x14,0x14,0x14,0x08}, // n o p
+    {0x08,0x14,0x14,0x18,0x7C}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20}, // q r s
+    {0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, // t u v
+    {0x3C,0x40,0x30,0x40,0x3C}, {0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C}, // w x y
+    {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00}, {0x00,0x00,0x7F,0x00,0x00}, // z { |
+    {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08},                              // } ~
+};
+
+static uint8_t atlasMask[ATLAS_WIDTH * ATLAS_HEIGHT];
+static pthread_once_t atlasOnce = PTHREAD_ONCE_INIT;
+
+static void build_atlas_mask(void){
+    for(int g = 0; g < GLYPH_COUNT; g++){
+        int x0 = (g % ATLAS_COLS) * GLYPH_ADVANCE;
+        int y0 = (g / ATLAS_COLS) * (GLYPH_HEIGHT + 1);
+        for(int col = 0; col < GLYPH_WIDTH; col++){
+            for(int row = 0; row < GLYPH_HEIGHT; row++){
+                if(font5x7[g][col] & (1 << row)) atlasMask[(y0 + row) * ATLAS_WIDTH + x0 + col] = 255;
+            }
+        }
+    }
+}
+
+const uint8_t *glyph_atlas_mask(int *width, int *height){
+    pthread_once(&atlasOnce, build_atlas_mask);
+    *width = ATLAS_WIDTH;
+    *height = ATLAS_HEIGHT;
+    return atlasMask;
+}
+
+SDL_Texture *glyph_atlas_create(SDL_Renderer *renderer){
+    int w, h;
+    const uint8_t *mask = glyph_atlas_mask(&w, &h);
+    static uint32_t pixels[ATLAS_WIDTH * ATLAS_HEIGHT];
+    for(int i = 0; i < w * h; i++) pixels[i] = ((uint32_t)mask[i] << 24) | 0x00FFFFFF;
+
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                             ATLAS_WIDTH, ATLAS_HEIGHT);
+    if(!texture) return NULL;
+    SDL_UpdateTexture(texture, NULL, pixels, ATLAS_WIDTH * (int)sizeof(uint32_t));
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(texture, SDL_ScaleModeNearest);
+    return texture;
+}
+
+int text_width(const char *s, int scale){
+    int n = (int)strlen(s);
+    return n ? (n * GLYPH_ADVANCE - 1) * scale : 0;
+}
+
+void draw_text(CommandBuffer *cb, int x, int y, int scale, uint32_t rgba, const char *s){
+    int quads = 0;
+    for(const char *c = s; *c; c++) if(*c != ' ') quads++;
+    if(quads == 0) return;
+    SDL_Vertex *v = cmd_glyph_quads(cb, quads);
+    if(!v) return;
+
+    SDL_Color color = { (uint8_t)(rgba >> 24), (uint8_t)(rgba >> 16), (uint8_t)(rgba >> 8), (uint8_t)rgba };
+    float w = (float)(GLYPH_WIDTH * scale), h = (float)(GLYPH_HEIGHT * scale);
+    float px = (float)x;
+    for(const char *c = s; *c; c++, px += (float)(GLYPH_ADVANCE * scale)){
+        if(*c == ' ') continue;
+        int g = (*c > GLYPH_FIRST && *c < GLYPH_FIRST + GLYPH_COUNT) ? *c - GLYPH_FIRST : '?' - GLYPH_FIRST;
+        float u0 = (float)((g % ATLAS_COLS) * GLYPH_ADVANCE) / ATLAS_WIDTH;
+        float v0 = (float)((g / ATLAS_COLS) * (GLYPH_HEIGHT + 1)) / ATLAS_HEIGHT;
+        float u1 = u0 + (float)GLYPH_WIDTH / ATLAS_WIDTH;
+        float v1 = v0 + (float)GLYPH_HEIGHT / ATLAS_HEIGHT;
+
+        SDL_Vertex tl = { { px, (float)y }, color, { u0, v0 } };
+        SDL_Vertex tr = { { px + w, (float)y }, color, { u1, v0 } };
+        SDL_Vertex bl = { { px, (float)y + h }, color, { u0, v1 } };
+        SDL_Vertex br = { { px + w, (float)y + h }, color, { u1, v1 } };
+        v[0] = tl; v[1] = tr; v[2] = bl;
+        v[3] = tr; v[4] = br; v[5] = bl;
+        v += 6;
+    }
+    PROF_COUNT(PROF_PIXELS, quads * GLYPH_WIDTH * GLYPH_HEIGHT * scale * scale);
+}
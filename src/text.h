@@ -0,0 +1,30 @@
+#ifndef ATLAS_TEXT_H
+#define ATLAS_TEXT_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+#include "cmdbuf.h"
+
+// Bitmap text: printable ASCII in a 5x7 font, rasterized once into a small
+// texture. Strings are recorded as textured quads, and consecutive strings
+// share one SDL_RenderGeometry call whatever their colour.
+
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define GLYPH_ADVANCE (GLYPH_WIDTH + 1)
+
+// White glyphs on transparent, nearest-filtered. Render thread only; pass
+// it to command_buffer_submit() through SubmitResources.glyphs.
+SDL_Texture *glyph_atlas_create(SDL_Renderer *renderer);
+// The same atlas as one coverage byte per texel, for CPU rasterization.
+const uint8_t *glyph_atlas_mask(int *width, int *height);
+
+// Width in pixels of s drawn at an integer scale, without trailing spacing.
+int text_width(const char *s, int scale);
+
+// Records s with its top-left corner at (x, y). Characters outside
+// printable ASCII draw as '?'.
+void draw_text(CommandBuffer *cb, int x, int y, int scale, uint32_t rgba, const char *s);
+
+#endif
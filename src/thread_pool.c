@@ -0,0 +1,197 @@
+#include "thread_pool.h"
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_POOL_THREADS 64
+
+typedef struct {
+    ParallelForFn fn;
+    void *ctx;
+    int count;
+    int grain;
+    atomic_int next;
+    atomic_int remaining;
+} PoolJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t finished;
+    pthread_t threads[MAX_POOL_THREADS];
+    int threadCount;
+    PoolJob *job;
+    int busyWorkers;
+    unsigned generation;
+    bool stopping;
+    bool started;
+} ThreadPool;
+
+static ThreadPool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .finished = PTHREAD_COND_INITIALIZER,
+};
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static _Thread_local bool insidePool = false;
+
+static void run_chunks(PoolJob *job){
+    PROF_SCOPE("pool_chunks");
+    for(;;){
+        int begin = atomic_fetch_add(&job->next, job->grain);
+        if(begin >= job->count) break;
+        int end = begin + job->grain;
+        if(end > job->count) end = job->count;
+
+        job->fn(job->ctx, begin, end);
+
+        if(atomic_fetch_sub(&job->remaining, end - begin) == end - begin){
+            pthread_mutex_lock(&pool.lock);
+            pthread_cond_broadcast(&pool.finished);
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+}
+
+static void *worker_main(void *arg){
+    (void)arg;
+    insidePool = true;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for(;;){
+        while(!pool.stopping && (pool.job == NULL || pool.generation == seen)){
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        if(pool.stopping) break;
+
+        seen = pool.generation;
+        PoolJob *job = pool.job;
+        pool.busyWorkers++;
+        pthread_mutex_unlock(&pool.lock);
+        run_chunks(job);
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.busyWorkers == 0) pthread_cond_broadcast(&pool.finished);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void pool_start(void){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("ATLAS_THREADS");
+    if(env && atoi(env) > 0) cpus = atoi(env);
+    if(cpus < 1) cpus = 1;
+    if(cpus > MAX_POOL_THREADS) cpus = MAX_POOL_THREADS;
+
+    for(int i = 0; i < (int)cpus - 1; i++){
+        if(pthread_create(&pool.threads[pool.threadCount], NULL, worker_main, NULL) != 0) break;
+        pool.threadCount++;
+    }
+    pool.started = true;
+}
+
+int thread_pool_size(void){
+    pthread_once(&poolOnce, pool_start);
+    return pool.threadCount + 1;
+}
+
+void parallel_for(int count, int grain, ParallelForFn fn, void *ctx){
+    if(count <= 0) return;
+    if(grain < 1) grain = 1;
+
+    PROF_SCOPE("parallel_for");
+    pthread_once(&poolOnce, pool_start);
+    if(insidePool || pool.threadCount == 0 || count <= grain){
+        fn(ctx, 0, count);
+        return;
+    }
+
+    PoolJob job = { .fn = fn, .ctx = ctx, .count = count, .grain = grain };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.remaining, count);
+
+    // One job in flight at a time. A caller arriving while another thread's
+    // job runs does its own range instead of waiting, so a long background
+    // job never stalls the frame loop.
+    pthread_mutex_lock(&pool.lock);
+    if(pool.job != NULL){
+        pthread_mutex_unlock(&pool.lock);
+        fn(ctx, 0, count);
+        return;
+    }
+    pool.job = &job;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    insidePool = true;
+    run_chunks(&job);
+    insidePool = false;
+
+    pthread_mutex_lock(&pool.lock);
+    // The job lives on this stack frame, so also wait for stragglers that
+    // picked it up but found no chunks left.
+    while(atomic_load(&job.remaining) > 0 || pool.busyWorkers > 0){
+        pthread_cond_wait(&pool.finished, &pool.lock);
+    }
+    pool.job = NULL;
+    pthread_cond_broadcast(&pool.finished);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void thread_pool_shutdown(void){
+    if(!pool.started) return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for(int i = 0; i < pool.threadCount; i++) pthread_join(pool.threads[i], NULL);
+    pool.threadCount = 0;
+}
+
+
+struct BackgroundTask {
+    pthread_t thread;
+    BackgroundFn fn;
+    void *ctx;
+    atomic_bool done;
+};
+
+static void *background_main(void *arg){
+    BackgroundTask *task = arg;
+    task->fn(task->ctx);
+    atomic_store(&task->done, true);
+    return NULL;
+}
+
+BackgroundTask *background_task_start(BackgroundFn fn, void *ctx){
+    BackgroundTask *task = calloc(1, sizeof(*task));
+    if(!task) return NULL;
+    task->fn = fn;
+    task->ctx = ctx;
+    atomic_init(&task->done, false);
+
+    if(pthread_create(&task->thread, NULL, background_main, task) != 0){
+        // No thread available: do the work inline so callers still see it done.
+        fn(ctx);
+        atomic_store(&task->done, true);
+        task->thread = pthread_self();
+    }
+    return task;
+}
+
+bool background_task_done(const BackgroundTask *task){
+    return task == NULL || atomic_load(&((BackgroundTask*)task)->done);
+}
+
+void background_task_join(BackgroundTask *task){
+    if(!task) return;
+    if(!pthread_equal(task->thread, pthread_self())) pthread_join(task->thread, NULL);
+    free(task);
+}
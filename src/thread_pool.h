@@ -0,0 +1,32 @@
+#ifndef ATLAS_THREAD_POOL_H
+#define ATLAS_THREAD_POOL_H
+
+#include <stdbool.h>
+
+// Work callback for parallel_for: processes items [begin, end).
+typedef void (*ParallelForFn)(void *ctx, int begin, int end);
+
+// Runs fn over [0, count) in chunks of `grain` items on the shared worker
+// pool. The calling thread participates and the call returns when every
+// chunk has finished. Nested calls from inside a worker run serially.
+// The pool takes one job at a time: a call made while another thread's job
+// is in flight runs its whole range on the calling thread instead of
+// waiting for the pool.
+void parallel_for(int count, int grain, ParallelForFn fn, void *ctx);
+
+// Number of threads parallel_for spreads work across (workers + caller).
+int thread_pool_size(void);
+
+void thread_pool_shutdown(void);
+
+typedef void (*BackgroundFn)(void *ctx);
+
+typedef struct BackgroundTask BackgroundTask;
+
+// Runs fn(ctx) on a dedicated thread. Poll background_task_done() from the
+// frame loop and call background_task_join() once it reports true.
+BackgroundTask *background_task_start(BackgroundFn fn, void *ctx);
+bool background_task_done(const BackgroundTask *task);
+void background_task_join(BackgroundTask *task);
+
+#endif
@@ -0,0 +1,268 @@
+#include "thumbnails.h"
+#include "export.h"
+#include "isosurface.h"
+#include "library.h"
+#include "profiler.h"
+#include "raster.h"
+#include "render.h"
+#include "sasa.h"
+#include "thread_pool.h"
+
+#include <SDL2/SDL.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define THUMB_MAX_SIZES 8
+#define THUMB_MAX_SHEET_SIDE 16384 // pixels; a full sheet is then at most 1 GiB
+#define THUMB_BACKGROUND 0xFF0A0A0Eu
+
+typedef struct {
+    const char *outDir;
+    const char *libraryPath;
+    int sizes[THUMB_MAX_SIZES];
+    int sizeCount;
+    int views;
+    float pitch;
+    RenderMode mode;
+    int cols, rows; // cells per sheet
+} ThumbOptions;
+
+// One sheet per size for the compounds [first, first + count).
+typedef struct {
+    const ThumbOptions *opt;
+    const Library *lib;
+    int first, count;
+    uint32_t *sheets[THUMB_MAX_SIZES];
+} ThumbBatch;
+
+static void print_thumbnails_usage(void){
+    fprintf(stderr,
+            "usage: pk_rk4 thumbnails --out DIR [--library FILE.xyz] [--size N[,N...]] [--views N]\n"
+            "                         [--pitch RADIANS] [--mode ball|wire|dots|surface] [--sheet COLSxROWS]\n"
+            "Renders each compound at --views evenly spaced yaw angles (default 8) per size\n"
+            "(default 128) into DIR/sheet_<size>_<n>.png (default 16x16 cells) and DIR/index.csv.\n");
+}
+
+static bool parse_sizes(const char *list, ThumbOptions *opt){
+    opt->sizeCount = 0;
+    const char *p = list;
+    while(*p){
+        char *end;
+        long v = strtol(p, &end, 10);
+        if(end == p || v < 16 || v > 2048 || opt->sizeCount == THUMB_MAX_SIZES) return false;
+        opt->sizes[opt->sizeCount++] = (int)v;
+        if(*end == ',') end++;
+        else if(*end != '\0') return false;
+        p = end;
+    }
+    return opt->sizeCount > 0;
+}
+
+static bool parse_thumbnail_options(int argc, char **argv, ThumbOptions *opt){
+    memset(opt, 0, sizeof(*opt));
+    opt->sizes[0] = 128;
+    opt->sizeCount = 1;
+    opt->views = 8;
+    opt->pitch = 0.35f;
+    opt->mode = RENDER_BALL_AND_STICK;
+    opt->cols = opt->rows = 16;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) opt->outDir = argv[++i];
+        else if(strcmp(argv[i], "--library") == 0 && i + 1 < argc) opt->libraryPath = argv[++i];
+        else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc){
+            if(!parse_sizes(argv[++i], opt)) return false;
+        }
+        else if(strcmp(argv[i], "--views") == 0 && i + 1 < argc) opt->views = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pitch") == 0 && i + 1 < argc) opt->pitch = (float)atof(argv[++i]);
+        else if(strcmp(argv[i], "--mode") == 0 && i + 1 < argc){
+            if(!render_mode_parse(argv[++i], &opt->mode)) return false;
+        }
+        else if(strcmp(argv[i], "--sheet") == 0 && i + 1 < argc){
+            if(sscanf(argv[++i], "%dx%d", &opt->cols, &opt->rows) != 2) return false;
+        }
+        else return false;
+    }
+    if(!opt->outDir || opt->views < 1 || opt->cols < 1 || opt->rows < 1) return false;
+    for(int k = 0; k < opt->sizeCount; k++){
+        long long w = (long long)opt->cols * opt->sizes[k], h = (long long)opt->rows * opt->sizes[k];
+        if(w > THUMB_MAX_SHEET_SIDE || h > THUMB_MAX_SHEET_SIDE){
+            fprintf(stderr, "thumbnails: a %dx%d sheet of %d px cells is %lldx%lld pixels, over the %d limit\n",
+                    opt->cols, opt->rows, opt->sizes[k], w, h, THUMB_MAX_SHEET_SIDE);
+            return false;
+        }
+    }
+    // A compound's views never straddle two sheets.
+    return opt->views <= opt->cols * opt->rows;
+}
+
+static void render_batch(void *ctx, int begin, int end){
+    ThumbBatch *batch = ctx;
+    const ThumbOptions *opt = batch->opt;
+    CommandBuffer cb;
+    command_buffer_init(&cb);
+    SasaCache *sasa = opt->mode == RENDER_DOTS ? malloc(sizeof(SasaCache)) : NULL;
+    SurfaceCache mesh;
+    surface_cache_init(&mesh);
+
+    for(int i = begin; i < end; i++){
+        int index = batch->first + i;
+        Compound compound = library_compound(batch->lib, index);
+        const MoleculeGeometry *mol = &batch->lib->entries[index].mol;
+        if(sasa){
+            sasa_cache_init(sasa);
+            sasa_update(sasa, mol);
+        }
+        if(opt->mode == RENDER_SURFACE) surface_cache_update(&mesh, mol);
+
+        for(int v = 0; v < opt->views; v++){
+            ViewControl view;
+            reset_view_control(&view);
+            view.yaw = 2.0f * PI * (float)v / (float)opt->views;
+            view.pitch = opt->pitch;
+            int cell = i * opt->views + v;
+            int col = cell % opt->cols, row = cell / opt->cols;
+
+            for(int k = 0; k < opt->sizeCount; k++){
+                int size = opt->sizes[k];
+                TileQuality quality = tile_quality_for_size(size, size);
+                Canvas canvas = { batch->sheets[k] + (size_t)row * size * opt->cols * size + (size_t)col * size,
+                                  size, size, opt->cols * size };
+                RectI rect = { 0, 0, size, size };
+                command_buffer_reset(&cb);
+                build_molecule(&cb, &compound, mol, &rect, false, opt->mode, sasa, &mesh,
+                               0.0f, &view, false, &quality);
+                command_buffer_rasterize(&cb, &canvas);
+            }
+        }
+    }
+    surface_cache_free(&mesh);
+    free(sasa);
+    command_buffer_free(&cb);
+}
+
+// Names go in quotes when they hold a comma or quote.
+static void write_csv_name(FILE *f, const char *name){
+    if(!strpbrk(name, ",\"")){
+        fputs(name, f);
+        return;
+    }
+    fputc('"', f);
+    for(const char *p = name; *p; p++){
+        if(*p == '"') fputc('"', f);
+        fputc(*p, f);
+    }
+    fputc('"', f);
+}
+
+static bool write_sheet(const char *dir, int size, int sheet, const uint32_t *pixels, int w, int h){
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/sheet_%d_%04d.png", dir, size, sheet);
+    FILE *f = fopen(path, "wb");
+    if(!f) return false;
+    bool ok = png_write(f, pixels, w, h);
+    return fclose(f) == 0 && ok;
+}
+
+static int run_thumbnails(const ThumbOptions *opt, const Library *lib){
+    if(mkdir(opt->outDir, 0777) != 0 && errno != EEXIST){
+        fprintf(stderr, "thumbnails: cannot create %s\n", opt->outDir);
+        return 1;
+    }
+    char indexPath[4096];
+    snprintf(indexPath, sizeof(indexPath), "%s/index.csv", opt->outDir);
+    FILE *index = fopen(indexPath, "w");
+    if(!index){
+        fprintf(stderr, "thumbnails: cannot write %s\n", indexPath);
+        return 1;
+    }
+    fprintf(index, "compound,name,size,view,yaw,pitch,sheet,x,y,w,h\n");
+
+    // Memory stays at one sheet per size however many compounds there are.
+    int perSheet = (opt->cols * opt->rows) / opt->views;
+    ThumbBatch batch = { opt, lib, 0, 0, {0} };
+    for(int k = 0; k < opt->sizeCount; k++){
+        size_t pixels = (size_t)opt->cols * opt->sizes[k] * (size_t)opt->rows * opt->sizes[k];
+        batch.sheets[k] = malloc(pixels * sizeof(uint32_t));
+        if(!batch.sheets[k]){
+            fprintf(stderr, "thumbnails: out of memory for %dx%d sheets of %d px\n", opt->cols, opt->rows, opt->sizes[k]);
+            for(int j = 0; j < k; j++) free(batch.sheets[j]);
+            fclose(index);
+            return 1;
+        }
+    }
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    bool ok = true;
+    int sheetCount = 0;
+    for(int first = 0; first < lib->count && ok; first += perSheet){
+        int sheet = sheetCount++;
+        batch.first = first;
+        batch.count = lib->count - first < perSheet ? lib->count - first : perSheet;
+        int usedRows = (batch.count * opt->views + opt->cols - 1) / opt->cols;
+        for(int k = 0; k < opt->sizeCount; k++){
+            Canvas whole = { batch.sheets[k], opt->cols * opt->sizes[k], usedRows * opt->sizes[k], opt->cols * opt->sizes[k] };
+            canvas_clear(&whole, THUMB_BACKGROUND);
+        }
+
+        parallel_for(batch.count, 1, render_batch, &batch);
+
+        for(int k = 0; k < opt->sizeCount && ok; k++){
+            int size = opt->sizes[k];
+            ok = write_sheet(opt->outDir, size, sheet, batch.sheets[k], opt->cols * size, usedRows * size);
+            for(int i = 0; i < batch.count; i++){
+                for(int v = 0; v < opt->views; v++){
+                    int cell = i * opt->views + v;
+                    fprintf(index, "%d,", first + i);
+                    write_csv_name(index, lib->entries[first + i].name);
+                    fprintf(index, ",%d,%d,%.6f,%.6f,sheet_%d_%04d.png,%d,%d,%d,%d\n", size, v,
+                            2.0 * PI * v / opt->views, opt->pitch, size, sheet,
+                            (cell % opt->cols) * size, (cell / opt->cols) * size, size, size);
+                }
+            }
+        }
+    }
+    double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    if(fclose(index) != 0) ok = false;
+    for(int k = 0; k < opt->sizeCount; k++) free(batch.sheets[k]);
+
+    if(!ok){
+        fprintf(stderr, "thumbnails: write to %s failed\n", opt->outDir);
+        return 1;
+    }
+    long long total = (long long)lib->count * opt->views * opt->sizeCount;
+    printf("thumbnails: %lld thumbnails of %d compounds in %d sheet(s) per size, %.2f s (%.0f/s on %d threads)\n",
+           total, lib->count, sheetCount, seconds, seconds > 0.0 ? total / seconds : 0.0, thread_pool_size());
+    return 0;
+}
+
+int thumbnails_main(int argc, char **argv){
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0){
+            print_thumbnails_usage();
+            return 0;
+        }
+    }
+    ThumbOptions opt;
+    if(!parse_thumbnail_options(argc, argv, &opt)){
+        print_thumbnails_usage();
+        return 2;
+    }
+
+    Library lib;
+    library_init(&lib);
+    char error[256] = "out of memory";
+    bool loaded = opt.libraryPath ? library_load_xyz(&lib, opt.libraryPath, error, sizeof(error))
+                                  : library_add_builtin(&lib);
+    if(!loaded){
+        fprintf(stderr, "thumbnails: %s\n", error);
+        library_free(&lib);
+        return 1;
+    }
+    int status = run_thumbnails(&opt, &lib);
+    library_free(&lib);
+    thread_pool_shutdown();
+    return status;
+}
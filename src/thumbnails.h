@@ -0,0 +1,11 @@
+#ifndef ATLAS_THUMBNAILS_H
+#define ATLAS_THUMBNAILS_H
+
+// `pk_rk4 thumbnails`: renders every compound (the built-in set or an XYZ
+// library) from several yaw angles at one or more sizes into PNG sprite
+// sheets, plus an index.csv locating each thumbnail. Headless; cells are
+// rasterized on the CPU across the worker pool. argv[0] is "thumbnails".
+// Returns a process exit code.
+int thumbnails_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,57 @@
+#include "watch.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+bool file_watch_open(FileWatch *w, const char *path){
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if(slash){
+        size_t n = (size_t)(slash - path);
+        if(n == 0) n = 1; // a file in "/"
+        if(n >= sizeof(dir)) return false;
+        memcpy(dir, path, n);
+        dir[n] = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+    const char *name = slash ? slash + 1 : path;
+    if(!*name || strlen(name) >= sizeof(w->name)) return false;
+    snprintf(w->name, sizeof(w->name), "%s", name);
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(w->fd < 0) return false;
+    w->wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(w->wd < 0){
+        file_watch_close(w);
+        return false;
+    }
+    return true;
+}
+
+void file_watch_close(FileWatch *w){
+    if(w->fd >= 0) close(w->fd);
+    w->fd = -1;
+}
+
+bool file_watch_changed(FileWatch *w){
+    if(w->fd < 0) return false;
+    bool changed = false;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for(;;){
+        ssize_t n = read(w->fd, buffer, sizeof(buffer));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+        for(char *p = buffer; p < buffer + n;){
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if(ev->len && strcmp(ev->name, w->name) == 0) changed = true;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,23 @@
+#ifndef ATLAS_WATCH_H
+#define ATLAS_WATCH_H
+
+#include <stdbool.h>
+
+// Change notification for one file through inotify. The directory is
+// watched rather than the file, so editors that save by writing a new file
+// and renaming it over the old one are seen too.
+
+typedef struct {
+    int fd;        // nonblocking inotify descriptor, for poll(); -1 when closed
+    int wd;
+    char name[256]; // the file's name within the watched directory
+} FileWatch;
+
+bool file_watch_open(FileWatch *w, const char *path);
+void file_watch_close(FileWatch *w);
+
+// Drains pending events without blocking. True if the file was written and
+// closed, or replaced, since the last call.
+bool file_watch_changed(FileWatch *w);
+
+#endif